@@ -7,6 +7,8 @@
 #     EXTRA_SOURCES         <.c/.h files>
 #     NO_TESTS_FOR_NOW      ON/OFF
 # )
+# a `bench_<target name>.c` next to the target is built as
+# `bench_<target name>` when `enable_benchmarking` is ON
 
 function (c_create_targets target_name)
     set(multiValueArgs TARGETS
@@ -54,4 +56,14 @@ function (c_create_targets target_name)
             COMMAND test_${target_name}
         )
     endif()
+
+    # add benchmarks
+    if(enable_benchmarking AND EXISTS ${CMAKE_CURRENT_SOURCE_DIR}/bench_${target_name}.c)
+        add_executable(bench_${target_name} bench_${target_name}.c)
+        target_link_libraries(bench_${target_name}
+            PRIVATE
+                ${target_name}
+                ${C_TARGET_TESTING_LIBS}
+        )
+    endif()
 endfunction()
\ No newline at end of file
@@ -0,0 +1,744 @@
+#include <cbuild_db_private.h>
+#include <cbuild_glob_private.h>
+#include <cbuild_paths_private.h>
+#include <cbuild_private.h>
+#include <cbuild_scan_private.h>
+#include <cbuild_stat_private.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
+
+#define BENCH_DIRS_LEN 500
+#define BENCH_FILES_PER_DIR 100
+#define BENCH_ROUNDS 5
+#define BENCH_OBJECTS_LEN 5000
+#define BENCH_OBJECTS_PER_CC 250
+#define BENCH_SCAN_SOURCES 1000
+#define BENCH_SCAN_HEADERS 500
+#define BENCH_SCAN_INCLUDES 10 // per source
+#define BENCH_SCAN_LEAVES 100   // the last headers, the others include 3
+#define BENCH_TARGETS_LEN 20000
+#define BENCH_ALLOC_TARGETS 10000
+#define BENCH_ALLOC_SOURCES 5 // per target, from the stat tree
+
+// the allocations are counted by wrapping the ones of glibc, a sanitizer
+// brings its own
+#if defined(__SANITIZE_ADDRESS__)
+#define BENCH_HAS_SANITIZER 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer)
+#define BENCH_HAS_SANITIZER 1
+#endif
+#endif
+#if defined(__GLIBC__) && !defined(BENCH_HAS_SANITIZER)
+#define BENCH_COUNT_ALLOCS 1
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* data, size_t size);
+
+static size_t bench_allocs = 0;
+
+void*
+malloc(size_t size)
+{
+  __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+  return __libc_malloc(size);
+}
+
+void*
+calloc(size_t count, size_t size)
+{
+  __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+  return __libc_calloc(count, size);
+}
+
+void*
+realloc(void* data, size_t size)
+{
+  __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+  return __libc_realloc(data, size);
+}
+#endif
+
+static double
+bench_now(void)
+{
+#ifdef _WIN32
+  return (double)clock() / CLOCKS_PER_SEC;
+#else
+  // wall time, the threads and the ring mostly wait
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+#endif
+}
+
+/// <root>/d<i>/f<j>.h, kept between runs
+static char**
+bench_create_tree(char const root[], size_t* out_paths_len)
+{
+  size_t const paths_len = BENCH_DIRS_LEN * BENCH_FILES_PER_DIR;
+  char**       paths     = calloc(paths_len, sizeof(char*));
+  if (!paths) { return NULL; }
+
+#ifdef _WIN32
+  _mkdir(root);
+#else
+  mkdir(root, 0755);
+#endif
+
+  char path[1024];
+  for (size_t iii = 0; iii < BENCH_DIRS_LEN; ++iii) {
+    snprintf(path, sizeof(path), "%s/d%zu", root, iii);
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+
+    for (size_t jjj = 0; jjj < BENCH_FILES_PER_DIR; ++jjj) {
+      snprintf(path, sizeof(path), "%s/d%zu/f%zu.h", root, iii, jjj);
+      paths[iii * BENCH_FILES_PER_DIR + jjj] = strdup(path);
+
+      FILE* file = fopen(path, "r");
+      if (!file) { file = fopen(path, "w"); }
+      if (file) { fclose(file); }
+    }
+  }
+
+  *out_paths_len = paths_len;
+
+  return paths;
+}
+
+/// cold metadata caches, linux and root only
+static void
+bench_drop_caches(void)
+{
+  FILE* file = fopen("/proc/sys/vm/drop_caches", "w");
+  if (file) {
+    fputs("3\n", file);
+    fclose(file);
+  }
+}
+
+/// <root>/o<i>.c and their objects, main.c calls every one of them and
+/// <root>/objects.rsp lists all of them for the link. kept between runs
+static bool
+bench_create_objects(char const root[])
+{
+#ifdef _WIN32
+  _mkdir(root);
+#else
+  mkdir(root, 0755);
+#endif
+
+  char  path[1024];
+  char  cmd[16 * 1024];
+  FILE* main_file = NULL;
+  FILE* rsp_file  = NULL;
+
+  snprintf(path, sizeof(path), "%s/objects.rsp", root);
+  if ((rsp_file = fopen(path, "r")) != NULL) {
+    fclose(rsp_file);
+    return true;
+  }
+
+  snprintf(path, sizeof(path), "%s/main.c", root);
+  main_file = fopen(path, "w");
+  if (!main_file) { return false; }
+  fputs("int main(void)\n{\n  int sum = 0;\n", main_file);
+
+  for (size_t iii = 0; iii < BENCH_OBJECTS_LEN; ++iii) {
+    snprintf(path, sizeof(path), "%s/o%zu.c", root, iii);
+    FILE* file = fopen(path, "w");
+    if (!file) {
+      fclose(main_file);
+      return false;
+    }
+    fprintf(file,
+            "static int table[64] = {%zu};\n"
+            "int f%zu(int x) { return table[x & 63] + x * %zu; }\n",
+            iii, iii, iii);
+    fclose(file);
+
+    fprintf(main_file, "  extern int f%zu(int);\n  sum += f%zu(sum);\n", iii,
+            iii);
+  }
+  fputs("  return sum & 1;\n}\n", main_file);
+  fclose(main_file);
+
+  // a compiler per batch, the link is what gets measured
+  for (size_t iii = 0; iii < BENCH_OBJECTS_LEN; iii += BENCH_OBJECTS_PER_CC) {
+    int len = snprintf(cmd, sizeof(cmd), "cd %s && cc -c", root);
+    for (size_t jjj = iii;
+         jjj < iii + BENCH_OBJECTS_PER_CC && jjj < BENCH_OBJECTS_LEN; ++jjj) {
+      len += snprintf(&cmd[len], sizeof(cmd) - (size_t)len, " o%zu.c", jjj);
+    }
+    if (system(cmd) != 0) { return false; }
+  }
+  snprintf(cmd, sizeof(cmd), "cd %s && cc -c main.c", root);
+  if (system(cmd) != 0) { return false; }
+
+  snprintf(path, sizeof(path), "%s/objects.rsp", root);
+  rsp_file = fopen(path, "w");
+  if (!rsp_file) { return false; }
+  for (size_t iii = 0; iii < BENCH_OBJECTS_LEN; ++iii) {
+    fprintf(rsp_file, "o%zu.o\n", iii);
+  }
+  fputs("main.o\n", rsp_file);
+  fclose(rsp_file);
+
+  return true;
+}
+
+/// link the objects of `root` with every linker `c build --linker` knows
+static int
+bench_link(char const root[])
+{
+  char const* const linkers[] = {"default", "gold", "lld", "mold"};
+
+  if (!bench_create_objects(root)) { return EXIT_FAILURE; }
+
+  printf("%d objects under %s, best of %d rounds\n", BENCH_OBJECTS_LEN + 1,
+         root, BENCH_ROUNDS);
+  printf("%-10s %10s\n", "linker", "ms");
+  for (size_t iii = 0; iii < sizeof(linkers) / sizeof(*linkers); ++iii) {
+    char cmd[1024];
+    snprintf(cmd, sizeof(cmd),
+             "cd %s && cc %s%s -o main @objects.rsp >/dev/null 2>&1", root,
+             iii > 0 ? "-fuse-ld=" : "", iii > 0 ? linkers[iii] : "");
+
+    double best = -1.0;
+    for (size_t rrr = 0; rrr < BENCH_ROUNDS; ++rrr) {
+      double const start   = bench_now();
+      int const    status  = system(cmd);
+      double const elapsed = bench_now() - start;
+      if (status != 0) { break; }
+
+      if (best < 0 || elapsed < best) { best = elapsed; }
+    }
+
+    if (best >= 0) {
+      printf("%-10s %10.2f\n", linkers[iii], best * 1e3);
+    } else {
+      printf("%-10s %10s\n", linkers[iii], "not installed");
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/// <root>/s<i>.c including headers of <root>/include and stdio.h, kept
+/// between runs
+static bool
+bench_create_sources(char const root[])
+{
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/include", root);
+#ifdef _WIN32
+  _mkdir(root);
+  _mkdir(path);
+#else
+  mkdir(root, 0755);
+  mkdir(path, 0755);
+#endif
+
+  for (size_t iii = 0; iii < BENCH_SCAN_HEADERS; ++iii) {
+    snprintf(path, sizeof(path), "%s/include/h%zu.h", root, iii);
+    FILE* file = fopen(path, "w");
+    if (!file) { return false; }
+    fprintf(file, "#ifndef H%zu\n#define H%zu\n", iii, iii);
+    for (size_t jjj = 1;
+         iii < BENCH_SCAN_HEADERS - BENCH_SCAN_LEAVES && jjj <= 3; ++jjj) {
+      fprintf(file, "#include \"h%zu.h\"\n",
+              BENCH_SCAN_HEADERS - BENCH_SCAN_LEAVES
+                  + (iii * 7 + jjj * 31) % BENCH_SCAN_LEAVES);
+    }
+    fprintf(file, "int h%zu(int x);\n#endif\n", iii);
+    fclose(file);
+  }
+
+  for (size_t iii = 0; iii < BENCH_SCAN_SOURCES; ++iii) {
+    snprintf(path, sizeof(path), "%s/s%zu.c", root, iii);
+    FILE* file = fopen(path, "w");
+    if (!file) { return false; }
+    fputs("#include <stdio.h>\n", file);
+    for (size_t jjj = 0; jjj < BENCH_SCAN_INCLUDES; ++jjj) {
+      fprintf(file, "#include <h%zu.h>\n",
+              (iii * 13 + jjj * 37) % BENCH_SCAN_HEADERS);
+    }
+    fprintf(file, "int s%zu(void) { return printf(\"%zu\"); }\n", iii, iii);
+    fclose(file);
+  }
+
+  return true;
+}
+
+/// headers of every source of `root` through the scanner, with a fresh
+/// cache and a kept one, then through the preprocessor
+static int
+bench_scan(char const root[])
+{
+  if (!bench_create_sources(root)) { return EXIT_FAILURE; }
+
+  char include_dir[1024];
+  snprintf(include_dir, sizeof(include_dir), "%s/include", root);
+  char const* include_dir_ptr = include_dir;
+  CArray      include_dirs;
+  if (c_array_create(sizeof(char const*), &include_dirs).code != 0
+      || c_array_push(&include_dirs, &include_dir_ptr).code != 0) {
+    return EXIT_FAILURE;
+  }
+
+  CBuildScanner scanner;
+  if (cbuild_scanner_create(&scanner).code != 0) { return EXIT_FAILURE; }
+
+  printf("%d sources under %s, best of %d rounds\n", BENCH_SCAN_SOURCES,
+         root, BENCH_ROUNDS);
+  printf("%-10s %10s %12s\n", "scan", "ms", "headers");
+  char const* const names[] = {"cold", "warm"};
+  for (size_t iii = 0; iii < 2; ++iii) {
+    double best        = -1.0;
+    size_t headers_len = 0;
+    for (size_t rrr = 0; rrr < BENCH_ROUNDS; ++rrr) {
+      // a cold round starts from an empty cache every time
+      if (iii == 0) {
+        cbuild_scanner_destroy(&scanner);
+        if (cbuild_scanner_create(&scanner).code != 0) {
+          return EXIT_FAILURE;
+        }
+      }
+
+      headers_len        = 0;
+      double const start = bench_now();
+      for (size_t jjj = 0; jjj < BENCH_SCAN_SOURCES; ++jjj) {
+        char path[1024];
+        int  len = snprintf(path, sizeof(path), "%s/s%zu.c", root, jjj);
+
+        CArray headers;
+        CError err = cbuild_scanner_headers(&scanner, path, (size_t)len,
+                                            &include_dirs, &headers, NULL);
+        if (err.code != 0) {
+          printf("%-10s %s\n", names[iii], err.desc);
+          return EXIT_FAILURE;
+        }
+        headers_len += headers.len;
+        for (size_t kkk = 0; kkk < headers.len; ++kkk) {
+          c_str_destroy(&((CStr*)headers.data)[kkk]);
+        }
+        c_array_destroy(&headers);
+      }
+      double const elapsed = bench_now() - start;
+
+      if (best < 0 || elapsed < best) { best = elapsed; }
+    }
+    printf("%-10s %10.2f %12zu\n", names[iii], best * 1e3, headers_len);
+  }
+
+  cbuild_scanner_destroy(&scanner);
+  c_array_destroy(&include_dirs);
+
+  // one preprocessor for all of them, the best case for it
+  char cmd[64 * 1024];
+  int  len = snprintf(cmd, sizeof(cmd), "cd %s && cc -MM -Iinclude", root);
+  for (size_t iii = 0; iii < BENCH_SCAN_SOURCES; ++iii) {
+    len += snprintf(&cmd[len], sizeof(cmd) - (size_t)len, " s%zu.c", iii);
+  }
+  snprintf(&cmd[len], sizeof(cmd) - (size_t)len, " >/dev/null 2>&1");
+
+  double best = -1.0;
+  for (size_t rrr = 0; rrr < BENCH_ROUNDS; ++rrr) {
+    double const start   = bench_now();
+    int const    status  = system(cmd);
+    double const elapsed = bench_now() - start;
+    if (status != 0) { break; }
+
+    if (best < 0 || elapsed < best) { best = elapsed; }
+  }
+  if (best >= 0) {
+    printf("%-10s %10.2f\n", "cc -MM", best * 1e3);
+  } else {
+    printf("%-10s %10s\n", "cc -MM", "failed");
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/// `<root>/**/*.h` over the stat tree, with a fresh database and with the
+/// listings kept by the previous round
+static int
+bench_glob(char const root[])
+{
+  size_t paths_len = 0;
+  char** paths     = bench_create_tree(root, &paths_len);
+  if (!paths) { return EXIT_FAILURE; }
+  for (size_t iii = 0; iii < paths_len; ++iii) {
+    free(paths[iii]);
+  }
+  free(paths);
+
+  char pattern[1024];
+  int  pattern_len = snprintf(pattern, sizeof(pattern), "%s/**/*.h", root);
+
+  CBuildDb db;
+  if (cbuild_db_create(&db).code != 0) { return EXIT_FAILURE; }
+
+  printf("%zu files under %s, best of %d rounds\n", paths_len, root,
+         BENCH_ROUNDS);
+  printf("%-10s %10s %12s\n", "glob", "ms", "matches");
+  char const* const names[] = {"cold", "warm"};
+  for (size_t iii = 0; iii < 2; ++iii) {
+    double best        = -1.0;
+    size_t matches_len = 0;
+    for (size_t rrr = 0; rrr < BENCH_ROUNDS; ++rrr) {
+      // a cold round lists every directory again
+      if (iii == 0) {
+        cbuild_db_destroy(&db);
+        if (cbuild_db_create(&db).code != 0) { return EXIT_FAILURE; }
+      }
+
+      CArray       matches;
+      double const start   = bench_now();
+      CError const err     = cbuild_glob(&db, ".", 1, pattern,
+                                         (size_t)pattern_len, &matches);
+      double const elapsed = bench_now() - start;
+      if (err.code != 0) {
+        printf("%-10s %s\n", names[iii], err.desc);
+        return EXIT_FAILURE;
+      }
+
+      matches_len = matches.len;
+      for (size_t jjj = 0; jjj < matches.len; ++jjj) {
+        c_str_destroy(&((CStr*)matches.data)[jjj]);
+      }
+      c_array_destroy(&matches);
+
+      if (best < 0 || elapsed < best) { best = elapsed; }
+    }
+    printf("%-10s %10.2f %12zu\n", names[iii], best * 1e3, matches_len);
+  }
+
+  cbuild_db_destroy(&db);
+
+  return EXIT_SUCCESS;
+}
+
+/// peak resident memory of the process in KB, 0 if unknown
+static long
+bench_peak_memory(void)
+{
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+  return usage.ru_maxrss;
+#endif
+}
+
+/// every file of the stat tree as a source of one target, the memory the
+/// targets keep before anything is built
+static int
+bench_configure(char const root[])
+{
+  size_t paths_len = 0;
+  char** paths     = bench_create_tree(root, &paths_len);
+  if (!paths) { return EXIT_FAILURE; }
+
+  long const   peak_before = bench_peak_memory();
+  double const start       = bench_now();
+
+  CBuild  cbuild;
+  CTarget target;
+  CError  err = cbuild_create(CBUILD_TYPE_debug, ".", 1, &cbuild);
+  if (err.code == 0) {
+    err = cbuild_exe_create(&cbuild, "bench", 5, ".", 1, &target);
+  }
+  // twice, like targets sharing their sources
+  for (size_t iii = 0; err.code == 0 && iii < 2 * paths_len; ++iii) {
+    char const* path = paths[iii % paths_len];
+    err = cbuild_target_add_source(&cbuild, &target, path, strlen(path));
+  }
+  if (err.code != 0) {
+    printf("configure %s\n", err.desc);
+    return EXIT_FAILURE;
+  }
+
+  double const elapsed    = bench_now() - start;
+  long const   peak_after = bench_peak_memory();
+
+  printf("%zu sources under %s\n", 2 * paths_len, root);
+  printf("%-10s %10s %12s %12s\n", "configure", "ms", "peak KB", "paths KB");
+  printf("%-10s %10.2f %12ld %12zu\n", "add", elapsed * 1e3,
+         peak_after - peak_before, cbuild.impl->paths->arena.bytes / 1024);
+
+  cbuild_destroy(&cbuild);
+  for (size_t iii = 0; iii < paths_len; ++iii) {
+    free(paths[iii]);
+  }
+  free(paths);
+
+  return EXIT_SUCCESS;
+}
+
+/// lookups of every target by name, one at a time then in one batch, like
+/// a generated build script with thousands of targets
+static int
+bench_targets(void)
+{
+  char**   names   = calloc(BENCH_TARGETS_LEN, sizeof(char*));
+  CTarget* targets = calloc(BENCH_TARGETS_LEN, sizeof(CTarget));
+  if (!names || !targets) { return EXIT_FAILURE; }
+
+  CBuild cbuild;
+  CError err = cbuild_create(CBUILD_TYPE_debug, ".", 1, &cbuild);
+  for (size_t iii = 0; err.code == 0 && iii < BENCH_TARGETS_LEN; ++iii) {
+    names[iii] = malloc(32);
+    if (!names[iii]) { return EXIT_FAILURE; }
+    snprintf(names[iii], 32, "target_%zu", iii);
+    err = cbuild_object_create(&cbuild, names[iii], strlen(names[iii]), ".",
+                               1, &targets[iii]);
+  }
+  if (err.code != 0) {
+    printf("create %s\n", err.desc);
+    return EXIT_FAILURE;
+  }
+
+  double start = bench_now();
+  for (size_t iii = 0; err.code == 0 && iii < BENCH_TARGETS_LEN; ++iii) {
+    CTarget target;
+    err = cbuild_target_get(&cbuild, names[iii], strlen(names[iii]), &target);
+  }
+  double const get_elapsed = bench_now() - start;
+
+  start = bench_now();
+  if (err.code == 0) {
+    err = cbuild_targets_get(&cbuild, (char const* const*)names,
+                             BENCH_TARGETS_LEN, targets);
+  }
+  double const batch_elapsed = bench_now() - start;
+
+  start = bench_now();
+  cbuild_destroy(&cbuild);
+  double const destroy_elapsed = bench_now() - start;
+
+  if (err.code != 0) {
+    printf("get %s\n", err.desc);
+    return EXIT_FAILURE;
+  }
+
+  printf("%d targets\n", BENCH_TARGETS_LEN);
+  printf("%-10s %10s %12s\n", "lookup", "ms", "targets/s");
+  printf("%-10s %10.2f %12.0f\n", "get", get_elapsed * 1e3,
+         BENCH_TARGETS_LEN / get_elapsed);
+  printf("%-10s %10.2f %12.0f\n", "batch", batch_elapsed * 1e3,
+         BENCH_TARGETS_LEN / batch_elapsed);
+  printf("%-10s %10.2f %12.0f\n", "destroy", destroy_elapsed * 1e3,
+         BENCH_TARGETS_LEN / destroy_elapsed);
+
+  for (size_t iii = 0; iii < BENCH_TARGETS_LEN; ++iii) {
+    free(names[iii]);
+  }
+  free(names);
+  free(targets);
+
+  return EXIT_SUCCESS;
+}
+
+/// targets of a generated project, with their sources and flags, and the
+/// allocations it takes to configure them
+static int
+bench_alloc(char const root[])
+{
+#ifndef BENCH_COUNT_ALLOCS
+  (void)root;
+  printf("allocations are only counted with glibc, without sanitizers\n");
+  return EXIT_FAILURE;
+#else
+  size_t paths_len = 0;
+  char** paths     = bench_create_tree(root, &paths_len);
+  if (!paths) { return EXIT_FAILURE; }
+
+  CBuild cbuild;
+  CError err = cbuild_create(CBUILD_TYPE_debug, ".", 1, &cbuild);
+  if (err.code != 0) {
+    printf("create %s\n", err.desc);
+    return EXIT_FAILURE;
+  }
+
+  long const   peak_before   = bench_peak_memory();
+  size_t const allocs_before = bench_allocs;
+  double const start         = bench_now();
+
+  char    name[32];
+  CTarget previous = {0};
+  for (size_t iii = 0; err.code == 0 && iii < BENCH_ALLOC_TARGETS; ++iii) {
+    CTarget target;
+    snprintf(name, sizeof(name), "target_%zu", iii);
+    err = cbuild_static_lib_create(&cbuild, name, strlen(name), ".", 1,
+                                   &target);
+    for (size_t jjj = 0; err.code == 0 && jjj < BENCH_ALLOC_SOURCES; ++jjj) {
+      char const* path = paths[(iii * BENCH_ALLOC_SOURCES + jjj) % paths_len];
+      err = cbuild_target_add_source(&cbuild, &target, path, strlen(path));
+    }
+    if (err.code == 0) {
+      err = cbuild_target_add_compile_flag(&cbuild, &target, "-Wall -Wextra",
+                                           13);
+    }
+    if (err.code == 0) {
+      err = cbuild_target_add_include_path_flag(&cbuild, &target, "include",
+                                                7);
+    }
+    if (err.code == 0 && previous.impl) {
+      err = cbuild_target_depends_on(&cbuild, &target, &previous,
+                                     CTARGET_PROPERTY_include_path);
+    }
+    previous = target;
+  }
+  if (err.code != 0) {
+    printf("configure %s\n", err.desc);
+    return EXIT_FAILURE;
+  }
+
+  double const elapsed    = bench_now() - start;
+  size_t const allocs     = bench_allocs - allocs_before;
+  long const   peak_after = bench_peak_memory();
+
+  printf("%d targets, %d sources each under %s\n", BENCH_ALLOC_TARGETS,
+         BENCH_ALLOC_SOURCES, root);
+  printf("%-10s %10s %12s %12s %12s\n", "configure", "ms", "allocs",
+         "per target", "peak KB");
+  printf("%-10s %10.2f %12zu %12.1f %12ld\n", "targets", elapsed * 1e3, allocs,
+         (double)allocs / BENCH_ALLOC_TARGETS, peak_after - peak_before);
+
+  cbuild_destroy(&cbuild);
+  for (size_t iii = 0; iii < paths_len; ++iii) {
+    free(paths[iii]);
+  }
+  free(paths);
+
+  return EXIT_SUCCESS;
+#endif
+}
+
+/// bench_cbuild [--cold] [<tree root>]
+/// bench_cbuild --link [<objects root>]
+/// bench_cbuild --scan [<sources root>]
+/// bench_cbuild --glob [<tree root>]
+/// bench_cbuild --configure [<tree root>]
+/// bench_cbuild --targets
+/// bench_cbuild --alloc [<tree root>]
+int
+main(int argc, char* argv[])
+{
+  char const* root    = NULL;
+  bool        is_cold = false;
+  bool        is_link = false;
+  bool        is_scan = false;
+  bool        is_glob = false;
+  bool        is_conf = false;
+  bool        is_tgts = false;
+  bool        is_allc = false;
+  for (int iii = 1; iii < argc; ++iii) {
+    if (strcmp(argv[iii], "--cold") == 0) {
+      is_cold = true;
+    } else if (strcmp(argv[iii], "--link") == 0) {
+      is_link = true;
+    } else if (strcmp(argv[iii], "--scan") == 0) {
+      is_scan = true;
+    } else if (strcmp(argv[iii], "--glob") == 0) {
+      is_glob = true;
+    } else if (strcmp(argv[iii], "--configure") == 0) {
+      is_conf = true;
+    } else if (strcmp(argv[iii], "--targets") == 0) {
+      is_tgts = true;
+    } else if (strcmp(argv[iii], "--alloc") == 0) {
+      is_allc = true;
+    } else {
+      root = argv[iii];
+    }
+  }
+
+  if (is_link) { return bench_link(root ? root : "c_bench_link_tree"); }
+  if (is_scan) { return bench_scan(root ? root : "c_bench_scan_tree"); }
+  if (is_tgts) { return bench_targets(); }
+  if (!root) { root = "c_bench_stat_tree"; }
+  if (is_glob) { return bench_glob(root); }
+  if (is_conf) { return bench_configure(root); }
+  if (is_allc) { return bench_alloc(root); }
+
+  struct {
+    CBuildStatImpl impl;
+    char const*    name;
+  } const impls[] = {
+      {CBUILD_STAT_IMPL_serial, "serial"},
+      {CBUILD_STAT_IMPL_threads, "threads"},
+      {CBUILD_STAT_IMPL_io_uring, "io_uring"},
+      {CBUILD_STAT_IMPL_auto, "auto"},
+  };
+
+  size_t paths_len = 0;
+  char** paths     = bench_create_tree(root, &paths_len);
+  if (!paths) { return EXIT_FAILURE; }
+
+  CBuildFileState* states = calloc(paths_len, sizeof(CBuildFileState));
+  if (!states) { return EXIT_FAILURE; }
+
+  printf("%zu files under %s, best of %d rounds (%s cache)\n", paths_len,
+         root, BENCH_ROUNDS, is_cold ? "cold" : "warm");
+  printf("%-10s %10s %12s\n", "impl", "ms", "files/s");
+  for (size_t iii = 0; iii < sizeof(impls) / sizeof(*impls); ++iii) {
+    double best = -1.0;
+
+    for (size_t rrr = 0; rrr < BENCH_ROUNDS; ++rrr) {
+      memset(states, 0, paths_len * sizeof(CBuildFileState));
+      if (is_cold) { bench_drop_caches(); }
+
+      double const start = bench_now();
+      CError const err   = cbuild_stat_many((char const* const*)paths,
+                                            paths_len, states, impls[iii].impl);
+      double const elapsed = bench_now() - start;
+      if (err.code != 0) {
+        printf("%-10s %s\n", impls[iii].name, err.desc);
+        break;
+      }
+
+      size_t existing = 0;
+      for (size_t jjj = 0; jjj < paths_len; ++jjj) {
+        existing += states[jjj].exists;
+      }
+      if (existing != paths_len) {
+        printf("%-10s missed %zu files\n", impls[iii].name,
+               paths_len - existing);
+        return EXIT_FAILURE;
+      }
+
+      if (best < 0 || elapsed < best) { best = elapsed; }
+    }
+
+    if (best >= 0) {
+      printf("%-10s %10.2f %12.0f\n", impls[iii].name, best * 1e3,
+             (double)paths_len / best);
+    }
+  }
+
+  for (size_t iii = 0; iii < paths_len; ++iii) {
+    free(paths[iii]);
+  }
+  free(paths);
+  free(states);
+
+  return EXIT_SUCCESS;
+}
@@ -1,11 +1,19 @@
 #include "cbuild.h"
+#include "cbuild_arena_private.h"
+#include "cbuild_db_private.h"
+#include "cbuild_glob_private.h"
+#include "cbuild_paths_private.h"
 #include "cbuild_private.h"
+#include "cbuild_scan_private.h"
+#include "cbuild_scheduler_private.h"
+#include "cbuild_toc_private.h"
 #include "cbuilder_private.h"
 #include "cerror.h"
 #include "cprocess.h"
 #include "helpers.h"
 
 #include <assert.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,8 +34,53 @@
 
 static char const default_builder_path[] = ".c_build";
 static char const default_install_path[] = "c_out";
+static char const default_db_name[]      = "c_build.db";
+
+// output roots are split per build type, so switching between them
+// never throws away the work of the other ones
+static struct {
+  char const* name;
+  char const* alias;
+} const build_type_names[] = {
+    [CBUILD_TYPE_none]                      = {"none", "none"},
+    [CBUILD_TYPE_debug]                     = {"debug", "debug"},
+    [CBUILD_TYPE_release]                   = {"release", "release"},
+    [CBUILD_TYPE_release_with_debug_info]   = {"release_with_debug_info",
+                                               "relwithdebinfo"},
+    [CBUILD_TYPE_release_with_minimum_size] = {"release_with_minimum_size",
+                                               "minsizerel"},
+};
+// every stage of a profile guided build keeps its own output roots, the
+// profiles live in `<config>_pgo_profile`
+static char const* const pgo_config_suffixes[] = {
+    [CBUILD_PGO_none]     = "",
+    [CBUILD_PGO_generate] = "_pgo_generate",
+    [CBUILD_PGO_use]      = "_pgo_use",
+};
+static char const pgo_profile_suffix[] = "_pgo_profile";
+static char const pgo_profile_name[]   = "merged";
+// `auto` picks the first one installed after `default`, fastest first
+static char const* const linker_names[] = {
+    [CBUILD_LINKER_default] = "default",
+    [CBUILD_LINKER_mold]    = "mold",
+    [CBUILD_LINKER_lld]     = "lld",
+    [CBUILD_LINKER_gold]    = "gold",
+    [CBUILD_LINKER_auto]    = "auto",
+};
+static char const default_linker_cache_name[] = "linker";
+static char const toc_extension[]             = ".toc";
+static char const archive_members_extension[] = ".members";
 #define default_build_c_target_name "_"
 #define MAX_BUILD_FUNCTION_NAME_LEN 1000
+// a hundred targets per block
+#define CBUILD_ARENA_BLOCK_SIZE (64 * 1024)
+
+/// a source going into a unity batch, sorted by batch then by position so
+/// the batches are written one after the other
+typedef struct CBuildUnitySource {
+  size_t batch;
+  size_t position; // inside `sources`
+} CBuildUnitySource;
 #ifdef _WIN32
 static char const default_pic_flag[] = "";
 #else
@@ -52,16 +105,190 @@ static char const lib_prefix[]    = "lib";
   c_defer_check(str_err.code == 0, c_str_destroy, &impl->lflags,               \
                 err = CERROR_internal_error(str_err.desc));
 
-static CError       internal_cbuild_get_path(CTargetImpl* target,
-                                             char const   build_install_dir_name[],
+static CError       internal_cbuild_get_path(CBuildImpl*  cbuild,
+                                             CTargetImpl* target,
+                                             char const   root_dir_name[],
                                              CStr*        out_path);
-static c_fs_error_t internal_find_and_push_all_compiled_objects_handler(
-    char path[], size_t path_len, void* extra_data);
 static CError       internal_compile_install_build_c(CBuild* self,
                                                      CStr*   out_cbuild_dll_dir,
                                                      CStr*   build_fn_name);
-static c_fs_error_t internal_find_and_push_all_compiled_objects_cstr_handler(
+static bool         internal_cbuild_is_object(CStr const* source);
+static CError       internal_cbuild_push_dependency_objects(
+          CBuildImpl* cbuild, CTargetImpl* target, CTargetImpl* dependency,
+          CArray* objects);
+static CError       internal_cbuild_target_get_object_path(CTargetImpl* target,
+                                                           CStr const*  source,
+                                                           CStr* out_object);
+static CError       internal_cbuild_target_get_output_path(CTargetImpl* target,
+                                                           CStr* out_output);
+static CError       internal_cbuild_target_get_meta_path(CTargetImpl* target,
+                                                         char const extension[],
+                                                         CStr*      out_path);
+static CError       internal_cbuild_archive_prepare(CBuildImpl*   cbuild,
+                                                    CTargetImpl*  target,
+                                                    CStr const*   output,
+                                                    CArray const* objects,
+                                                    CHash128      prefix_hash,
+                                                    size_t        objects_at,
+                                                    CArray*       cmd);
+static CError       internal_cbuild_archive_write_members(
+          CBuildImpl* cbuild, CTargetImpl* target, CArray const* objects,
+          CHash128 prefix_hash);
+static int          internal_cbuild_compare_strings(void const* lhs,
+                                                    void const* rhs);
+static CError       internal_cbuild_write_toc(CBuildImpl*  cbuild,
+                                              CTargetImpl* target,
+                                              CStr const*  output);
+static CError       internal_cbuild_target_get_pch_paths(CTargetImpl* target,
+                                                         CStr* out_include,
+                                                         CStr* out_pch);
+static CError       internal_cbuild_write_if_changed(CBuildImpl* cbuild,
+                                                     CStr const* path,
+                                                     CStr const* content);
+static CError       internal_cbuild_exec(CArray const* cmd,
+                                         CBuildArena*  scratch);
+static CError       internal_cbuild_exec_compile(CBuild*       self,
+                                                 CTargetImpl*  target,
+                                                 CArray const* cmd,
+                                                 CStr const*   source,
+                                                 CStr const*   output,
+                                                 CStr const*   dwo,
+                                                 CStr const*   pch,
+                                                 CBuildArena*  scratch);
+static CError       internal_cbuild_compile_fingerprint(CBuild*       self,
+                                                        CTargetImpl*  target,
+                                                        CArray const* cmd,
+                                                        CStr const*   source,
+                                                        CStr const*   object,
+                                                        CStr const*   pch,
+                                                        CHash128* out_hash);
+static CError       internal_cbuild_scanned_headers_hash(CBuildImpl*   cbuild,
+                                                         CArray const* cmd,
+                                                         CStr const*   source,
+                                                         CHash128* inout_hash);
+static CError       internal_cbuild_push_include_dirs(CArray const* cmd,
+                                                      CArray* include_dirs);
+static CError       internal_cbuild_command_fingerprint(
+          CBuildImpl* cbuild, CBuildCommand const* command, CArray const* cmd,
+          CHash128* out_hash);
+static CError       internal_cbuild_command_create_paths(CBuildImpl* cbuild);
+static bool         internal_cbuild_is_generated(CBuildImpl* cbuild,
+                                                 CStr const* path);
+static bool         internal_cbuild_path_has_name(CStr const* path,
+                                                  CStr const* name);
+static void         internal_cbuild_command_destroy(CBuildCommand* command);
+static CError       internal_cbuild_link_fingerprint(CBuild*       self,
+                                                     CArray const* cmd,
+                                                     CArray const* objects,
+                                                     CTargetImpl*  target,
+                                                     CHash128*     out_hash);
+static CHash128     internal_cbuild_cmd_hash(CArray const* cmd);
+static bool         internal_cbuild_is_up_to_date(CBuild*     self,
+                                                  CStr const* output,
+                                                  CHash128    fingerprint);
+static void         internal_cbuild_objects_destroy(CArray* objects);
+static CError       internal_cbuild_push_flags(CStr* flags, CArray* cmd);
+static CError       internal_cbuild_push_arg(CBuildImpl* cbuild,
+                                             CArray*     args,
+                                             char const  arg[],
+                                             size_t      arg_len);
+static CError       internal_cbuild_push_args(CBuildImpl* cbuild,
+                                              CArray*     args,
+                                              char const  flags[],
+                                              size_t      flags_len);
+static CError       internal_cbuild_push_joined_arg(CBuildImpl*       cbuild,
+                                                    CArray*           args,
+                                                    char const* const parts[],
+                                                    size_t parts_len);
+static CError       internal_cbuild_push_all(CArray const* args, CArray* cmd);
+static CError       internal_cbuild_scratch_join(CBuildArena*      scratch,
+                                                 char const* const parts[],
+                                                 size_t            parts_len,
+                                                 CStr*             out_joined);
+static CError       internal_cbuild_intern_joined(CBuildImpl*       cbuild,
+                                                  char const* const parts[],
+                                                  size_t            parts_len,
+                                                  CStr*             out_joined);
+static CError       internal_cbuild_target_create_paths(CTargetImpl* target);
+static uint64_t     internal_cbuild_target_hash(char const name[],
+                                                size_t     name_len);
+static size_t       internal_cbuild_target_find(CBuildImpl* cbuild,
+                                                char const  name[],
+                                                size_t      name_len);
+static CError       internal_cbuild_get_project_path(CBuildImpl* self,
+                                                     char const  path[],
+                                                     size_t      path_len,
+                                                     CStr*       out_path);
+static CError       internal_cbuild_to_project_path(CBuildImpl* self,
+                                                    char const  path[],
+                                                    size_t      path_len,
+                                                    CStr*       out_path);
+static CError       internal_cbuild_target_set_units(CBuildImpl*  cbuild,
+                                                     CTargetImpl* target);
+static CError       internal_cbuild_target_set_objects(CBuildImpl*  cbuild,
+                                                       CTargetImpl* target);
+static CError       internal_cbuild_target_set_args(CBuildImpl*  cbuild,
+                                                    CTargetImpl* target);
+static CError       internal_cbuild_index_paths(CArray const* paths,
+                                                CHashIndex*   out_index);
+static CError       internal_cbuild_target_index(CTargetImpl* target);
+static bool         internal_cbuild_is_indexed(CArray const*     paths,
+                                               CHashIndex const* index,
+                                               CStr const*       path);
+static int          internal_cbuild_compare_unity_sources(void const* lhs,
+                                                          void const* rhs);
+static bool         internal_cbuild_is_share_excluded(CTargetImpl* target,
+                                                      CStr const*  source);
+static bool         internal_cbuild_is_shared_source(CTargetImpl* target,
+                                                     CStr const*  source);
+static bool         internal_cbuild_is_unity_excluded(CTargetImpl* target,
+                                                      CStr const*  source);
+static uint64_t     internal_cbuild_stamp_seed(CBuildImpl* cbuild);
+static unsigned     internal_cbuild_get_debug_info(CBuildImpl* cbuild);
+static CError       internal_cbuild_push_debug_info_flags(CBuildImpl* cbuild,
+                                                          bool        is_link,
+                                                          CArray*     args);
+static CError       internal_cbuild_push_lto_flags(CBuildImpl*  cbuild,
+                                                   CTargetImpl* target,
+                                                   bool         is_link,
+                                                   CArray*      args);
+static CError       internal_cbuild_push_pic_flag(CBuildImpl*  cbuild,
+                                                  CTargetImpl* target,
+                                                  CArray*      args);
+static CError       internal_cbuild_push_pgo_flags(CBuildImpl*  cbuild,
+                                                   CTargetImpl* target,
+                                                   bool         is_link,
+                                                   CArray*      args);
+static bool         internal_cbuild_is_pgo_target(CBuildImpl*  cbuild,
+                                                  CTargetImpl* target);
+static CError       internal_cbuild_get_pgo_profile_path(CBuildImpl* cbuild,
+                                                         bool  is_merged,
+                                                         CStr* out_path);
+static CError       internal_cbuild_get_raw_profiles(CBuildImpl* cbuild,
+                                                     CArray*     out_paths);
+static c_fs_error_t internal_cbuild_push_raw_profiles_handler(
     char* path, size_t path_len, void* extra_data);
+static CError       internal_cbuild_pgo_profile_hash(CBuildImpl* cbuild,
+                                                     uint64_t*   out_hash);
+static CError       internal_cbuild_pgo_reset(CBuildImpl*  cbuild,
+                                              CBuildArena* scratch);
+static CError       internal_cbuild_pgo_run_trainings(CBuildImpl*  cbuild,
+                                                      CBuildArena* scratch);
+static CError       internal_cbuild_pgo_merge(CBuildImpl*  cbuild,
+                                              CBuildArena* scratch);
+static CError       internal_cbuild_collect_projects(CBuildImpl* cbuild,
+                                                     CArray*     projects);
+static CError       internal_cbuild_probe_linker(CBuildImpl*   cbuild,
+                                                 CBuildLinker* out_linker);
+static CError       internal_cbuild_get_stamp(CBuildImpl* impl,
+                                              bool        is_outputs_only,
+                                              CHash128*   out_stamp);
+static CError       internal_cbuild_order_projects(CArray const* projects,
+                                                   CArray*       out_ordered);
+static CError       internal_cbuild_build_projects(CArray const* projects,
+                                                   bool          is_partial,
+                                                   size_t        jobs);
+static void         internal_cbuild_collect_closure(CTargetImpl* target);
 
 CError
 cbuild_create(CBuildType btype,
@@ -101,6 +328,16 @@ cbuild_create(CBuildType btype,
   c_defer_check(fs_err.code == 0, c_str_destroy, &out_cbuild->impl->base_path,
                 err = CERROR_internal_error(fs_err.desc));
 
+  /// config, `cbuild_set_pgo` may move it
+  str_err = c_str_create_empty(c_fs_path_get_max_len(),
+                               &out_cbuild->impl->config);
+  c_defer_check(str_err.code == 0, c_str_destroy, &out_cbuild->impl->config,
+                err = CERROR_internal_error(str_err.desc));
+  str_err = c_str_format(&out_cbuild->impl->config, 0, C_STR_INV("%s"),
+                         cbuild_type_get_name(btype));
+  c_defer_check(str_err.code == 0, c_str_destroy, &out_cbuild->impl->config,
+                err = CERROR_internal_error(str_err.desc));
+
   /// compiler
   str_err = c_str_create(C_STR2(default_builder->compiler),
                          &out_cbuild->impl->cmds.compiler);
@@ -122,6 +359,13 @@ cbuild_create(CBuildType btype,
                 &out_cbuild->impl->cmds.static_lib_creator,
                 err = CERROR_internal_error(str_err.desc));
 
+  /// static library creator for lto objects
+  str_err = c_str_create(C_STR2(default_builder->archiver_static_lto),
+                         &out_cbuild->impl->cmds.static_lib_creator_lto);
+  c_defer_check(str_err.code == 0, c_str_destroy,
+                &out_cbuild->impl->cmds.static_lib_creator_lto,
+                err = CERROR_internal_error(str_err.desc));
+
   /// shared library creator
   str_err = c_str_create(C_STR2(default_builder->archiver_shared),
                          &out_cbuild->impl->cmds.shared_lib_creator);
@@ -160,6 +404,14 @@ cbuild_create(CBuildType btype,
       = c_array_create(sizeof(CTargetImpl*), &out_cbuild->impl->targets);
   c_defer_check(arr_err.code == 0, c_array_destroy, &out_cbuild->impl->targets,
                 err = CERROR_internal_error(arr_err.desc));
+  err = c_hash_index_create(0, &out_cbuild->impl->target_index);
+  c_defer_check(err.code == 0, c_hash_index_destroy,
+                &out_cbuild->impl->target_index, NULL);
+
+  /// custom commands
+  arr_err = c_array_create(sizeof(CBuildCommand), &out_cbuild->impl->commands);
+  c_defer_check(arr_err.code == 0, c_array_destroy, &out_cbuild->impl->commands,
+                err = CERROR_internal_error(arr_err.desc));
 
   /// other projects
   arr_err
@@ -168,6 +420,34 @@ cbuild_create(CBuildType btype,
                 &out_cbuild->impl->other_projects,
                 err = CERROR_internal_error(arr_err.desc));
 
+  /// build db, loaded by `cbuild_configure`
+  out_cbuild->impl->db = calloc(1, sizeof(CBuildDb));
+  c_defer_check(out_cbuild->impl->db, NULL, NULL,
+                err = CERROR_memory_allocation);
+  err = cbuild_db_create(out_cbuild->impl->db);
+  c_defer_check(err.code == 0, free, out_cbuild->impl->db, NULL);
+
+  /// the targets
+  out_cbuild->impl->arena = calloc(1, sizeof(CBuildArena));
+  c_defer_check(out_cbuild->impl->arena, NULL, NULL,
+                err = CERROR_memory_allocation);
+  err = cbuild_arena_create(CBUILD_ARENA_BLOCK_SIZE, out_cbuild->impl->arena);
+  c_defer_check(err.code == 0, free, out_cbuild->impl->arena, NULL);
+
+  /// interned paths of the targets
+  out_cbuild->impl->paths = calloc(1, sizeof(CBuildPaths));
+  c_defer_check(out_cbuild->impl->paths, NULL, NULL,
+                err = CERROR_memory_allocation);
+  err = cbuild_paths_create(out_cbuild->impl->paths);
+  c_defer_check(err.code == 0, free, out_cbuild->impl->paths, NULL);
+
+  /// include scanner, filled while building
+  out_cbuild->impl->scanner = calloc(1, sizeof(CBuildScanner));
+  c_defer_check(out_cbuild->impl->scanner, NULL, NULL,
+                err = CERROR_memory_allocation);
+  err = cbuild_scanner_create(out_cbuild->impl->scanner);
+  c_defer_check(err.code == 0, free, out_cbuild->impl->scanner, NULL);
+
   c_defer_deinit();
 
   return err;
@@ -237,7 +517,7 @@ cbuild_target_add_source(CBuild*    self,
 
   c_defer_init(6);
 
-  // make sure the source has absolute path
+  // make sure the source has absolute path, the target keeps it interned
   CStr target_path = {0};
 
   bool is_absolute = false;
@@ -245,8 +525,8 @@ cbuild_target_add_source(CBuild*    self,
   if (!is_absolute) {
     // <base_path>/
     c_str_error_t str_err = c_str_clone(&self->impl->base_path, &target_path);
-    c_defer_check(str_err.code == 0, c_str_destroy, &target,
-                  err = CERROR_internal_error(str_err.desc));
+    c_defer_err(str_err.code == 0, c_str_destroy, &target_path,
+                err = CERROR_internal_error(str_err.desc));
     str_err = c_str_set_capacity(&target_path, c_fs_path_get_max_len());
     c_defer_check(str_err.code == 0, NULL, NULL,
                   err = CERROR_internal_error(str_err.desc));
@@ -260,15 +540,22 @@ cbuild_target_add_source(CBuild*    self,
   } else {
     c_str_error_t str_err
         = c_str_create(source_path, source_path_len, &target_path);
-    c_defer_check(str_err.code == 0, c_str_destroy, &target,
-                  err = CERROR_internal_error(str_err.desc));
+    c_defer_err(str_err.code == 0, c_str_destroy, &target_path,
+                err = CERROR_internal_error(str_err.desc));
   }
 
+  // a generated source is written while building
   bool exists;
   c_fs_exists(target_path.data, target_path.len, &exists);
+  exists = exists || internal_cbuild_is_generated(self->impl, &target_path);
   c_defer_check(exists, NULL, NULL, err = CERROR_no_such_source);
 
-  c_array_error_t arr_err = c_array_push(&target->impl->sources, &target_path);
+  CStr source = {0};
+  err         = cbuild_paths_intern(self->impl->paths, target_path.data,
+                                    target_path.len, &source);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  c_array_error_t arr_err = c_array_push(&target->impl->sources, &source);
   c_defer_check(arr_err.code == 0, NULL, NULL,
                 err = CERROR_internal_error(arr_err.desc));
 
@@ -277,6 +564,235 @@ cbuild_target_add_source(CBuild*    self,
   return err;
 }
 
+CError
+cbuild_target_add_sources_glob(CBuild*    self,
+                               CTarget*   target,
+                               char const pattern[],
+                               size_t     pattern_len)
+{
+  assert(self && self->impl);
+  assert(target && target->impl && target->impl->name.data);
+  assert(pattern && pattern_len > 0);
+
+  CError err   = CERROR_none;
+  CArray paths = {0}; // CArray< CStr >
+
+  c_defer_init(4);
+
+  // the paths are absolute and exist
+  err = cbuild_glob(self->impl->db, self->impl->base_path.data,
+                    self->impl->base_path.len, pattern, pattern_len, &paths);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  c_defer_err(paths.len > 0, c_array_destroy, &paths,
+              err = CERROR_no_such_source);
+
+  for (size_t iii = 0; iii < paths.len; ++iii) {
+    CStr* path   = &((CStr*)paths.data)[iii];
+    CStr  source = {0};
+    if (err.code == 0) {
+      err = cbuild_paths_intern(self->impl->paths, path->data, path->len,
+                                &source);
+    }
+    if (err.code == 0) {
+      c_array_error_t arr_err = c_array_push(&target->impl->sources, &source);
+      if (arr_err.code != 0) { err = CERROR_internal_error(arr_err.desc); }
+    }
+    c_str_destroy(path);
+  }
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_target_set_precompiled_header(CBuild*    self,
+                                     CTarget*   target,
+                                     char const header_path[],
+                                     size_t     header_path_len)
+{
+  assert(self && self->impl);
+  assert(target && target->impl);
+  assert(header_path && header_path_len > 0);
+
+  CStr path = {0};
+
+  CError err
+      = internal_cbuild_get_project_path(self->impl, header_path,
+                                         header_path_len, &path);
+  if (err.code != 0) { return err; }
+
+  c_str_error_t str_err = c_str_replace_at(
+      &target->impl->precompiled_header, 0,
+      target->impl->precompiled_header.len, path.data, path.len);
+  c_str_destroy(&path);
+
+  return str_err.code == 0 ? CERROR_none : CERROR_internal_error(str_err.desc);
+}
+
+CError
+cbuild_target_set_lto(CBuild* self, CTarget* target, CTargetLto lto)
+{
+  assert(self && self->impl);
+  assert(target && target->impl);
+
+  if (lto > CTARGET_LTO_parallel) { return CERROR_wrong_options; }
+
+  target->impl->lto = lto;
+
+  return CERROR_none;
+}
+
+CError
+cbuild_target_set_thin_archive(CBuild* self, CTarget* target, bool is_thin)
+{
+  assert(self && self->impl);
+  assert(target && target->impl);
+
+  if (target->impl->ttype != CTARGET_TYPE_static) {
+    return CERROR_invalid_target_type;
+  }
+
+  target->impl->is_thin_archive = is_thin;
+
+  return CERROR_none;
+}
+
+CError
+cbuild_target_share_objects(CBuild*  self,
+                            CTarget* target,
+                            CTarget* objects_of)
+{
+  assert(self && self->impl);
+  assert(target && target->impl);
+  assert(objects_of && objects_of->impl);
+
+  CTargetImpl* const impl = target->impl;
+  CTargetImpl* const of   = objects_of->impl;
+
+  // executables are built without pic, a chain of sharing libraries would
+  // hide objects from the ones down the chain
+  bool const is_library
+      = (impl->ttype == CTARGET_TYPE_static
+         || impl->ttype == CTARGET_TYPE_shared)
+        && (of->ttype == CTARGET_TYPE_static
+            || of->ttype == CTARGET_TYPE_shared);
+  if (!is_library || impl == of || impl->is_pic || of->objects_of
+      || strcmp(impl->cbuild_base_dir.data, of->cbuild_base_dir.data) != 0) {
+    return CERROR_invalid_target_type;
+  }
+
+  if (impl->objects_of && impl->objects_of != of) {
+    return CERROR_invalid_target_type;
+  }
+
+  // built before `target`, like any other dependency
+  bool is_recorded = false;
+  for (size_t iii = 0; iii < impl->dependencies.len; ++iii) {
+    is_recorded = is_recorded
+                  || ((CTargetImpl**)impl->dependencies.data)[iii] == of;
+  }
+  if (!is_recorded) {
+    c_array_error_t arr_err = c_array_push(&impl->dependencies, &of);
+    if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+  }
+
+  impl->objects_of = of;
+  of->is_pic       = true;
+
+  return CERROR_none;
+}
+
+CError
+cbuild_target_exclude_from_sharing(CBuild*    self,
+                                   CTarget*   target,
+                                   char const source_path[],
+                                   size_t     source_path_len)
+{
+  assert(self && self->impl);
+  assert(target && target->impl);
+  assert(source_path && source_path_len > 0);
+
+  CStr path = {0};
+
+  CError err = internal_cbuild_get_project_path(self->impl, source_path,
+                                                source_path_len, &path);
+  if (err.code != 0) { return err; }
+
+  c_array_error_t arr_err = c_array_push(&target->impl->share_excluded, &path);
+  if (arr_err.code != 0) {
+    c_str_destroy(&path);
+    return CERROR_internal_error(arr_err.desc);
+  }
+
+  return CERROR_none;
+}
+
+CError
+cbuild_target_add_pgo_training(CBuild*    self,
+                               CTarget*   target,
+                               char const args[],
+                               size_t     args_len)
+{
+  assert(self && self->impl);
+  assert(target && target->impl);
+  assert(args || args_len == 0);
+
+  if (target->impl->ttype != CTARGET_TYPE_executable) {
+    return CERROR_invalid_target_type;
+  }
+
+  CStr            training;
+  c_str_error_t   str_err = c_str_create(args ? args : "", args_len, &training);
+  c_array_error_t arr_err = {0};
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  arr_err = c_array_push(&target->impl->pgo_trainings, &training);
+  if (arr_err.code != 0) {
+    c_str_destroy(&training);
+    return CERROR_internal_error(arr_err.desc);
+  }
+
+  return CERROR_none;
+}
+
+CError
+cbuild_target_set_unity(CBuild* self, CTarget* target, size_t batches)
+{
+  assert(self && self->impl);
+  assert(target && target->impl);
+
+  target->impl->is_unity_set  = true;
+  target->impl->unity_batches = batches;
+
+  return CERROR_none;
+}
+
+CError
+cbuild_target_exclude_from_unity(CBuild*    self,
+                                 CTarget*   target,
+                                 char const source_path[],
+                                 size_t     source_path_len)
+{
+  assert(self && self->impl);
+  assert(target && target->impl);
+  assert(source_path && source_path_len > 0);
+
+  CStr path = {0};
+
+  CError err = internal_cbuild_get_project_path(self->impl, source_path,
+                                                source_path_len, &path);
+  if (err.code != 0) { return err; }
+
+  c_array_error_t arr_err = c_array_push(&target->impl->unity_excluded, &path);
+  if (arr_err.code != 0) {
+    c_str_destroy(&path);
+    return CERROR_internal_error(arr_err.desc);
+  }
+
+  return CERROR_none;
+}
+
 CError
 cbuild_target_set_include_path(CBuild*    self,
                                CTarget*   target,
@@ -289,10 +805,8 @@ cbuild_target_set_include_path(CBuild*    self,
 
   if (include_path[include_path_len] != '\0') { return CERROR_invalid_string; }
 
-  c_str_error_t str_err
-      = c_str_replace_at(&target->impl->base_dir, 0, target->impl->base_dir.len,
-                         include_path, include_path_len);
-  return str_err.code == 0 ? CERROR_none : CERROR_internal_error(str_err.desc);
+  return cbuild_paths_intern(self->impl->paths, include_path,
+                             include_path_len, &target->impl->base_dir);
 }
 
 CError
@@ -307,10 +821,11 @@ cbuild_target_add_include_path_flag(CBuild*    self,
 
   if (include_path[include_path_len] != '\0') { return CERROR_invalid_string; }
 
-  c_str_error_t str_err = c_str_format(
-      &target->impl->cflags, target->impl->cflags.len, C_STR_INV(" %s%s"),
-      default_builder->cflags.include_path, include_path);
-  return str_err.code == 0 ? CERROR_none : CERROR_internal_error(str_err.desc);
+  // a single argument, the path may hold spaces
+  char const* const parts[] = {default_builder->cflags.include_path,
+                               include_path};
+  return internal_cbuild_push_joined_arg(self->impl, &target->impl->cflags,
+                                         parts, sizeof(parts) / sizeof(*parts));
 }
 
 CError
@@ -325,37 +840,29 @@ cbuild_target_depends_on(CBuild*         self,
 
   CError        err          = CERROR_none;
   c_str_error_t str_err      = C_STR_ERROR_none;
-  c_fs_error_t  fs_err       = C_FS_ERROR_none;
-  CStr          build_path   = {0};
   CStr          install_path = {0};
 
   c_defer_init(6);
 
-  if ((property & CTARGET_PROPERTY_objects) == CTARGET_PROPERTY_objects) {
-    str_err = c_str_create_empty(c_fs_path_get_max_len(), &build_path);
-    c_defer_err(str_err.code == 0, c_str_destroy, &build_path,
-                err = CERROR_internal_error(str_err.desc));
-
-    if (strcmp(target->impl->base_dir.data, depend_on->impl->base_dir.data)
-        != 0) {
-      char separator = c_fs_path_get_separator();
-      str_err        = c_str_format(&build_path, 0, C_STR_INV("%s%c%s"),
-                                    depend_on->impl->base_dir.data, separator,
-                                    depend_on->impl->build_path.data);
-      c_defer_check(str_err.code == 0, NULL, NULL,
-                    err = CERROR_internal_error(str_err.desc));
-    } else {
-      str_err = c_str_append(&build_path, &depend_on->impl->build_path);
-      c_defer_check(str_err.code == 0, NULL, NULL,
-                    err = CERROR_internal_error(str_err.desc));
+  // targets which have to be built before `target`, the link of `target`
+  // takes the objects of object targets as they were built
+  if ((property
+       & (CTARGET_PROPERTY_objects | CTARGET_PROPERTY_library
+          | CTARGET_PROPERTY_library_with_rpath))
+      != 0) {
+    bool is_recorded = false;
+    for (size_t iii = 0; iii < target->impl->dependencies.len; ++iii) {
+      is_recorded = is_recorded
+                    || ((CTargetImpl**)target->impl->dependencies.data)[iii]
+                           == depend_on->impl;
     }
 
-    fs_err
-        = c_fs_foreach(build_path.data, build_path.len, build_path.capacity,
-                       internal_find_and_push_all_compiled_objects_cstr_handler,
-                       &target->impl->sources);
-    c_defer_check(fs_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(fs_err.desc));
+    if (!is_recorded) {
+      c_array_error_t arr_err
+          = c_array_push(&target->impl->dependencies, &depend_on->impl);
+      c_defer_check(arr_err.code == 0, NULL, NULL,
+                    err = CERROR_internal_error(arr_err.desc));
+    }
   }
 
   if (((property & CTARGET_PROPERTY_library) == CTARGET_PROPERTY_library)
@@ -373,52 +880,50 @@ cbuild_target_depends_on(CBuild*         self,
                   err = CERROR_internal_error(str_err.desc));
 
     // -L<library path>
-    str_err = c_str_format(
-        &target->impl->lflags, target->impl->lflags.len, C_STR_INV(" %s%s"),
-        default_builder->lflags.library_path, install_path.data);
-    c_defer_check(str_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(str_err.desc));
+    char const* const library_path[]
+        = {default_builder->lflags.library_path, install_path.data};
+    err = internal_cbuild_push_joined_arg(
+        self->impl, &target->impl->lflags, library_path,
+        sizeof(library_path) / sizeof(*library_path));
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
 
     // -l<library>
-    str_err
-        = c_str_format(&target->impl->link_with, target->impl->link_with.len,
-                       C_STR_INV(" %s%s"), default_builder->lflags.library,
-                       depend_on->impl->name.data
-
-        );
-    c_defer_check(str_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(str_err.desc));
+#ifndef _WIN32
+    char const* const library[]
+        = {default_builder->lflags.library, depend_on->impl->name.data};
+#else
+    char const* const library[]
+        = {default_builder->lflags.library, depend_on->impl->name.data,
+           default_builder->extension.lib_static};
+#endif
+    err = internal_cbuild_push_joined_arg(self->impl, &target->impl->link_with,
+                                          library,
+                                          sizeof(library) / sizeof(*library));
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
 
 #ifndef _WIN32
     if ((property & CTARGET_PROPERTY_library_with_rpath)
         == CTARGET_PROPERTY_library_with_rpath) {
       // -Wl,-rpath,<library path>
-      str_err = c_str_format(&target->impl->lflags, target->impl->lflags.len,
-                             C_STR_INV(" -Wl,-rpath,%s"), install_path.data);
-      c_defer_check(str_err.code == 0, NULL, NULL,
-                    err = CERROR_internal_error(str_err.desc));
+      char const* const rpath[] = {"-Wl,-rpath,", install_path.data};
+      err = internal_cbuild_push_joined_arg(self->impl, &target->impl->lflags,
+                                            rpath,
+                                            sizeof(rpath) / sizeof(*rpath));
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
     }
-#else
-    str_err
-        = c_str_append_with_cstr(&target->impl->link_with,
-                                 C_STR2(default_builder->extension.lib_static));
-    c_defer_check(str_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(str_err.desc));
 #endif
   }
 
   if ((property & CTARGET_PROPERTY_cflags) == CTARGET_PROPERTY_cflags) {
-    str_err = c_str_format(&target->impl->cflags, target->impl->cflags.len,
-                           C_STR_INV(" %s"), depend_on->impl->cflags.data);
-    c_defer_check(str_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(str_err.desc));
+    err = internal_cbuild_push_all(&depend_on->impl->cflags,
+                                   &target->impl->cflags);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
   }
 
   if ((property & CTARGET_PROPERTY_lflags) == CTARGET_PROPERTY_lflags) {
-    str_err = c_str_format(&target->impl->lflags, target->impl->lflags.len,
-                           C_STR_INV(" %s"), depend_on->impl->lflags.data);
-    c_defer_check(str_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(str_err.desc));
+    err = internal_cbuild_push_all(&depend_on->impl->lflags,
+                                   &target->impl->lflags);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
   }
 
   if ((property & CTARGET_PROPERTY_include_path)
@@ -442,15 +947,11 @@ cbuild_target_add_compile_flag(CBuild*    self,
   assert(self && self->impl);
   assert(target && target->impl);
 
-  CError err = CERROR_none;
-
   if (flag[flag_len] != '\0') { return CERROR_invalid_string; }
 
-  c_str_error_t str_err = c_str_format(
-      &target->impl->cflags, target->impl->cflags.len, C_STR_INV(" %s"), flag);
-  err = str_err.code == 0 ? CERROR_none : CERROR_internal_error(str_err.desc);
-
-  return err;
+  // split on whitespaces once, here, instead of for every action
+  return internal_cbuild_push_args(self->impl, &target->impl->cflags, flag,
+                                   flag_len);
 }
 
 CError
@@ -462,15 +963,11 @@ cbuild_target_add_link_flag(CBuild*    self,
   assert(self && self->impl);
   assert(target && target->impl);
 
-  CError err = CERROR_none;
-
   if (flag[flag_len] != '\0') { return CERROR_invalid_string; }
 
-  c_str_error_t str_err = c_str_format(
-      &target->impl->lflags, target->impl->lflags.len, C_STR_INV(" %s"), flag);
-  err = str_err.code == 0 ? CERROR_none : CERROR_internal_error(str_err.desc);
-
-  return err;
+  // split on whitespaces once, here, instead of for every action
+  return internal_cbuild_push_args(self->impl, &target->impl->lflags, flag,
+                                   flag_len);
 }
 
 CError
@@ -484,16 +981,30 @@ cbuild_target_get(CBuild*    self,
 
   if (!out_target) { return CERROR_none; }
 
-  CError err = CERROR_no_such_target;
+  CTargetImpl** targets = (CTargetImpl**)self->impl->targets.data;
+  size_t const  index
+      = internal_cbuild_target_find(self->impl, target_name, target_name_len);
+  *out_target = index < self->impl->targets.len ? (CTarget){targets[index]}
+                                                : (CTarget){0};
 
-  /// FIXME: need better algorithm
-  *out_target = (CTarget){0};
-  for (size_t i = 0; i < self->impl->targets.len; ++i) {
-    CTargetImpl* target_impl = ((CTargetImpl**)self->impl->targets.data)[i];
-    if (strncmp(target_impl->name.data, target_name, target_name_len) == 0) {
-      *out_target = (CTarget){.impl = target_impl};
-      return CERROR_none;
-    }
+  return out_target->impl ? CERROR_none : CERROR_no_such_target;
+}
+
+CError
+cbuild_targets_get(CBuild*           self,
+                   char const* const target_names[],
+                   size_t            target_names_len,
+                   CTarget           out_targets[])
+{
+  assert(self && self->impl);
+  assert(target_names || target_names_len == 0);
+  assert(out_targets || target_names_len == 0);
+
+  CError err = CERROR_none;
+  for (size_t iii = 0; iii < target_names_len; ++iii) {
+    CError const target_err = cbuild_target_get(
+        self, C_STR2(target_names[iii]), &out_targets[iii]);
+    if (err.code == 0) { err = target_err; }
   }
 
   return err;
@@ -518,6 +1029,9 @@ cbuild_depends_on(CBuild*    self,
                       other_cbuild_path_len, out_other_cbuild);
   c_defer_check(err.code == 0, cbuild_destroy, out_other_cbuild, NULL);
 
+  err = cbuild_set_pgo(out_other_cbuild, self->impl->pgo);
+  c_defer_check(err.code == 0, cbuild_destroy, out_other_cbuild, NULL);
+
   c_array_error_t arr_err
       = c_array_push(&self->impl->other_projects, &out_other_cbuild->impl);
   c_defer_check(arr_err.code == 0, NULL, NULL,
@@ -530,37 +1044,121 @@ cbuild_depends_on(CBuild*    self,
   return err;
 }
 
+CError
+cbuild_custom_command(CBuild*           self,
+                      char const* const argv[],
+                      size_t            argv_len,
+                      char const* const inputs[],
+                      size_t            inputs_len,
+                      char const* const outputs[],
+                      size_t            outputs_len)
+{
+  assert(self && self->impl);
+  assert(argv && argv_len > 0);
+  assert(inputs || inputs_len == 0);
+  assert(outputs && outputs_len > 0);
+
+  CError        err     = CERROR_none;
+  CBuildCommand command = {0};
+
+  c_defer_init(4);
+
+  c_array_error_t arr_err = c_array_create(sizeof(CStr), &command.argv);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+  arr_err = c_array_create(sizeof(CStr), &command.inputs);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+  arr_err = c_array_create(sizeof(CStr), &command.outputs);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+
+  for (size_t iii = 0; iii < argv_len; ++iii) {
+    CStr          arg     = {0};
+    c_str_error_t str_err = c_str_create(C_STR2(argv[iii]), &arg);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+    arr_err = c_array_push(&command.argv, &arg);
+    if (arr_err.code != 0) { c_str_destroy(&arg); }
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+
+  // inputs may be written by an earlier command, outputs don't exist yet
+  for (size_t iii = 0; iii < inputs_len + outputs_len; ++iii) {
+    bool const  is_input = iii < inputs_len;
+    char const* path     = is_input ? inputs[iii] : outputs[iii - inputs_len];
+
+    CStr absolute;
+    err = internal_cbuild_to_project_path(self->impl, C_STR2(path), &absolute);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+    arr_err = c_array_push(is_input ? &command.inputs : &command.outputs,
+                           &absolute);
+    if (arr_err.code != 0) { c_str_destroy(&absolute); }
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+
+  arr_err = c_array_push(&self->impl->commands, &command);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+
+  c_defer_deinit();
+
+  if (err.code != 0) { internal_cbuild_command_destroy(&command); }
+
+  return err;
+}
+
 void
 cbuild_target_destroy(CBuild* self, CTarget* target)
 {
   assert(self && self->impl);
 
-  /// FIXME: find a better way to do this
-  // remove it from target list from `self`
-  for (size_t i = 0; i < self->impl->targets.len; i++) {
-    if (target->impl == ((CTargetImpl**)self->impl->targets.data)[i]) {
-      c_array_remove(&self->impl->targets, i);
-      break;
+  // remove it from target list from `self`, the last target takes its
+  // place and the index follows it
+  CTargetImpl**  targets = (CTargetImpl**)self->impl->targets.data;
+  uint64_t const hash    = internal_cbuild_target_hash(target->impl->name.data,
+                                                      target->impl->name.len);
+  size_t         cursor  = 0;
+  size_t         index   = 0;
+  while (c_hash_index_next(&self->impl->target_index, hash, &cursor, &index)) {
+    if (target->impl != targets[index]) { continue; }
+
+    size_t const       last  = self->impl->targets.len - 1;
+    CTargetImpl* const moved = targets[last];
+    c_hash_index_remove(&self->impl->target_index, hash, index);
+    if (index != last) {
+      targets[index] = moved;
+      c_hash_index_move(
+          &self->impl->target_index,
+          internal_cbuild_target_hash(moved->name.data, moved->name.len), last,
+          index);
     }
+    c_array_remove(&self->impl->targets, last);
+    break;
   }
 
-  c_str_destroy(&target->impl->name);
-  c_str_destroy(&target->impl->cbuild_base_dir);
-  c_str_destroy(&target->impl->base_dir);
-  c_str_destroy(&target->impl->build_path);
-  c_str_destroy(&target->impl->install_path);
-  c_str_destroy(&target->impl->cflags);
-  c_str_destroy(&target->impl->lflags);
-  c_str_destroy(&target->impl->link_with);
-  for (size_t i = 0; i < target->impl->sources.len; ++i) {
-    c_str_destroy(&((CStr*)target->impl->sources.data)[i]);
-  }
+  c_str_destroy(&target->impl->precompiled_header);
   c_array_destroy(&target->impl->sources);
+  c_array_destroy(&target->impl->units);
+  c_array_destroy(&target->impl->objects);
+  c_array_destroy(&target->impl->cflags);
+  c_array_destroy(&target->impl->lflags);
+  c_array_destroy(&target->impl->link_with);
+  c_array_destroy(&target->impl->compile_args);
+  c_array_destroy(&target->impl->link_args);
+  internal_cbuild_objects_destroy(&target->impl->unity_excluded);
+  c_hash_index_destroy(&target->impl->unity_index);
+  internal_cbuild_objects_destroy(&target->impl->share_excluded);
+  c_hash_index_destroy(&target->impl->share_index);
+  c_hash_index_destroy(&target->impl->source_index);
+  internal_cbuild_objects_destroy(&target->impl->pgo_trainings);
 
   c_array_destroy(&target->impl->dependencies);
 
+  // taken from the arena of the project, released with it
   *target->impl = (CTargetImpl){0};
-  free(target->impl);
 
   *target = (CTarget){0};
 }
@@ -592,35 +1190,57 @@ cbuild_configure(CBuild* self)
   c_defer_check(fs_err.code == 0, NULL, NULL,
                 err = CERROR_internal_error(fs_err.desc));
 
-  // create build path if not existing
-  CStr build_path;
-  str_err = c_str_create(default_builder_path, sizeof(default_builder_path) - 1,
-                         &build_path);
-  c_defer_err(str_err.code == 0, c_str_destroy, &build_path,
+  // create build and install paths if not existing
+  // <build path>/<config>
+  // <install path>/<config>
+  char const* const roots[] = {default_builder_path, default_install_path};
+  char const*       config  = self->impl->config.data;
+
+  CStr config_path;
+  str_err = c_str_create_empty(c_fs_path_get_max_len(), &config_path);
+  c_defer_err(str_err.code == 0, c_str_destroy, &config_path,
               err = CERROR_internal_error(str_err.desc));
 
-  bool exists = false;
-  c_fs_dir_exists(build_path.data, build_path.len, &exists);
-  if (!exists) {
-    fs_err = c_fs_dir_create(build_path.data, build_path.len);
-    c_defer_check(fs_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(fs_err.desc));
-  }
+  for (size_t iii = 0; iii < sizeof(roots) / sizeof(roots[0]); ++iii) {
+    str_err = c_str_format(&config_path, 0, C_STR_INV("%s"), roots[iii]);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
 
-  /// create install path if not existing
-  CStr install_path;
-  str_err = c_str_create(default_install_path, sizeof(default_install_path) - 1,
-                         &install_path);
-  c_defer_err(str_err.code == 0, c_str_destroy, &install_path,
-              err = CERROR_internal_error(str_err.desc));
+    bool exists = false;
+    c_fs_dir_exists(config_path.data, config_path.len, &exists);
+    if (!exists) {
+      fs_err = c_fs_dir_create(config_path.data, config_path.len);
+      c_defer_check(fs_err.code == 0, NULL, NULL,
+                    err = CERROR_internal_error(fs_err.desc));
+    }
 
-  c_fs_dir_exists(install_path.data, install_path.len, &exists);
-  if (!exists) {
-    fs_err = c_fs_dir_create(install_path.data, install_path.len);
-    c_defer_check(fs_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(fs_err.desc));
+    str_err = c_str_format(&config_path, config_path.len, C_STR_INV("%c%s"),
+                           c_fs_path_get_separator(), config);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+
+    c_fs_dir_exists(config_path.data, config_path.len, &exists);
+    if (!exists) {
+      fs_err = c_fs_dir_create(config_path.data, config_path.len);
+      c_defer_check(fs_err.code == 0, NULL, NULL,
+                    err = CERROR_internal_error(fs_err.desc));
+    }
   }
 
+  // <base path>/<build path>/<config>/<db name>
+  CStr db_path;
+  str_err = c_str_create_empty(c_fs_path_get_max_len(), &db_path);
+  c_defer_err(str_err.code == 0, c_str_destroy, &db_path,
+              err = CERROR_internal_error(str_err.desc));
+  str_err = c_str_format(&db_path, 0, C_STR_INV("%s%c%s%c%s%c%s"),
+                         self->impl->base_path.data, c_fs_path_get_separator(),
+                         default_builder_path, c_fs_path_get_separator(),
+                         config, c_fs_path_get_separator(), default_db_name);
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+  err = cbuild_db_load(self->impl->db, db_path.data, db_path.len);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
   // this will build and install build.c
   CStr cbuild_dll_dir      = {0};
   CStr build_function_name = {0};
@@ -673,6 +1293,9 @@ cbuild_configure(CBuild* self)
   err = build_fn(self);
   c_defer_check(err.code == 0, NULL, NULL, NULL);
 
+  err = cbuild_db_save(self->impl->db);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
   // restore old path
   fs_err = c_fs_dir_change_current(cur_dir_path.data, cur_dir_path.len);
   c_defer_check(fs_err.code == 0, NULL, NULL,
@@ -683,53 +1306,633 @@ cbuild_configure(CBuild* self)
   return err;
 }
 
-CError
-cbuild_build(CBuild* self)
+void
+cbuild_set_unity_batches(CBuild* self, size_t batches)
 {
   assert(self && self->impl);
 
-  CError err = CERROR_none;
+  self->impl->unity_batches = batches;
 
-  c_defer_init(6);
+  for (size_t iii = 0; iii < self->impl->other_projects.len; ++iii) {
+    cbuild_set_unity_batches(
+        &(CBuild){((CBuildImpl**)self->impl->other_projects.data)[iii]},
+        batches);
+  }
+}
 
-  // save current path
-  CStr          cur_dir_path;
-  c_str_error_t str_err
+CError
+cbuild_set_pgo(CBuild* self, CBuildPgo pgo)
+{
+  assert(self && self->impl);
+
+  if (pgo > CBUILD_PGO_use) { return CERROR_wrong_options; }
+  if (pgo != CBUILD_PGO_none
+      && default_builder->cflags.pgo_generate[0] == '\0') {
+    return CERROR_wrong_options;
+  }
+
+  self->impl->pgo = pgo;
+
+  // <config>_pgo_generate
+  // <config>_pgo_use
+  c_str_error_t str_err = c_str_format(
+      &self->impl->config, 0, C_STR_INV("%s%s"),
+      cbuild_type_get_name(self->impl->btype), pgo_config_suffixes[pgo]);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  // taken once, a training that changes the profile rebuilds everything
+  self->impl->pgo_profile = 0;
+  if (pgo != CBUILD_PGO_use) { return CERROR_none; }
+
+  return internal_cbuild_pgo_profile_hash(self->impl,
+                                          &self->impl->pgo_profile);
+}
+
+CError
+cbuild_pgo_train(CBuild* self)
+{
+  assert(self && self->impl);
+  assert(self->impl->pgo == CBUILD_PGO_generate);
+
+  CError      err          = CERROR_none;
+  CArray      projects     = {0}; // CArray< CBuildImpl* >
+  CStr        cur_dir_path = {0};
+  CStr        profile_path = {0};
+  CBuildArena scratch      = {0}; // the output of each command
+
+  c_defer_init(6);
+
+  // save current path, it is restored after the cleanup
+  c_str_error_t str_err
       = c_str_create_empty(c_fs_path_get_max_len(), &cur_dir_path);
-  c_defer_err(str_err.code == 0, c_str_destroy, &cur_dir_path,
-              err = CERROR_internal_error(str_err.desc));
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
   c_fs_error_t fs_err = c_fs_dir_get_current(
       cur_dir_path.data, cur_dir_path.capacity, &cur_dir_path.len);
   c_defer_check(fs_err.code == 0, NULL, NULL,
                 err = CERROR_internal_error(fs_err.desc));
 
-  // change to the base path
-  fs_err = c_fs_dir_change_current(self->impl->base_path.data,
-                                   self->impl->base_path.len);
-  c_defer_check(fs_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(fs_err.desc));
+  c_array_error_t arr_err = c_array_create(sizeof(CBuildImpl*), &projects);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &projects,
+              err = CERROR_internal_error(arr_err.desc));
+  err = internal_cbuild_collect_projects(self->impl, &projects);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
 
-  /// build dependant projects
-  for (size_t i = 0; i < self->impl->other_projects.len; i++) {
-    err = cbuild_build(
-        &(CBuild){((CBuildImpl**)self->impl->other_projects.data)[i]});
+  // the instrumented projects as they are now and what would run on them
+  CHash128 fingerprint = {0};
+  for (size_t iii = 0; iii < projects.len; ++iii) {
+    CBuildImpl* cbuild = ((CBuildImpl**)projects.data)[iii];
+
+    // outputs are known by paths relative to their project
+    fs_err = c_fs_dir_change_current(cbuild->base_path.data,
+                                     cbuild->base_path.len);
+    c_defer_check(fs_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(fs_err.desc));
+    err = cbuild_db_scan(cbuild->db, true);
     c_defer_check(err.code == 0, NULL, NULL, NULL);
+    fingerprint = c_hash128_combine(
+        fingerprint,
+        cbuild_db_stamp(cbuild->db, internal_cbuild_stamp_seed(cbuild)));
+
+    for (size_t jjj = 0; jjj < cbuild->targets.len; ++jjj) {
+      CTargetImpl* target = ((CTargetImpl**)cbuild->targets.data)[jjj];
+      for (size_t kkk = 0; kkk < target->pgo_trainings.len; ++kkk) {
+        CStr const* args = &((CStr*)target->pgo_trainings.data)[kkk];
+        fingerprint      = c_hash128_combine(
+            fingerprint, c_hash128(target->name.data, target->name.len, kkk));
+        fingerprint = c_hash128_combine(fingerprint,
+                                        c_hash128(args->data, args->len, kkk));
+      }
+    }
   }
 
-  /// build dependant targets
-  for (size_t i = 0; i < self->impl->targets.len; ++i) {
-    err = cbuild_target_build(self,
-                              ((CTargetImpl**)self->impl->targets.data)[i]);
+  str_err = c_str_create_empty(c_fs_path_get_max_len(), &profile_path);
+  c_defer_err(str_err.code == 0, c_str_destroy, &profile_path,
+              err = CERROR_internal_error(str_err.desc));
+  err = internal_cbuild_get_pgo_profile_path(self->impl, false, &profile_path);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  bool            is_trained = false;
+  CBuildDbRecord* record
+      = cbuild_db_find(self->impl->db, CBUILD_DB_KIND_stamp,
+                       profile_path.data, profile_path.len);
+  c_fs_dir_exists(profile_path.data, profile_path.len, &is_trained);
+  if (is_trained && record && c_hash128_equal(record->hash, fingerprint)) {
+    c_defer_check(false, NULL, NULL, NULL);
+  }
+
+  // a training profiles the libraries of other projects as well, so every
+  // project is reset before the first one runs and merged after the last
+  CError (*const steps[])(CBuildImpl*, CBuildArena*) = {
+      internal_cbuild_pgo_reset,
+      internal_cbuild_pgo_run_trainings,
+      internal_cbuild_pgo_merge,
+  };
+  err = cbuild_arena_create(CBUILD_SCRATCH_BLOCK_SIZE, &scratch);
+  c_defer_err(err.code == 0, cbuild_arena_destroy, &scratch, NULL);
+  for (size_t iii = 0; iii < sizeof(steps) / sizeof(*steps); ++iii) {
+    for (size_t jjj = 0; jjj < projects.len; ++jjj) {
+      CBuildImpl* cbuild = ((CBuildImpl**)projects.data)[jjj];
+
+      // trainings run inside their project
+      fs_err = c_fs_dir_change_current(cbuild->base_path.data,
+                                       cbuild->base_path.len);
+      c_defer_check(fs_err.code == 0, NULL, NULL,
+                    err = CERROR_internal_error(fs_err.desc));
+      err = steps[iii](cbuild, &scratch);
+      cbuild_arena_reset(&scratch);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+  }
+
+  err = cbuild_db_put(self->impl->db, CBUILD_DB_KIND_stamp, profile_path.data,
+                      profile_path.len,
+                      &(CBuildDbRecord){.hash = fingerprint});
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  err = cbuild_db_save(self->impl->db);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  c_defer_deinit();
+
+  // restore old path, a training may have failed anywhere
+  if (cur_dir_path.data) {
+    if (cur_dir_path.len > 0) {
+      c_fs_dir_change_current(cur_dir_path.data, cur_dir_path.len);
+    }
+    c_str_destroy(&cur_dir_path);
+  }
+
+  return err;
+}
+
+CError
+cbuild_linker_from_name(char const    name[],
+                        size_t        name_len,
+                        CBuildLinker* out_linker)
+{
+  assert(name);
+  assert(out_linker);
+
+  size_t const linkers_len = sizeof(linker_names) / sizeof(*linker_names);
+  for (size_t iii = 0; iii < linkers_len; ++iii) {
+    if (strlen(linker_names[iii]) == name_len
+        && strncmp(linker_names[iii], name, name_len) == 0) {
+      *out_linker = (CBuildLinker)iii;
+      return CERROR_none;
+    }
+  }
+
+  return CERROR_wrong_options;
+}
+
+CError
+cbuild_set_linker(CBuild* self, CBuildLinker linker)
+{
+  assert(self && self->impl);
+
+  if (linker > CBUILD_LINKER_auto) { return CERROR_wrong_options; }
+
+  if (linker == CBUILD_LINKER_auto) {
+    CError err = internal_cbuild_probe_linker(self->impl, &linker);
+    if (err.code != 0) { return err; }
+  }
+
+  if (linker != CBUILD_LINKER_default
+      && default_builder->lflags.use_linker[0] == '\0') {
+    return CERROR_wrong_options;
+  }
+
+  self->impl->linker = linker;
+
+  for (size_t iii = 0; iii < self->impl->other_projects.len; ++iii) {
+    CError err = cbuild_set_linker(
+        &(CBuild){((CBuildImpl**)self->impl->other_projects.data)[iii]},
+        linker);
+    if (err.code != 0) { return err; }
+  }
+
+  return CERROR_none;
+}
+
+CError
+cbuild_set_debug_info(CBuild* self, unsigned debug_info)
+{
+  assert(self && self->impl);
+
+  unsigned const all
+      = CBUILD_DEBUG_INFO_split | CBUILD_DEBUG_INFO_compressed;
+  if ((debug_info & ~all) != 0
+      || ((debug_info & CBUILD_DEBUG_INFO_split)
+          && default_builder->cflags.split_dwarf[0] == '\0')
+      || ((debug_info & CBUILD_DEBUG_INFO_compressed)
+          && default_builder->cflags.compress_debug[0] == '\0')) {
+    return CERROR_wrong_options;
+  }
+
+  self->impl->debug_info = debug_info;
+
+  for (size_t iii = 0; iii < self->impl->other_projects.len; ++iii) {
+    CError err = cbuild_set_debug_info(
+        &(CBuild){((CBuildImpl**)self->impl->other_projects.data)[iii]},
+        debug_info);
+    if (err.code != 0) { return err; }
+  }
+
+  return CERROR_none;
+}
+
+CError
+cbuild_build(CBuild* self)
+{
+  assert(self && self->impl);
+
+  return cbuild_build_many(self, 1, NULL, 0, 0);
+}
+
+CError
+cbuild_build_targets(CBuild*           self,
+                     char const* const target_names[],
+                     size_t            target_names_len)
+{
+  assert(self && self->impl);
+
+  return cbuild_build_many(self, 1, target_names, target_names_len, 0);
+}
+
+CError
+cbuild_build_many(CBuild            cbuilds[],
+                  size_t            cbuilds_len,
+                  char const* const target_names[],
+                  size_t            target_names_len,
+                  size_t            jobs)
+{
+  assert(cbuilds && cbuilds_len > 0);
+  assert(target_names || target_names_len == 0);
+
+  CError   err      = CERROR_none;
+  CArray   projects = {0}; // CArray< CBuildImpl* >
+  CTarget* targets  = NULL;
+
+  c_defer_init(3);
+
+  c_array_error_t arr_err = c_array_create(sizeof(CBuildImpl*), &projects);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &projects,
+              err = CERROR_internal_error(arr_err.desc));
+  for (size_t iii = 0; iii < cbuilds_len; ++iii) {
+    err = internal_cbuild_collect_projects(cbuilds[iii].impl, &projects);
     c_defer_check(err.code == 0, NULL, NULL, NULL);
   }
 
-  // restore old path
-  fs_err = c_fs_dir_change_current(cur_dir_path.data, cur_dir_path.len);
+  // a full build selects every target, a partial one starts from none
+  for (size_t iii = 0; iii < projects.len; ++iii) {
+    CArray const* project_targets
+        = &((CBuildImpl**)projects.data)[iii]->targets;
+    for (size_t jjj = 0; jjj < project_targets->len; ++jjj) {
+      ((CTargetImpl**)project_targets->data)[jjj]->is_selected
+          = target_names_len == 0;
+    }
+  }
+
+  if (target_names_len > 0) {
+    targets = calloc(target_names_len, sizeof(CTarget));
+    c_defer_err(targets, free, targets, err = CERROR_memory_allocation);
+  }
+
+  // the requested targets of every configuration and what they need
+  for (size_t iii = 0; iii < cbuilds_len && target_names_len > 0; ++iii) {
+    err = cbuild_targets_get(&cbuilds[iii], target_names, target_names_len,
+                             targets);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    for (size_t jjj = 0; jjj < target_names_len; ++jjj) {
+      internal_cbuild_collect_closure(targets[jjj].impl);
+    }
+  }
+
+  err = internal_cbuild_build_projects(&projects, target_names_len > 0, jobs);
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_get_stamp(CBuild* self, CHash128* out_stamp)
+{
+  assert(self && self->impl);
+  assert(out_stamp);
+
+  return internal_cbuild_get_stamp(self->impl, false, out_stamp);
+}
+
+CError
+cbuild_get_outputs_stamp(CBuild* self, CHash128* out_stamp)
+{
+  assert(self && self->impl);
+  assert(out_stamp);
+
+  return internal_cbuild_get_stamp(self->impl, true, out_stamp);
+}
+
+CError
+cbuild_get_external_include_dirs(CBuild* self, CArray* out_dirs)
+{
+  assert(self && self->impl);
+  assert(out_dirs);
+
+  CBuildImpl* cbuild    = self->impl;
+  char const  separator = c_fs_path_get_separator();
+  CArray      dirs; // CArray< char const* >
+
+  c_array_error_t arr_err = c_array_create(sizeof(char const*), &dirs);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+  arr_err = c_array_create(sizeof(CStr), out_dirs);
+  if (arr_err.code != 0) {
+    c_array_destroy(&dirs);
+    return CERROR_internal_error(arr_err.desc);
+  }
+
+  CError err = CERROR_none;
+  for (size_t iii = 0; iii < cbuild->targets.len && err.code == 0; ++iii) {
+    err = internal_cbuild_push_include_dirs(
+        &((CTargetImpl**)cbuild->targets.data)[iii]->cflags, &dirs);
+  }
+
+  for (size_t iii = 0; iii < dirs.len && err.code == 0; ++iii) {
+    char const*  dir     = ((char const**)dirs.data)[iii];
+    size_t const dir_len = strlen(dir);
+
+    // relative to the project, the compiles run inside it
+    bool is_absolute = false;
+    c_fs_path_is_absolute(dir, dir_len, &is_absolute);
+
+    CStr          dir_path;
+    c_str_error_t str_err = c_str_create_empty(
+        cbuild->base_path.len + dir_len + 2, &dir_path);
+    if (str_err.code == 0) {
+      str_err = is_absolute
+                    ? c_str_format(&dir_path, 0, C_STR_INV("%s"), dir)
+                    : c_str_format(&dir_path, 0, C_STR_INV("%s%c%s"),
+                                   cbuild->base_path.data, separator, dir);
+      if (str_err.code != 0) { c_str_destroy(&dir_path); }
+    }
+    if (str_err.code != 0) {
+      err = CERROR_internal_error(str_err.desc);
+      break;
+    }
+
+    // <base path>[/...] is watched with the project
+    bool is_known
+        = dir_path.len >= cbuild->base_path.len
+          && memcmp(dir_path.data, cbuild->base_path.data,
+                    cbuild->base_path.len)
+                 == 0
+          && (dir_path.len == cbuild->base_path.len
+              || dir_path.data[cbuild->base_path.len] == separator);
+    for (size_t jjj = 0; !is_known && jjj < out_dirs->len; ++jjj) {
+      is_known = strcmp(((CStr*)out_dirs->data)[jjj].data, dir_path.data) == 0;
+    }
+
+    if (is_known) {
+      c_str_destroy(&dir_path);
+      continue;
+    }
+
+    arr_err = c_array_push(out_dirs, &dir_path);
+    if (arr_err.code != 0) {
+      c_str_destroy(&dir_path);
+      err = CERROR_internal_error(arr_err.desc);
+    }
+  }
+
+  c_array_destroy(&dirs);
+  if (err.code != 0) { internal_cbuild_objects_destroy(out_dirs); }
+
+  return err;
+}
+
+CError
+internal_cbuild_get_stamp(CBuildImpl* impl,
+                          bool        is_outputs_only,
+                          CHash128*   out_stamp)
+{
+  CError err          = CERROR_none;
+  CArray projects     = {0}; // CArray< CBuildImpl* >
+  CStr   cur_dir_path = {0};
+
+  c_defer_init(4);
+
+  // save current path, it is restored even if a project fails
+  c_str_error_t str_err
+      = c_str_create_empty(c_fs_path_get_max_len(), &cur_dir_path);
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+  c_fs_error_t fs_err = c_fs_dir_get_current(
+      cur_dir_path.data, cur_dir_path.capacity, &cur_dir_path.len);
+  c_defer_check(fs_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(fs_err.desc));
+
+  c_array_error_t arr_err = c_array_create(sizeof(CBuildImpl*), &projects);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &projects,
+              err = CERROR_internal_error(arr_err.desc));
+  err = internal_cbuild_collect_projects(impl, &projects);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  *out_stamp = (CHash128){0};
+  for (size_t iii = 0; iii < projects.len; ++iii) {
+    CBuildImpl* cbuild = ((CBuildImpl**)projects.data)[iii];
+
+    // outputs are known by paths relative to their project
+    fs_err = c_fs_dir_change_current(cbuild->base_path.data,
+                                     cbuild->base_path.len);
+    c_defer_check(fs_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(fs_err.desc));
+
+    CHash128 stamp;
+    if (is_outputs_only) {
+      err = cbuild_db_outputs_stamp(cbuild->db,
+                                    internal_cbuild_stamp_seed(cbuild), &stamp);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    } else {
+      err = cbuild_db_scan(cbuild->db, true);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+      stamp = cbuild_db_stamp(cbuild->db, internal_cbuild_stamp_seed(cbuild));
+    }
+    *out_stamp = c_hash128_combine(*out_stamp, stamp);
+  }
+
+  c_defer_deinit();
+
+  if (cur_dir_path.data) {
+    if (cur_dir_path.len > 0) {
+      c_fs_dir_change_current(cur_dir_path.data, cur_dir_path.len);
+    }
+    c_str_destroy(&cur_dir_path);
+  }
+
+  return err;
+}
+
+CError
+internal_cbuild_build_projects(CArray const* projects,
+                               bool          is_partial,
+                               size_t        jobs)
+{
+  CError          err          = CERROR_none;
+  CStr            cur_dir_path = {0};
+  CArray          ordered      = {0}; // CArray< CBuildImpl* >
+  bool*           is_queued    = NULL;
+  bool*           record_stamp = NULL;
+  CBuildScheduler scheduler    = {0};
+
+  c_defer_init(8);
+
+  // save current path, it is restored even if a project fails
+  c_str_error_t str_err
+      = c_str_create_empty(c_fs_path_get_max_len(), &cur_dir_path);
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+  c_fs_error_t fs_err = c_fs_dir_get_current(
+      cur_dir_path.data, cur_dir_path.capacity, &cur_dir_path.len);
   c_defer_check(fs_err.code == 0, NULL, NULL,
                 err = CERROR_internal_error(fs_err.desc));
 
+  // a project is queued after the projects it depends on
+  c_array_error_t arr_err = c_array_create(sizeof(CBuildImpl*), &ordered);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &ordered,
+              err = CERROR_internal_error(arr_err.desc));
+  err = internal_cbuild_order_projects(projects, &ordered);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  is_queued = calloc(ordered.len, sizeof(bool));
+  c_defer_err(is_queued, free, is_queued, err = CERROR_memory_allocation);
+  record_stamp = calloc(ordered.len, sizeof(bool));
+  c_defer_err(record_stamp, free, record_stamp,
+              err = CERROR_memory_allocation);
+
+  // the actions of all projects in one graph, a target waits only for the
+  // targets it depends on, not for the whole project they belong to
+  err = cbuild_scheduler_create(jobs, &scheduler);
+  c_defer_err(err.code == 0, cbuild_scheduler_destroy, &scheduler, NULL);
+
+  CBuildImpl** cbuilds = ordered.data;
+  for (size_t iii = 0; iii < ordered.len; ++iii) {
+    CBuildImpl* cbuild = cbuilds[iii];
+    CBuild      handle = {cbuild};
+
+    size_t selected_len = 0;
+    for (size_t jjj = 0; jjj < cbuild->targets.len; ++jjj) {
+      CTargetImpl* target = ((CTargetImpl**)cbuild->targets.data)[jjj];
+      if (target->is_selected) { selected_len++; }
+    }
+    if (selected_len == 0) { continue; }
+
+    // build paths are relative to their project
+    fs_err = c_fs_dir_change_current(cbuild->base_path.data,
+                                     cbuild->base_path.len);
+    c_defer_check(fs_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(fs_err.desc));
+
+    // the state of everything the project knows, in one batch. headers
+    // may have come and gone since the last build
+    err = cbuild_db_scan(cbuild->db, true);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+    cbuild_scanner_forget_resolutions(cbuild->scanner);
+
+    // other targets link the objects of object targets, even when their
+    // project is up to date
+    for (size_t jjj = 0; jjj < cbuild->targets.len; ++jjj) {
+      CTargetImpl* target = ((CTargetImpl**)cbuild->targets.data)[jjj];
+      if (target->ttype != CTARGET_TYPE_object || !target->is_selected) {
+        continue;
+      }
+
+      err = cbuild_target_prepare(&handle, target);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+
+    // a project nothing changed in since its last successful build is
+    // skipped without walking its targets, unless a project it depends on
+    // is about to change its inputs
+    bool is_outdated = false;
+    for (size_t jjj = 0; jjj < iii && !is_outdated; ++jjj) {
+      if (!is_queued[jjj]) { continue; }
+      for (size_t kkk = 0; kkk < cbuild->other_projects.len; ++kkk) {
+        if (((CBuildImpl**)cbuild->other_projects.data)[kkk] == cbuilds[jjj]) {
+          is_outdated = true;
+          break;
+        }
+      }
+    }
+    CBuildDbRecord* stamp_record
+        = cbuild_db_find(cbuild->db, CBUILD_DB_KIND_stamp,
+                         cbuild->base_path.data, cbuild->base_path.len);
+    CHash128 const stamp
+        = cbuild_db_stamp(cbuild->db, internal_cbuild_stamp_seed(cbuild));
+    if (!is_outdated && stamp_record
+        && c_hash128_equal(stamp_record->hash, stamp)) {
+      continue;
+    }
+
+    // the stamp covers the whole project, partial builds can't record it
+    record_stamp[iii] = selected_len == cbuild->targets.len;
+    is_queued[iii]    = true;
+
+    err = internal_cbuild_command_create_paths(cbuild);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    for (size_t jjj = 0; jjj < cbuild->targets.len; ++jjj) {
+      CTargetImpl* target = ((CTargetImpl**)cbuild->targets.data)[jjj];
+      if (target->ttype == CTARGET_TYPE_object || !target->is_selected) {
+        continue;
+      }
+
+      err = cbuild_target_prepare(&handle, target);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+
+    err = cbuild_scheduler_add_project(&scheduler, &handle, is_partial);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  /// build dependant targets
+  err = cbuild_scheduler_run(&scheduler);
+
+  for (size_t iii = 0; iii < ordered.len; ++iii) {
+    CBuildImpl* cbuild = cbuilds[iii];
+    if (!is_queued[iii]) { continue; }
+
+    fs_err = c_fs_dir_change_current(cbuild->base_path.data,
+                                     cbuild->base_path.len);
+    if (fs_err.code != 0 && err.code == 0) {
+      err = CERROR_internal_error(fs_err.desc);
+    }
+
+    if (record_stamp[iii] && err.code == 0) {
+      CBuildDbRecord stamp = {
+          .hash = cbuild_db_stamp(cbuild->db,
+                                  internal_cbuild_stamp_seed(cbuild)),
+      };
+      err = cbuild_db_put(cbuild->db, CBUILD_DB_KIND_stamp,
+                          cbuild->base_path.data, cbuild->base_path.len,
+                          &stamp);
+    }
+
+    // keep the fingerprints of whatever succeeded
+    CError db_err = cbuild_db_save(cbuild->db);
+    if (err.code == 0) { err = db_err; }
+  }
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
   c_defer_deinit();
 
+  if (cur_dir_path.data) {
+    if (cur_dir_path.len > 0) {
+      c_fs_dir_change_current(cur_dir_path.data, cur_dir_path.len);
+    }
+    c_str_destroy(&cur_dir_path);
+  }
+
   return err;
 }
 
@@ -745,6 +1948,7 @@ cbuild_destroy(CBuild* self)
   c_array_destroy(&self->impl->other_projects);
 
   c_str_destroy(&self->impl->base_path);
+  c_str_destroy(&self->impl->config);
   c_str_destroy(&self->impl->cflags);
   c_str_destroy(&self->impl->lflags);
   c_str_destroy(&self->impl->link_with);
@@ -752,13 +1956,32 @@ cbuild_destroy(CBuild* self)
   c_str_destroy(&self->impl->cmds.linker);
   c_str_destroy(&self->impl->cmds.shared_lib_creator);
   c_str_destroy(&self->impl->cmds.static_lib_creator);
+  c_str_destroy(&self->impl->cmds.static_lib_creator_lto);
+
+  cbuild_db_destroy(self->impl->db);
+  free(self->impl->db);
+  cbuild_scanner_destroy(self->impl->scanner);
+  free(self->impl->scanner);
 
-  // targets
-  for (size_t i = 0; i < self->impl->targets.len;) {
+  // targets, the last first, nothing is moved
+  for (size_t iii = self->impl->targets.len; iii > 0; --iii) {
     cbuild_target_destroy(
-        self, &(CTarget){((CTargetImpl**)self->impl->targets.data)[i]});
+        self, &(CTarget){((CTargetImpl**)self->impl->targets.data)[iii - 1]});
   }
   c_array_destroy(&self->impl->targets);
+  c_hash_index_destroy(&self->impl->target_index);
+
+  for (size_t iii = 0; iii < self->impl->commands.len; ++iii) {
+    internal_cbuild_command_destroy(
+        &((CBuildCommand*)self->impl->commands.data)[iii]);
+  }
+  c_array_destroy(&self->impl->commands);
+
+  // after the targets, their sources and units are views inside
+  cbuild_paths_destroy(self->impl->paths);
+  free(self->impl->paths);
+  cbuild_arena_destroy(self->impl->arena);
+  free(self->impl->arena);
 
   *self->impl = (CBuildImpl){0};
   free(self->impl);
@@ -766,107 +1989,2716 @@ cbuild_destroy(CBuild* self)
   *self = (CBuild){0};
 }
 
+char const*
+cbuild_type_get_name(CBuildType btype)
+{
+  size_t const types_len = sizeof(build_type_names) / sizeof(*build_type_names);
+  if ((size_t)btype >= types_len) { return build_type_names[0].name; }
+
+  return build_type_names[btype].name;
+}
+
 CError
-cbuild_target_create(CBuild*     self,
-                     char const  name[],
-                     size_t      name_len,
-                     char const  base_path[],
-                     size_t      base_path_len,
-                     char const  lflags[],
-                     size_t      lflags_len,
+cbuild_type_from_name(char const  name[],
+                      size_t      name_len,
+                      CBuildType* out_btype)
+{
+  assert(name);
+  assert(out_btype);
+
+  size_t const types_len = sizeof(build_type_names) / sizeof(*build_type_names);
+  for (size_t iii = 0; iii < types_len; ++iii) {
+    char const* type_name  = build_type_names[iii].name;
+    char const* type_alias = build_type_names[iii].alias;
+    if ((strlen(type_name) == name_len
+         && strncmp(type_name, name, name_len) == 0)
+        || (strlen(type_alias) == name_len
+            && strncmp(type_alias, name, name_len) == 0)) {
+      *out_btype = (CBuildType)iii;
+      return CERROR_none;
+    }
+  }
+
+  return CERROR_wrong_options;
+}
+
+char const*
+cbuild_get_builder_dir_name(void)
+{
+  return default_builder_path;
+}
+
+bool
+cbuild_is_output_dir(char const dir_name[], size_t dir_name_len)
+{
+  assert(dir_name);
+
+  char const* const roots[] = {default_builder_path, default_install_path};
+  for (size_t iii = 0; iii < sizeof(roots) / sizeof(roots[0]); ++iii) {
+    if (strlen(roots[iii]) == dir_name_len
+        && strncmp(roots[iii], dir_name, dir_name_len) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+CError
+cbuild_target_create(CBuild*     self,
+                     char const  name[],
+                     size_t      name_len,
+                     char const  base_path[],
+                     size_t      base_path_len,
+                     char const  lflags[],
+                     size_t      lflags_len,
                      CTargetType ttype,
                      CTarget*    out_target)
 {
-  assert(self && self->impl);
+  assert(self && self->impl);
+
+  if (!out_target) { return CERROR_none; }
+
+  CError err = CERROR_none;
+
+  c_defer_init(6);
+
+  // from the arena of the project, nothing is released before it is
+  *out_target      = (CTarget){0};
+  out_target->impl = cbuild_arena_alloc(self->impl->arena, sizeof(CTargetImpl),
+                                        CBUILD_ALIGNOF(CTargetImpl));
+  if (!out_target->impl) { return CERROR_memory_allocation; }
+  *out_target->impl = (CTargetImpl){0};
+
+  // ttype
+  out_target->impl->ttype = ttype;
+
+  // target name
+  err = cbuild_paths_intern(self->impl->paths, name, name_len,
+                            &out_target->impl->name);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // cbuild base dir
+  err = cbuild_paths_intern(self->impl->paths, self->impl->base_path.data,
+                            self->impl->base_path.len,
+                            &out_target->impl->cbuild_base_dir);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // base dir
+  CStr         base_dir    = {0};
+  bool         is_absolute = false;
+  c_fs_error_t fs_err
+      = c_fs_path_is_absolute(base_path, base_path_len, &is_absolute);
+  if (!is_absolute) {
+    c_str_error_t str_err
+        = c_str_create_empty(c_fs_path_get_max_len(), &base_dir);
+    c_defer_err(str_err.code == 0, c_str_destroy, &base_dir,
+                err = CERROR_internal_error(str_err.desc));
+    fs_err = c_fs_path_to_absolute(base_path, base_path_len, base_dir.data,
+                                   base_dir.capacity, &base_dir.len);
+    c_defer_check(fs_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(fs_err.desc));
+    err = cbuild_paths_intern(self->impl->paths, base_dir.data, base_dir.len,
+                              &out_target->impl->base_dir);
+  } else {
+    err = cbuild_paths_intern(self->impl->paths, base_path, base_path_len,
+                              &out_target->impl->base_dir);
+  }
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // build path
+  err = internal_cbuild_get_path(self->impl, out_target->impl,
+                                 default_builder_path,
+                                 &out_target->impl->build_path);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // install path
+  err = internal_cbuild_get_path(self->impl, out_target->impl,
+                                 default_install_path,
+                                 &out_target->impl->install_path);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // precompiled header
+  c_str_error_t str_err
+      = c_str_create(C_STR(""), &out_target->impl->precompiled_header);
+  c_defer_check(str_err.code == 0, c_str_destroy,
+                &out_target->impl->precompiled_header,
+                err = CERROR_internal_error(str_err.desc));
+
+  // sources
+  c_array_error_t arr_err
+      = c_array_create(sizeof(CStr), &out_target->impl->sources);
+  c_defer_check(arr_err.code == 0, c_array_destroy, &out_target->impl->sources,
+                err = CERROR_internal_error(arr_err.desc));
+
+  // units
+  arr_err = c_array_create(sizeof(CStr), &out_target->impl->units);
+  c_defer_check(arr_err.code == 0, c_array_destroy, &out_target->impl->units,
+                err = CERROR_internal_error(arr_err.desc));
+
+  // objects of the units
+  arr_err = c_array_create(sizeof(CStr), &out_target->impl->objects);
+  c_defer_check(arr_err.code == 0, c_array_destroy,
+                &out_target->impl->objects,
+                err = CERROR_internal_error(arr_err.desc));
+
+  // sources kept out of unity builds
+  arr_err = c_array_create(sizeof(CStr), &out_target->impl->unity_excluded);
+  c_defer_check(arr_err.code == 0, c_array_destroy,
+                &out_target->impl->unity_excluded,
+                err = CERROR_internal_error(arr_err.desc));
+
+  // sources compiled by every library sharing the objects
+  arr_err = c_array_create(sizeof(CStr), &out_target->impl->share_excluded);
+  c_defer_check(arr_err.code == 0, c_array_destroy,
+                &out_target->impl->share_excluded,
+                err = CERROR_internal_error(arr_err.desc));
+
+  // pgo trainings
+  arr_err = c_array_create(sizeof(CStr), &out_target->impl->pgo_trainings);
+  c_defer_check(arr_err.code == 0, c_array_destroy,
+                &out_target->impl->pgo_trainings,
+                err = CERROR_internal_error(arr_err.desc));
+
+  // dependencies
+  arr_err
+      = c_array_create(sizeof(CTargetImpl*), &out_target->impl->dependencies);
+  c_defer_check(arr_err.code == 0, c_array_destroy,
+                &out_target->impl->dependencies,
+                err = CERROR_internal_error(arr_err.desc));
+
+  // cflags
+  arr_err = c_array_create(sizeof(char const*), &out_target->impl->cflags);
+  c_defer_check(arr_err.code == 0, c_array_destroy, &out_target->impl->cflags,
+                err = CERROR_internal_error(arr_err.desc));
+  err = internal_cbuild_push_args(self->impl, &out_target->impl->cflags,
+                                  self->impl->cflags.data,
+                                  self->impl->cflags.len);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // lflags
+  arr_err = c_array_create(sizeof(char const*), &out_target->impl->lflags);
+  c_defer_check(arr_err.code == 0, c_array_destroy, &out_target->impl->lflags,
+                err = CERROR_internal_error(arr_err.desc));
+  err = internal_cbuild_push_args(self->impl, &out_target->impl->lflags,
+                                  lflags, lflags_len);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // link_with
+  arr_err = c_array_create(sizeof(char const*), &out_target->impl->link_with);
+  c_defer_check(arr_err.code == 0, c_array_destroy,
+                &out_target->impl->link_with,
+                err = CERROR_internal_error(arr_err.desc));
+
+  // compile and link arguments, set before every build
+  arr_err
+      = c_array_create(sizeof(char const*), &out_target->impl->compile_args);
+  c_defer_check(arr_err.code == 0, c_array_destroy,
+                &out_target->impl->compile_args,
+                err = CERROR_internal_error(arr_err.desc));
+  arr_err = c_array_create(sizeof(char const*), &out_target->impl->link_args);
+  c_defer_check(arr_err.code == 0, c_array_destroy,
+                &out_target->impl->link_args,
+                err = CERROR_internal_error(arr_err.desc));
+
+  arr_err = c_array_push(&self->impl->targets, &out_target->impl);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+  err = c_hash_index_insert(&self->impl->target_index,
+                            internal_cbuild_target_hash(name, name_len),
+                            self->impl->targets.len - 1);
+  if (err.code != 0) {
+    c_array_remove(&self->impl->targets, self->impl->targets.len - 1);
+  }
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_target_prepare(CBuild* self, CTargetImpl* target)
+{
+  assert(self && self->impl);
+  assert(target);
+
+  // create the target build path if not existing
+  CError err = internal_cbuild_target_create_paths(target);
+  if (err.code != 0) { return err; }
+
+  // the units are picked through the library sharing its objects too,
+  // which may be prepared after `target`
+  if (target->objects_of) {
+    err = internal_cbuild_target_index(target->objects_of);
+    if (err.code != 0) { return err; }
+  }
+  err = internal_cbuild_target_index(target);
+  if (err.code != 0) { return err; }
+
+  err = internal_cbuild_target_set_units(self->impl, target);
+  if (err.code != 0) { return err; }
+
+  err = internal_cbuild_target_set_objects(self->impl, target);
+  if (err.code != 0) { return err; }
+
+  return internal_cbuild_target_set_args(self->impl, target);
+}
+
+CError
+cbuild_target_build(CBuild* self, CTargetImpl* target)
+{
+  if (!target) { return CERROR_none; }
+
+  CError err = CERROR_none;
+
+  c_defer_init(6);
+
+  err = cbuild_target_prepare(self, target);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  for (size_t iii = 0; iii < target->dependencies.len; iii++) {
+    /// FIXME: this will introduce an issue if one of deps
+    /// destructed
+    CTargetImpl* dependency = ((CTargetImpl**)target->dependencies.data)[iii];
+
+    // targets of other projects are built by their own project
+    if (strcmp(dependency->cbuild_base_dir.data, target->cbuild_base_dir.data)
+        != 0) {
+      continue;
+    }
+
+    err = cbuild_target_build(self, dependency);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  // compile
+  err = cbuild_target_compile(self, target);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  if (target->ttype != CTARGET_TYPE_object) {
+    CBuildArena scratch;
+    err = cbuild_arena_create(CBUILD_SCRATCH_BLOCK_SIZE, &scratch);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+    err = cbuild_target_link(self, target, &scratch);
+    cbuild_arena_destroy(&scratch);
+  }
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_target_compile(CBuild* self, CTargetImpl* target)
+{
+  CBuildArena scratch;
+  CError      err = cbuild_arena_create(CBUILD_SCRATCH_BLOCK_SIZE, &scratch);
+  if (err.code != 0) { return err; }
+
+  err = cbuild_target_precompile_header(self, target, &scratch);
+  cbuild_arena_reset(&scratch);
+
+  for (size_t iii = 0; err.code == 0 && iii < target->units.len; ++iii) {
+    err = cbuild_target_compile_source(self, target, iii, &scratch);
+    cbuild_arena_reset(&scratch);
+  }
+  cbuild_arena_destroy(&scratch);
+
+  return err;
+}
+
+CError
+cbuild_target_compile_source(CBuild*      self,
+                             CTargetImpl* target,
+                             size_t       unit_index,
+                             CBuildArena* scratch)
+{
+  assert(unit_index < target->units.len);
+  assert(scratch);
+
+  CStr const* source = &((CStr*)target->units.data)[unit_index];
+
+  // objects are handed to the linker as they are
+  if (internal_cbuild_is_object(source)) { return CERROR_none; }
+
+  CError      err     = CERROR_none;
+  CStr const* pch_ptr = NULL;
+  CStr const* object  = &((CStr*)target->objects.data)[unit_index];
+  CStr        output  = {0}; // inside `scratch`, like the arguments
+  CStr        dwo     = {0}; // inside `scratch`
+  CStr const* dwo_ptr = NULL;
+
+  c_defer_init(4);
+
+  // every argument but the template is known, the command is taken from
+  // `scratch` at once instead of growing
+  size_t const argv_capacity = target->compile_args.len + 8;
+  char const** argv          = cbuild_arena_alloc(scratch,
+                                         argv_capacity * sizeof(char const*),
+                                         CBUILD_ALIGNOF(char const*));
+  c_defer_check(argv, NULL, NULL, err = CERROR_memory_allocation);
+
+  // $ <compiler> <cflags>, expanded once for every compile of the target
+  size_t argv_len = target->compile_args.len;
+  memcpy(argv, target->compile_args.data, argv_len * sizeof(char const*));
+
+  // $ <compiler> <cflags> -include <build path>/<header name>
+  if (target->precompiled_header.len > 0) {
+    argv[argv_len++] = default_builder->cflags.force_include;
+
+    if (target->pch.len > 0) {
+      argv[argv_len++] = target->pch_include.data;
+      pch_ptr          = &target->pch;
+    } else {
+      argv[argv_len++] = target->precompiled_header.data;
+    }
+  }
+
+  // $ <compiler> <cflags> -c
+  argv[argv_len++] = default_builder->cflags.compile;
+
+  // $ <compiler> <cflags> -c -MMD
+  if (default_builder->cflags.depfile[0] != '\0') {
+    argv[argv_len++] = default_builder->cflags.depfile;
+  }
+
+#ifdef _WIN32
+  // $ <compiler> <cflags> -c /Fdc:<c_out>/<target name>
+  char const        separator[] = {c_fs_path_get_separator(), '\0'};
+  char const* const pdb_output[]
+      = {builder_windows_compile_flag_pdb_output_path, target->build_path.data,
+         separator, target->name.data};
+  CStr pdb = {0};
+  err = internal_cbuild_scratch_join(
+      scratch, pdb_output, sizeof(pdb_output) / sizeof(*pdb_output), &pdb);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  argv[argv_len++] = pdb.data;
+  char const* flag_output = builder_windows_compile_flag_obj_output_path;
+#else
+  char const* flag_output = default_builder->flags.output;
+#endif
+
+  // $ <compiler> <cflags> -c -o<build path>/<source name>.<hash>.o
+  char const* const output_parts[] = {flag_output, object->data};
+  err = internal_cbuild_scratch_join(
+      scratch, output_parts, sizeof(output_parts) / sizeof(*output_parts),
+      &output);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  argv[argv_len++] = output.data;
+
+  // <build path>/<source name>.<hash>.dwo
+  // the compiler replaces the last extension of the object
+  if (internal_cbuild_get_debug_info(self->impl) & CBUILD_DEBUG_INFO_split) {
+    size_t const stem_len
+        = object->len - strlen(default_builder->extension.object);
+    size_t const ext_len = strlen(default_builder->extension.split_dwarf);
+    dwo.data = cbuild_arena_alloc(scratch, stem_len + ext_len + 1, 1);
+    c_defer_check(dwo.data, NULL, NULL, err = CERROR_memory_allocation);
+    memcpy(dwo.data, object->data, stem_len);
+    memcpy(&dwo.data[stem_len], default_builder->extension.split_dwarf,
+           ext_len + 1);
+    dwo.len      = stem_len + ext_len;
+    dwo.capacity = dwo.len;
+    dwo_ptr      = &dwo;
+  }
+
+  // $ <compiler> <cflags> -c -o<object> <source>
+  argv[argv_len++] = source->data;
+
+  // $ <compiler> <cflags> -c -o<object> <source> <NULL>
+  argv[argv_len++] = NULL;
+  assert(argv_len <= argv_capacity);
+
+  // a read only view, nothing is pushed to it
+  CArray const cmd = {.data = argv, .len = argv_len};
+  err = internal_cbuild_exec_compile(self, target, &cmd, source, object,
+                                     dwo_ptr, pch_ptr, scratch);
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_target_precompile_header(CBuild*      self,
+                                CTargetImpl* target,
+                                CBuildArena* scratch)
+{
+  // without builder support the header is included as it is
+  if (target->pch.len == 0) { return CERROR_none; }
+
+  CError      err     = CERROR_none;
+  CArray      cmd     = {0}; // CArray < char* >
+  CStr const* include = &target->pch_include;
+  CStr const* pch     = &target->pch;
+  CStr        content = {0}; // inside `scratch`
+  CStr        output  = {0}; // inside `scratch`
+
+  c_defer_init(4);
+
+  // the sources include a header of the build path that includes the real
+  // one, the compiler falls back to it if it rejects the precompiled one
+  char const* const content_parts[]
+      = {"#include \"", target->precompiled_header.data, "\"\n"};
+  err = internal_cbuild_scratch_join(
+      scratch, content_parts, sizeof(content_parts) / sizeof(*content_parts),
+      &content);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  err = internal_cbuild_write_if_changed(self->impl, include, &content);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  c_array_error_t arr_err = c_array_create(sizeof(char*), &cmd);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &cmd,
+              err = CERROR_internal_error(arr_err.desc));
+
+  // $ <compiler> <cflags>, the sources have to be compiled with the same
+  err = internal_cbuild_push_all(&target->compile_args, &cmd);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // $ <compiler> <cflags> -xc-header -MMD
+  arr_err = c_array_push(
+      &cmd, &(char const*){default_builder->cflags.precompile_header});
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+  if (default_builder->cflags.depfile[0] != '\0') {
+    arr_err
+        = c_array_push(&cmd, &(char const*){default_builder->cflags.depfile});
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+
+  // $ <compiler> <cflags> -xc-header -MMD -o<build path>/<header name>.gch
+  char const* const output_parts[] = {default_builder->flags.output, pch->data};
+  err = internal_cbuild_scratch_join(
+      scratch, output_parts, sizeof(output_parts) / sizeof(*output_parts),
+      &output);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  arr_err = c_array_push(&cmd, &output.data);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+
+  // $ <compiler> <cflags> -xc-header -MMD -o<pch> <build path>/<header name>
+  arr_err = c_array_push(&cmd, &include->data);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+
+  arr_err = c_array_push(&cmd, &(void*){NULL});
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+
+  err = internal_cbuild_exec_compile(self, target, &cmd, include, pch,
+                                     NULL, NULL, scratch);
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_target_link(CBuild* self, CTargetImpl* target, CBuildArena* scratch)
+{
+  CError err = CERROR_none;
+
+  c_defer_init(8);
+
+  CArray          cmd; // CArray < char* >
+  c_array_error_t arr_err = c_array_create(sizeof(char*), &cmd);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &cmd,
+              err = CERROR_internal_error(arr_err.desc));
+
+  CArray objects; // CArray < CStr >
+  arr_err = c_array_create(sizeof(CStr), &objects);
+  c_defer_err(arr_err.code == 0, internal_cbuild_objects_destroy, &objects,
+              err = CERROR_internal_error(arr_err.desc));
+
+  // create the install path if not exists
+  bool install_path_exists = false;
+  c_fs_dir_exists(target->install_path.data, target->install_path.len,
+                  &install_path_exists);
+  if (!install_path_exists) {
+    c_fs_error_t fs_err
+        = c_fs_dir_create(target->install_path.data, target->install_path.len);
+    c_defer_check(fs_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(fs_err.desc));
+  }
+
+  char const* flag_output = default_builder->flags.output;
+
+  // $ <link creator> <lflags>
+  if (target->ttype != CTARGET_TYPE_static
+      && target->ttype != CTARGET_TYPE_shared
+      && target->ttype != CTARGET_TYPE_executable) {
+    c_defer_check(false, NULL, NULL, err = CERROR_invalid_target_type);
+  }
+  err = internal_cbuild_push_all(&target->link_args, &cmd);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  /// FIXME: very ugly hack
+  char const*  creator     = ((char const**)target->link_args.data)[0];
+  size_t const creator_len = strlen(creator);
+  if (target->ttype == CTARGET_TYPE_static && creator_len >= 2
+      && strcmp("ar", &creator[creator_len - 2]) == 0) {
+    flag_output = "";
+  }
+
+  CStr output_path;
+  err = internal_cbuild_target_get_output_path(target, &output_path);
+  c_defer_err(err.code == 0, c_str_destroy, &output_path, NULL);
+
+  // -o<install_path>/lib<name>.so
+  // -o<install path>/<name>
+  // <install path>/<name>.a
+  char const* const output_parts[] = {flag_output, output_path.data};
+  CStr              output         = {0}; // inside `scratch`
+  err = internal_cbuild_scratch_join(
+      scratch, output_parts, sizeof(output_parts) / sizeof(*output_parts),
+      &output);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  arr_err = c_array_push(&cmd, &output.data);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+
+  // $ <lib creator> <lflags> <object files>
+  // exactly the objects of this target, stale objects left inside the
+  // build path are never linked
+  for (size_t iii = 0; iii < target->units.len; ++iii) {
+    CStr const* source = &((CStr*)target->units.data)[iii];
+    CStr        object = {0};
+
+    if (internal_cbuild_is_object(source)) {
+      c_str_error_t str_err = c_str_clone(source, &object);
+      c_defer_check(str_err.code == 0, NULL, NULL,
+                    err = CERROR_internal_error(str_err.desc));
+    } else {
+      err = internal_cbuild_target_get_object_path(target, source, &object);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+
+    arr_err = c_array_push(&objects, &object);
+    if (arr_err.code != 0) { c_str_destroy(&object); }
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+
+  // $ <lib creator> <lflags> <object files> <dependency objects>
+  // of object targets and of the library it shares the objects of
+  for (size_t iii = 0; iii < target->dependencies.len; ++iii) {
+    CTargetImpl* dependency = ((CTargetImpl**)target->dependencies.data)[iii];
+    if (dependency->ttype != CTARGET_TYPE_object
+        && dependency != target->objects_of) {
+      continue;
+    }
+
+    err = internal_cbuild_push_dependency_objects(self->impl, target,
+                                                  dependency, &objects);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  // a thin archive finds its members from its own directory, relative
+  // paths only work from the current one
+  char const   separator[] = {c_fs_path_get_separator(), '\0'};
+  size_t const objects_at  = cmd.len;
+  for (size_t iii = 0; iii < objects.len; ++iii) {
+    CStr const* object      = &((CStr*)objects.data)[iii];
+    bool        is_absolute = true;
+    if (target->ttype == CTARGET_TYPE_static && target->is_thin_archive) {
+      c_fs_path_is_absolute(object->data, object->len, &is_absolute);
+    }
+
+    if (is_absolute) {
+      arr_err = c_array_push(&cmd, &object->data);
+    } else {
+      // inside `scratch`
+      char const* const parts[]
+          = {target->cbuild_base_dir.data, separator, object->data};
+      CStr absolute = {0};
+      err = internal_cbuild_scratch_join(
+          scratch, parts, sizeof(parts) / sizeof(*parts), &absolute);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+      arr_err = c_array_push(&cmd, &absolute.data);
+    }
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+
+  // $ <lib creator> <lflags> <object files> <link with>
+  err = internal_cbuild_push_all(&target->link_with, &cmd);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  arr_err = c_array_push(&cmd, &(void*){NULL});
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+
+  // a shared library without its table of contents is linked again to get
+  // one, its dependents never see it missing
+  bool has_toc = true;
+  if (target->ttype == CTARGET_TYPE_shared) {
+    CStr toc;
+    err = internal_cbuild_target_get_meta_path(target, toc_extension, &toc);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+    c_fs_exists(toc.data, toc.len, &has_toc);
+    c_str_destroy(&toc);
+  }
+
+  CHash128 fingerprint;
+  cbuild_db_lock(self->impl->db);
+  err = internal_cbuild_link_fingerprint(self, &cmd, &objects, target,
+                                         &fingerprint);
+  bool is_up_to_date
+      = err.code == 0 && has_toc
+        && internal_cbuild_is_up_to_date(self, &output_path, fingerprint);
+  cbuild_db_unlock(self->impl->db);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  c_defer_check(!is_up_to_date, NULL, NULL, NULL);
+
+  // a static library only gets its changed members replaced
+  CArray   prefix      = cmd;
+  CHash128 prefix_hash = {0};
+  if (target->ttype == CTARGET_TYPE_static) {
+    prefix.len  = objects_at;
+    prefix_hash = internal_cbuild_cmd_hash(&prefix);
+    err = internal_cbuild_archive_prepare(self->impl, target, &output_path,
+                                          &objects, prefix_hash, objects_at,
+                                          &cmd);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  err = internal_cbuild_exec(&cmd, scratch);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  cbuild_db_lock(self->impl->db);
+  err = cbuild_db_put(self->impl->db, CBUILD_DB_KIND_action, output_path.data,
+                      output_path.len, &(CBuildDbRecord){.hash = fingerprint});
+  cbuild_db_unlock(self->impl->db);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  if (target->ttype == CTARGET_TYPE_shared) {
+    err = internal_cbuild_write_toc(self->impl, target, &output_path);
+  } else if (target->ttype == CTARGET_TYPE_static) {
+    err = internal_cbuild_archive_write_members(self->impl, target, &objects,
+                                                prefix_hash);
+  }
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_command_run(CBuild* self, size_t command_index, CBuildArena* scratch)
+{
+  assert(command_index < self->impl->commands.len);
+
+  CBuildCommand const* command
+      = &((CBuildCommand*)self->impl->commands.data)[command_index];
+
+  CError err = CERROR_none;
+  CArray cmd = {0}; // CArray< char const* >
+
+  c_defer_init(2);
+
+  c_array_error_t arr_err = c_array_create(sizeof(char const*), &cmd);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &cmd,
+              err = CERROR_internal_error(arr_err.desc));
+
+  // $ <argv> <NULL>
+  for (size_t iii = 0; iii <= command->argv.len; ++iii) {
+    char const* arg = iii < command->argv.len
+                          ? ((CStr*)command->argv.data)[iii].data
+                          : NULL;
+    arr_err         = c_array_push(&cmd, &arg);
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+
+  CHash128 fingerprint;
+  cbuild_db_lock(self->impl->db);
+  err = internal_cbuild_command_fingerprint(self->impl, command, &cmd,
+                                            &fingerprint);
+  bool is_up_to_date = err.code == 0;
+  for (size_t iii = 0; is_up_to_date && iii < command->outputs.len; ++iii) {
+    is_up_to_date = internal_cbuild_is_up_to_date(
+        self, &((CStr*)command->outputs.data)[iii], fingerprint);
+  }
+  cbuild_db_unlock(self->impl->db);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  c_defer_check(!is_up_to_date, NULL, NULL, NULL);
+
+  err = internal_cbuild_exec(&cmd, scratch);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // the compiles reading the outputs hash them again, a generated header
+  // may be found where nothing was
+  cbuild_db_lock(self->impl->db);
+  cbuild_scanner_forget_resolutions(self->impl->scanner);
+  for (size_t iii = 0; err.code == 0 && iii < command->outputs.len; ++iii) {
+    CStr const* output = &((CStr*)command->outputs.data)[iii];
+    cbuild_db_forget_states_of(self->impl->db, output->data, output->len);
+
+    bool exists = false;
+    c_fs_exists(output->data, output->len, &exists);
+    if (!exists) {
+      err = CERROR_internal_error("c: a custom command missed an output");
+      break;
+    }
+    err = cbuild_db_put(self->impl->db, CBUILD_DB_KIND_action, output->data,
+                        output->len, &(CBuildDbRecord){.hash = fingerprint});
+  }
+  cbuild_db_unlock(self->impl->db);
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_target_source_commands(CBuild*      self,
+                              CTargetImpl* target,
+                              CStr const*  source,
+                              CArray*      out_commands)
+{
+  CError err          = CERROR_none;
+  CArray include_dirs = {0}; // CArray< char const* >
+  CArray headers      = {0}; // CArray< CStr >
+  CArray missing      = {0}; // CArray< CStr >
+
+  c_array_error_t arr_err = c_array_create(sizeof(size_t), out_commands);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+
+  // objects are handed to the linker as they are
+  if (self->impl->commands.len == 0 || internal_cbuild_is_object(source)) {
+    return CERROR_none;
+  }
+
+  c_defer_init(6);
+
+  // the include paths of the compile
+  arr_err = c_array_create(sizeof(char const*), &include_dirs);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &include_dirs,
+              err = CERROR_internal_error(arr_err.desc));
+  err = internal_cbuild_push_include_dirs(&target->cflags, &include_dirs);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  err = cbuild_scanner_headers(self->impl->scanner, source->data, source->len,
+                               &include_dirs, &headers, &missing);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  for (size_t iii = 0; iii < self->impl->commands.len; ++iii) {
+    CBuildCommand const* command
+        = &((CBuildCommand*)self->impl->commands.data)[iii];
+
+    bool is_written = false;
+    for (size_t jjj = 0; !is_written && jjj < command->outputs.len; ++jjj) {
+      CStr const* output = &((CStr*)command->outputs.data)[jjj];
+
+      is_written = output->len == source->len
+                   && memcmp(output->data, source->data, source->len) == 0;
+      for (size_t kkk = 0; !is_written && kkk < headers.len; ++kkk) {
+        is_written = internal_cbuild_path_has_name(
+            output, &((CStr*)headers.data)[kkk]);
+      }
+      for (size_t kkk = 0; !is_written && kkk < missing.len; ++kkk) {
+        is_written = internal_cbuild_path_has_name(
+            output, &((CStr*)missing.data)[kkk]);
+      }
+    }
+
+    if (is_written) {
+      arr_err = c_array_push(out_commands, &iii);
+      if (arr_err.code != 0) { err = CERROR_internal_error(arr_err.desc); }
+    }
+    if (err.code != 0) { break; }
+  }
+
+  internal_cbuild_objects_destroy(&headers);
+  internal_cbuild_objects_destroy(&missing);
+
+  c_defer_deinit();
+
+  if (err.code != 0) { c_array_destroy(out_commands); }
+
+  return err;
+}
+
+// ------------------------------------------------------------------------//
+// ------------------------------ Internals -------------------------------//
+// ------------------------------------------------------------------------//
+
+bool
+internal_cbuild_is_object(CStr const* source)
+{
+  size_t ext_len = strlen(default_builder->extension.object);
+
+  return source->len > ext_len
+         && strcmp(&source->data[source->len - ext_len],
+                   default_builder->extension.object)
+                == 0;
+}
+
+CError
+internal_cbuild_push_dependency_objects(CBuildImpl*  cbuild,
+                                        CTargetImpl* target,
+                                        CTargetImpl* dependency,
+                                        CArray*      objects)
+{
+  // paths of other projects are relative to their own directory
+  bool const is_other_project = strcmp(dependency->cbuild_base_dir.data,
+                                       target->cbuild_base_dir.data)
+                                != 0;
+
+  for (size_t iii = 0; iii < dependency->units.len; ++iii) {
+    CStr const* source = &((CStr*)dependency->units.data)[iii];
+    CStr        object = {0};
+    if (internal_cbuild_is_share_excluded(dependency, source)) { continue; }
+
+    if (internal_cbuild_is_object(source)) {
+      c_str_error_t str_err = c_str_clone(source, &object);
+      if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+    } else {
+      CError err = internal_cbuild_target_get_object_path(dependency, source,
+                                                          &object);
+      if (err.code != 0) { return err; }
+    }
+
+    bool is_absolute = true;
+    c_fs_path_is_absolute(object.data, object.len, &is_absolute);
+    if (is_other_project && !is_absolute) {
+      CStr          absolute = {0};
+      c_str_error_t str_err
+          = c_str_create_empty(c_fs_path_get_max_len(), &absolute);
+      if (str_err.code == 0) {
+        str_err = c_str_format(&absolute, 0, C_STR_INV("%s%c%s"),
+                               dependency->cbuild_base_dir.data,
+                               c_fs_path_get_separator(), object.data);
+      }
+      c_str_destroy(&object);
+      object = absolute;
+      if (str_err.code != 0) {
+        c_str_destroy(&object);
+        return CERROR_internal_error(str_err.desc);
+      }
+
+      // the project of the dependency wrote it during this build
+      cbuild_db_forget_state(cbuild->db, object.data, object.len);
+    }
+
+    c_array_error_t arr_err = c_array_push(objects, &object);
+    if (arr_err.code != 0) {
+      c_str_destroy(&object);
+      return CERROR_internal_error(arr_err.desc);
+    }
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_target_get_object_path(CTargetImpl* target,
+                                       CStr const*  source,
+                                       CStr*        out_object)
+{
+  // sources with the same name inside different directories must not
+  // share an object
+  CHash128 source_hash = c_hash128(source->data, source->len, 0);
+
+  char const* source_name = source->data;
+  for (size_t iii = 0; iii < source->len; ++iii) {
+    if (source->data[iii] == '/' || source->data[iii] == '\\') {
+      source_name = &source->data[iii + 1];
+    }
+  }
+
+  // <build path>/<source name>.<hash>.o
+  c_str_error_t str_err = c_str_format(
+      out_object, 0, C_STR_INV("%s%c%s.%08x%s"), target->build_path.data,
+      c_fs_path_get_separator(), source_name,
+      (unsigned int)(source_hash.low & 0xffffffffU),
+      default_builder->extension.object);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_target_get_output_path(CTargetImpl* target, CStr* out_output)
+{
+  char const* extension = "";
+  switch (target->ttype) {
+  case CTARGET_TYPE_static:
+    extension = default_builder->extension.lib_static;
+    break;
+  case CTARGET_TYPE_shared:
+    extension = default_builder->extension.lib_shared;
+    break;
+  case CTARGET_TYPE_executable:
+    extension = default_builder->extension.exe;
+    break;
+  default:
+    break;
+  }
+
+  c_str_error_t str_err
+      = c_str_create_empty(c_fs_path_get_max_len(), out_output);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  // <cbuild base dir>/<install path>/lib<name>.so
+  // <cbuild base dir>/<install path>/<name>
+  char separator = c_fs_path_get_separator();
+  str_err        = c_str_format(
+      out_output, 0, C_STR_INV("%s%c%s%c%s%s%s"), target->cbuild_base_dir.data,
+      separator, target->install_path.data, separator,
+      target->ttype != CTARGET_TYPE_executable ? lib_prefix : "",
+      target->name.data, extension);
+  if (str_err.code != 0) {
+    c_str_destroy(out_output);
+    return CERROR_internal_error(str_err.desc);
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_target_get_meta_path(CTargetImpl* target,
+                                     char const   extension[],
+                                     CStr*        out_path)
+{
+  c_str_error_t str_err
+      = c_str_create_empty(c_fs_path_get_max_len(), out_path);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  // <cbuild base dir>/<build path>/<name><extension>
+  // the dependents of other projects look for them too
+  char separator = c_fs_path_get_separator();
+  str_err        = c_str_format(out_path, 0, C_STR_INV("%s%c%s%c%s%s"),
+                                target->cbuild_base_dir.data, separator,
+                                target->build_path.data, separator,
+                                target->name.data, extension);
+  if (str_err.code != 0) {
+    c_str_destroy(out_path);
+    return CERROR_internal_error(str_err.desc);
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_archive_prepare(CBuildImpl*   cbuild,
+                                CTargetImpl*  target,
+                                CStr const*   output,
+                                CArray const* objects,
+                                CHash128      prefix_hash,
+                                size_t        objects_at,
+                                CArray*       cmd)
+{
+  CError       err            = CERROR_none;
+  CStr         members_path   = {0};
+  CStr         members        = {0};
+  CStr         line           = {0}; // <object hash> <object path>
+  char const** names          = NULL;
+  CArray       kept           = {0}; // CArray< char const* >, manifest lines
+  bool*        is_claimed     = NULL;
+  CArray       changed        = {0}; // CArray< char const* >
+  CArray       delete_cmd     = {0}; // CArray< char const* >
+  bool         is_incremental = false;
+
+  c_defer_init(10);
+
+  // thin archives only reference their members, they are cheap to write
+  // again. so is everything the archiver can't take members out of
+  c_defer_check(!target->is_thin_archive
+                    && default_builder->flags.static_library_delete[0]
+                           != '\0',
+                NULL, NULL, NULL);
+
+  bool exists = false;
+  c_fs_exists(output->data, output->len, &exists);
+  c_defer_check(exists, NULL, NULL, NULL);
+
+  // members are named after the objects without their directories, the
+  // same array keeps what follows the objects inside `cmd` later
+  size_t const tail_len = cmd->len - objects_at - objects->len;
+  names = calloc(objects->len + tail_len + 1, sizeof(char const*));
+  c_defer_err(names, free, names, err = CERROR_memory_allocation);
+  for (size_t iii = 0; iii < objects->len; ++iii) {
+    CStr const* object = &((CStr*)objects->data)[iii];
+    char const* name   = strrchr(object->data, c_fs_path_get_separator());
+    names[iii]         = name ? name + 1 : object->data;
+  }
+  qsort(names, objects->len, sizeof(char const*),
+        internal_cbuild_compare_strings);
+  for (size_t iii = 1; iii < objects->len; ++iii) {
+    c_defer_check(strcmp(names[iii - 1], names[iii]) != 0, NULL, NULL, NULL);
+  }
+
+  // <prefix hash>
+  // <object hash> <object path>
+  // ...
+  err = internal_cbuild_target_get_meta_path(target, archive_members_extension,
+                                             &members_path);
+  c_defer_err(err.code == 0, c_str_destroy, &members_path, NULL);
+
+  CBuildFileState state;
+  cbuild_stat(members_path.data, &state);
+  c_defer_check(state.exists, NULL, NULL, NULL);
+
+  c_str_error_t str_err
+      = c_str_create_empty((size_t)state.size + 2, &members);
+  c_defer_err(str_err.code == 0, c_str_destroy, &members,
+              err = CERROR_internal_error(str_err.desc));
+  CFile        file   = {0};
+  c_fs_error_t fs_err = c_fs_file_open(C_STR2(members_path.data), "r", &file);
+  c_defer_check(fs_err.code == 0, NULL, NULL, NULL);
+  fs_err = c_fs_file_read(&file, members.data, (size_t)state.size + 1,
+                          &members.len);
+  c_fs_file_close(&file);
+  c_defer_check(fs_err.code == 0, NULL, NULL, NULL);
+  members.data[members.len] = '\0';
+
+  unsigned long long high = 0;
+  unsigned long long low  = 0;
+  c_defer_check(sscanf(members.data, "%16llx%16llx", &high, &low) == 2
+                    && high == prefix_hash.high && low == prefix_hash.low,
+                NULL, NULL, NULL);
+
+  c_array_error_t arr_err = c_array_create(sizeof(char const*), &kept);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &kept,
+              err = CERROR_internal_error(arr_err.desc));
+  for (char* line = strchr(members.data, '\n'); line && line[1] != '\0';) {
+    *line++ = '\0';
+    arr_err = c_array_push(&kept, &(char const*){line});
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+    line = strchr(line, '\n');
+  }
+  for (size_t iii = 0; iii < kept.len; ++iii) {
+    char* line = ((char**)kept.data)[iii];
+    line[strcspn(line, "\n")] = '\0';
+  }
+  qsort(kept.data, kept.len, sizeof(char const*),
+        internal_cbuild_compare_strings);
+
+  // the manifest lines of the members that stay as they are get claimed,
+  // what is left over is gone from the target
+  is_claimed = calloc(kept.len + 1, sizeof(bool));
+  c_defer_err(is_claimed, free, is_claimed, err = CERROR_memory_allocation);
+
+  arr_err = c_array_create(sizeof(char const*), &changed);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &changed,
+              err = CERROR_internal_error(arr_err.desc));
+
+  // sized for the longest object, every line fits without growing
+  size_t line_len = 0;
+  for (size_t iii = 0; iii < objects->len; ++iii) {
+    size_t const object_len = ((CStr*)objects->data)[iii].len;
+    line_len                = object_len > line_len ? object_len : line_len;
+  }
+  str_err = c_str_create_empty(2 * 16 + 1 + line_len, &line);
+  c_defer_err(str_err.code == 0, c_str_destroy, &line,
+              err = CERROR_internal_error(str_err.desc));
+
+  cbuild_db_lock(cbuild->db);
+  for (size_t iii = 0; iii < objects->len && err.code == 0; ++iii) {
+    CStr const* object = &((CStr*)objects->data)[iii];
+
+    CHash128 hash;
+    err = cbuild_db_file_hash(cbuild->db, object->data, object->len, &exists,
+                              &hash);
+    if (err.code != 0 || !exists) { break; }
+
+    str_err = c_str_format(&line, 0, C_STR_INV("%016llx%016llx %s"),
+                           (unsigned long long)hash.high,
+                           (unsigned long long)hash.low, object->data);
+    if (str_err.code != 0) {
+      err = CERROR_internal_error(str_err.desc);
+      break;
+    }
+    char const** found
+        = bsearch(&(char const*){line.data}, kept.data, kept.len,
+                  sizeof(char const*), internal_cbuild_compare_strings);
+    if (found) {
+      is_claimed[found - (char const**)kept.data] = true;
+    } else {
+      arr_err = c_array_push(&changed, &object->data);
+      if (arr_err.code != 0) { err = CERROR_internal_error(arr_err.desc); }
+    }
+  }
+  cbuild_db_unlock(cbuild->db);
+  c_defer_check(err.code == 0 && exists, NULL, NULL, NULL);
+
+  // $ <archiver> d <archive> <member>...
+  arr_err = c_array_create(sizeof(char const*), &delete_cmd);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &delete_cmd,
+              err = CERROR_internal_error(arr_err.desc));
+  char const* const delete_prefix[] = {
+      ((char const**)cmd->data)[0],
+      default_builder->flags.static_library_delete, output->data};
+  for (size_t iii = 0; iii < 3 && arr_err.code == 0; ++iii) {
+    arr_err = c_array_push(&delete_cmd, &delete_prefix[iii]);
+  }
+  for (size_t iii = 0; iii < kept.len && arr_err.code == 0; ++iii) {
+    char const* kept_line = ((char const**)kept.data)[iii];
+    if (is_claimed[iii]) { continue; }
+
+    char const* name = strrchr(kept_line, c_fs_path_get_separator());
+    name             = name ? name + 1 : strchr(kept_line, ' ') + 1;
+    if (!bsearch(&name, names, objects->len, sizeof(char const*),
+                 internal_cbuild_compare_strings)) {
+      arr_err = c_array_push(&delete_cmd, &name);
+    }
+  }
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+  if (delete_cmd.len > 3) {
+    arr_err = c_array_push(&delete_cmd, &(void*){NULL});
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+
+    int status = 0;
+    c_defer_check(cprocess_exec((char const* const*)delete_cmd.data,
+                                delete_cmd.len, true, &status, NULL)
+                              .code
+                          == 0
+                      && status == 0,
+                  NULL, NULL, NULL);
+  }
+
+  // $ <archiver> <lflags> <archive> <changed objects> <link with>
+  char const** tail = &((char const**)cmd->data)[objects_at + objects->len];
+  memcpy(names, tail, tail_len * sizeof(char const*));
+  cmd->len = objects_at;
+  for (size_t iii = 0; iii < changed.len && arr_err.code == 0; ++iii) {
+    arr_err = c_array_push(cmd, &((char const**)changed.data)[iii]);
+  }
+  for (size_t iii = 0; iii < tail_len && arr_err.code == 0; ++iii) {
+    arr_err = c_array_push(cmd, &names[iii]);
+  }
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+
+  is_incremental = true;
+
+  c_defer_deinit();
+
+  // written from scratch, `ar r` keeps members that are gone
+  if (err.code == 0 && !is_incremental) { remove(output->data); }
+
+  return err;
+}
+
+CError
+internal_cbuild_archive_write_members(CBuildImpl*   cbuild,
+                                      CTargetImpl*  target,
+                                      CArray const* objects,
+                                      CHash128      prefix_hash)
+{
+  CError err     = CERROR_none;
+  CStr   path    = {0};
+  CStr   members = {0};
+
+  c_defer_init(2);
+
+  err = internal_cbuild_target_get_meta_path(target, archive_members_extension,
+                                             &path);
+  c_defer_err(err.code == 0, c_str_destroy, &path, NULL);
+
+  c_str_error_t str_err = c_str_create_empty(
+      (objects->len + 1) * (c_fs_path_get_max_len() / 8), &members);
+  c_defer_err(str_err.code == 0, c_str_destroy, &members,
+              err = CERROR_internal_error(str_err.desc));
+  str_err = c_str_format(&members, 0, C_STR_INV("%016llx%016llx\n"),
+                         (unsigned long long)prefix_hash.high,
+                         (unsigned long long)prefix_hash.low);
+
+  cbuild_db_lock(cbuild->db);
+  for (size_t iii = 0; iii < objects->len && str_err.code == 0; ++iii) {
+    CStr const* object = &((CStr*)objects->data)[iii];
+
+    bool     exists = false;
+    CHash128 hash   = {0};
+    err = cbuild_db_file_hash(cbuild->db, object->data, object->len, &exists,
+                              &hash);
+    if (err.code != 0) { break; }
+
+    str_err = c_str_format(&members, members.len,
+                           C_STR_INV("%016llx%016llx %s\n"),
+                           (unsigned long long)hash.high,
+                           (unsigned long long)hash.low, object->data);
+  }
+  cbuild_db_unlock(cbuild->db);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+
+  err = internal_cbuild_write_if_changed(cbuild, &path, &members);
+
+  c_defer_deinit();
+
+  return err;
+}
+
+int
+internal_cbuild_compare_strings(void const* lhs, void const* rhs)
+{
+  return strcmp(*(char const* const*)lhs, *(char const* const*)rhs);
+}
+
+CError
+internal_cbuild_write_toc(CBuildImpl*  cbuild,
+                          CTargetImpl* target,
+                          CStr const*  output)
+{
+  CError err = CERROR_none;
+  CStr   toc_path;
+  CStr   toc;
+
+  c_defer_init(2);
+
+  err = internal_cbuild_target_get_meta_path(target, toc_extension, &toc_path);
+  c_defer_err(err.code == 0, c_str_destroy, &toc_path, NULL);
+
+  err = cbuild_toc_read(output->data, output->len, &toc);
+  c_defer_err(err.code == 0, c_str_destroy, &toc, NULL);
+
+  // without a symbol table the dependents track the whole library
+  if (toc.len == 0) {
+    CHash128 hash;
+    err = c_hash128_file(output->data, output->len, &hash);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    c_str_error_t str_err = c_str_format(
+        &toc, 0, C_STR_INV("library %016llx%016llx\n"),
+        (unsigned long long)hash.high, (unsigned long long)hash.low);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+  }
+
+  err = internal_cbuild_write_if_changed(cbuild, &toc_path, &toc);
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+internal_cbuild_target_get_pch_paths(CTargetImpl* target,
+                                     CStr*        out_include,
+                                     CStr*        out_pch)
+{
+  CStr const* header = &target->precompiled_header;
+
+  char const* header_name = header->data;
+  for (size_t iii = 0; iii < header->len; ++iii) {
+    if (header->data[iii] == '/' || header->data[iii] == '\\') {
+      header_name = &header->data[iii + 1];
+    }
+  }
+
+  // <build path>/<header name>
+  // <build path>/<header name>.gch
+  c_str_error_t str_err
+      = c_str_format(out_include, 0, C_STR_INV("%s%c%s"),
+                     target->build_path.data, c_fs_path_get_separator(),
+                     header_name);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+  str_err = c_str_format(out_pch, 0, C_STR_INV("%s%s"), out_include->data,
+                         default_builder->extension.precompiled_header);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_write_if_changed(CBuildImpl* cbuild,
+                                 CStr const* path,
+                                 CStr const* content)
+{
+  // a rewritten file would look changed to everything depending on it
+  CStr          current = {0};
+  c_str_error_t str_err = c_str_create_empty(content->len + 2, &current);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  CFile        file   = {0};
+  c_fs_error_t fs_err = c_fs_file_open(path->data, path->len, "r", &file);
+  if (fs_err.code == 0) {
+    fs_err = c_fs_file_read(&file, current.data, content->len + 1,
+                            &current.len);
+    c_fs_file_close(&file);
+  }
+  bool is_same = fs_err.code == 0 && current.len == content->len
+                 && memcmp(current.data, content->data, content->len) == 0;
+  c_str_destroy(&current);
+  if (is_same) { return CERROR_none; }
+
+  fs_err = c_fs_file_open(path->data, path->len, "w", &file);
+  if (fs_err.code != 0) { return CERROR_internal_error(fs_err.desc); }
+  fs_err = c_fs_file_write(&file, content->data, content->len, NULL);
+  c_fs_file_close(&file);
+
+  // scanned before it was written
+  cbuild_db_lock(cbuild->db);
+  cbuild_db_forget_state(cbuild->db, path->data, path->len);
+  cbuild_db_unlock(cbuild->db);
+
+  if (fs_err.code != 0) { return CERROR_internal_error(fs_err.desc); }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_exec(CArray const* cmd, CBuildArena* scratch)
+{
+  // only shown, a view released with the rest of `scratch`
+  char* out = cbuild_arena_alloc(scratch, CBUILD_COMMAND_OUTPUT_CAPACITY + 1,
+                                 1);
+  if (!out) { return CERROR_memory_allocation; }
+  CStr cmd_out = {.data = out, .capacity = CBUILD_COMMAND_OUTPUT_CAPACITY};
+
+  int    out_status = 0;
+  CError err = cprocess_exec((char const* const*)cmd->data, cmd->len, true,
+                             &out_status, &cmd_out);
+  if (err.code == 0 && out_status != 0) { err = CERROR_failed_command; }
+
+  return err;
+}
+
+CError
+internal_cbuild_exec_compile(CBuild*       self,
+                             CTargetImpl*  target,
+                             CArray const* cmd,
+                             CStr const*   source,
+                             CStr const*   output,
+                             CStr const*   dwo,
+                             CStr const*   pch,
+                             CBuildArena*  scratch)
+{
+  CError err = CERROR_none;
+
+  c_defer_init(2);
+
+  CHash128 fingerprint;
+  cbuild_db_lock(self->impl->db);
+  err = internal_cbuild_compile_fingerprint(self, target, cmd, source, output,
+                                            pch, &fingerprint);
+  // the debug info of a split object is an output of the same action
+  bool is_up_to_date
+      = err.code == 0
+        && internal_cbuild_is_up_to_date(self, output, fingerprint)
+        && (!dwo || internal_cbuild_is_up_to_date(self, dwo, fingerprint));
+  cbuild_db_unlock(self->impl->db);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  c_defer_check(!is_up_to_date, NULL, NULL, NULL);
+
+  err = internal_cbuild_exec(cmd, scratch);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // the depfile is fresh now, it may list new headers
+  cbuild_db_lock(self->impl->db);
+  err = internal_cbuild_compile_fingerprint(self, target, cmd, source, output,
+                                            pch, &fingerprint);
+  if (err.code == 0) {
+    err = cbuild_db_put(self->impl->db, CBUILD_DB_KIND_action, output->data,
+                        output->len, &(CBuildDbRecord){.hash = fingerprint});
+  }
+  if (err.code == 0 && dwo) {
+    err = cbuild_db_put(self->impl->db, CBUILD_DB_KIND_action, dwo->data,
+                        dwo->len, &(CBuildDbRecord){.hash = fingerprint});
+  }
+  cbuild_db_unlock(self->impl->db);
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CHash128
+internal_cbuild_cmd_hash(CArray const* cmd)
+{
+  CHash128 hash = {0};
+
+  for (size_t iii = 0; iii < cmd->len; ++iii) {
+    char const* arg = ((char const**)cmd->data)[iii];
+    if (!arg) { continue; }
+    hash = c_hash128_combine(hash, c_hash128(arg, strlen(arg), iii));
+  }
+
+  return hash;
+}
+
+CError
+internal_cbuild_compile_fingerprint(CBuild*       self,
+                                    CTargetImpl*  target,
+                                    CArray const* cmd,
+                                    CStr const*   source,
+                                    CStr const*   object,
+                                    CStr const*   pch,
+                                    CHash128*     out_hash)
+{
+  CError err = CERROR_none;
+  CStr   depfile;
+
+  c_defer_init(6);
+
+  *out_hash = internal_cbuild_cmd_hash(cmd);
+
+  bool     exists = false;
+  CHash128 source_hash;
+  err = cbuild_db_file_hash(self->impl->db, source->data, source->len, &exists,
+                            &source_hash);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  c_defer_check(exists, NULL, NULL, err = CERROR_no_such_source);
+  *out_hash = c_hash128_combine(*out_hash, source_hash);
+
+  // depfiles don't list a precompiled header that was used, its own
+  // fingerprint covers the header content and the flags
+  if (pch) {
+    CBuildDbRecord* pch_record = cbuild_db_find(
+        self->impl->db, CBUILD_DB_KIND_action, pch->data, pch->len);
+    c_defer_check(pch_record, NULL, NULL, err = CERROR_no_such_source);
+    *out_hash = c_hash128_combine(*out_hash, pch_record->hash);
+  }
+
+  // the profile is named by the flags, its content is what matters
+  if (self->impl->pgo == CBUILD_PGO_use
+      && internal_cbuild_is_pgo_target(self->impl, target)) {
+    *out_hash = c_hash128_combine(
+        *out_hash, c_hash128(&self->impl->pgo_profile,
+                             sizeof(self->impl->pgo_profile), 0));
+  }
+
+  // <build path>/<source name>.<hash>.d
+  // <build path>/<header name>.d
+  // the compiler replaces the last extension of the output
+  bool has_depfile = false;
+  if (default_builder->extension.depfile[0] != '\0') {
+    c_str_error_t str_err = c_str_clone(object, &depfile);
+    c_defer_err(str_err.code == 0, c_str_destroy, &depfile,
+                err = CERROR_internal_error(str_err.desc));
+    size_t ext_len = depfile.len - (size_t)(strrchr(depfile.data, '.')
+                                            - depfile.data);
+    str_err
+        = c_str_replace_at(&depfile, depfile.len - ext_len, ext_len,
+                           C_STR2(default_builder->extension.depfile));
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+
+    err = cbuild_db_depfile_hash(self->impl->db, depfile.data, depfile.len,
+                                 &has_depfile, out_hash);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  // msvc writes none, and a depfile may be gone since
+  if (!has_depfile) {
+    err = internal_cbuild_scanned_headers_hash(self->impl, cmd, source,
+                                               out_hash);
+  }
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+internal_cbuild_scanned_headers_hash(CBuildImpl*   cbuild,
+                                     CArray const* cmd,
+                                     CStr const*   source,
+                                     CHash128*     inout_hash)
+{
+  CError err          = CERROR_none;
+  CArray include_dirs = {0}; // CArray< char const* >
+  CArray headers      = {0}; // CArray< CStr >
+
+  c_defer_init(2);
+
+  c_array_error_t arr_err = c_array_create(sizeof(char const*), &include_dirs);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &include_dirs,
+              err = CERROR_internal_error(arr_err.desc));
+  err = internal_cbuild_push_include_dirs(cmd, &include_dirs);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  err = cbuild_scanner_headers(cbuild->scanner, source->data, source->len,
+                               &include_dirs, &headers, NULL);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // same as the depfile ones, a header that moved or went missing
+  // invalidates the action
+  for (size_t iii = 0; iii < headers.len && err.code == 0; ++iii) {
+    CStr const* header = &((CStr*)headers.data)[iii];
+
+    bool     exists = false;
+    CHash128 hash   = {0};
+    err = cbuild_db_file_hash(cbuild->db, header->data, header->len, &exists,
+                              &hash);
+
+    *inout_hash = c_hash128_combine(
+        *inout_hash, c_hash128(header->data, header->len, exists));
+    if (exists) { *inout_hash = c_hash128_combine(*inout_hash, hash); }
+  }
+  internal_cbuild_objects_destroy(&headers);
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+internal_cbuild_push_include_dirs(CArray const* cmd, CArray* include_dirs)
+{
+  // -I<dir>
+  // -I <dir>
+  size_t const flag_len = strlen(default_builder->cflags.include_path);
+  for (size_t iii = 0; iii < cmd->len; ++iii) {
+    char const* arg = ((char const**)cmd->data)[iii];
+    if (!arg || strncmp(arg, default_builder->cflags.include_path, flag_len)
+                    != 0) {
+      continue;
+    }
+
+    char const* dir = &arg[flag_len];
+    if (*dir == '\0' && iii + 1 < cmd->len) {
+      dir = ((char const**)cmd->data)[++iii];
+    }
+    if (!dir || *dir == '\0') { continue; }
+
+    c_array_error_t arr_err = c_array_push(include_dirs, &dir);
+    if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_command_fingerprint(CBuildImpl*          cbuild,
+                                    CBuildCommand const* command,
+                                    CArray const*        cmd,
+                                    CHash128*            out_hash)
+{
+  *out_hash = internal_cbuild_cmd_hash(cmd);
+
+  // an input written by another command runs after it
+  for (size_t iii = 0; iii < command->inputs.len; ++iii) {
+    CStr const* input = &((CStr*)command->inputs.data)[iii];
+
+    bool     exists = false;
+    CHash128 hash;
+    CError   err = cbuild_db_file_hash(cbuild->db, input->data, input->len,
+                                       &exists, &hash);
+    if (err.code != 0) { return err; }
+    if (!exists) { return CERROR_no_such_source; }
+    *out_hash = c_hash128_combine(*out_hash,
+                                  c_hash128(input->data, input->len, iii));
+    *out_hash = c_hash128_combine(*out_hash, hash);
+  }
+
+  // the outputs are named by `cmd` or not at all
+  for (size_t iii = 0; iii < command->outputs.len; ++iii) {
+    CStr const* output = &((CStr*)command->outputs.data)[iii];
+    *out_hash          = c_hash128_combine(
+        *out_hash, c_hash128(output->data, output->len, iii));
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_command_create_paths(CBuildImpl* cbuild)
+{
+  // done before any action runs, like the build paths of the targets
+  char const separator = c_fs_path_get_separator();
+  for (size_t iii = 0; iii < cbuild->commands.len; ++iii) {
+    CBuildCommand const* command
+        = &((CBuildCommand*)cbuild->commands.data)[iii];
+
+    for (size_t jjj = 0; jjj < command->outputs.len; ++jjj) {
+      CStr const* output = &((CStr*)command->outputs.data)[jjj];
+
+      size_t dir_len = output->len;
+      while (dir_len > 0 && output->data[dir_len - 1] != '/'
+             && output->data[dir_len - 1] != separator) {
+        dir_len--;
+      }
+      if (dir_len <= 1) { continue; }
+
+      CStr          dir     = {0};
+      c_str_error_t str_err = c_str_create(output->data, dir_len - 1, &dir);
+      if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+      bool exists = false;
+      c_fs_dir_exists(dir.data, dir.len, &exists);
+      c_fs_error_t fs_err = C_FS_ERROR_none;
+      if (!exists) { fs_err = c_fs_dir_create(dir.data, dir.len); }
+      c_str_destroy(&dir);
+      if (fs_err.code != 0) { return CERROR_internal_error(fs_err.desc); }
+    }
+  }
+
+  return CERROR_none;
+}
+
+bool
+internal_cbuild_is_generated(CBuildImpl* cbuild, CStr const* path)
+{
+  for (size_t iii = 0; iii < cbuild->commands.len; ++iii) {
+    CBuildCommand const* command
+        = &((CBuildCommand*)cbuild->commands.data)[iii];
+
+    for (size_t jjj = 0; jjj < command->outputs.len; ++jjj) {
+      CStr const* output = &((CStr*)command->outputs.data)[jjj];
+      if (output->len == path->len
+          && memcmp(output->data, path->data, path->len) == 0) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+bool
+internal_cbuild_path_has_name(CStr const* path, CStr const* name)
+{
+  // <path> = [<directory>/]<name>
+  if (name->len == 0 || name->len > path->len
+      || memcmp(&path->data[path->len - name->len], name->data, name->len)
+             != 0) {
+    return false;
+  }
+
+  char const before = path->len == name->len
+                          ? '/'
+                          : path->data[path->len - name->len - 1];
+  return before == '/' || before == c_fs_path_get_separator();
+}
+
+void
+internal_cbuild_command_destroy(CBuildCommand* command)
+{
+  internal_cbuild_objects_destroy(&command->argv);
+  internal_cbuild_objects_destroy(&command->inputs);
+  internal_cbuild_objects_destroy(&command->outputs);
+}
+
+CError
+internal_cbuild_link_fingerprint(CBuild*       self,
+                                 CArray const* cmd,
+                                 CArray const* objects,
+                                 CTargetImpl*  target,
+                                 CHash128*     out_hash)
+{
+  CError err = CERROR_none;
+
+  *out_hash = internal_cbuild_cmd_hash(cmd);
+
+  // the objects names are part of `cmd`, their content is what matters
+  bool     exists = false;
+  CHash128 hash;
+  for (size_t iii = 0; iii < objects->len; ++iii) {
+    CStr const* object = &((CStr*)objects->data)[iii];
+
+    // objects of other projects are known by absolute paths, their project
+    // may have compiled them during this build
+    bool is_absolute = false;
+    c_fs_path_is_absolute(object->data, object->len, &is_absolute);
+    if (is_absolute) {
+      cbuild_db_forget_state(self->impl->db, object->data, object->len);
+    }
+
+    err = cbuild_db_file_hash(self->impl->db, object->data, object->len,
+                              &exists, &hash);
+    if (err.code != 0) { return err; }
+    if (!exists) { return CERROR_no_such_source; }
+    *out_hash = c_hash128_combine(*out_hash, hash);
+  }
+
+  // libraries are linked by name, so track their outputs too. a shared
+  // library counts through its table of contents when it has one, a thin
+  // archive through its members, it doesn't change when they do
+  for (size_t iii = 0; iii < target->dependencies.len; ++iii) {
+    CTargetImpl* dependency = ((CTargetImpl**)target->dependencies.data)[iii];
+    // shared objects are part of `objects`
+    if (dependency->ttype == CTARGET_TYPE_object
+        || dependency == target->objects_of) {
+      continue;
+    }
+
+    CStr dependency_output;
+    exists = false;
+    if (dependency->ttype == CTARGET_TYPE_shared
+        || (dependency->ttype == CTARGET_TYPE_static
+            && dependency->is_thin_archive)) {
+      err = internal_cbuild_target_get_meta_path(
+          dependency,
+          dependency->ttype == CTARGET_TYPE_shared ? toc_extension
+                                                   : archive_members_extension,
+          &dependency_output);
+      if (err.code != 0) { return err; }
+      c_fs_exists(dependency_output.data, dependency_output.len, &exists);
+      if (!exists) { c_str_destroy(&dependency_output); }
+    }
+    if (!exists) {
+      err = internal_cbuild_target_get_output_path(dependency,
+                                                   &dependency_output);
+      if (err.code != 0) { return err; }
+    }
+
+    // the project of the dependency wrote it during this build
+    cbuild_db_forget_state(self->impl->db, dependency_output.data,
+                           dependency_output.len);
+    err = cbuild_db_file_hash(self->impl->db, dependency_output.data,
+                              dependency_output.len, &exists, &hash);
+    c_str_destroy(&dependency_output);
+    if (err.code != 0) { return err; }
+    if (exists) { *out_hash = c_hash128_combine(*out_hash, hash); }
+  }
+
+  return err;
+}
+
+bool
+internal_cbuild_is_up_to_date(CBuild*     self,
+                              CStr const* output,
+                              CHash128    fingerprint)
+{
+  bool exists = false;
+  c_fs_exists(output->data, output->len, &exists);
+  if (!exists) { return false; }
+
+  CBuildDbRecord* record = cbuild_db_find(
+      self->impl->db, CBUILD_DB_KIND_action, output->data, output->len);
+
+  return record && c_hash128_equal(record->hash, fingerprint);
+}
+
+CError
+internal_cbuild_push_flags(CStr* flags, CArray* cmd)
+{
+  // same as strtok, but reentrant, actions are running concurrently
+  char* cursor = flags->data;
+  while (*(cursor = c_skip_whitespaces(cursor)) != '\0') {
+    c_array_error_t arr_err = c_array_push(cmd, &cursor);
+    if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+
+    while (*cursor != '\0' && !isspace((unsigned char)*cursor)) {
+      cursor++;
+    }
+    if (*cursor != '\0') { *cursor++ = '\0'; }
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_push_arg(CBuildImpl* cbuild,
+                         CArray*     args,
+                         char const  arg[],
+                         size_t      arg_len)
+{
+  // interned, it outlives whatever `arg` was built in
+  CStr   interned = {0};
+  CError err = cbuild_paths_intern(cbuild->paths, arg, arg_len, &interned);
+  if (err.code != 0) { return err; }
+
+  c_array_error_t arr_err = c_array_push(args, &interned.data);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_push_args(CBuildImpl* cbuild,
+                          CArray*     args,
+                          char const  flags[],
+                          size_t      flags_len)
+{
+  // whitespace separated, there is no quoting
+  size_t cursor = 0;
+  while (cursor < flags_len) {
+    while (cursor < flags_len && isspace((unsigned char)flags[cursor])) {
+      cursor++;
+    }
+    size_t const begin = cursor;
+    while (cursor < flags_len && !isspace((unsigned char)flags[cursor])) {
+      cursor++;
+    }
+    if (cursor == begin) { continue; }
+
+    CError err = internal_cbuild_push_arg(cbuild, args, &flags[begin],
+                                          cursor - begin);
+    if (err.code != 0) { return err; }
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_push_joined_arg(CBuildImpl*       cbuild,
+                                CArray*           args,
+                                char const* const parts[],
+                                size_t            parts_len)
+{
+  // a single argument whatever the parts hold, spaces of paths included
+  CStr   arg = {0};
+  CError err = internal_cbuild_intern_joined(cbuild, parts, parts_len, &arg);
+  if (err.code != 0 || arg.len == 0) { return err; }
+
+  c_array_error_t arr_err = c_array_push(args, &arg.data);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_scratch_join(CBuildArena*      scratch,
+                             char const* const parts[],
+                             size_t            parts_len,
+                             CStr*             out_joined)
+{
+  size_t joined_len = 0;
+  for (size_t iii = 0; iii < parts_len; ++iii) {
+    joined_len += strlen(parts[iii]);
+  }
+
+  // a view, released with the rest of `scratch`
+  char* joined = cbuild_arena_alloc(scratch, joined_len + 1, 1);
+  if (!joined) { return CERROR_memory_allocation; }
+  size_t cursor = 0;
+  for (size_t iii = 0; iii < parts_len; ++iii) {
+    size_t const part_len = strlen(parts[iii]);
+    memcpy(&joined[cursor], parts[iii], part_len);
+    cursor += part_len;
+  }
+  joined[cursor] = '\0';
+
+  *out_joined
+      = (CStr){.data = joined, .len = joined_len, .capacity = joined_len};
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_intern_joined(CBuildImpl*       cbuild,
+                              char const* const parts[],
+                              size_t            parts_len,
+                              CStr*             out_joined)
+{
+  size_t joined_len = 0;
+  for (size_t iii = 0; iii < parts_len; ++iii) {
+    joined_len += strlen(parts[iii]);
+  }
+  *out_joined = (CStr){0};
+  if (joined_len == 0) { return CERROR_none; }
+
+  // only the interned copy is kept, most flags and paths fit on the stack
+  char  buffer[512];
+  char* joined = joined_len < sizeof(buffer) ? buffer : malloc(joined_len + 1);
+  if (!joined) { return CERROR_memory_allocation; }
+  size_t cursor = 0;
+  for (size_t iii = 0; iii < parts_len; ++iii) {
+    size_t const part_len = strlen(parts[iii]);
+    memcpy(&joined[cursor], parts[iii], part_len);
+    cursor += part_len;
+  }
+  joined[cursor] = '\0';
+
+  CError err
+      = cbuild_paths_intern(cbuild->paths, joined, joined_len, out_joined);
+  if (joined != buffer) { free(joined); }
+
+  return err;
+}
+
+CError
+internal_cbuild_push_all(CArray const* args, CArray* cmd)
+{
+  // the pointers only, the arguments are interned
+  for (size_t iii = 0; iii < args->len; ++iii) {
+    c_array_error_t arr_err
+        = c_array_push(cmd, &((char const**)args->data)[iii]);
+    if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+  }
+
+  return CERROR_none;
+}
+
+uint64_t
+internal_cbuild_target_hash(char const name[], size_t name_len)
+{
+  return c_hash128(name, name_len, 0).low;
+}
+
+size_t
+internal_cbuild_target_find(CBuildImpl* cbuild,
+                            char const  name[],
+                            size_t      name_len)
+{
+  // names are not unique, the first target created wins
+  uint64_t const hash   = internal_cbuild_target_hash(name, name_len);
+  size_t         found  = cbuild->targets.len;
+  size_t         cursor = 0;
+  size_t         index  = 0;
+  while (c_hash_index_next(&cbuild->target_index, hash, &cursor, &index)) {
+    CTargetImpl const* target = ((CTargetImpl**)cbuild->targets.data)[index];
+    if (index < found && target->name.len == name_len
+        && memcmp(target->name.data, name, name_len) == 0) {
+      found = index;
+    }
+  }
+
+  return found;
+}
+
+CError
+internal_cbuild_target_create_paths(CTargetImpl* target)
+{
+  // done before any action runs, concurrent actions of the same target
+  // would race on it
+  bool exists = false;
+  c_fs_dir_exists(target->build_path.data, target->build_path.len, &exists);
+  if (!exists) {
+    c_fs_error_t fs_err
+        = c_fs_dir_create(target->build_path.data, target->build_path.len);
+    if (fs_err.code != 0) { return CERROR_internal_error(fs_err.desc); }
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_get_project_path(CBuildImpl* self,
+                                 char const  path[],
+                                 size_t      path_len,
+                                 CStr*       out_path)
+{
+  CError err = internal_cbuild_to_project_path(self, path, path_len, out_path);
+  if (err.code != 0) { return err; }
+
+  bool exists = false;
+  c_fs_exists(out_path->data, out_path->len, &exists);
+  if (!exists && !internal_cbuild_is_generated(self, out_path)) {
+    c_str_destroy(out_path);
+    return CERROR_no_such_source;
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_to_project_path(CBuildImpl* self,
+                                char const  path[],
+                                size_t      path_len,
+                                CStr*       out_path)
+{
+  CError err = CERROR_none;
+  *out_path  = (CStr){0};
+
+  c_defer_init(4);
+
+  c_str_error_t str_err = c_str_create_empty(c_fs_path_get_max_len(), out_path);
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+
+  // relative to the project, like the sources
+  bool is_absolute = false;
+  c_fs_path_is_absolute(path, path_len, &is_absolute);
+  if (!is_absolute) {
+    str_err = c_str_append(out_path, &self->base_path);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+
+    c_fs_error_t fs_err
+        = c_fs_path_append(out_path->data, out_path->len, out_path->capacity,
+                           path, path_len, &out_path->len);
+    c_defer_check(fs_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(fs_err.desc));
+  } else {
+    str_err = c_str_append_with_cstr(out_path, path, path_len);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+  }
+
+  c_defer_deinit();
+
+  if (err.code != 0) { c_str_destroy(out_path); }
+
+  return err;
+}
+
+CError
+internal_cbuild_target_set_units(CBuildImpl* cbuild, CTargetImpl* target)
+{
+  CError             err         = CERROR_none;
+  c_str_error_t      str_err     = C_STR_ERROR_none;
+  c_array_error_t    arr_err     = C_ARRAY_ERROR_none;
+  CBuildUnitySource* batched     = NULL; // what goes into a unity file
+  size_t             batched_len = 0;
+  CStr               content     = {0}; // of one unity file at a time
+  CStr               path        = {0};
+  size_t             batches_len = target->is_unity_set
+                                       ? target->unity_batches
+                                       : cbuild->unity_batches;
+  if (batches_len == CBUILD_UNITY_BATCHES_auto) {
+    batches_len = cbuild_thread_get_cpu_count();
+  }
+
+  // interned, nothing to destroy
+  target->units.len = 0;
+
+  size_t candidates_len = 0;
+  for (size_t iii = 0; iii < target->sources.len; ++iii) {
+    CStr const* source = &((CStr*)target->sources.data)[iii];
+    candidates_len += !internal_cbuild_is_object(source)
+                      && !internal_cbuild_is_unity_excluded(target, source)
+                      && !internal_cbuild_is_shared_source(target, source);
+  }
+  // a batch of one source only adds an include
+  if (candidates_len < 2) { batches_len = 0; }
+
+  c_defer_init(4);
+
+  if (batches_len > 0) {
+    batched = malloc(candidates_len * sizeof(CBuildUnitySource));
+    c_defer_check(batched, NULL, NULL, err = CERROR_memory_allocation);
+  }
+
+  for (size_t iii = 0; iii < target->sources.len; ++iii) {
+    CStr const* source = &((CStr*)target->sources.data)[iii];
+
+    // linked from the library sharing its objects, or compiled below when
+    // that library leaves it out
+    if (internal_cbuild_is_shared_source(target, source)) { continue; }
+
+    if (batches_len == 0 || internal_cbuild_is_object(source)
+        || internal_cbuild_is_unity_excluded(target, source)) {
+      arr_err = c_array_push(&target->units, source);
+      c_defer_check(arr_err.code == 0, NULL, NULL,
+                    err = CERROR_internal_error(arr_err.desc));
+      continue;
+    }
+
+    // picked by path over the configured count, never over the number of
+    // sources, so adding or removing a source only changes its own batch.
+    // batches nothing falls into are not written
+    batched[batched_len++] = (CBuildUnitySource){
+        .batch    = c_hash128(source->data, source->len, 0).low % batches_len,
+        .position = iii,
+    };
+  }
+
+  // what the shared objects leave out is compiled for `target` itself
+  for (size_t iii = 0; target->objects_of
+                       && iii < target->objects_of->share_excluded.len;
+       ++iii) {
+    CStr const* excluded
+        = &((CStr*)target->objects_of->share_excluded.data)[iii];
+    CStr        unit = {0};
+    err = cbuild_paths_intern(cbuild->paths, excluded->data, excluded->len,
+                              &unit);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+    arr_err = c_array_push(&target->units, &unit);
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+
+  c_defer_check(batched_len > 0, NULL, NULL, NULL);
+
+  // the same two buffers for every unity file
+  str_err = c_str_create_empty(c_fs_path_get_max_len(), &content);
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+  str_err = c_str_create_empty(c_fs_path_get_max_len(), &path);
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+
+  qsort(batched, batched_len, sizeof(CBuildUnitySource),
+        internal_cbuild_compare_unity_sources);
+  for (size_t iii = 0; iii < batched_len; ++iii) {
+    CStr const* source
+        = &((CStr*)target->sources.data)[batched[iii].position];
+    str_err = c_str_format(&content, content.len,
+                           C_STR_INV("#include \"%s\"\n"), source->data);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+
+    // written after the last source of its batch
+    if (iii + 1 < batched_len && batched[iii + 1].batch == batched[iii].batch) {
+      continue;
+    }
+
+    // <build path>/unity_<batch>.c
+    str_err = c_str_format(&path, 0, C_STR_INV("%s%cunity_%zu.c"),
+                           target->build_path.data, c_fs_path_get_separator(),
+                           batched[iii].batch);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+    err = internal_cbuild_write_if_changed(cbuild, &path, &content);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    CStr unit = {0};
+    err = cbuild_paths_intern(cbuild->paths, path.data, path.len, &unit);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+    arr_err = c_array_push(&target->units, &unit);
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+
+    content.len = 0;
+  }
+
+  c_defer_deinit();
+
+  if (path.data) { c_str_destroy(&path); }
+  if (content.data) { c_str_destroy(&content); }
+  free(batched);
+
+  return err;
+}
+
+CError
+internal_cbuild_target_set_objects(CBuildImpl* cbuild, CTargetImpl* target)
+{
+  CError          err     = CERROR_none;
+  c_array_error_t arr_err = C_ARRAY_ERROR_none;
+  CStr            path    = {0}; // only the interned copies are kept
+  CStr            pch     = {0};
+
+  // interned, nothing to destroy
+  target->objects.len = 0;
+  target->pch_include = (CStr){0};
+  target->pch         = (CStr){0};
+
+  c_defer_init(4);
+
+  for (size_t iii = 0; iii < target->units.len; ++iii) {
+    CStr const* unit   = &((CStr*)target->units.data)[iii];
+    CStr        object = *unit; // objects are handed to the linker as they are
+
+    if (!internal_cbuild_is_object(unit)) {
+      err = internal_cbuild_target_get_object_path(target, unit, &path);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+      err = cbuild_paths_intern(cbuild->paths, path.data, path.len, &object);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+
+    arr_err = c_array_push(&target->objects, &object);
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+
+  // without builder support the header is included as it is
+  c_defer_check(target->precompiled_header.len > 0
+                    && default_builder->extension.precompiled_header[0]
+                           != '\0',
+                NULL, NULL, NULL);
+
+  err = internal_cbuild_target_get_pch_paths(target, &path, &pch);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  err = cbuild_paths_intern(cbuild->paths, path.data, path.len,
+                            &target->pch_include);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  err = cbuild_paths_intern(cbuild->paths, pch.data, pch.len, &target->pch);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  c_defer_deinit();
+
+  if (path.data) { c_str_destroy(&path); }
+  if (pch.data) { c_str_destroy(&pch); }
+
+  return err;
+}
+
+CError
+internal_cbuild_target_set_args(CBuildImpl* cbuild, CTargetImpl* target)
+{
+  CError          err     = CERROR_none;
+  c_array_error_t arr_err = C_ARRAY_ERROR_none;
+
+  // rebuilt every build, the settings of the build may have changed since
+  target->compile_args.len = 0;
+  target->link_args.len    = 0;
+
+  c_defer_init(4);
+
+  // $ <compiler> <cflags> <build flags>
+  arr_err = c_array_push(&target->compile_args, &cbuild->cmds.compiler.data);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+  for (size_t iii = 0; iii < target->cflags.len; ++iii) {
+    arr_err = c_array_push(&target->compile_args,
+                           &((char const**)target->cflags.data)[iii]);
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+  err = internal_cbuild_push_lto_flags(cbuild, target, false,
+                                       &target->compile_args);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  err = internal_cbuild_push_pgo_flags(cbuild, target, false,
+                                       &target->compile_args);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  err = internal_cbuild_push_debug_info_flags(cbuild, false,
+                                              &target->compile_args);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  err = internal_cbuild_push_pic_flag(cbuild, target, &target->compile_args);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // $ <link creator> <lflags> <build flags>
+  CStr const* creator = NULL;
+  if (target->ttype == CTARGET_TYPE_static) {
+    // plain `ar` drops the symbol index of lto objects
+    creator = target->lto != CTARGET_LTO_none
+                  ? &cbuild->cmds.static_lib_creator_lto
+                  : &cbuild->cmds.static_lib_creator;
+  } else if (target->ttype == CTARGET_TYPE_shared) {
+    creator = &cbuild->cmds.shared_lib_creator;
+  } else if (target->ttype == CTARGET_TYPE_executable) {
+    creator = &cbuild->cmds.linker;
+  }
+  // object targets are never linked
+  c_defer_check(creator, NULL, NULL, NULL);
+
+  arr_err = c_array_push(&target->link_args, &creator->data);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+  for (size_t iii = 0; iii < target->lflags.len; ++iii) {
+    arr_err = c_array_push(&target->link_args,
+                           &((char const**)target->lflags.data)[iii]);
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+  if (target->ttype != CTARGET_TYPE_static) {
+    err = internal_cbuild_push_lto_flags(cbuild, target, true,
+                                         &target->link_args);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+    err = internal_cbuild_push_pgo_flags(cbuild, target, true,
+                                         &target->link_args);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    // -fuse-ld=<linker>
+    if (cbuild->linker != CBUILD_LINKER_default) {
+      char const* const parts[] = {default_builder->lflags.use_linker,
+                                   linker_names[cbuild->linker]};
+      err = internal_cbuild_push_joined_arg(cbuild, &target->link_args, parts,
+                                            sizeof(parts) / sizeof(*parts));
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+
+    err = internal_cbuild_push_debug_info_flags(cbuild, true,
+                                                &target->link_args);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  } else if (target->is_thin_archive
+             && default_builder->flags.static_library_thin[0] != '\0') {
+    // rcs --thin
+    err = internal_cbuild_push_args(
+        cbuild, &target->link_args,
+        C_STR2(default_builder->flags.static_library_thin));
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+internal_cbuild_index_paths(CArray const* paths, CHashIndex* out_index)
+{
+  c_hash_index_destroy(out_index);
+
+  CError err = c_hash_index_create(paths->len, out_index);
+  for (size_t iii = 0; err.code == 0 && iii < paths->len; ++iii) {
+    CStr const* path = &((CStr*)paths->data)[iii];
+    err = c_hash_index_insert(
+        out_index, c_hash128(path->data, path->len, 0).low, iii);
+  }
+
+  return err;
+}
+
+CError
+internal_cbuild_target_index(CTargetImpl* target)
+{
+  CError err = internal_cbuild_index_paths(&target->sources,
+                                           &target->source_index);
+  if (err.code != 0) { return err; }
+
+  err = internal_cbuild_index_paths(&target->unity_excluded,
+                                    &target->unity_index);
+  if (err.code != 0) { return err; }
+
+  return internal_cbuild_index_paths(&target->share_excluded,
+                                     &target->share_index);
+}
+
+bool
+internal_cbuild_is_indexed(CArray const*     paths,
+                           CHashIndex const* index,
+                           CStr const*       path)
+{
+  uint64_t const hash   = c_hash128(path->data, path->len, 0).low;
+  size_t         cursor = 0;
+  size_t         found  = 0;
+  while (c_hash_index_next(index, hash, &cursor, &found)) {
+    CStr const* indexed = &((CStr*)paths->data)[found];
+    if (indexed->len == path->len
+        && memcmp(indexed->data, path->data, path->len) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+int
+internal_cbuild_compare_unity_sources(void const* lhs, void const* rhs)
+{
+  CBuildUnitySource const* left  = lhs;
+  CBuildUnitySource const* right = rhs;
+  if (left->batch != right->batch) {
+    return left->batch < right->batch ? -1 : 1;
+  }
+
+  return left->position < right->position ? -1
+                                          : left->position > right->position;
+}
+
+bool
+internal_cbuild_is_unity_excluded(CTargetImpl* target, CStr const* source)
+{
+  if (internal_cbuild_is_indexed(&target->unity_excluded,
+                                 &target->unity_index, source)) {
+    return true;
+  }
+
+  // the libraries sharing the objects leave those out
+  return internal_cbuild_is_share_excluded(target, source);
+}
+
+bool
+internal_cbuild_is_shared_source(CTargetImpl* target, CStr const* source)
+{
+  CTargetImpl const* of = target->objects_of;
+
+  return of && internal_cbuild_is_indexed(&of->sources, &of->source_index,
+                                          source);
+}
+
+bool
+internal_cbuild_is_share_excluded(CTargetImpl* target, CStr const* source)
+{
+  return internal_cbuild_is_indexed(&target->share_excluded,
+                                    &target->share_index, source);
+}
+
+CError
+internal_cbuild_push_lto_flags(CBuildImpl*  cbuild,
+                               CTargetImpl* target,
+                               bool         is_link,
+                               CArray*      args)
+{
+  if (target->lto == CTARGET_LTO_none) { return CERROR_none; }
+
+  bool const  is_parallel = target->lto == CTARGET_LTO_parallel;
+  char const* lto_flags
+      = is_link ? (is_parallel ? default_builder->lflags.lto_parallel
+                               : default_builder->lflags.lto_full)
+                : (is_parallel ? default_builder->cflags.lto_parallel
+                               : default_builder->cflags.lto_full);
+
+  CError err = internal_cbuild_push_args(cbuild, args, C_STR2(lto_flags));
+  if (err.code != 0) { return err; }
+
+  // -Wl,--thinlto-cache-dir=<build path>/lto_cache
+  // incremental thin links only redo the modules that changed
+  if (is_link && is_parallel
+      && default_builder->lflags.lto_cache_dir[0] != '\0') {
+    char const        separator[] = {c_fs_path_get_separator(), '\0'};
+    char const* const parts[]     = {default_builder->lflags.lto_cache_dir,
+                                     target->build_path.data, separator,
+                                     "lto_cache"};
+    err = internal_cbuild_push_joined_arg(cbuild, args, parts,
+                                          sizeof(parts) / sizeof(*parts));
+  }
+
+  return err;
+}
+
+uint64_t
+internal_cbuild_stamp_seed(CBuildImpl* cbuild)
+{
+  // settings that change the actions without changing any file
+  uint64_t const settings[] = {(uint64_t)cbuild->btype,
+                               (uint64_t)cbuild->unity_batches,
+                               (uint64_t)cbuild->linker,
+                               (uint64_t)cbuild->debug_info,
+                               cbuild->pgo_profile};
+
+  return c_hash128(settings, sizeof(settings), 0).low;
+}
+
+unsigned
+internal_cbuild_get_debug_info(CBuildImpl* cbuild)
+{
+  // the other types have no debug info to split or compress
+  bool const has_debug_info
+      = cbuild->btype == CBUILD_TYPE_debug
+        || cbuild->btype == CBUILD_TYPE_release_with_debug_info;
+
+  return has_debug_info ? cbuild->debug_info : 0;
+}
+
+CError
+internal_cbuild_push_debug_info_flags(CBuildImpl* cbuild,
+                                      bool        is_link,
+                                      CArray*     args)
+{
+  unsigned const debug_info = internal_cbuild_get_debug_info(cbuild);
+  bool const     is_split   = debug_info & CBUILD_DEBUG_INFO_split;
+
+  CError err = CERROR_none;
+
+  // -gsplit-dwarf
+  // -Wl,--gdb-index, ld.bfd doesn't have it
+  if (is_split && !is_link) {
+    err = internal_cbuild_push_args(
+        cbuild, args, C_STR2(default_builder->cflags.split_dwarf));
+  } else if (is_split && cbuild->linker != CBUILD_LINKER_default
+             && default_builder->lflags.gdb_index[0] != '\0') {
+    err = internal_cbuild_push_args(cbuild, args,
+                                    C_STR2(default_builder->lflags.gdb_index));
+  }
+  if (err.code != 0) { return err; }
+
+  // -gz
+  if (debug_info & CBUILD_DEBUG_INFO_compressed) {
+    err = internal_cbuild_push_args(
+        cbuild, args,
+        C_STR2(is_link ? default_builder->lflags.compress_debug
+                       : default_builder->cflags.compress_debug));
+  }
+
+  return err;
+}
+
+CError
+internal_cbuild_push_pic_flag(CBuildImpl*  cbuild,
+                              CTargetImpl* target,
+                              CArray*      args)
+{
+  // -fPIC, the objects end up inside a shared library too. shared
+  // libraries usually ask for it already
+  if (!target->is_pic || default_pic_flag[0] == '\0') { return CERROR_none; }
+  for (size_t iii = 0; iii < args->len; ++iii) {
+    if (strcmp(((char const**)args->data)[iii], default_pic_flag) == 0) {
+      return CERROR_none;
+    }
+  }
+
+  return internal_cbuild_push_args(cbuild, args, C_STR(default_pic_flag));
+}
+
+CError
+internal_cbuild_push_pgo_flags(CBuildImpl*  cbuild,
+                               CTargetImpl* target,
+                               bool         is_link,
+                               CArray*      args)
+{
+  if (!internal_cbuild_is_pgo_target(cbuild, target)) { return CERROR_none; }
+
+  // nothing was trained, the use stage builds without a profile
+  if (cbuild->pgo == CBUILD_PGO_use && cbuild->pgo_profile == 0) {
+    return CERROR_none;
+  }
+
+  if (is_link) {
+    // the instrumented objects need the profiling runtime
+    if (cbuild->pgo != CBUILD_PGO_generate) { return CERROR_none; }
+    return internal_cbuild_push_args(
+        cbuild, args, C_STR2(default_builder->lflags.pgo_generate));
+  }
+
+  CStr          profile;
+  c_str_error_t str_err
+      = c_str_create_empty(c_fs_path_get_max_len(), &profile);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  bool const is_use = cbuild->pgo == CBUILD_PGO_use;
+  CError     err
+      = internal_cbuild_get_pgo_profile_path(cbuild, is_use, &profile);
+
+  // -fprofile-generate=<profile path>
+  // -fprofile-instr-generate=<profile path>/%m.profraw
+  // -fprofile-use=<profile path>
+  // -fprofile-instr-use=<profile path>/merged.profdata
+  // %m: one raw profile per binary, the runs of a binary merge into it
+  char const separator[] = {c_fs_path_get_separator(), '\0'};
+  bool const has_raw
+      = !is_use && default_builder->profile_merger[0] != '\0';
+  if (err.code == 0) {
+    char const* const parts[] = {
+        is_use ? default_builder->cflags.pgo_use
+               : default_builder->cflags.pgo_generate,
+        profile.data,
+        has_raw ? separator : "",
+        has_raw ? "%m" : "",
+        has_raw ? default_builder->extension.profile_raw : "",
+    };
+    err = internal_cbuild_push_joined_arg(cbuild, args, parts,
+                                          sizeof(parts) / sizeof(*parts));
+  }
+  // -fprofile-prefix-path=<base path>/.c_build/<config>
+  // gcc names the profile of an object after its path, inside different
+  // trees for both stages
+  if (err.code == 0 && default_builder->cflags.pgo_prefix_path[0] != '\0') {
+    char const* const parts[] = {
+        default_builder->cflags.pgo_prefix_path,
+        cbuild->base_path.data,
+        separator,
+        default_builder_path,
+        separator,
+        cbuild->config.data,
+    };
+    err = internal_cbuild_push_joined_arg(cbuild, args, parts,
+                                          sizeof(parts) / sizeof(*parts));
+  }
+  // instrumented code takes the address of every function, a shared
+  // library can't go without pic then. both stages have to agree on it
+  if (err.code == 0 && target->ttype == CTARGET_TYPE_shared
+      && default_pic_flag[0] != '\0') {
+    err = internal_cbuild_push_args(cbuild, args, C_STR(default_pic_flag));
+  }
+  c_str_destroy(&profile);
+
+  return err;
+}
+
+bool
+internal_cbuild_is_pgo_target(CBuildImpl* cbuild, CTargetImpl* target)
+{
+  // build.c is built in every stage, it is never profiled
+  return cbuild->pgo != CBUILD_PGO_none
+         && strcmp(target->name.data, default_build_c_target_name) != 0;
+}
+
+CError
+internal_cbuild_get_pgo_profile_path(CBuildImpl* cbuild,
+                                     bool        is_merged,
+                                     CStr*       out_path)
+{
+  // <base path>/.c_build/<type>_pgo_profile
+  c_str_error_t str_err = c_str_format(
+      out_path, 0, C_STR_INV("%s%c%s%c%s%s"), cbuild->base_path.data,
+      c_fs_path_get_separator(), default_builder_path,
+      c_fs_path_get_separator(), cbuild_type_get_name(cbuild->btype),
+      pgo_profile_suffix);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  // <base path>/.c_build/<type>_pgo_profile/merged.profdata
+  // builders without a merger read the raw profiles
+  if (is_merged && default_builder->profile_merger[0] != '\0') {
+    str_err = c_str_format(out_path, out_path->len, C_STR_INV("%c%s%s"),
+                           c_fs_path_get_separator(), pgo_profile_name,
+                           default_builder->extension.profile);
+    if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_get_raw_profiles(CBuildImpl* cbuild, CArray* out_paths)
+{
+  CStr          dir;
+  c_str_error_t str_err = c_str_create_empty(c_fs_path_get_max_len(), &dir);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  CError err = internal_cbuild_get_pgo_profile_path(cbuild, false, &dir);
+
+  bool exists = false;
+  if (err.code == 0) { c_fs_dir_exists(dir.data, dir.len, &exists); }
+  if (exists) {
+    c_fs_error_t fs_err
+        = c_fs_foreach(dir.data, dir.len, dir.capacity,
+                       internal_cbuild_push_raw_profiles_handler, out_paths);
+    if (fs_err.code != 0) { err = CERROR_internal_error(fs_err.desc); }
+  }
+  c_str_destroy(&dir);
+
+  return err;
+}
+
+c_fs_error_t
+internal_cbuild_push_raw_profiles_handler(char*  path,
+                                          size_t path_len,
+                                          void*  extra_data)
+{
+  CArray*      paths   = extra_data;
+  char const*  raw     = default_builder->extension.profile_raw;
+  size_t const raw_len = strlen(raw);
 
-  if (!out_target) { return CERROR_none; }
+  if (path_len < raw_len || strcmp(&path[path_len - raw_len], raw) != 0) {
+    return (c_fs_error_t){0};
+  }
 
-  CError err = CERROR_none;
+  CStr          profile;
+  c_str_error_t str_err = c_str_create(path, path_len, &profile);
+  if (str_err.code != 0) { return (c_fs_error_t){-1, ""}; }
+  c_array_error_t arr_err = c_array_push(paths, &profile);
+  if (arr_err.code != 0) {
+    c_str_destroy(&profile);
+    return (c_fs_error_t){-1, ""};
+  }
 
-  c_defer_init(6);
+  return (c_fs_error_t){0};
+}
 
-  *out_target      = (CTarget){0};
-  out_target->impl = calloc(1, sizeof(CTargetImpl));
-  if (!out_target->impl) { return CERROR_memory_allocation; }
+CError
+internal_cbuild_pgo_profile_hash(CBuildImpl* cbuild, uint64_t* out_hash)
+{
+  CError err      = CERROR_none;
+  CArray profiles = {0}; // CArray< CStr >
 
-  // ttype
-  out_target->impl->ttype = ttype;
+  *out_hash = 0;
 
-  // target name
-  c_str_error_t str_err = c_str_create(name, name_len, &out_target->impl->name);
-  c_defer_check(str_err.code == 0, c_str_destroy, &out_target->impl->name,
-                err = CERROR_internal_error(str_err.desc));
+  c_defer_init(4);
 
-  // cbuild base dir
-  str_err
-      = c_str_clone(&self->impl->base_path, &out_target->impl->cbuild_base_dir);
-  c_defer_check(str_err.code == 0, c_str_destroy,
-                &out_target->impl->cbuild_base_dir,
-                err = CERROR_internal_error(str_err.desc));
+  c_array_error_t arr_err = c_array_create(sizeof(CStr), &profiles);
+  c_defer_err(arr_err.code == 0, internal_cbuild_objects_destroy, &profiles,
+              err = CERROR_internal_error(arr_err.desc));
 
-  // base dir
-  str_err = c_str_set_capacity(&out_target->impl->base_dir,
-                               c_fs_path_get_max_len());
-  c_defer_check(str_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(str_err.desc));
-  bool         is_absolute = false;
-  c_fs_error_t fs_err
-      = c_fs_path_is_absolute(base_path, base_path_len, &is_absolute);
-  if (!is_absolute) {
-    fs_err = c_fs_path_to_absolute(
-        base_path, base_path_len, out_target->impl->base_dir.data,
-        out_target->impl->base_dir.capacity, &out_target->impl->base_dir.len);
-    c_defer_check(fs_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(fs_err.desc));
+  // gcc reads the raw profiles, clang what they were merged into
+  if (default_builder->profile_merger[0] == '\0') {
+    err = internal_cbuild_get_raw_profiles(cbuild, &profiles);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
   } else {
-    str_err = c_str_replace_at(&out_target->impl->base_dir, 0,
-                               out_target->impl->base_dir.len, base_path,
-                               base_path_len);
+    CStr          merged;
+    c_str_error_t str_err
+        = c_str_create_empty(c_fs_path_get_max_len(), &merged);
     c_defer_check(str_err.code == 0, NULL, NULL,
                   err = CERROR_internal_error(str_err.desc));
+    arr_err = c_array_push(&profiles, &merged);
+    c_defer_check(arr_err.code == 0, c_str_destroy, &merged,
+                  err = CERROR_internal_error(arr_err.desc));
+    err = internal_cbuild_get_pgo_profile_path(cbuild, true, &merged);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
   }
 
-  // build path
-  err = internal_cbuild_get_path(out_target->impl, default_builder_path,
-                                 &out_target->impl->build_path);
-  c_defer_check(str_err.code == 0, NULL, NULL, NULL);
-
-  // install path
-  err = internal_cbuild_get_path(out_target->impl, default_install_path,
-                                 &out_target->impl->install_path);
-  c_defer_check(str_err.code == 0, c_str_destroy,
-                &out_target->impl->install_path,
-                err = CERROR_internal_error(str_err.desc));
-
-  // cflags
-  str_err = c_str_clone(&self->impl->cflags, &out_target->impl->cflags);
-  c_defer_check(str_err.code == 0, c_str_destroy, &out_target->impl->cflags,
-                err = CERROR_internal_error(str_err.desc));
-  // lflags
-  str_err = c_str_create(lflags, lflags_len, &out_target->impl->lflags);
-  c_defer_check(str_err.code == 0, c_str_destroy, &out_target->impl->lflags,
-                err = CERROR_internal_error(str_err.desc));
-  // link_with
-  str_err = c_str_create(C_STR(""), &out_target->impl->link_with);
-  c_defer_check(str_err.code == 0, c_str_destroy, &out_target->impl->link_with,
-                err = CERROR_internal_error(str_err.desc));
+  for (size_t iii = 0; iii < profiles.len; ++iii) {
+    CStr const* profile = &((CStr*)profiles.data)[iii];
 
-  // sources
-  c_array_error_t arr_err
-      = c_array_create(sizeof(CStr), &out_target->impl->sources);
-  c_defer_check(arr_err.code == 0, c_array_destroy, &out_target->impl->sources,
-                err = CERROR_internal_error(arr_err.desc));
+    bool exists = false;
+    c_fs_exists(profile->data, profile->len, &exists);
+    if (!exists) { continue; }
 
-  // dependencies
-  arr_err
-      = c_array_create(sizeof(CTargetImpl*), &out_target->impl->dependencies);
-  c_defer_check(arr_err.code == 0, c_array_destroy,
-                &out_target->impl->dependencies,
-                err = CERROR_internal_error(arr_err.desc));
+    CHash128 hash;
+    err = c_hash128_file(profile->data, profile->len, &hash);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+    hash = c_hash128_combine(hash,
+                             c_hash128(profile->data, profile->len, 0));
 
-  arr_err = c_array_push(&self->impl->targets, &out_target->impl);
-  c_defer_check(arr_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(arr_err.desc));
+    // directories are listed in any order, a sum does not depend on it
+    *out_hash += hash.low;
+  }
 
   c_defer_deinit();
 
@@ -874,41 +4706,44 @@ cbuild_target_create(CBuild*     self,
 }
 
 CError
-cbuild_target_build(CBuild* self, CTargetImpl* target)
+internal_cbuild_pgo_reset(CBuildImpl* cbuild, CBuildArena* scratch)
 {
-  if (!target) { return CERROR_none; }
+  (void)scratch; // nothing runs
 
-  CError err = CERROR_none;
+  CError err      = CERROR_none;
+  CStr   merged   = {0};
+  CArray profiles = {0}; // CArray< CStr >
 
-  c_defer_init(6);
+  c_defer_init(4);
 
-  // create the target build path if not existing
-  bool obj_out_path_exists = false;
-  c_fs_dir_exists(target->build_path.data, target->build_path.len,
-                  &obj_out_path_exists);
-  if (!obj_out_path_exists) {
-    c_fs_error_t fs_err
-        = c_fs_dir_create(target->build_path.data, target->build_path.len);
+  // <base path>/.c_build/<type>_pgo_profile
+  c_str_error_t str_err = c_str_create_empty(c_fs_path_get_max_len(), &merged);
+  c_defer_err(str_err.code == 0, c_str_destroy, &merged,
+              err = CERROR_internal_error(str_err.desc));
+  err = internal_cbuild_get_pgo_profile_path(cbuild, false, &merged);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  bool exists = false;
+  c_fs_dir_exists(merged.data, merged.len, &exists);
+  if (!exists) {
+    c_fs_error_t fs_err = c_fs_dir_create(merged.data, merged.len);
     c_defer_check(fs_err.code == 0, NULL, NULL,
                   err = CERROR_internal_error(fs_err.desc));
   }
 
-  for (size_t iii = 0; iii < target->dependencies.len; iii++) {
-    /// FIXME: this will introduce an issue if one of deps
-    /// destructed
-    err = cbuild_target_build(self,
-                              ((CTargetImpl**)target->dependencies.data)[iii]);
-    c_defer_check(err.code == 0, NULL, NULL, NULL);
-  }
-
-  // compile
-  err = cbuild_target_compile(self, target);
+  // runs of an older binary would be merged with the new ones
+  c_array_error_t arr_err = c_array_create(sizeof(CStr), &profiles);
+  c_defer_err(arr_err.code == 0, internal_cbuild_objects_destroy, &profiles,
+              err = CERROR_internal_error(arr_err.desc));
+  err = internal_cbuild_get_raw_profiles(cbuild, &profiles);
   c_defer_check(err.code == 0, NULL, NULL, NULL);
-
-  if (target->ttype != CTARGET_TYPE_object) {
-    err = cbuild_target_link(self, target);
+  for (size_t iii = 0; iii < profiles.len; ++iii) {
+    remove(((CStr*)profiles.data)[iii].data);
   }
+
+  err = internal_cbuild_get_pgo_profile_path(cbuild, true, &merged);
   c_defer_check(err.code == 0, NULL, NULL, NULL);
+  if (default_builder->profile_merger[0] != '\0') { remove(merged.data); }
 
   c_defer_deinit();
 
@@ -916,122 +4751,101 @@ cbuild_target_build(CBuild* self, CTargetImpl* target)
 }
 
 CError
-cbuild_target_compile(CBuild* self, CTargetImpl* target)
+internal_cbuild_pgo_run_trainings(CBuildImpl* cbuild, CBuildArena* scratch)
 {
-  CError err    = CERROR_none;
-  CArray cmd    = {0}; // CArray < char* >
-  CStr   cflags = {0};
-#ifdef _WIN32
-  CStr obj_output = {0};
-  CStr pdb_output = {0};
-#endif
-
-  c_defer_init(6);
-
-  c_array_error_t arr_err = c_array_create(sizeof(char*), &cmd);
-  c_defer_err(arr_err.code == 0, c_array_destroy, &cmd,
-              err = CERROR_internal_error(arr_err.desc));
+  CError err = CERROR_none;
 
-  // $ <compiler>
-  arr_err = c_array_push(&cmd, &self->impl->cmds.compiler.data);
-  c_defer_check(arr_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(arr_err.desc));
+  for (size_t iii = 0; iii < cbuild->targets.len && err.code == 0; ++iii) {
+    CTargetImpl* target = ((CTargetImpl**)cbuild->targets.data)[iii];
+    if (target->pgo_trainings.len == 0) { continue; }
+
+    CStr output;
+    err = internal_cbuild_target_get_output_path(target, &output);
+    if (err.code != 0) { return err; }
+
+    for (size_t jjj = 0; jjj < target->pgo_trainings.len && err.code == 0;
+         ++jjj) {
+      CArray cmd  = {0}; // CArray< char* >
+      CStr   args = {0};
+
+      // $ <install path>/<name> <args> <NULL>
+      c_array_error_t arr_err = c_array_create(sizeof(char*), &cmd);
+      if (arr_err.code == 0) { arr_err = c_array_push(&cmd, &output.data); }
+      c_str_error_t str_err = c_str_clone(
+          &((CStr*)target->pgo_trainings.data)[jjj], &args);
+      if (arr_err.code != 0) {
+        err = CERROR_internal_error(arr_err.desc);
+      } else if (str_err.code != 0) {
+        err = CERROR_internal_error(str_err.desc);
+      } else {
+        err = internal_cbuild_push_flags(&args, &cmd);
+      }
+      if (err.code == 0) {
+        arr_err = c_array_push(&cmd, &(void*){NULL});
+        err     = arr_err.code == 0 ? internal_cbuild_exec(&cmd, scratch)
+                                    : CERROR_internal_error(arr_err.desc);
+        cbuild_arena_reset(scratch);
+      }
+
+      c_str_destroy(&args);
+      c_array_destroy(&cmd);
+    }
 
-  // $ <compiler> <cflags>
-  c_str_error_t str_err = c_str_clone(&target->cflags, &cflags);
-  c_defer_err(str_err.code == 0, c_str_destroy, &cflags,
-              err = CERROR_internal_error(str_err.desc));
-  char* subtoken = strtok(cflags.data, c_str_get_whitespaces());
-  if (subtoken) {
-    do {
-      arr_err = c_array_push(&cmd, &subtoken);
-      c_defer_check(arr_err.code == 0, NULL, NULL,
-                    err = CERROR_internal_error(arr_err.desc));
-    } while ((subtoken = strtok(NULL, c_str_get_whitespaces())));
+    c_str_destroy(&output);
   }
 
-  // $ <compiler> <cflags> -c
-  arr_err = c_array_push(&cmd, &(char const*){default_builder->cflags.compile});
-  c_defer_check(arr_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(arr_err.desc));
+  return err;
+}
 
-  char separator = c_fs_path_get_separator();
+CError
+internal_cbuild_pgo_merge(CBuildImpl* cbuild, CBuildArena* scratch)
+{
+  if (default_builder->profile_merger[0] == '\0') { return CERROR_none; }
 
-#ifndef _WIN32
-  // $ <compiler> <cflags> -c -o<c_out>/<target name>/<target name>.o
-  CStr output = {0};
-  str_err     = c_str_create_empty(1, &output);
-  c_defer_err(str_err.code == 0, c_str_destroy, &output,
-              err = CERROR_internal_error(str_err.desc));
-  str_err = c_str_format(&output, 0, C_STR_INV("%s%s%c%s%s"),
-                         default_builder->flags.output, target->build_path.data,
-                         separator, target->name.data,
-                         default_builder->extension.object);
-  c_defer_check(str_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(str_err.desc));
-  arr_err = c_array_push(&cmd, &output.data);
-  c_defer_check(arr_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(arr_err.desc));
-#else
-  // $ <compiler> <cflags> -c /Foc:<c_out>/<target name>
-  str_err = c_str_create_empty(1, &obj_output);
-  c_defer_err(str_err.code == 0, c_str_destroy, &obj_output,
-              err = CERROR_internal_error(str_err.desc));
-  str_err = c_str_format(&obj_output, 0, C_STR_INV("%s%s%c%s"),
-                         builder_windows_compile_flag_obj_output_path,
-                         target->build_path.data, separator, target->name.data);
-  c_defer_check(str_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(str_err.desc));
-  arr_err = c_array_push(&cmd, &obj_output.data);
-  c_defer_check(arr_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(arr_err.desc));
+  CError err      = CERROR_none;
+  CArray cmd      = {0}; // CArray< char* >
+  CArray profiles = {0}; // CArray< CStr >
+  CStr   merged   = {0};
 
-  // $ <compiler> <cflags> -c /Foc:<c_out>/<target name>
-  // /Fdc:<c_out>/<target name>
-  str_err = c_str_create_empty(1, &pdb_output);
-  c_defer_err(str_err.code == 0, c_str_destroy, &pdb_output,
-              err = CERROR_internal_error(str_err.desc));
-  str_err = c_str_format(&pdb_output, 0, C_STR_INV("%s%s%c%s"),
-                         builder_windows_compile_flag_pdb_output_path,
-                         target->build_path.data, separator, target->name.data);
-  c_defer_check(str_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(str_err.desc));
-  arr_err = c_array_push(&cmd, &pdb_output.data);
-  c_defer_check(arr_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(arr_err.desc));
-#endif
+  c_defer_init(4);
 
-  for (size_t iii = 0; iii < target->sources.len; ++iii) {
-    // $ <compiler> <cflags> -c <source>
-    arr_err = c_array_push(&cmd, &((CStr*)target->sources.data)[iii].data);
-    c_defer_check(arr_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(arr_err.desc));
+  c_array_error_t arr_err = c_array_create(sizeof(CStr), &profiles);
+  c_defer_err(arr_err.code == 0, internal_cbuild_objects_destroy, &profiles,
+              err = CERROR_internal_error(arr_err.desc));
+  err = internal_cbuild_get_raw_profiles(cbuild, &profiles);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
 
-    // $ <compiler> <cflags> -c <source> <NULL>
-    arr_err = c_array_push(&cmd, &(void*){NULL});
-    c_defer_check(arr_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(arr_err.desc));
+  // nothing of this project ran, its use stage goes without a profile
+  c_defer_check(profiles.len > 0, NULL, NULL, NULL);
 
-    CStr cmd_out = {0};
-    /// FIXME: don't use magic numbers
-    str_err = c_str_create_empty(8192, &cmd_out);
-    c_defer_err(str_err.code == 0, c_str_destroy, &cmd_out,
-                err = CERROR_internal_error(str_err.desc));
-    int out_status = 0;
-    err            = cprocess_exec((char const* const*)cmd.data, cmd.len, true,
-                                   &out_status, &cmd_out);
-    c_defer_check(err.code == 0, NULL, NULL, NULL);
-    c_defer_check(out_status == 0, NULL, NULL, NULL);
+  c_str_error_t str_err = c_str_create_empty(c_fs_path_get_max_len(), &merged);
+  c_defer_err(str_err.code == 0, c_str_destroy, &merged,
+              err = CERROR_internal_error(str_err.desc));
+  err = internal_cbuild_get_pgo_profile_path(cbuild, true, &merged);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
 
-    // $ <compiler> <cflags> -c <source>
-    arr_err = c_array_pop(&cmd, NULL);
+  // $ llvm-profdata merge -o <profile path>/merged.profdata <raw>... <NULL>
+  arr_err = c_array_create(sizeof(char*), &cmd);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &cmd,
+              err = CERROR_internal_error(arr_err.desc));
+
+  char const* const args[]
+      = {default_builder->profile_merger, "merge", "-o", merged.data};
+  for (size_t iii = 0; iii < sizeof(args) / sizeof(*args); ++iii) {
+    arr_err = c_array_push(&cmd, &args[iii]);
     c_defer_check(arr_err.code == 0, NULL, NULL,
                   err = CERROR_internal_error(arr_err.desc));
-    // $ <compiler> <cflags> -c
-    arr_err = c_array_pop(&cmd, NULL);
+  }
+  for (size_t iii = 0; iii < profiles.len; ++iii) {
+    arr_err = c_array_push(&cmd, &((CStr*)profiles.data)[iii].data);
     c_defer_check(arr_err.code == 0, NULL, NULL,
                   err = CERROR_internal_error(arr_err.desc));
   }
+  arr_err = c_array_push(&cmd, &(void*){NULL});
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+
+  err = internal_cbuild_exec(&cmd, scratch);
 
   c_defer_deinit();
 
@@ -1039,209 +4853,214 @@ cbuild_target_compile(CBuild* self, CTargetImpl* target)
 }
 
 CError
-cbuild_target_link(CBuild* self, CTargetImpl* target)
+internal_cbuild_collect_projects(CBuildImpl* cbuild, CArray* projects)
 {
-  CError err = CERROR_none;
-
-  c_defer_init(6);
+  for (size_t iii = 0; iii < projects->len; ++iii) {
+    if (((CBuildImpl**)projects->data)[iii] == cbuild) { return CERROR_none; }
+  }
 
-  CArray          cmd; // CArray < char* >
-  c_array_error_t arr_err = c_array_create(sizeof(char*), &cmd);
-  c_defer_err(arr_err.code == 0, c_str_destroy, &cmd,
-              err = CERROR_internal_error(arr_err.desc));
+  c_array_error_t arr_err = c_array_push(projects, &cbuild);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
 
-  // create the install path if not exists
-  bool install_path_exists = false;
-  c_fs_dir_exists(target->install_path.data, target->install_path.len,
-                  &install_path_exists);
-  if (!install_path_exists) {
-    c_fs_error_t fs_err
-        = c_fs_dir_create(target->install_path.data, target->install_path.len);
-    c_defer_check(fs_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(fs_err.desc));
+  for (size_t iii = 0; iii < cbuild->other_projects.len; ++iii) {
+    CError err = internal_cbuild_collect_projects(
+        ((CBuildImpl**)cbuild->other_projects.data)[iii], projects);
+    if (err.code != 0) { return err; }
   }
 
-  char const* lib_extenstion = NULL;
-  char const* flag_output    = default_builder->flags.output;
+  return CERROR_none;
+}
 
-  // $ <link creator>
-  if (target->ttype == CTARGET_TYPE_static) {
-    arr_err = c_array_push(&cmd, &self->impl->cmds.static_lib_creator.data);
-    c_defer_check(arr_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(arr_err.desc));
-    lib_extenstion = default_builder->extension.lib_static;
-    /// FIXME: very ugly hack
-    if (strcmp("ar", &self->impl->cmds.static_lib_creator
-                          .data[self->impl->cmds.static_lib_creator.len - 2])
-        == 0) {
-      flag_output = "";
+CError
+internal_cbuild_order_projects(CArray const* projects, CArray* out_ordered)
+{
+  CBuildImpl* const* all = projects->data;
+
+  // each pass takes the projects whose dependencies are all taken
+  while (out_ordered->len < projects->len) {
+    size_t const ordered_len = out_ordered->len;
+
+    for (size_t iii = 0; iii < projects->len; ++iii) {
+      CBuildImpl* cbuild     = all[iii];
+      bool        is_ordered = false;
+      bool        is_ready   = true;
+
+      for (size_t jjj = 0; jjj < out_ordered->len; ++jjj) {
+        CBuildImpl* other = ((CBuildImpl**)out_ordered->data)[jjj];
+        if (other == cbuild) { is_ordered = true; }
+      }
+      if (is_ordered) { continue; }
+
+      for (size_t jjj = 0; is_ready && jjj < cbuild->other_projects.len;
+           ++jjj) {
+        CBuildImpl* dependency
+            = ((CBuildImpl**)cbuild->other_projects.data)[jjj];
+        is_ready = false;
+        for (size_t kkk = 0; kkk < ordered_len; ++kkk) {
+          if (((CBuildImpl**)out_ordered->data)[kkk] == dependency) {
+            is_ready = true;
+          }
+        }
+      }
+      if (!is_ready) { continue; }
+
+      c_array_error_t arr_err = c_array_push(out_ordered, &cbuild);
+      if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+    }
+
+    if (out_ordered->len == ordered_len) {
+      return CERROR_internal_error("c: cyclic project dependencies");
     }
-  } else if (target->ttype == CTARGET_TYPE_shared) {
-    arr_err = c_array_push(&cmd, &self->impl->cmds.shared_lib_creator.data);
-    lib_extenstion = default_builder->extension.lib_shared;
-  } else if (target->ttype == CTARGET_TYPE_executable) {
-    arr_err = c_array_push(&cmd, &self->impl->cmds.linker.data);
-    c_defer_check(arr_err.code == 0, NULL, NULL,
-                  err = CERROR_internal_error(arr_err.desc));
-    lib_extenstion = default_builder->extension.exe;
-  } else {
-    c_defer_check(false, NULL, NULL, err = CERROR_invalid_target_type);
   }
 
-  // $ <lib creator> <lflags>
-  CStr          lflags;
-  c_str_error_t str_err = c_str_clone(&target->lflags, &lflags);
-  c_defer_err(str_err.code == 0, c_str_destroy, &lflags,
-              err = CERROR_internal_error(str_err.desc));
-  char* subtoken = strtok(lflags.data, c_str_get_whitespaces());
-  if (subtoken) {
-    do {
-      arr_err = c_array_push(&cmd, &subtoken);
-      c_defer_check(arr_err.code == 0, NULL, NULL,
-                    err = CERROR_internal_error(arr_err.desc));
-    } while ((subtoken = strtok(NULL, c_str_get_whitespaces())));
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_probe_linker(CBuildImpl* cbuild, CBuildLinker* out_linker)
+{
+  // the last answer of the process, the daemon keeps it between builds
+  static CBuildLinker probed     = CBUILD_LINKER_auto;
+  static uint64_t     probed_key = 0;
+
+  // the answer holds for the same compiler found through the same PATH
+  char const* env_path = getenv("PATH");
+  CHash128    key      = c_hash128(cbuild->cmds.compiler.data,
+                                   cbuild->cmds.compiler.len, 0);
+  if (env_path) {
+    key = c_hash128_combine(key, c_hash128(env_path, strlen(env_path), 0));
   }
 
-  CStr output;
-  str_err = c_str_create(C_STR(""), &output);
-  c_defer_err(str_err.code == 0, c_str_destroy, &output,
-              err = CERROR_internal_error(str_err.desc));
+  if (probed != CBUILD_LINKER_auto && probed_key == key.low) {
+    *out_linker = probed;
+    return CERROR_none;
+  }
 
-  char path_separator = c_fs_path_get_separator();
+  CError err   = CERROR_none;
+  CStr   path  = {0};
+  CStr   cache = {0};
+  CFile  file  = {0};
 
-  // -o<install_path>/lib<name>.so
-  // -o<install path>/<name>
-  // <install path>/<name>.a
-  str_err
-      = c_str_format(&output, 0, C_STR_INV("%s%s%c%s%s%s"), flag_output,
-                     target->install_path.data, path_separator,
-                     target->ttype != CTARGET_TYPE_executable ? lib_prefix : "",
-                     target->name.data, lib_extenstion);
-  c_defer_check(str_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(str_err.desc));
+  // forgotten until this probe answers
+  probed     = CBUILD_LINKER_auto;
+  probed_key = key.low;
 
-  arr_err = c_array_push(&cmd, &output.data);
-  c_defer_check(arr_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(arr_err.desc));
+  c_defer_init(4);
 
-  // $ <lib creator> <lflags> <object files>
-  // object files
-  size_t       start_cmd_len = cmd.len;
-  c_fs_error_t fs_err        = c_fs_foreach(
-      target->build_path.data, target->build_path.len,
-      target->build_path.capacity,
-      &internal_find_and_push_all_compiled_objects_handler, (void*)&cmd);
-  c_defer_check(fs_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(fs_err.desc));
-  size_t end_cmd_len = cmd.len;
-  // free the strdup we created at the handler
-  for (size_t i = start_cmd_len; i < end_cmd_len; ++i) {
-    c_defer_err(true, free, ((char**)(cmd.data))[i], NULL);
-  }
+  // <base path>/.c_build/linker
+  c_str_error_t str_err = c_str_create_empty(c_fs_path_get_max_len(), &path);
+  c_defer_err(str_err.code == 0, c_str_destroy, &path,
+              err = CERROR_internal_error(str_err.desc));
+  str_err = c_str_format(&path, 0, C_STR_INV("%s%c%s%c%s"),
+                         cbuild->base_path.data, c_fs_path_get_separator(),
+                         default_builder_path, c_fs_path_get_separator(),
+                         default_linker_cache_name);
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
 
-  // $ <lib creator> <lflags> <object files> <link with>
-  CStr link_with;
-  str_err = c_str_clone(&target->link_with, &link_with);
-  c_defer_err(str_err.code == 0, c_str_destroy, &link_with,
+  // <key> <linker name>
+  str_err = c_str_create_empty(64, &cache);
+  c_defer_err(str_err.code == 0, c_str_destroy, &cache,
               err = CERROR_internal_error(str_err.desc));
-  subtoken = strtok(link_with.data, c_str_get_whitespaces());
-  if (subtoken) {
-    do {
-      arr_err = c_array_push(&cmd, &subtoken);
-      c_defer_check(arr_err.code == 0, NULL, NULL,
-                    err = CERROR_internal_error(arr_err.desc));
-    } while ((subtoken = strtok(NULL, c_str_get_whitespaces())));
+  c_fs_error_t fs_err = c_fs_file_open(path.data, path.len, "r", &file);
+  if (fs_err.code == 0) {
+    fs_err
+        = c_fs_file_read(&file, cache.data, cache.capacity - 1, &cache.len);
+    c_fs_file_close(&file);
+  }
+  if (fs_err.code == 0) {
+    cache.data[cache.len] = '\0';
+
+    char*                    name = NULL;
+    unsigned long long const cached_key
+        = strtoull(cache.data, &name, 16);
+    if (cached_key == key.low && *name == ' '
+        && cbuild_linker_from_name(&name[1], strcspn(&name[1], "\n"),
+                                   &probed)
+                   .code
+               == 0
+        && probed != CBUILD_LINKER_auto) {
+      c_defer_check(false, NULL, NULL, NULL);
+    }
   }
 
-  arr_err = c_array_push(&cmd, &(void*){NULL});
-  c_defer_check(arr_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(arr_err.desc));
+  // $ <compiler> -fuse-ld=<linker> -Wl,--version
+  // the compiler fails on a linker it doesn't know or can't find
+  probed = CBUILD_LINKER_default;
+  for (size_t iii = CBUILD_LINKER_mold;
+       iii < CBUILD_LINKER_auto
+       && default_builder->lflags.use_linker[0] != '\0';
+       ++iii) {
+    char flag[64];
+    snprintf(flag, sizeof(flag), "%s%s", default_builder->lflags.use_linker,
+             linker_names[iii]);
+
+    char const* const cmd[]  = {cbuild->cmds.compiler.data, flag,
+                                "-Wl,--version", NULL};
+    int               status = 0;
+    if (cprocess_exec(cmd, sizeof(cmd) / sizeof(*cmd), false, &status, NULL)
+                .code
+            == 0
+        && status == 0) {
+      probed = (CBuildLinker)iii;
+      break;
+    }
+  }
 
-  CStr cmd_out = {0};
-  /// FIXME: don't use magic numbers
-  str_err = c_str_create_empty(8192, &cmd_out);
-  c_defer_err(str_err.code == 0, c_str_destroy, &cmd_out,
-              err = CERROR_internal_error(str_err.desc));
-  int out_status = 0;
-  err = cprocess_exec((char const* const*)cmd.data, cmd.len, true, &out_status,
-                      &cmd_out);
-  c_defer_check(err.code == 0, NULL, NULL, NULL);
-  c_defer_check(out_status == 0, NULL, NULL, NULL);
+  // a cache that can't be written only costs the next probe
+  str_err = c_str_format(&cache, 0, C_STR_INV("%016llx %s\n"),
+                         (unsigned long long)key.low, linker_names[probed]);
+  if (str_err.code == 0
+      && c_fs_file_open(path.data, path.len, "w", &file).code == 0) {
+    c_fs_file_write(&file, cache.data, cache.len, NULL);
+    c_fs_file_close(&file);
+  }
 
   c_defer_deinit();
 
+  *out_linker = probed;
+
   return err;
 }
 
-// ------------------------------------------------------------------------//
-// ------------------------------ Internals -------------------------------//
-// ------------------------------------------------------------------------//
-
-c_fs_error_t
-internal_find_and_push_all_compiled_objects_handler(char   path[],
-                                                    size_t path_len,
-                                                    void*  extra_data)
+void
+internal_cbuild_collect_closure(CTargetImpl* target)
 {
-  (void)path_len;
-
-  c_fs_error_t fs_err = {0};
-  CArray*      cmd    = extra_data;
-
-  if (strstr(path, default_builder->extension.object)) {
-    c_array_error_t arr_err = c_array_push(cmd, &(char*){strdup(path)});
-    if (arr_err.code != 0) { return (c_fs_error_t){-1, ""}; }
+  // the flag keeps the walk linear, shared dependencies are seen once
+  if (target->is_selected) { return; }
+  target->is_selected = true;
+
+  // dependencies may belong to other projects
+  for (size_t iii = 0; iii < target->dependencies.len; ++iii) {
+    internal_cbuild_collect_closure(
+        ((CTargetImpl**)target->dependencies.data)[iii]);
   }
-
-  return fs_err;
 }
 
-c_fs_error_t
-internal_find_and_push_all_compiled_objects_cstr_handler(char*  path,
-                                                         size_t path_len,
-                                                         void*  extra_data)
+void
+internal_cbuild_objects_destroy(CArray* objects)
 {
-  (void)path_len;
-
-  c_fs_error_t fs_err  = {0};
-  CArray*      sources = extra_data;
-
-  if (strstr(path, default_builder->extension.object)) {
-    CStr          object;
-    c_str_error_t str_err = c_str_create(path, path_len, &object);
-    if (str_err.code != 0) { return (c_fs_error_t){-1, ""}; }
-    c_array_error_t arr_err = c_array_push(sources, &object);
-    if (arr_err.code != 0) { return (c_fs_error_t){-1, ""}; }
+  for (size_t iii = 0; iii < objects->len; ++iii) {
+    c_str_destroy(&((CStr*)objects->data)[iii]);
   }
-
-  return fs_err;
+  c_array_destroy(objects);
 }
 
 CError
-internal_cbuild_get_path(CTargetImpl* target,
-                         char const   build_install_dir_name[],
+internal_cbuild_get_path(CBuildImpl*  cbuild,
+                         CTargetImpl* target,
+                         char const   root_dir_name[],
                          CStr*        out_path)
 {
-  CError err = CERROR_none;
-  *out_path  = (CStr){0};
-
-  c_defer_init(6);
-
-  // <build_install_dir_name>
-  c_str_error_t str_err = c_str_create_empty(c_fs_path_get_max_len(), out_path);
-  c_defer_check(str_err.code == 0, c_str_destroy, out_path,
-                err = CERROR_internal_error(str_err.desc));
-
-  char separator = c_fs_path_get_separator();
-
-  // <build_install_dir_name>/<target name>
-  str_err = c_str_format(out_path, 0, C_STR_INV("%s%c%s"),
-                         build_install_dir_name, separator, target->name.data);
-  c_defer_check(str_err.code == 0, NULL, NULL,
-                err = CERROR_internal_error(str_err.desc));
-
-  c_defer_deinit();
-
-  return err;
+  char const separator[] = {c_fs_path_get_separator(), '\0'};
+
+  // <root_dir_name>/<config>/<target name>
+  char const* const parts[]
+      = {root_dir_name,      separator, cbuild->config.data, separator,
+         target->name.data};
+  return internal_cbuild_intern_joined(cbuild, parts,
+                                       sizeof(parts) / sizeof(*parts),
+                                       out_path);
 }
 
 CError
@@ -1277,6 +5096,9 @@ internal_find_build_function_name(char   build_file_path[],
     buf.data += sizeof("CError") - 1;
     buf.data = c_skip_whitespaces(buf.data);
 
+    // only the last candidate is kept
+    out_function_name_buf->len = 0;
+
     if (!(((*buf.data <= 'z') && (*buf.data >= 'a'))
           || ((*buf.data <= 'Z') && (*buf.data >= 'A')) || *buf.data != '_')) {
       continue;
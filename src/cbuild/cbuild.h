@@ -1,6 +1,7 @@
 #ifndef CBUILD_H
 #define CBUILD_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "cerror.h"
@@ -42,6 +43,12 @@ typedef enum CTargetProperty {
   CTARGET_PROPERTY_include_path       = 1 << 5,
 } CTargetProperty;
 
+typedef enum CTargetLto {
+  CTARGET_LTO_none,
+  CTARGET_LTO_full,     // the whole link optimized as one unit
+  CTARGET_LTO_parallel, // gcc -flto=auto, clang ThinLTO
+} CTargetLto;
+
 typedef struct CTargetSource {
   char*  path;
   size_t path_len;
@@ -88,11 +95,80 @@ __C_DLL__ CError cbuild_target_add_source(CBuild*    self,
                                           char const source_path[],
                                           size_t     source_path_len);
 
+/// add every file matching `pattern` as a source, `*` and `?` match inside a
+/// path component and `**` any number of directories, e.g. `src/**/*.c`.
+/// relative patterns are from the project base path, hidden directories and
+/// build outputs are not walked. the directory listings are kept in the
+/// build database, a later configure only lists the changed directories
+__C_DLL__ CError cbuild_target_add_sources_glob(CBuild*    self,
+                                                CTarget*   target,
+                                                char const pattern[],
+                                                size_t     pattern_len);
+
+/// `header_path` is compiled once per target and configuration, then
+/// included first by every source of the target. a second call replaces it
+__C_DLL__ CError cbuild_target_set_precompiled_header(CBuild*    self,
+                                                      CTarget*   target,
+                                                      char const header_path[],
+                                                      size_t header_path_len);
+
+/// link time optimization of `target`, static libraries are archived with
+/// an lto aware archiver so their objects keep their symbols. a parallel
+/// lto link counts as a job for every worker
+__C_DLL__ CError cbuild_target_set_lto(CBuild*    self,
+                                       CTarget*   target,
+                                       CTargetLto lto);
+
+/// the static library `target` references the objects inside the build
+/// path instead of copying them, for libraries only linked inside the tree.
+/// archivers without thin archives copy them anyway
+__C_DLL__ CError cbuild_target_set_thin_archive(CBuild*  self,
+                                                CTarget* target,
+                                                bool     is_thin);
+
+/// the library `target` links the objects of the library `objects_of`
+/// instead of compiling the same sources again, they are compiled once
+/// with pic and the flags of `objects_of` for both. the sources of
+/// `target` that `objects_of` has too are never compiled for `target`
+__C_DLL__ CError cbuild_target_share_objects(CBuild*  self,
+                                             CTarget* target,
+                                             CTarget* objects_of);
+
+/// compile `source_path` of `target` for every library sharing its
+/// objects on its own, with their flags and without pic for archives, for
+/// the sources pic slows down
+__C_DLL__ CError cbuild_target_exclude_from_sharing(CBuild*    self,
+                                                    CTarget*   target,
+                                                    char const source_path[],
+                                                    size_t source_path_len);
+
+/// run the executable `target` with `args` to train a profile guided build
+/// (`c build --pgo`), every call adds a run. plain builds ignore it
+__C_DLL__ CError cbuild_target_add_pgo_training(CBuild*    self,
+                                                CTarget*   target,
+                                                char const args[],
+                                                size_t     args_len);
+
+/// compile the sources of `target` through at most `batches` generated unity
+/// files, each of them includes several sources. 0 keeps the target out of
+/// unity builds, even when `c build --unity` asks for them
+__C_DLL__ CError cbuild_target_set_unity(CBuild*  self,
+                                         CTarget* target,
+                                         size_t   batches);
+
+/// compile `source_path` on its own in unity builds, for sources that
+/// clash with the others (static names, macros)
+__C_DLL__ CError cbuild_target_exclude_from_unity(CBuild*    self,
+                                                  CTarget*   target,
+                                                  char const source_path[],
+                                                  size_t     source_path_len);
+
 __C_DLL__ CError cbuild_target_set_include_path(CBuild*    self,
                                                 CTarget*   target,
                                                 char const include_path[],
                                                 size_t     include_path_len);
 
+/// `include_path` is passed as a single argument, spaces included
 __C_DLL__ CError cbuild_target_add_include_path_flag(CBuild*    self,
                                                      CTarget*   target,
                                                      char const include_path[],
@@ -103,6 +179,8 @@ __C_DLL__ CError cbuild_target_depends_on(CBuild*         self,
                                           CTarget*        depend_on,
                                           CTargetProperty resource);
 
+/// `flag` may hold several flags separated by whitespaces, there is no
+/// quoting. a path with spaces goes through the dedicated calls
 __C_DLL__ CError cbuild_target_add_compile_flag(CBuild*    self,
                                                 CTarget*   target,
                                                 char const flag[],
@@ -118,11 +196,31 @@ __C_DLL__ CError cbuild_target_get(CBuild*    self,
                                    size_t     target_name_len,
                                    CTarget*   out_target);
 
+/// `out_targets[iii]` = the target named `target_names[iii]`, zeroed when
+/// there is none. every name is looked up, the first unknown one is reported
+__C_DLL__ CError cbuild_targets_get(CBuild*           self,
+                                    char const* const target_names[],
+                                    size_t            target_names_len,
+                                    CTarget           out_targets[]);
+
 __C_DLL__ CError cbuild_depends_on(CBuild*    self,
                                    char const other_cbuild_path[],
                                    size_t     other_cbuild_path_len,
                                    CBuild*    out_other_cbuild);
 
+/// run `argv` to generate `outputs` from `inputs`, paths are relative to
+/// the project. it runs again once `argv` or the content of an input
+/// changes or an output is missing, always before the compiles whose
+/// sources or includes name one of its outputs. the outputs can be added
+/// as sources right away
+__C_DLL__ CError cbuild_custom_command(CBuild*           self,
+                                       char const* const argv[],
+                                       size_t            argv_len,
+                                       char const* const inputs[],
+                                       size_t            inputs_len,
+                                       char const* const outputs[],
+                                       size_t            outputs_len);
+
 __C_DLL__ void cbuild_target_destroy(CBuild* self, CTarget* target);
 
 #endif // CBUILD_H
@@ -0,0 +1,90 @@
+#include "cbuild_arena_private.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+static bool internal_cbuild_arena_push_block(CBuildArena* self, size_t size);
+
+CError
+cbuild_arena_create(size_t block_size, CBuildArena* out_arena)
+{
+  assert(block_size > 0);
+  assert(out_arena);
+
+  *out_arena = (CBuildArena){.block_size = block_size};
+
+  c_array_error_t arr_err = c_array_create(sizeof(char*), &out_arena->blocks);
+  return arr_err.code == 0 ? CERROR_none
+                           : CERROR_internal_error(arr_err.desc);
+}
+
+void*
+cbuild_arena_alloc(CBuildArena* self, size_t size, size_t align)
+{
+  assert(self);
+  assert(align > 0 && (align & (align - 1)) == 0);
+
+  // the first block always has the regular size, it is the one kept by a
+  // reset
+  if (self->blocks.len == 0) {
+    if (!internal_cbuild_arena_push_block(self, 0)) { return NULL; }
+    self->block_used = 0;
+  }
+
+  // the padding wastes at most `align` - 1 bytes, blocks are aligned for
+  // any type by malloc
+  size_t const offset = (self->block_used + align - 1) & ~(align - 1);
+  if (offset + size > self->block_size) {
+    if (!internal_cbuild_arena_push_block(self, size)) { return NULL; }
+    self->block_used = size;
+    return ((char**)self->blocks.data)[self->blocks.len - 1];
+  }
+
+  self->block_used = offset + size;
+  return &((char**)self->blocks.data)[self->blocks.len - 1][offset];
+}
+
+void
+cbuild_arena_reset(CBuildArena* self)
+{
+  assert(self);
+
+  for (size_t iii = self->blocks.len; iii > 1; --iii) {
+    free(((char**)self->blocks.data)[iii - 1]);
+  }
+  self->blocks.len = self->blocks.len > 0 ? 1 : 0;
+  self->block_used = 0;
+  self->bytes      = self->blocks.len * self->block_size;
+}
+
+void
+cbuild_arena_destroy(CBuildArena* self)
+{
+  assert(self);
+
+  for (size_t iii = 0; iii < self->blocks.len; ++iii) {
+    free(((char**)self->blocks.data)[iii]);
+  }
+  c_array_destroy(&self->blocks);
+
+  *self = (CBuildArena){0};
+}
+
+bool
+internal_cbuild_arena_push_block(CBuildArena* self, size_t size)
+{
+  // the bytes left in the last block are wasted, at most one allocation
+  size_t const block_size = size > self->block_size ? size : self->block_size;
+  char*        block      = malloc(block_size);
+  if (!block) { return false; }
+
+  c_array_error_t arr_err = c_array_push(&self->blocks, &block);
+  if (arr_err.code != 0) {
+    free(block);
+    return false;
+  }
+  self->bytes += block_size;
+
+  return true;
+}
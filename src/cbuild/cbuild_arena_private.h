@@ -0,0 +1,41 @@
+#ifndef CBUILD_ARENA_PRIVATE_H
+#define CBUILD_ARENA_PRIVATE_H
+
+/// bump allocator, many small objects living as long as each other are
+/// taken from a few large blocks and released all at once
+
+#include "cbuild.h"
+#include "cbuild_private.h"
+#include "cerror.h"
+
+#include <array.h>
+
+#include <stddef.h>
+
+/// alignment of `type`, `_Alignof` is not part of C99
+#define CBUILD_ALIGNOF(type) offsetof(struct { char c; type t; }, t)
+
+/// nothing is allocated before the first call to `cbuild_arena_alloc`. it
+/// is not thread safe
+struct CBuildArena {
+  CArray blocks;     // CArray< char* >
+  size_t block_size; // an allocation bigger than it gets its own block
+  size_t block_used; // bytes used inside the last block
+  size_t bytes;      // allocated by all the blocks
+};
+
+__C_DLL__ CError cbuild_arena_create(size_t block_size, CBuildArena* out_arena);
+
+/// `size` bytes aligned on `align` (a power of 2), uninitialized. NULL if
+/// out of memory
+__C_DLL__ void* cbuild_arena_alloc(CBuildArena* self,
+                                   size_t       size,
+                                   size_t       align);
+
+/// everything allocated so far is released, the first block is kept for
+/// what comes next
+__C_DLL__ void cbuild_arena_reset(CBuildArena* self);
+
+__C_DLL__ void cbuild_arena_destroy(CBuildArena* self);
+
+#endif // CBUILD_ARENA_PRIVATE_H
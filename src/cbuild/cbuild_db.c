@@ -0,0 +1,796 @@
+#include "cbuild_db_private.h"
+#include "helpers.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <defer.h>
+#include <fs.h>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4996) // disable warning about unsafe functions
+#endif
+
+static char const db_header[] = "c_build_db 2\n";
+
+static uint64_t internal_cbuild_db_key_hash(char       kind,
+                                            char const key[],
+                                            size_t     key_len);
+static CError   internal_cbuild_db_read_file(char const path[],
+                                             size_t     path_len,
+                                             uint64_t   file_size,
+                                             CStr*      out_content);
+static CError   internal_cbuild_db_parse(CBuildDb* self, CStr* content);
+static CError   internal_cbuild_db_append_escaped(CStr*      content,
+                                                  char const field[],
+                                                  size_t     field_len);
+static size_t   internal_cbuild_db_unescape(char field[], size_t field_len);
+
+CError
+cbuild_db_create(CBuildDb* out_db)
+{
+  assert(out_db);
+
+  CError err = CERROR_none;
+
+  c_defer_init(3);
+
+  *out_db = (CBuildDb){0};
+
+  c_str_error_t str_err = c_str_create(C_STR(""), &out_db->path);
+  c_defer_check(str_err.code == 0, c_str_destroy, &out_db->path,
+                err = CERROR_internal_error(str_err.desc));
+
+  c_array_error_t arr_err
+      = c_array_create(sizeof(CBuildDbRecord), &out_db->records);
+  c_defer_check(arr_err.code == 0, c_array_destroy, &out_db->records,
+                err = CERROR_internal_error(arr_err.desc));
+
+  err = c_hash_index_create(0, &out_db->index);
+  c_defer_check(err.code == 0, c_hash_index_destroy, &out_db->index, NULL);
+
+  c_defer_check(cbuild_mutex_create(&out_db->lock), NULL, NULL,
+                err = CERROR_internal_error("c: failed to create a mutex"));
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_db_load(CBuildDb* self, char const path[], size_t path_len)
+{
+  assert(self);
+  assert(path && path_len > 0);
+
+  if (path[path_len] != '\0') { return CERROR_invalid_string; }
+
+  CError err = CERROR_none;
+
+  c_defer_init(4);
+
+  c_str_error_t str_err
+      = c_str_replace_at(&self->path, 0, self->path.len, path, path_len);
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+
+  CBuildFileState db_state;
+  cbuild_stat(path, &db_state);
+  if (!db_state.exists) {
+    // first build
+    c_defer_check(false, NULL, NULL, NULL);
+  }
+
+  CStr content = {0};
+  err = internal_cbuild_db_read_file(path, path_len, db_state.size, &content);
+  c_defer_err(err.code == 0, c_str_destroy, &content, NULL);
+
+  // a database from an unknown version is just ignored
+  if (strncmp(content.data, C_STR(db_header)) == 0) {
+    err = internal_cbuild_db_parse(self, &content);
+  }
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_db_save(CBuildDb* self)
+{
+  assert(self);
+
+  if (!self->is_dirty || self->path.len == 0) { return CERROR_none; }
+
+  CError err = CERROR_none;
+
+  c_defer_init(4);
+
+  CStr          content = {0};
+  c_str_error_t str_err
+      = c_str_create_empty(self->records.len * 128 + sizeof(db_header),
+                           &content);
+  c_defer_err(str_err.code == 0, c_str_destroy, &content,
+              err = CERROR_internal_error(str_err.desc));
+
+  str_err = c_str_append_with_cstr(&content, C_STR(db_header));
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+
+  for (size_t iii = 0; iii < self->records.len; ++iii) {
+    CBuildDbRecord* record = &((CBuildDbRecord*)self->records.data)[iii];
+
+    // <kind> <hash> <inode> <mtime> <size> <key>[\t<value>]
+    str_err = c_str_format(
+        &content, content.len,
+        C_STR_INV("%c %016llx%016llx %llu %lld %llu "), record->kind,
+        (unsigned long long)record->hash.high,
+        (unsigned long long)record->hash.low, (unsigned long long)record->inode,
+        (long long)record->mtime, (unsigned long long)record->size);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+
+    err = internal_cbuild_db_append_escaped(&content, record->key.data,
+                                            record->key.len);
+    if (err.code == 0 && record->value.data) {
+      str_err = c_str_append_with_cstr(&content, C_STR("\t"));
+      err     = str_err.code == 0 ? internal_cbuild_db_append_escaped(
+                                        &content, record->value.data,
+                                        record->value.len)
+                                  : CERROR_internal_error(str_err.desc);
+    }
+    if (err.code == 0) {
+      str_err = c_str_append_with_cstr(&content, C_STR("\n"));
+      if (str_err.code != 0) { err = CERROR_internal_error(str_err.desc); }
+    }
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  // write to a temporary file first, a killed build must not leave a
+  // truncated database behind
+  CStr tmp_path = {0};
+  str_err       = c_str_clone(&self->path, &tmp_path);
+  c_defer_err(str_err.code == 0, c_str_destroy, &tmp_path,
+              err = CERROR_internal_error(str_err.desc));
+  str_err = c_str_append_with_cstr(&tmp_path, C_STR(".tmp"));
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+
+  CFile        db_file = {0};
+  c_fs_error_t fs_err
+      = c_fs_file_open(tmp_path.data, tmp_path.len, "w", &db_file);
+  c_defer_check(fs_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(fs_err.desc));
+  fs_err = c_fs_file_write(&db_file, content.data, content.len, NULL);
+  c_fs_file_close(&db_file);
+  c_defer_check(fs_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(fs_err.desc));
+
+#ifdef _WIN32
+  remove(self->path.data);
+#endif
+  c_defer_check(rename(tmp_path.data, self->path.data) == 0, NULL, NULL,
+                err = CERROR_internal_error("c: failed to save the build db"));
+
+  self->is_dirty = false;
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CBuildDbRecord*
+cbuild_db_find(CBuildDb*    self,
+               CBuildDbKind kind,
+               char const   key[],
+               size_t       key_len)
+{
+  assert(self);
+  assert(key && key_len > 0);
+
+  uint64_t const hash   = internal_cbuild_db_key_hash((char)kind, key, key_len);
+  size_t         cursor = 0;
+  size_t         index  = 0;
+  while (c_hash_index_next(&self->index, hash, &cursor, &index)) {
+    CBuildDbRecord* record = &((CBuildDbRecord*)self->records.data)[index];
+    if (record->kind == (char)kind && record->key.len == key_len
+        && memcmp(record->key.data, key, key_len) == 0) {
+      return record;
+    }
+  }
+
+  return NULL;
+}
+
+CError
+cbuild_db_put(CBuildDb*       self,
+              CBuildDbKind    kind,
+              char const      key[],
+              size_t          key_len,
+              CBuildDbRecord* record)
+{
+  assert(self);
+  assert(key && key_len > 0);
+  assert(record);
+
+  self->is_dirty = true;
+
+  // the action just wrote its output
+  if (kind == CBUILD_DB_KIND_action) {
+    cbuild_db_forget_state(self, key, key_len);
+  }
+
+  CStr value = {0};
+  if (record->value.data) {
+    c_str_error_t str_err = c_str_clone(&record->value, &value);
+    if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+  }
+
+  CBuildDbRecord* old_record = cbuild_db_find(self, kind, key, key_len);
+  if (old_record) {
+    if (old_record->value.data) { c_str_destroy(&old_record->value); }
+    old_record->value      = value;
+    old_record->hash       = record->hash;
+    old_record->inode      = record->inode;
+    old_record->mtime      = record->mtime;
+    old_record->size       = record->size;
+    old_record->is_scanned = record->is_scanned;
+    old_record->scanned    = record->scanned;
+    return CERROR_none;
+  }
+
+  CBuildDbRecord new_record = *record;
+  new_record.kind           = (char)kind;
+  new_record.value          = value;
+  c_str_error_t str_err     = c_str_create(key, key_len, &new_record.key);
+  if (str_err.code != 0) {
+    if (value.data) { c_str_destroy(&value); }
+    return CERROR_internal_error(str_err.desc);
+  }
+
+  c_array_error_t arr_err = c_array_push(&self->records, &new_record);
+  if (arr_err.code != 0) {
+    c_str_destroy(&new_record.key);
+    if (value.data) { c_str_destroy(&value); }
+    return CERROR_internal_error(arr_err.desc);
+  }
+
+  return c_hash_index_insert(
+      &self->index, internal_cbuild_db_key_hash((char)kind, key, key_len),
+      self->records.len - 1);
+}
+
+CError
+cbuild_db_file_hash(CBuildDb*  self,
+                    char const path[],
+                    size_t     path_len,
+                    bool*      out_exists,
+                    CHash128*  out_hash)
+{
+  assert(self);
+  assert(path && path_len > 0);
+  assert(out_exists && out_hash);
+
+  if (path[path_len] != '\0') { return CERROR_invalid_string; }
+
+  // headers shared by many sources are asked once per build
+  CBuildDbRecord* record
+      = cbuild_db_find(self, CBUILD_DB_KIND_file, path, path_len);
+  CBuildFileState state;
+  if (record && record->is_scanned) {
+    state = record->scanned;
+  } else {
+    cbuild_stat(path, &state);
+  }
+
+  *out_exists = state.exists;
+  if (!*out_exists) { return CERROR_none; }
+
+  if (record && record->inode == state.inode && record->mtime == state.mtime
+      && record->size == state.size) {
+    record->is_scanned = true;
+    record->scanned    = state;
+    *out_hash          = record->hash;
+    return CERROR_none;
+  }
+
+  CBuildDbRecord new_record = {
+      .inode      = state.inode,
+      .mtime      = state.mtime,
+      .size       = state.size,
+      .is_scanned = true,
+      .scanned    = state,
+  };
+  CError err = c_hash128_file(path, path_len, &new_record.hash);
+  if (err.code != 0) { return err; }
+
+  *out_hash = new_record.hash;
+
+  return cbuild_db_put(self, CBUILD_DB_KIND_file, path, path_len,
+                       &new_record);
+}
+
+CError
+cbuild_db_depfile_hash(CBuildDb*  self,
+                       char const depfile_path[],
+                       size_t     depfile_path_len,
+                       bool*      out_exists,
+                       CHash128*  inout_hash)
+{
+  assert(self);
+  assert(depfile_path && depfile_path_len > 0);
+  assert(out_exists);
+  assert(inout_hash);
+
+  CError err = CERROR_none;
+
+  c_defer_init(4);
+
+  CBuildFileState depfile_state;
+  cbuild_stat(depfile_path, &depfile_state);
+  *out_exists = depfile_state.exists;
+  if (!depfile_state.exists) {
+    c_defer_check(false, NULL, NULL, NULL);
+  }
+
+  CStr content = {0};
+  err = internal_cbuild_db_read_file(depfile_path, depfile_path_len,
+                                     depfile_state.size, &content);
+  c_defer_err(err.code == 0, c_str_destroy, &content, NULL);
+
+  CStr          prerequisite = {0};
+  c_str_error_t str_err
+      = c_str_create_empty(c_fs_path_get_max_len(), &prerequisite);
+  c_defer_err(str_err.code == 0, c_str_destroy, &prerequisite,
+              err = CERROR_internal_error(str_err.desc));
+
+  // <target>: <prerequisite> <prerequisite> ...
+  char* cursor = content.data;
+  while (*cursor
+         && !(cursor[0] == ':'
+              && (isspace((unsigned char)cursor[1]) || !cursor[1]))) {
+    cursor++;
+  }
+  if (*cursor) { cursor++; }
+
+  while (*cursor) {
+    // skip separators and line continuations, an end of line ends the rule
+    if (cursor[0] == '\\' && (cursor[1] == '\n' || cursor[1] == '\r')) {
+      cursor++;
+      if (*cursor == '\r') { cursor++; }
+      if (*cursor == '\n') { cursor++; }
+      continue;
+    } else if (*cursor == '\n') {
+      break;
+    } else if (isspace((unsigned char)*cursor)) {
+      cursor++;
+      continue;
+    }
+
+    prerequisite.len = 0;
+    while (*cursor && !isspace((unsigned char)*cursor)) {
+      char ch = *cursor;
+      if (ch == '\\' && (cursor[1] == ' ' || cursor[1] == '#')) {
+        ch = cursor[1];
+        cursor += 2;
+      } else if (ch == '\\' && (cursor[1] == '\n' || cursor[1] == '\r')) {
+        break;
+      } else if (ch == '$' && cursor[1] == '$') {
+        cursor += 2;
+      } else {
+        cursor++;
+      }
+
+      if (prerequisite.len + 1 < prerequisite.capacity) {
+        prerequisite.data[prerequisite.len++] = ch;
+      }
+    }
+    prerequisite.data[prerequisite.len] = '\0';
+
+    bool     exists = false;
+    CHash128 hash   = {0};
+    err = cbuild_db_file_hash(self, prerequisite.data, prerequisite.len,
+                              &exists, &hash);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    // the path is part of the fingerprint as well, so a header that moved
+    // or went missing invalidates the action
+    *inout_hash = c_hash128_combine(
+        *inout_hash, c_hash128(prerequisite.data, prerequisite.len, exists));
+    if (exists) { *inout_hash = c_hash128_combine(*inout_hash, hash); }
+  }
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_db_scan(CBuildDb* self, bool is_fresh)
+{
+  assert(self);
+
+  CError           err       = CERROR_none;
+  char const**     paths     = NULL;
+  size_t*          owners    = NULL; // paths[i] is records[owners[i]]
+  CBuildFileState* states    = NULL;
+  size_t           paths_len = 0;
+
+  c_defer_init(4);
+
+  paths  = calloc(self->records.len + 1, sizeof(char const*));
+  owners = calloc(self->records.len + 1, sizeof(size_t));
+  states = calloc(self->records.len + 1, sizeof(CBuildFileState));
+  c_defer_err(paths, free, paths, err = CERROR_memory_allocation);
+  c_defer_err(owners, free, owners, err = CERROR_memory_allocation);
+  c_defer_err(states, free, states, err = CERROR_memory_allocation);
+
+  CBuildDbRecord* records = self->records.data;
+  for (size_t iii = 0; iii < self->records.len; ++iii) {
+    CBuildDbRecord* record = &records[iii];
+    // directories are asked by the globs reading them
+    if (record->kind == CBUILD_DB_KIND_stamp
+        || record->kind == CBUILD_DB_KIND_dir) {
+      continue;
+    }
+    if (is_fresh) { record->is_scanned = false; }
+    if (record->is_scanned) { continue; }
+
+    // an object is both an action output and a file the link hashes
+    if (record->kind == CBUILD_DB_KIND_action
+        && cbuild_db_find(self, CBUILD_DB_KIND_file, record->key.data,
+                          record->key.len)) {
+      continue;
+    }
+
+    paths[paths_len]  = record->key.data;
+    owners[paths_len] = iii;
+    paths_len++;
+  }
+
+  err = cbuild_stat_many(paths, paths_len, states, CBUILD_STAT_IMPL_auto);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  for (size_t iii = 0; iii < paths_len; ++iii) {
+    records[owners[iii]].is_scanned = true;
+    records[owners[iii]].scanned    = states[iii];
+  }
+  for (size_t iii = 0; iii < self->records.len; ++iii) {
+    CBuildDbRecord* record = &records[iii];
+    if (record->kind != CBUILD_DB_KIND_action || record->is_scanned) {
+      continue;
+    }
+
+    CBuildDbRecord const* file_record = cbuild_db_find(
+        self, CBUILD_DB_KIND_file, record->key.data, record->key.len);
+    if (file_record && file_record->is_scanned) {
+      record->is_scanned = true;
+      record->scanned    = file_record->scanned;
+    }
+  }
+
+  c_defer_deinit();
+
+  return err;
+}
+
+void
+cbuild_db_forget_state(CBuildDb* self, char const path[], size_t path_len)
+{
+  assert(self);
+  assert(path && path_len > 0);
+
+  CBuildDbKind const kinds[] = {CBUILD_DB_KIND_file, CBUILD_DB_KIND_action};
+  for (size_t iii = 0; iii < sizeof(kinds) / sizeof(*kinds); ++iii) {
+    CBuildDbRecord* record = cbuild_db_find(self, kinds[iii], path, path_len);
+    if (record) { record->is_scanned = false; }
+  }
+}
+
+void
+cbuild_db_forget_states_of(CBuildDb* self, char const path[], size_t path_len)
+{
+  assert(self);
+  assert(path && path_len > 0);
+
+  char const separator = c_fs_path_get_separator();
+  for (size_t iii = 0; iii < self->records.len; ++iii) {
+    CBuildDbRecord* record = &((CBuildDbRecord*)self->records.data)[iii];
+    if (record->kind == CBUILD_DB_KIND_stamp
+        || record->kind == CBUILD_DB_KIND_dir || record->key.len > path_len
+        || memcmp(&path[path_len - record->key.len], record->key.data,
+                  record->key.len)
+               != 0) {
+      continue;
+    }
+
+    // <path> = [<directory>/]<key>
+    char const before = record->key.len == path_len
+                            ? separator
+                            : path[path_len - record->key.len - 1];
+    if (before == '/' || before == separator) { record->is_scanned = false; }
+  }
+}
+
+CHash128
+cbuild_db_stamp(CBuildDb* self, uint64_t seed)
+{
+  assert(self);
+
+  // whatever fails to scan in a batch is asked one by one below
+  (void)cbuild_db_scan(self, false);
+
+  CHash128 stamp = c_hash128(NULL, 0, seed);
+
+  for (size_t iii = 0; iii < self->records.len; ++iii) {
+    CBuildDbRecord const* record
+        = &((CBuildDbRecord*)self->records.data)[iii];
+    if (record->kind == CBUILD_DB_KIND_stamp) { continue; }
+
+    // a glob lists its changed directories before, a new file is a new
+    // source
+    if (record->kind == CBUILD_DB_KIND_dir) {
+      stamp = c_hash128_combine(
+          stamp, c_hash128(record->key.data, record->key.len,
+                           (uint64_t)(unsigned char)record->kind));
+      stamp = c_hash128_combine(
+          stamp, c_hash128(record->value.data, record->value.len, 0));
+      continue;
+    }
+
+    // a missing file keeps a zeroed state
+    CBuildFileState state;
+    if (record->is_scanned) {
+      state = record->scanned;
+    } else {
+      cbuild_stat(record->key.data, &state);
+    }
+    uint64_t const state_data[] = {state.inode, (uint64_t)state.mtime,
+                                   state.size};
+
+    stamp = c_hash128_combine(
+        stamp, c_hash128(record->key.data, record->key.len,
+                         (uint64_t)(unsigned char)record->kind));
+    stamp = c_hash128_combine(
+        stamp, c_hash128(state_data, sizeof(state_data), 0));
+    if (record->kind == CBUILD_DB_KIND_action) {
+      stamp = c_hash128_combine(stamp, record->hash);
+    }
+  }
+
+  return stamp;
+}
+
+CError
+cbuild_db_outputs_stamp(CBuildDb* self, uint64_t seed, CHash128* out_stamp)
+{
+  assert(self);
+  assert(out_stamp);
+
+  CError           err       = CERROR_none;
+  char const**     paths     = NULL;
+  size_t*          owners    = NULL; // paths[i] is records[owners[i]]
+  CBuildFileState* states    = NULL;
+  size_t           paths_len = 0;
+
+  c_defer_init(4);
+
+  paths  = calloc(self->records.len + 1, sizeof(char const*));
+  owners = calloc(self->records.len + 1, sizeof(size_t));
+  states = calloc(self->records.len + 1, sizeof(CBuildFileState));
+  c_defer_err(paths, free, paths, err = CERROR_memory_allocation);
+  c_defer_err(owners, free, owners, err = CERROR_memory_allocation);
+  c_defer_err(states, free, states, err = CERROR_memory_allocation);
+
+  CBuildDbRecord const* records = self->records.data;
+  for (size_t iii = 0; iii < self->records.len; ++iii) {
+    if (records[iii].kind != CBUILD_DB_KIND_action) { continue; }
+
+    paths[paths_len]  = records[iii].key.data;
+    owners[paths_len] = iii;
+    paths_len++;
+  }
+
+  err = cbuild_stat_many(paths, paths_len, states, CBUILD_STAT_IMPL_auto);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // a missing output keeps a zeroed state
+  *out_stamp = c_hash128(NULL, 0, seed);
+  for (size_t iii = 0; iii < paths_len; ++iii) {
+    CBuildDbRecord const* record       = &records[owners[iii]];
+    uint64_t const        state_data[] = {states[iii].inode,
+                                          (uint64_t)states[iii].mtime,
+                                          states[iii].size};
+
+    *out_stamp = c_hash128_combine(
+        *out_stamp, c_hash128(record->key.data, record->key.len, 0));
+    *out_stamp = c_hash128_combine(
+        *out_stamp, c_hash128(state_data, sizeof(state_data), 0));
+    *out_stamp = c_hash128_combine(*out_stamp, record->hash);
+  }
+
+  c_defer_deinit();
+
+  return err;
+}
+
+void
+cbuild_db_lock(CBuildDb* self)
+{
+  assert(self);
+
+  cbuild_mutex_lock(&self->lock);
+}
+
+void
+cbuild_db_unlock(CBuildDb* self)
+{
+  assert(self);
+
+  cbuild_mutex_unlock(&self->lock);
+}
+
+void
+cbuild_db_destroy(CBuildDb* self)
+{
+  assert(self);
+
+  cbuild_mutex_destroy(&self->lock);
+
+  for (size_t iii = 0; iii < self->records.len; ++iii) {
+    CBuildDbRecord* record = &((CBuildDbRecord*)self->records.data)[iii];
+    c_str_destroy(&record->key);
+    if (record->value.data) { c_str_destroy(&record->value); }
+  }
+  c_array_destroy(&self->records);
+  c_hash_index_destroy(&self->index);
+  c_str_destroy(&self->path);
+
+  *self = (CBuildDb){0};
+}
+
+// ------------------------------------------------------------------------//
+// ------------------------------ Internals -------------------------------//
+// ------------------------------------------------------------------------//
+
+uint64_t
+internal_cbuild_db_key_hash(char kind, char const key[], size_t key_len)
+{
+  return c_hash128(key, key_len, (uint64_t)(unsigned char)kind).low;
+}
+
+CError
+internal_cbuild_db_read_file(char const path[],
+                             size_t     path_len,
+                             uint64_t   file_size,
+                             CStr*      out_content)
+{
+  c_str_error_t str_err
+      = c_str_create_empty((size_t)file_size + 2, out_content);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  CFile        file   = {0};
+  c_fs_error_t fs_err = c_fs_file_open(path, path_len, "r", &file);
+  if (fs_err.code != 0) { return CERROR_internal_error(fs_err.desc); }
+
+  fs_err = c_fs_file_read(&file, out_content->data, (size_t)file_size + 1,
+                          &out_content->len);
+  c_fs_file_close(&file);
+  if (fs_err.code != 0) { return CERROR_internal_error(fs_err.desc); }
+
+  out_content->data[out_content->len] = '\0';
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_db_parse(CBuildDb* self, CStr* content)
+{
+  CError err  = CERROR_none;
+  char*  line = content->data + sizeof(db_header) - 1;
+
+  while (*line) {
+    char* line_end = strchr(line, '\n');
+    if (!line_end) { break; }
+    *line_end = '\0';
+
+    // <kind> <hash> <inode> <mtime> <size> <key>[\t<value>]
+    CBuildDbRecord record = {.kind = line[0]};
+    char*          cursor = line + 1;
+    char           high[17] = {0};
+    if (strlen(cursor) > 33) {
+      memcpy(high, cursor + 1, 16);
+      record.hash.high = strtoull(high, NULL, 16);
+      record.hash.low  = strtoull(cursor + 17, &cursor, 16);
+      record.inode     = strtoull(cursor, &cursor, 10);
+      record.mtime     = strtoll(cursor, &cursor, 10);
+      record.size      = strtoull(cursor, &cursor, 10);
+
+      // a directory keeps its listing after the key, the tabs inside both
+      // are escaped
+      char* key_end = line_end;
+      if (record.kind == CBUILD_DB_KIND_dir
+          && (key_end = strchr(cursor, '\t')) != NULL) {
+        *key_end              = '\0';
+        c_str_error_t str_err = c_str_create(
+            key_end + 1,
+            internal_cbuild_db_unescape(key_end + 1,
+                                        (size_t)(line_end - key_end - 1)),
+            &record.value);
+        if (str_err.code != 0) {
+          err = CERROR_internal_error(str_err.desc);
+          break;
+        }
+      } else {
+        key_end = line_end;
+      }
+
+      if (*cursor == ' ' && cursor + 1 < key_end) {
+        cursor++;
+        size_t const key_len
+            = internal_cbuild_db_unescape(cursor, (size_t)(key_end - cursor));
+        err = cbuild_db_put(self, (CBuildDbKind)record.kind, cursor, key_len,
+                            &record);
+      }
+      if (record.value.data) { c_str_destroy(&record.value); }
+      if (err.code != 0) { break; }
+    }
+
+    line = line_end + 1;
+  }
+
+  self->is_dirty = false;
+
+  return err;
+}
+
+CError
+internal_cbuild_db_append_escaped(CStr*      content,
+                                  char const field[],
+                                  size_t     field_len)
+{
+  // paths may hold the separators of the lines, \\ \t \n stand for them
+  for (size_t iii = 0; iii < field_len;) {
+    size_t plain = iii;
+    while (plain < field_len && field[plain] != '\\' && field[plain] != '\t'
+           && field[plain] != '\n') {
+      plain++;
+    }
+    c_str_error_t str_err
+        = c_str_append_with_cstr(content, &field[iii], plain - iii);
+    if (str_err.code == 0 && plain < field_len) {
+      char const ch        = field[plain++];
+      char const escaped[] = {'\\', ch == '\t' ? 't' : ch == '\n' ? 'n' : ch};
+      str_err = c_str_append_with_cstr(content, escaped, sizeof(escaped));
+    }
+    if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+    iii = plain;
+  }
+
+  return CERROR_none;
+}
+
+size_t
+internal_cbuild_db_unescape(char field[], size_t field_len)
+{
+  size_t len = 0;
+  for (size_t iii = 0; iii < field_len; ++iii) {
+    char ch = field[iii];
+    if (ch == '\\' && iii + 1 < field_len) {
+      ch = field[++iii];
+      ch = ch == 't' ? '\t' : ch == 'n' ? '\n' : ch;
+    }
+    field[len++] = ch;
+  }
+  field[len] = '\0';
+
+  return len;
+}
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
@@ -0,0 +1,122 @@
+#ifndef CBUILD_DB_PRIVATE_H
+#define CBUILD_DB_PRIVATE_H
+
+#include "cbuild_private.h"
+#include "cbuild_stat_private.h"
+#include "cbuild_thread_private.h"
+#include "cerror.h"
+
+#include <chash.h>
+
+#include <array.h>
+#include <str.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum CBuildDbKind {
+  CBUILD_DB_KIND_file   = 'F', // path -> state and content hash
+  CBUILD_DB_KIND_action = 'A', // action output -> fingerprint
+  CBUILD_DB_KIND_stamp  = 'S', // project -> state of the last build
+  CBUILD_DB_KIND_dir    = 'D', // directory -> state and listing
+} CBuildDbKind;
+
+typedef struct CBuildDbRecord {
+  char     kind; // CBuildDbKind
+  CStr     key;
+  CHash128 hash;
+  uint64_t inode;
+  int64_t  mtime; // nanoseconds
+  uint64_t size;
+  CStr     value; // directories only, `<name>\t<directory name>/\t...`
+
+  // not saved, the state of the file during this build
+  bool            is_scanned;
+  CBuildFileState scanned;
+} CBuildDbRecord;
+
+/// the build database, it lives inside the builder path and remembers
+/// files content hashes and the fingerprints of the last successful
+/// actions between runs.
+/// it is not thread safe by itself, concurrent actions have to hold
+/// `cbuild_db_lock` while using it
+struct CBuildDb {
+  CStr        path;
+  CArray      records; // CArray< CBuildDbRecord >
+  CHashIndex  index;   // hash(kind, key) -> index inside `records`
+  bool        is_dirty;
+  CBuildMutex lock;
+};
+
+CError cbuild_db_create(CBuildDb* out_db);
+
+/// load `path` if it exists, the database will be saved to `path`
+CError cbuild_db_load(CBuildDb* self, char const path[], size_t path_len);
+
+CError cbuild_db_save(CBuildDb* self);
+
+/// the returned record is invalidated by the next `cbuild_db_put`
+CBuildDbRecord* cbuild_db_find(CBuildDb*    self,
+                               CBuildDbKind kind,
+                               char const   key[],
+                               size_t       key_len);
+
+CError cbuild_db_put(CBuildDb*       self,
+                     CBuildDbKind    kind,
+                     char const      key[],
+                     size_t          key_len,
+                     CBuildDbRecord* record);
+
+/// content hash of a file, memoised per (inode, mtime, size)
+CError cbuild_db_file_hash(CBuildDb*  self,
+                           char const path[],
+                           size_t     path_len,
+                           bool*      out_exists,
+                           CHash128*  out_hash);
+
+/// combine the content hashes of all prerequisites listed in a make
+/// style depfile, nothing is combined if the depfile does not exist
+CError cbuild_db_depfile_hash(CBuildDb*  self,
+                              char const depfile_path[],
+                              size_t     depfile_path_len,
+                              bool*      out_exists,
+                              CHash128*  inout_hash);
+
+/// take the state of every file and action output known to the database
+/// in one batch, a path is asked once even if it is known as both.
+/// `cbuild_db_file_hash` and `cbuild_db_stamp` use these states instead of
+/// asking again, an action output forgets its state when the action is
+/// recorded. `is_fresh` forgets all of them first, a build starts with it
+CError cbuild_db_scan(CBuildDb* self, bool is_fresh);
+
+/// `path` was written during this build, its scanned state is stale
+void cbuild_db_forget_state(CBuildDb* self, char const path[], size_t path_len);
+
+/// same for every key naming the absolute `path`, relative ones included.
+/// a file written during this build may be known by another spelling,
+/// like the include path a depfile lists
+void cbuild_db_forget_states_of(CBuildDb*  self,
+                                char const path[],
+                                size_t     path_len);
+
+/// combine the current state (inode, mtime, size) of every file and
+/// action output known to the database, and the listing of every
+/// directory, stamps are excluded.
+/// it never reads a file content, so it is cheap enough to decide if a
+/// whole project has to be walked at all. missing states are scanned
+CHash128 cbuild_db_stamp(CBuildDb* self, uint64_t seed);
+
+/// combine the current state of every action output known to the
+/// database, and the fingerprint it was written with. only the outputs are
+/// asked, the files a watcher of the sources can't see change
+CError cbuild_db_outputs_stamp(CBuildDb* self,
+                               uint64_t  seed,
+                               CHash128* out_stamp);
+
+void cbuild_db_lock(CBuildDb* self);
+
+void cbuild_db_unlock(CBuildDb* self);
+
+void cbuild_db_destroy(CBuildDb* self);
+
+#endif // CBUILD_DB_PRIVATE_H
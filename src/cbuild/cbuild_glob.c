@@ -0,0 +1,434 @@
+#include "cbuild_glob_private.h"
+#include "cbuild_private.h"
+#include "cbuild_stat_private.h"
+#include "helpers.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <defer.h>
+#include <fs.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+typedef struct CBuildGlob {
+  CBuildDb* db;
+  CArray    segments; // CArray< char* >, the components after the root
+  CStr      path;     // directory being walked
+  CArray*   paths;    // CArray< CStr >, the matches
+} CBuildGlob;
+
+static CError internal_cbuild_glob_walk(CBuildGlob* self, size_t segment);
+static CError internal_cbuild_glob_list(CBuildGlob* self, CStr* out_listing);
+static bool   internal_cbuild_glob_read_dir(char const path[],
+                                            CStr*      out_listing);
+static CError internal_cbuild_glob_prefetch(CBuildDb* db, CStr const* root);
+static bool   internal_cbuild_glob_is_separator(char ch);
+static int    internal_cbuild_glob_compare(void const* lhs, void const* rhs);
+
+bool
+cbuild_glob_match(char const pattern[], char const name[])
+{
+  assert(pattern && name);
+
+  if (name[0] == '.' && pattern[0] != '.') { return false; }
+
+  // the last `*` seen and where the name was then, to backtrack to
+  char const* star      = NULL;
+  char const* star_name = NULL;
+  while (*name) {
+    if (*pattern == '*') {
+      star      = ++pattern;
+      star_name = name;
+    } else if (*pattern == '?' || *pattern == *name) {
+      pattern++;
+      name++;
+    } else if (star) {
+      pattern = star;
+      name    = ++star_name;
+    } else {
+      return false;
+    }
+  }
+  while (*pattern == '*') {
+    pattern++;
+  }
+
+  return *pattern == '\0';
+}
+
+CError
+cbuild_glob(CBuildDb*  db,
+            char const base_path[],
+            size_t     base_path_len,
+            char const pattern[],
+            size_t     pattern_len,
+            CArray*    out_paths)
+{
+  assert(db);
+  assert(base_path && base_path_len > 0);
+  assert(pattern && pattern_len > 0);
+  assert(out_paths);
+
+  CError     err  = CERROR_none;
+  CStr       rest = {0}; // the components after the root, split in place
+  CBuildGlob glob = {.db = db, .paths = out_paths};
+  char const sep  = c_fs_path_get_separator();
+
+  c_array_error_t arr_err = c_array_create(sizeof(CStr), out_paths);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+
+  c_defer_init(4);
+
+  // <root>/<rest>, the root is the directory before the first wildcard
+  size_t wildcard = 0;
+  while (wildcard < pattern_len && pattern[wildcard] != '*'
+         && pattern[wildcard] != '?') {
+    wildcard++;
+  }
+  size_t root_len = wildcard;
+  while (root_len > 0
+         && !internal_cbuild_glob_is_separator(pattern[root_len - 1])) {
+    root_len--;
+  }
+
+  c_str_error_t str_err
+      = c_str_create_empty(c_fs_path_get_max_len(), &glob.path);
+  c_defer_err(str_err.code == 0, c_str_destroy, &glob.path,
+              err = CERROR_internal_error(str_err.desc));
+  bool is_absolute = false;
+  c_fs_path_is_absolute(pattern, pattern_len, &is_absolute);
+  if (is_absolute) {
+    str_err = c_str_format(&glob.path, 0, C_STR_INV("%.*s"),
+                           (int)(root_len > 1 ? root_len - 1 : root_len),
+                           pattern);
+  } else if (root_len > 0) {
+    str_err = c_str_format(&glob.path, 0, C_STR_INV("%.*s%c%.*s"),
+                           (int)base_path_len, base_path, sep,
+                           (int)root_len - 1, pattern);
+  } else {
+    str_err = c_str_format(&glob.path, 0, C_STR_INV("%.*s"),
+                           (int)base_path_len, base_path);
+  }
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+
+  str_err = c_str_create(&pattern[root_len], pattern_len - root_len, &rest);
+  c_defer_err(str_err.code == 0, c_str_destroy, &rest,
+              err = CERROR_internal_error(str_err.desc));
+  arr_err = c_array_create(sizeof(char*), &glob.segments);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &glob.segments,
+              err = CERROR_internal_error(arr_err.desc));
+  for (char* cursor = rest.data; *cursor;) {
+    char* segment = cursor;
+    while (*cursor && !internal_cbuild_glob_is_separator(*cursor)) {
+      cursor++;
+    }
+    if (*cursor) { *cursor++ = '\0'; }
+    if (*segment == '\0') { continue; }
+
+    arr_err = c_array_push(&glob.segments, &segment);
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+
+  if (glob.segments.len > 0) {
+    err = internal_cbuild_glob_prefetch(db, &glob.path);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    err = internal_cbuild_glob_walk(&glob, 0);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  // `**/**` walks a directory twice, the duplicates end up next to each
+  // other and the kept paths are moved down in one pass
+  qsort(out_paths->data, out_paths->len, sizeof(CStr),
+        internal_cbuild_glob_compare);
+  CStr*  paths    = out_paths->data;
+  size_t kept_len = out_paths->len > 0 ? 1 : 0;
+  for (size_t iii = 1; iii < out_paths->len; ++iii) {
+    if (strcmp(paths[kept_len - 1].data, paths[iii].data) == 0) {
+      c_str_destroy(&paths[iii]);
+    } else {
+      paths[kept_len++] = paths[iii];
+    }
+  }
+  out_paths->len = kept_len;
+
+  c_defer_deinit();
+
+  if (err.code != 0) {
+    for (size_t iii = 0; iii < out_paths->len; ++iii) {
+      c_str_destroy(&((CStr*)out_paths->data)[iii]);
+    }
+    c_array_destroy(out_paths);
+  }
+
+  return err;
+}
+
+CError
+internal_cbuild_glob_walk(CBuildGlob* self, size_t segment)
+{
+  char const* const pattern = ((char**)self->segments.data)[segment];
+  bool const        is_deep = strcmp(pattern, "**") == 0;
+  bool const        is_last = segment + 1 == self->segments.len;
+  size_t const      dir_len = self->path.len;
+
+  // `**` matches no directory as well
+  if (is_deep && !is_last) {
+    CError err = internal_cbuild_glob_walk(self, segment + 1);
+    if (err.code != 0) { return err; }
+  }
+
+  CStr   listing;
+  CError err = internal_cbuild_glob_list(self, &listing);
+  if (err.code != 0) { return err; }
+
+  // <name>\t<directory name>/\t...
+  for (char* name = listing.data; err.code == 0 && *name;) {
+    char*  end      = strchr(name, '\t');
+    size_t name_len = end ? (size_t)(end - name) : strlen(name);
+    char*  next     = end ? end + 1 : name + name_len;
+
+    bool const is_dir = name_len > 0 && name[name_len - 1] == '/';
+    name[name_len - is_dir] = '\0';
+
+    // wildcards don't walk into the outputs of builds
+    bool is_match = false;
+    if (is_dir && (is_deep || !is_last)) {
+      is_match = cbuild_glob_match(is_deep ? "*" : pattern, name)
+                 && (strcmp(pattern, name) == 0
+                     || !cbuild_is_output_dir(name, name_len - 1));
+    } else if (!is_dir && is_last) {
+      is_match = cbuild_glob_match(is_deep ? "*" : pattern, name);
+    }
+
+    if (is_match) {
+      c_str_error_t str_err
+          = c_str_format(&self->path, dir_len, C_STR_INV("%c%s"),
+                         c_fs_path_get_separator(), name);
+      if (str_err.code != 0) {
+        err = CERROR_internal_error(str_err.desc);
+      } else if (is_dir) {
+        err = internal_cbuild_glob_walk(self, is_deep ? segment : segment + 1);
+      } else {
+        CStr match = {0};
+        str_err    = c_str_clone(&self->path, &match);
+        c_array_error_t arr_err = {0};
+        if (str_err.code == 0) { arr_err = c_array_push(self->paths, &match); }
+        if (str_err.code != 0) {
+          err = CERROR_internal_error(str_err.desc);
+        } else if (arr_err.code != 0) {
+          c_str_destroy(&match);
+          err = CERROR_internal_error(arr_err.desc);
+        }
+      }
+
+      self->path.len           = dir_len;
+      self->path.data[dir_len] = '\0';
+    }
+
+    name = next;
+  }
+
+  c_str_destroy(&listing);
+
+  return err;
+}
+
+CError
+internal_cbuild_glob_list(CBuildGlob* self, CStr* out_listing)
+{
+  CBuildDbRecord* record = cbuild_db_find(
+      self->db, CBUILD_DB_KIND_dir, self->path.data, self->path.len);
+  CBuildFileState state;
+  if (record && record->is_scanned) {
+    state = record->scanned;
+  } else {
+    cbuild_stat(self->path.data, &state);
+  }
+
+  // `record` is gone once the walk puts another directory, keep a copy
+  if (record && record->value.data && state.exists
+      && record->inode == state.inode && record->mtime == state.mtime
+      && record->size == state.size) {
+    c_str_error_t str_err = c_str_clone(&record->value, out_listing);
+    if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+    return CERROR_none;
+  }
+
+  c_str_error_t str_err = c_str_create(C_STR(""), out_listing);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  // not a directory or gone, nothing to remember
+  if (!state.exists
+      || !internal_cbuild_glob_read_dir(self->path.data, out_listing)) {
+    out_listing->len     = 0;
+    out_listing->data[0] = '\0';
+    return CERROR_none;
+  }
+
+  // the state from before the read, a change while reading lists it again
+  CBuildDbRecord new_record = {
+      .inode      = state.inode,
+      .mtime      = state.mtime,
+      .size       = state.size,
+      .value      = *out_listing,
+      .is_scanned = true,
+      .scanned    = state,
+  };
+  CError err = cbuild_db_put(self->db, CBUILD_DB_KIND_dir, self->path.data,
+                             self->path.len, &new_record);
+  if (err.code != 0) { c_str_destroy(out_listing); }
+
+  return err;
+}
+
+bool
+internal_cbuild_glob_read_dir(char const path[], CStr* out_listing)
+{
+  // names holding the separators of the listing can't be sources anyway
+#ifdef _WIN32
+  char pattern[MAX_PATH];
+  if (snprintf(pattern, sizeof(pattern), "%s\\*", path)
+      >= (int)sizeof(pattern)) {
+    return false;
+  }
+
+  WIN32_FIND_DATAA entry;
+  HANDLE           find = FindFirstFileA(pattern, &entry);
+  if (find == INVALID_HANDLE_VALUE) { return false; }
+
+  bool is_ok = true;
+  do {
+    char const* name = entry.cFileName;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0
+        || strpbrk(name, "\t\n")) {
+      continue;
+    }
+
+    // junctions are not followed, they could loop
+    DWORD const attributes = entry.dwFileAttributes;
+    if ((attributes & FILE_ATTRIBUTE_DIRECTORY)
+        && (attributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+      continue;
+    }
+    bool const is_dir = attributes & FILE_ATTRIBUTE_DIRECTORY;
+
+    c_str_error_t str_err
+        = c_str_format(out_listing, out_listing->len, C_STR_INV("%s%s\t"),
+                       name, is_dir ? "/" : "");
+    is_ok = str_err.code == 0;
+  } while (is_ok && FindNextFileA(find, &entry));
+
+  FindClose(find);
+
+  return is_ok;
+#else
+  DIR* dir = opendir(path);
+  if (!dir) { return false; }
+
+  bool is_ok = true;
+  for (struct dirent* entry = readdir(dir); is_ok && entry;
+       entry = readdir(dir)) {
+    char const* name = entry->d_name;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0
+        || strpbrk(name, "\t\n")) {
+      continue;
+    }
+
+    // symbolic links to directories are not followed, they could loop
+    bool        is_dir = entry->d_type == DT_DIR;
+    struct stat info;
+    if (entry->d_type == DT_UNKNOWN
+        && fstatat(dirfd(dir), name, &info, AT_SYMLINK_NOFOLLOW) == 0) {
+      is_dir = S_ISDIR(info.st_mode);
+    } else if (entry->d_type == DT_LNK
+               && fstatat(dirfd(dir), name, &info, 0) == 0
+               && S_ISDIR(info.st_mode)) {
+      continue;
+    }
+
+    c_str_error_t str_err
+        = c_str_format(out_listing, out_listing->len, C_STR_INV("%s%s\t"),
+                       name, is_dir ? "/" : "");
+    is_ok = str_err.code == 0;
+  }
+
+  closedir(dir);
+
+  return is_ok;
+#endif
+}
+
+CError
+internal_cbuild_glob_prefetch(CBuildDb* db, CStr const* root)
+{
+  CError           err       = CERROR_none;
+  char const**     paths     = NULL;
+  size_t*          owners    = NULL; // paths[i] is records[owners[i]]
+  CBuildFileState* states    = NULL;
+  size_t           paths_len = 0;
+  char const       sep       = c_fs_path_get_separator();
+
+  c_defer_init(3);
+
+  paths  = calloc(db->records.len + 1, sizeof(char const*));
+  owners = calloc(db->records.len + 1, sizeof(size_t));
+  states = calloc(db->records.len + 1, sizeof(CBuildFileState));
+  c_defer_err(paths, free, paths, err = CERROR_memory_allocation);
+  c_defer_err(owners, free, owners, err = CERROR_memory_allocation);
+  c_defer_err(states, free, states, err = CERROR_memory_allocation);
+
+  // <root>
+  // <root>/...
+  CBuildDbRecord* records = db->records.data;
+  for (size_t iii = 0; iii < db->records.len; ++iii) {
+    CBuildDbRecord* record = &records[iii];
+    record->is_scanned &= record->kind != CBUILD_DB_KIND_dir;
+    if (record->kind != CBUILD_DB_KIND_dir || record->key.len < root->len
+        || memcmp(record->key.data, root->data, root->len) != 0
+        || (record->key.len > root->len
+            && record->key.data[root->len] != '/'
+            && record->key.data[root->len] != sep)) {
+      continue;
+    }
+
+    paths[paths_len]  = record->key.data;
+    owners[paths_len] = iii;
+    paths_len++;
+  }
+
+  err = cbuild_stat_many(paths, paths_len, states, CBUILD_STAT_IMPL_auto);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  for (size_t iii = 0; iii < paths_len; ++iii) {
+    records[owners[iii]].is_scanned = true;
+    records[owners[iii]].scanned    = states[iii];
+  }
+
+  c_defer_deinit();
+
+  return err;
+}
+
+bool
+internal_cbuild_glob_is_separator(char ch)
+{
+  return ch == '/' || ch == c_fs_path_get_separator();
+}
+
+int
+internal_cbuild_glob_compare(void const* lhs, void const* rhs)
+{
+  return strcmp(((CStr const*)lhs)->data, ((CStr const*)rhs)->data);
+}
@@ -0,0 +1,34 @@
+#ifndef CBUILD_GLOB_PRIVATE_H
+#define CBUILD_GLOB_PRIVATE_H
+
+/// source globs, `src/**/*.c`. the listing of every directory walked is
+/// kept in the build database with its state, a directory that didn't
+/// change since is not read again
+
+#include "cbuild.h"
+#include "cbuild_db_private.h"
+#include "cerror.h"
+
+#include <array.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// whether the path component `name` matches the pattern component
+/// `pattern`, `*` matches any run of characters and `?` any single one.
+/// a hidden name is only matched by a pattern starting with `.`
+__C_DLL__ bool cbuild_glob_match(char const pattern[], char const name[]);
+
+/// `out_paths` (CArray< CStr >) = the files matching `pattern` under
+/// `base_path` (an absolute pattern ignores it), sorted. `**` matches any
+/// number of directories, hidden ones and build outputs excepted. the
+/// known directories below the first wildcard are asked for their state in
+/// one batch, only the changed ones are listed again
+__C_DLL__ CError cbuild_glob(CBuildDb*  db,
+                             char const base_path[],
+                             size_t     base_path_len,
+                             char const pattern[],
+                             size_t     pattern_len,
+                             CArray*    out_paths);
+
+#endif // CBUILD_GLOB_PRIVATE_H
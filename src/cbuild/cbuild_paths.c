@@ -0,0 +1,87 @@
+#include "cbuild_paths_private.h"
+
+#include <assert.h>
+#include <string.h>
+
+/// big enough for a few hundred paths, a longer path gets its own block
+#define CBUILD_PATHS_BLOCK_SIZE (64 * 1024)
+
+CError
+cbuild_paths_create(CBuildPaths* out_paths)
+{
+  assert(out_paths);
+
+  *out_paths = (CBuildPaths){0};
+
+  CError err = cbuild_arena_create(CBUILD_PATHS_BLOCK_SIZE, &out_paths->arena);
+  if (err.code != 0) { return err; }
+
+  c_array_error_t arr_err = c_array_create(sizeof(CStr), &out_paths->paths);
+  if (arr_err.code != 0) {
+    cbuild_arena_destroy(&out_paths->arena);
+    return CERROR_internal_error(arr_err.desc);
+  }
+
+  err = c_hash_index_create(0, &out_paths->index);
+  if (err.code != 0) {
+    c_array_destroy(&out_paths->paths);
+    cbuild_arena_destroy(&out_paths->arena);
+  }
+
+  return err;
+}
+
+CError
+cbuild_paths_intern(CBuildPaths* self,
+                    char const   path[],
+                    size_t       path_len,
+                    CStr*        out_path)
+{
+  assert(self);
+  assert(path && path_len > 0);
+  assert(out_path);
+
+  uint64_t const hash   = c_hash128(path, path_len, 0).low;
+  size_t         cursor = 0;
+  size_t         index  = 0;
+  while (c_hash_index_next(&self->index, hash, &cursor, &index)) {
+    CStr const* interned = &((CStr*)self->paths.data)[index];
+    if (interned->len == path_len
+        && memcmp(interned->data, path, path_len) == 0) {
+      *out_path = *interned;
+      return CERROR_none;
+    }
+  }
+
+  char* data = cbuild_arena_alloc(&self->arena, path_len + 1, 1);
+  if (!data) { return CERROR_memory_allocation; }
+  memcpy(data, path, path_len);
+  data[path_len] = '\0';
+
+  // full, growing it would move the other paths
+  CStr const interned = {.data = data, .len = path_len, .capacity = path_len};
+  c_array_error_t arr_err = c_array_push(&self->paths, &interned);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+
+  CError err = c_hash_index_insert(&self->index, hash, self->paths.len - 1);
+  if (err.code != 0) {
+    c_array_remove(&self->paths, self->paths.len - 1);
+    return err;
+  }
+
+  *out_path = interned;
+
+  return CERROR_none;
+}
+
+void
+cbuild_paths_destroy(CBuildPaths* self)
+{
+  assert(self);
+
+  cbuild_arena_destroy(&self->arena);
+  c_array_destroy(&self->paths);
+  c_hash_index_destroy(&self->index);
+
+  *self = (CBuildPaths){0};
+}
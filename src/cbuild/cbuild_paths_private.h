@@ -0,0 +1,39 @@
+#ifndef CBUILD_PATHS_PRIVATE_H
+#define CBUILD_PATHS_PRIVATE_H
+
+/// interned paths, every distinct path or argument of a project is stored
+/// once inside a few large blocks instead of a buffer sized for the longest
+/// path
+
+#include "cbuild.h"
+#include "cbuild_arena_private.h"
+#include "cbuild_private.h"
+#include "cerror.h"
+
+#include <chash.h>
+
+#include <array.h>
+#include <str.h>
+
+#include <stddef.h>
+
+/// a path stays valid until the arena is destroyed, there is no way to
+/// release a single one. it is not thread safe
+struct CBuildPaths {
+  CBuildArena arena;
+  CArray      paths; // CArray< CStr >, views inside `arena`
+  CHashIndex  index; // hash(path) -> index inside `paths`
+};
+
+__C_DLL__ CError cbuild_paths_create(CBuildPaths* out_paths);
+
+/// `out_path` = a view of the stored copy of `path`, stored the first time
+/// only. it must not be changed nor destroyed, it is copied freely
+__C_DLL__ CError cbuild_paths_intern(CBuildPaths* self,
+                                     char const   path[],
+                                     size_t       path_len,
+                                     CStr*        out_path);
+
+__C_DLL__ void cbuild_paths_destroy(CBuildPaths* self);
+
+#endif // CBUILD_PATHS_PRIVATE_H
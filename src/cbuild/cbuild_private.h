@@ -3,44 +3,200 @@
 
 #include "cbuild.h"
 
+#include <chash.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct CBuildArena   CBuildArena;
+typedef struct CBuildDb      CBuildDb;
+typedef struct CBuildPaths   CBuildPaths;
+typedef struct CBuildScanner CBuildScanner;
+
+typedef enum CBuildPgo {
+  CBUILD_PGO_none,
+  CBUILD_PGO_generate, // instrumented, in `<config>_pgo_generate`
+  CBUILD_PGO_use,      // optimized, in `<config>_pgo_use`
+} CBuildPgo;
+
+typedef enum CBuildLinker {
+  CBUILD_LINKER_default, // whatever the compiler picks, mostly ld.bfd
+  CBUILD_LINKER_mold,
+  CBUILD_LINKER_lld,
+  CBUILD_LINKER_gold,
+  CBUILD_LINKER_auto, // the fastest one installed
+} CBuildLinker;
+
+/// how `debug` and `release_with_debug_info` builds emit debug info, the
+/// other types have none
+typedef enum CBuildDebugInfo {
+  CBUILD_DEBUG_INFO_split      = 1 << 0, // .dwo files next to the objects
+  CBUILD_DEBUG_INFO_compressed = 1 << 1, // zlib compressed sections
+} CBuildDebugInfo;
+
 struct CTargetImpl {
-  CTargetType ttype;
-  CStr        name;
-  CStr        cbuild_base_dir;
-  CStr        base_dir;
-  CStr        build_path;
-  CStr        install_path;
-  CStr        cflags;
-  CStr        lflags;
-  CStr        link_with;
-  CArray      sources;      // CArray< CStr >
-  CArray      dependencies; // CArray< CTargetImpl* >
+  CTargetType  ttype;
+  CStr         name;               // interned, like the paths below
+  CStr         cbuild_base_dir;
+  CStr         base_dir;
+  CStr         build_path;
+  CStr         install_path;
+  CArray       cflags;             // CArray< char const* >, interned
+  CArray       lflags;             // CArray< char const* >, interned
+  CArray       link_with;          // CArray< char const* >, interned
+  CArray       compile_args;       // CArray< char const* >, <compiler>
+                                   // <cflags> <build flags>, every build
+  CArray       link_args;          // CArray< char const* >, <creator>
+                                   // <lflags> <build flags>, every build
+  CStr         precompiled_header; // empty if none
+  CStr         pch_include;        // interned, what the sources include,
+                                   // empty without builder support
+  CStr         pch;                // interned, the precompiled header
+  bool         is_unity_set;       // the project setting is ignored
+  size_t       unity_batches;      // 0 if off
+  CArray       unity_excluded;     // CArray< CStr >
+  CHashIndex   unity_index;        // hash(path) -> index inside
+                                   // `unity_excluded`, every prepare
+  CTargetLto   lto;
+  bool         is_thin_archive;
+  bool         is_pic;             // its objects are shared with a library
+  CTargetImpl* objects_of;         // NULL if it compiles its own
+  CArray       share_excluded;     // CArray< CStr >, compiled per library
+  CHashIndex   share_index;        // hash(path) -> index inside
+                                   // `share_excluded`, every prepare
+  CArray       pgo_trainings;      // CArray< CStr >, arguments of each run
+  CArray       sources;            // CArray< CStr >, interned
+  CHashIndex   source_index;       // hash(path) -> index inside `sources`,
+                                   // every prepare
+  CArray       units;              // CArray< CStr >, interned, what a build
+                                   // compiles
+  CArray       objects;            // CArray< CStr >, interned, the object of
+                                   // each unit, every prepare
+  CArray       dependencies;       // CArray< CTargetImpl* >
+  bool         is_selected;        // part of the running build
 };
 
+/// a command generating files of the project, see `cbuild_custom_command`
+typedef struct CBuildCommand {
+  CArray argv;    // CArray< CStr >
+  CArray inputs;  // CArray< CStr >, absolute
+  CArray outputs; // CArray< CStr >, absolute
+} CBuildCommand;
+
 struct CBuildImpl {
   CBuildType btype;
+  CBuildPgo  pgo;
+  CStr       config; // name of the output roots, e.g. `release_pgo_use`
   CStr       base_path;
   struct {
     CStr compiler;
     CStr linker;
     CStr static_lib_creator;
+    CStr static_lib_creator_lto;
     CStr shared_lib_creator;
   } cmds;
-  CStr   cflags;
-  CStr   lflags;
-  CStr   link_with;
-  CArray targets;        // CArray< CTargetImpl* >
-  CArray other_projects; // CArray< CBuildImpl* >
+  CStr           cflags;
+  CStr           lflags;
+  CStr           link_with;
+  CArray         targets;        // CArray< CTargetImpl* >
+  CHashIndex     target_index;   // hash(name) -> index inside `targets`
+  CArray         commands;       // CArray< CBuildCommand >
+  CArray         other_projects; // CArray< CBuildImpl* >
+  CBuildDb*      db;
+  CBuildArena*   arena;         // the targets, released with the project
+  CBuildPaths*   paths;         // sources, units and flags of the targets
+  CBuildScanner* scanner;       // headers when there is no depfile
+  size_t         unity_batches; // 0 if off
+  CBuildLinker   linker;        // never auto
+  unsigned       debug_info;    // CBuildDebugInfo flags
+  uint64_t       pgo_profile;   // hash of what a use build reads, 0 if none
 };
 
+/// one unity batch per cpu
+#define CBUILD_UNITY_BATCHES_auto SIZE_MAX
+
 __C_DLL__ CError cbuild_create(CBuildType btype,
                                char const base_path[],
                                size_t     base_path_len,
                                CBuild*    out_cbuild);
 
+/// name of the output roots of `btype`, e.g. `.c_build/debug`
+__C_DLL__ char const* cbuild_type_get_name(CBuildType btype);
+
+/// accepts the full names and the short aliases (`relwithdebinfo`,
+/// `minsizerel`)
+__C_DLL__ CError cbuild_type_from_name(char const  name[],
+                                       size_t      name_len,
+                                       CBuildType* out_btype);
+
+/// directory of the build state inside every project, `.c_build`
+__C_DLL__ char const* cbuild_get_builder_dir_name(void);
+
+/// whether `dir_name` is one of the directories a build writes into
+__C_DLL__ bool cbuild_is_output_dir(char const dir_name[], size_t dir_name_len);
+
+/// unity batches of the targets that did not choose for themselves, in
+/// this project and the ones it depends on. 0 turns unity builds off
+__C_DLL__ void cbuild_set_unity_batches(CBuild* self, size_t batches);
+
+/// move `self` to a stage of a profile guided build, before
+/// `cbuild_configure`. every stage has its own output roots and the
+/// projects it depends on follow it
+__C_DLL__ CError cbuild_set_pgo(CBuild* self, CBuildPgo pgo);
+
+/// run the trainings of an instrumented build, the profiles of every
+/// project end up in `.c_build/<config>_pgo_profile`. nothing runs again
+/// while the instrumented projects and the trainings stay the same
+__C_DLL__ CError cbuild_pgo_train(CBuild* self);
+
+/// `default`, `mold`, `lld`, `gold` or `auto`
+__C_DLL__ CError cbuild_linker_from_name(char const    name[],
+                                         size_t        name_len,
+                                         CBuildLinker* out_linker);
+
+/// linker of the executables and shared libraries of this project and the
+/// ones it depends on. `auto` asks the compiler which linkers it can use
+/// once per process and remembers the answer in `.c_build/linker`
+__C_DLL__ CError cbuild_set_linker(CBuild* self, CBuildLinker linker);
+
+/// CBuildDebugInfo flags of this project and the ones it depends on, split
+/// dwarf links the objects without their debug info and a linker other
+/// than the default one indexes it for gdb
+__C_DLL__ CError cbuild_set_debug_info(CBuild* self, unsigned debug_info);
+
 __C_DLL__ CError cbuild_configure(CBuild* self);
 __C_DLL__ CError cbuild_build(CBuild* self);
 
+/// build only `target_names` and everything they depend on, including
+/// targets of other projects
+__C_DLL__ CError cbuild_build_targets(CBuild*           self,
+                                      char const* const target_names[],
+                                      size_t            target_names_len);
+
+/// build several configurations of the same project, all of their
+/// actions share one pool of `jobs` workers (0 means one per cpu).
+/// `target_names_len` = 0 builds every target
+__C_DLL__ CError cbuild_build_many(CBuild            cbuilds[],
+                                   size_t            cbuilds_len,
+                                   char const* const target_names[],
+                                   size_t            target_names_len,
+                                   size_t            jobs);
+
+/// combined state of every file known to this project and the ones it
+/// depends on, outputs included (see `cbuild_db_stamp`). it is taken from
+/// the disk again, a deleted output changes it
+__C_DLL__ CError cbuild_get_stamp(CBuild* self, CHash128* out_stamp);
+
+/// same, for the outputs only (see `cbuild_db_outputs_stamp`). whoever
+/// watches the sources asks for this one, it never stats a source
+__C_DLL__ CError cbuild_get_outputs_stamp(CBuild* self, CHash128* out_stamp);
+
+/// the directories of the `-I` flags of the targets of this project that
+/// lie outside of it, absolute and without duplicates.
+/// `out_dirs` = CArray< CStr >, each of them is destroyed by the caller
+__C_DLL__ CError cbuild_get_external_include_dirs(CBuild* self,
+                                                  CArray* out_dirs);
+
 __C_DLL__ CError cbuild_target_create(CBuild*     self,
                                       char const  name[],
                                       size_t      name_len,
@@ -51,11 +207,55 @@ __C_DLL__ CError cbuild_target_create(CBuild*     self,
                                       CTargetType ttype,
                                       CTarget*    out_target);
 
+/// the build folders of `target`, the units it compiles (unity batches
+/// are written), their objects and the arguments of its compiles and link.
+/// done again before every build, the settings may have changed since
+__C_DLL__ CError cbuild_target_prepare(CBuild* self, CTargetImpl* target);
+
 __C_DLL__ CError cbuild_target_build(CBuild* self, CTargetImpl* target);
 
 __C_DLL__ CError cbuild_target_compile(CBuild* self, CTargetImpl* target);
 
-__C_DLL__ CError cbuild_target_link(CBuild* self, CTargetImpl* target);
+/// a command, its paths and its output, a bigger one takes another block
+#define CBUILD_SCRATCH_BLOCK_SIZE (16 * 1024)
+
+/// what a command prints is kept up to it, the rest is cut
+#define CBUILD_COMMAND_OUTPUT_CAPACITY 8192
+
+/// precompile the header of `target`, every source compile of the target
+/// has to wait for it. nothing to do without one. what the command needs
+/// is taken from `scratch`, as for `cbuild_target_compile_source`
+__C_DLL__ CError cbuild_target_precompile_header(CBuild*      self,
+                                                 CTargetImpl* target,
+                                                 CBuildArena* scratch);
+
+/// compile one of the `units` of `target`, safe to call concurrently with
+/// a `scratch` per caller. the command is built inside it, the caller resets
+/// it once done
+__C_DLL__ CError cbuild_target_compile_source(CBuild*      self,
+                                              CTargetImpl* target,
+                                              size_t       unit_index,
+                                              CBuildArena* scratch);
+
+/// link `target`, its output and the paths of its objects are taken from
+/// `scratch`
+__C_DLL__ CError cbuild_target_link(CBuild*      self,
+                                    CTargetImpl* target,
+                                    CBuildArena* scratch);
+
+/// run the custom command `command_index` of `self` unless it is up to
+/// date, safe to call concurrently. its output is taken from `scratch`
+__C_DLL__ CError cbuild_command_run(CBuild*      self,
+                                    size_t       command_index,
+                                    CBuildArena* scratch);
+
+/// `out_commands` (CArray< size_t >) = the custom commands of `self`
+/// writing `source` of `target` or one of the headers it includes. an
+/// include that doesn't exist yet matches the outputs ending with its name
+__C_DLL__ CError cbuild_target_source_commands(CBuild*      self,
+                                               CTargetImpl* target,
+                                               CStr const*  source,
+                                               CArray*      out_commands);
 
 __C_DLL__ void cbuild_destroy(CBuild* self);
 
@@ -0,0 +1,541 @@
+#include "cbuild_scan_private.h"
+#include "cbuild_stat_private.h"
+#include "helpers.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <defer.h>
+#include <fs.h>
+
+#ifdef _WIN32
+#pragma warning(push)
+#pragma warning(disable : 4996) // disable warning about unsafe functions
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+typedef struct CBuildScanFile {
+  CStr            path;
+  CBuildFileState state;    // when `includes` were read
+  CArray          includes; // CArray< CStr >
+} CBuildScanFile;
+
+/// where an include resolves, `key` covers the include, the directory of
+/// the file including it for a `""` one and the include directories
+typedef struct CBuildScanResolution {
+  CHash128 key;
+  CStr     header; // empty for a system header
+} CBuildScanResolution;
+
+static CError      internal_cbuild_scan_buffer(char const* data,
+                                               size_t      size,
+                                               CArray*     out_includes);
+static CError      internal_cbuild_scanner_get(CBuildScanner*         self,
+                                               CStr const*            path,
+                                               CBuildFileState const* state,
+                                               CArray const** out_includes);
+static CError      internal_cbuild_scanner_resolve(CBuildScanner* self,
+                                                   char const     dir[],
+                                                   size_t         dir_len,
+                                                   CStr const*    include,
+                                                   CArray const*  include_dirs,
+                                                   CHash128       dirs_hash,
+                                                   CStr*          candidate,
+                                                   CStr*          out_header);
+static CError      internal_cbuild_scanner_push(CStr const* header,
+                                                CHashIndex* seen,
+                                                CArray*     headers);
+static char const* internal_cbuild_scan_skip_blanks(char const* cursor,
+                                                    char const* end);
+static bool        internal_cbuild_scan_state_equal(CBuildFileState const* lhs,
+                                                    CBuildFileState const* rhs);
+static void        internal_cbuild_scan_strings_destroy(CArray* strings);
+
+CError
+cbuild_scanner_create(CBuildScanner* out_scanner)
+{
+  assert(out_scanner);
+
+  *out_scanner = (CBuildScanner){0};
+
+  c_array_error_t arr_err
+      = c_array_create(sizeof(CBuildScanFile), &out_scanner->files);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+
+  arr_err = c_array_create(sizeof(CBuildScanResolution),
+                           &out_scanner->resolutions);
+  if (arr_err.code != 0) {
+    c_array_destroy(&out_scanner->files);
+    return CERROR_internal_error(arr_err.desc);
+  }
+
+  // the index of the resolutions is created with the first one
+  CError err = c_hash_index_create(0, &out_scanner->index);
+  if (err.code != 0) {
+    c_array_destroy(&out_scanner->resolutions);
+    c_array_destroy(&out_scanner->files);
+  }
+
+  return err;
+}
+
+CError
+cbuild_scan_file(char const path[], size_t path_len, CArray* out_includes)
+{
+  assert(path && path_len > 0);
+  assert(out_includes);
+
+  if (path[path_len] != '\0') { return CERROR_invalid_string; }
+
+  c_array_error_t arr_err = c_array_create(sizeof(CStr), out_includes);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+
+  CError err = CERROR_none;
+
+#ifndef _WIN32
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) { return CERROR_none; }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    return CERROR_none;
+  }
+
+  size_t const size = (size_t)file_stat.st_size;
+  void*        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) { return CERROR_none; }
+
+  err = internal_cbuild_scan_buffer(data, size, out_includes);
+
+  munmap(data, size);
+#else
+  FILE* file = fopen(path, "rb");
+  if (!file) { return CERROR_none; }
+
+  CBuildFileState state;
+  cbuild_stat(path, &state);
+
+  char* data = malloc(state.size + 1);
+  if (!data) {
+    fclose(file);
+    c_array_destroy(out_includes);
+    return CERROR_memory_allocation;
+  }
+  size_t const size = fread(data, 1, state.size, file);
+  fclose(file);
+
+  err = internal_cbuild_scan_buffer(data, size, out_includes);
+
+  free(data);
+#endif
+
+  if (err.code != 0) { internal_cbuild_scan_strings_destroy(out_includes); }
+
+  return err;
+}
+
+CError
+cbuild_scanner_headers(CBuildScanner* self,
+                       char const     source[],
+                       size_t         source_len,
+                       CArray const*  include_dirs,
+                       CArray*        out_headers,
+                       CArray*        out_missing)
+{
+  assert(self);
+  assert(source && source_len > 0);
+  assert(include_dirs);
+  assert(out_headers);
+
+  CError     err       = CERROR_none;
+  CHashIndex seen      = {0}; // hash(header) -> index inside `out_headers`
+  CStr       candidate = {0};
+  CStr       file      = {0};
+
+  c_defer_init(3);
+
+  c_array_error_t arr_err = c_array_create(sizeof(CStr), out_headers);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+  if (out_missing) {
+    arr_err = c_array_create(sizeof(CStr), out_missing);
+    if (arr_err.code != 0) {
+      c_array_destroy(out_headers);
+      return CERROR_internal_error(arr_err.desc);
+    }
+  }
+
+  err = c_hash_index_create(0, &seen);
+  c_defer_err(err.code == 0, c_hash_index_destroy, &seen, NULL);
+
+  c_str_error_t str_err
+      = c_str_create_empty(c_fs_path_get_max_len(), &candidate);
+  c_defer_err(str_err.code == 0, c_str_destroy, &candidate,
+              err = CERROR_internal_error(str_err.desc));
+
+  str_err = c_str_create(source, source_len, &file);
+  c_defer_err(str_err.code == 0, c_str_destroy, &file,
+              err = CERROR_internal_error(str_err.desc));
+
+  // a resolution holds for the same include directories only
+  CHash128 dirs_hash = {0};
+  for (size_t iii = 0; iii < include_dirs->len; ++iii) {
+    char const* dir = ((char const**)include_dirs->data)[iii];
+    dirs_hash       = c_hash128_combine(dirs_hash,
+                                        c_hash128(dir, strlen(dir), 0));
+  }
+
+  char const separator = c_fs_path_get_separator();
+
+  // breadth first, `out_headers` is the queue as well
+  CBuildFileState state;
+  cbuild_stat(file.data, &state);
+  for (size_t next = 0; state.exists; ++next) {
+    CArray const* includes = NULL;
+    err = internal_cbuild_scanner_get(self, &file, &state, &includes);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    // <directory of the file>/
+    size_t dir_len = file.len;
+    while (dir_len > 0 && file.data[dir_len - 1] != '/'
+           && file.data[dir_len - 1] != separator) {
+      dir_len--;
+    }
+
+    for (size_t iii = 0; iii < includes->len; ++iii) {
+      CStr const* include = &((CStr*)includes->data)[iii];
+      CStr        header  = {0};
+
+      err = internal_cbuild_scanner_resolve(self, file.data, dir_len, include,
+                                            include_dirs, dirs_hash,
+                                            &candidate, &header);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+      if (header.data) {
+        err = internal_cbuild_scanner_push(&header, &seen, out_headers);
+        c_defer_check(err.code == 0, NULL, NULL, NULL);
+      } else if (out_missing) {
+        CStr missing = {0};
+        str_err = c_str_create(&include->data[1], include->len - 1, &missing);
+        c_defer_check(str_err.code == 0, NULL, NULL,
+                      err = CERROR_internal_error(str_err.desc));
+        arr_err = c_array_push(out_missing, &missing);
+        if (arr_err.code != 0) { c_str_destroy(&missing); }
+        c_defer_check(arr_err.code == 0, NULL, NULL,
+                      err = CERROR_internal_error(arr_err.desc));
+      }
+    }
+
+    if (next >= out_headers->len) { break; }
+
+    CStr const* header = &((CStr*)out_headers->data)[next];
+    str_err            = c_str_replace_at(&file, 0, file.len, header->data,
+                                          header->len);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+    cbuild_stat(file.data, &state);
+  }
+
+  c_defer_deinit();
+
+  if (err.code != 0) {
+    internal_cbuild_scan_strings_destroy(out_headers);
+    if (out_missing) { internal_cbuild_scan_strings_destroy(out_missing); }
+  }
+
+  return err;
+}
+
+void
+cbuild_scanner_destroy(CBuildScanner* self)
+{
+  assert(self);
+
+  for (size_t iii = 0; iii < self->files.len; ++iii) {
+    CBuildScanFile* file = &((CBuildScanFile*)self->files.data)[iii];
+    c_str_destroy(&file->path);
+    internal_cbuild_scan_strings_destroy(&file->includes);
+  }
+  c_array_destroy(&self->files);
+  c_hash_index_destroy(&self->index);
+
+  cbuild_scanner_forget_resolutions(self);
+  c_array_destroy(&self->resolutions);
+
+  *self = (CBuildScanner){0};
+}
+
+void
+cbuild_scanner_forget_resolutions(CBuildScanner* self)
+{
+  assert(self);
+
+  for (size_t iii = 0; iii < self->resolutions.len; ++iii) {
+    CBuildScanResolution* resolution
+        = &((CBuildScanResolution*)self->resolutions.data)[iii];
+    if (resolution->header.data) { c_str_destroy(&resolution->header); }
+  }
+  self->resolutions.len = 0;
+  c_hash_index_destroy(&self->resolution_index);
+}
+
+CError
+internal_cbuild_scan_buffer(char const* data, size_t size, CArray* out_includes)
+{
+  char const* const end    = data + size;
+  char const*       cursor = data;
+
+  // memchr is vectorized, directives are rare compared to the text around
+  while ((cursor = memchr(cursor, '#', (size_t)(end - cursor))) != NULL) {
+    char const* line = cursor++;
+
+    // # starts a directive only after blanks
+    while (line > data && (line[-1] == ' ' || line[-1] == '\t')) {
+      line--;
+    }
+    if (line > data && line[-1] != '\n' && line[-1] != '\r') { continue; }
+
+    // # include "<name>"
+    // # include <<name>>
+    cursor = internal_cbuild_scan_skip_blanks(cursor, end);
+    if ((size_t)(end - cursor) < sizeof("include") - 1
+        || memcmp(cursor, "include", sizeof("include") - 1) != 0) {
+      continue;
+    }
+    cursor = internal_cbuild_scan_skip_blanks(
+        cursor + sizeof("include") - 1, end);
+    if (cursor == end || (*cursor != '"' && *cursor != '<')) { continue; }
+
+    char const  close    = *cursor == '"' ? '"' : '>';
+    char const* name_end = cursor + 1;
+    while (name_end < end && *name_end != close && *name_end != '\n') {
+      name_end++;
+    }
+    if (name_end == end || *name_end != close || name_end == cursor + 1) {
+      cursor = name_end;
+      continue;
+    }
+
+    CStr          include = {0};
+    c_str_error_t str_err
+        = c_str_create(cursor, (size_t)(name_end - cursor), &include);
+    if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+    c_array_error_t arr_err = c_array_push(out_includes, &include);
+    if (arr_err.code != 0) {
+      c_str_destroy(&include);
+      return CERROR_internal_error(arr_err.desc);
+    }
+
+    cursor = name_end;
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_scanner_get(CBuildScanner*         self,
+                            CStr const*            path,
+                            CBuildFileState const* state,
+                            CArray const**         out_includes)
+{
+  uint64_t const hash   = c_hash128(path->data, path->len, 0).low;
+  size_t         cursor = 0;
+  size_t         index  = 0;
+  while (c_hash_index_next(&self->index, hash, &cursor, &index)) {
+    CBuildScanFile* file = &((CBuildScanFile*)self->files.data)[index];
+    if (file->path.len != path->len
+        || memcmp(file->path.data, path->data, path->len) != 0) {
+      continue;
+    }
+
+    if (!internal_cbuild_scan_state_equal(&file->state, state)) {
+      CArray includes;
+      CError err = cbuild_scan_file(path->data, path->len, &includes);
+      if (err.code != 0) { return err; }
+
+      internal_cbuild_scan_strings_destroy(&file->includes);
+      file->includes = includes;
+      file->state    = *state;
+    }
+
+    *out_includes = &file->includes;
+    return CERROR_none;
+  }
+
+  CBuildScanFile file = {.state = *state};
+  CError err = cbuild_scan_file(path->data, path->len, &file.includes);
+  if (err.code != 0) { return err; }
+
+  c_str_error_t str_err = c_str_clone(path, &file.path);
+  if (str_err.code != 0) {
+    internal_cbuild_scan_strings_destroy(&file.includes);
+    return CERROR_internal_error(str_err.desc);
+  }
+
+  c_array_error_t arr_err = c_array_push(&self->files, &file);
+  if (arr_err.code == 0) {
+    err = c_hash_index_insert(&self->index, hash, self->files.len - 1);
+    if (err.code != 0) { c_array_remove(&self->files, self->files.len - 1); }
+  } else {
+    err = CERROR_internal_error(arr_err.desc);
+  }
+  if (err.code != 0) {
+    c_str_destroy(&file.path);
+    internal_cbuild_scan_strings_destroy(&file.includes);
+    return err;
+  }
+
+  *out_includes = &((CBuildScanFile*)self->files.data)[self->files.len - 1]
+                       .includes;
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_scanner_resolve(CBuildScanner* self,
+                                char const     dir[],
+                                size_t         dir_len,
+                                CStr const*    include,
+                                CArray const*  include_dirs,
+                                CHash128       dirs_hash,
+                                CStr*          candidate,
+                                CStr*          out_header)
+{
+  // a `<>` include resolves the same from every directory
+  bool const     is_quoted = include->data[0] == '"';
+  CHash128 const key       = c_hash128_combine(
+      c_hash128(dir, is_quoted ? dir_len : 0, dirs_hash.low),
+      c_hash128(include->data, include->len, 0));
+
+  size_t cursor = 0;
+  size_t index  = 0;
+  while (c_hash_index_next(&self->resolution_index, key.low, &cursor,
+                           &index)) {
+    CBuildScanResolution const* resolution
+        = &((CBuildScanResolution*)self->resolutions.data)[index];
+    if (c_hash128_equal(resolution->key, key)) {
+      *out_header = resolution->header;
+      return CERROR_none;
+    }
+  }
+
+  // next to the file first for a `""` one, then inside the include
+  // directories in order
+  char const*     name     = &include->data[1];
+  bool            is_found = false;
+  c_str_error_t   str_err  = C_STR_ERROR_none;
+  CBuildFileState state;
+  if (is_quoted) {
+    str_err = c_str_format(candidate, 0, C_STR_INV("%.*s%s"), (int)dir_len,
+                           dir, name);
+    if (str_err.code == 0) { cbuild_stat(candidate->data, &state); }
+    is_found = str_err.code == 0 && state.exists;
+  }
+  for (size_t iii = 0;
+       !is_found && str_err.code == 0 && iii < include_dirs->len; ++iii) {
+    str_err = c_str_format(candidate, 0, C_STR_INV("%s%c%s"),
+                           ((char const**)include_dirs->data)[iii],
+                           c_fs_path_get_separator(), name);
+    if (str_err.code == 0) { cbuild_stat(candidate->data, &state); }
+    is_found = str_err.code == 0 && state.exists;
+  }
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  CBuildScanResolution resolution = {.key = key};
+  if (is_found) {
+    str_err = c_str_clone(candidate, &resolution.header);
+    if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+  }
+
+  CError err = CERROR_none;
+  if (self->resolution_index.capacity == 0) {
+    err = c_hash_index_create(0, &self->resolution_index);
+  }
+  c_array_error_t arr_err = C_ARRAY_ERROR_none;
+  if (err.code == 0) {
+    arr_err = c_array_push(&self->resolutions, &resolution);
+    if (arr_err.code != 0) { err = CERROR_internal_error(arr_err.desc); }
+  }
+  if (err.code == 0) {
+    err = c_hash_index_insert(&self->resolution_index, key.low,
+                              self->resolutions.len - 1);
+    if (err.code != 0) {
+      c_array_remove(&self->resolutions, self->resolutions.len - 1);
+    }
+  }
+  if (err.code != 0) {
+    if (resolution.header.data) { c_str_destroy(&resolution.header); }
+    return err;
+  }
+
+  *out_header = resolution.header;
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_scanner_push(CStr const* header,
+                             CHashIndex* seen,
+                             CArray*     headers)
+{
+  uint64_t const hash   = c_hash128(header->data, header->len, 0).low;
+  size_t         cursor = 0;
+  size_t         index  = 0;
+  while (c_hash_index_next(seen, hash, &cursor, &index)) {
+    CStr const* pushed = &((CStr*)headers->data)[index];
+    if (pushed->len == header->len
+        && memcmp(pushed->data, header->data, header->len) == 0) {
+      return CERROR_none;
+    }
+  }
+
+  CStr          copy    = {0};
+  c_str_error_t str_err = c_str_clone(header, &copy);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+  c_array_error_t arr_err = c_array_push(headers, &copy);
+  if (arr_err.code != 0) {
+    c_str_destroy(&copy);
+    return CERROR_internal_error(arr_err.desc);
+  }
+
+  return c_hash_index_insert(seen, hash, headers->len - 1);
+}
+
+char const*
+internal_cbuild_scan_skip_blanks(char const* cursor, char const* end)
+{
+  while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+    cursor++;
+  }
+
+  return cursor;
+}
+
+bool
+internal_cbuild_scan_state_equal(CBuildFileState const* lhs,
+                                 CBuildFileState const* rhs)
+{
+  return lhs->exists == rhs->exists && lhs->inode == rhs->inode
+         && lhs->mtime == rhs->mtime && lhs->size == rhs->size;
+}
+
+void
+internal_cbuild_scan_strings_destroy(CArray* strings)
+{
+  for (size_t iii = 0; iii < strings->len; ++iii) {
+    c_str_destroy(&((CStr*)strings->data)[iii]);
+  }
+  c_array_destroy(strings);
+}
+
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
@@ -0,0 +1,59 @@
+#ifndef CBUILD_SCAN_PRIVATE_H
+#define CBUILD_SCAN_PRIVATE_H
+
+/// `#include` scanner, the headers a source depends on without running
+/// the preprocessor. conditional compilation is not evaluated, so headers
+/// under an `#if 0` are listed too, and computed includes are missed
+
+#include "cbuild.h"
+#include "cbuild_private.h"
+#include "cerror.h"
+
+#include <chash.h>
+
+#include <array.h>
+#include <str.h>
+
+#include <stddef.h>
+
+/// the directives of every file scanned so far, a file is scanned again
+/// once its state (inode, mtime, size) changes. where an include resolves
+/// is kept until `cbuild_scanner_forget_resolutions`.
+/// it has no lock of its own: the compiles running at the same time only
+/// call it while holding the lock of the database of the project
+/// (`cbuild_db_lock`), everything else calls it before they start
+struct CBuildScanner {
+  CArray     files;            // CArray< CBuildScanFile >
+  CHashIndex index;            // hash(path) -> index inside `files`
+  CArray     resolutions;      // CArray< CBuildScanResolution >
+  CHashIndex resolution_index; // key -> index inside `resolutions`
+};
+
+__C_DLL__ CError cbuild_scanner_create(CBuildScanner* out_scanner);
+
+/// `out_includes` = the `#include` directives of `path` in order, each one
+/// as `"<name>` or `<<name>` (CArray< CStr >). a missing file has none
+__C_DLL__ CError cbuild_scan_file(char const path[],
+                                  size_t     path_len,
+                                  CArray*    out_includes);
+
+/// `out_headers` = every header `source` includes directly or not
+/// (CArray< CStr >). a `""` include is looked up next to the file
+/// including it first, then inside `include_dirs` (CArray< char const* >)
+/// in order like a `<>` one. what isn't found is a system header and left
+/// out, as `-MMD` does. `out_missing` (CArray< CStr >, may be NULL) = the
+/// names of those, a header generated later is one of them
+__C_DLL__ CError cbuild_scanner_headers(CBuildScanner* self,
+                                        char const     source[],
+                                        size_t         source_len,
+                                        CArray const*  include_dirs,
+                                        CArray*        out_headers,
+                                        CArray*        out_missing);
+
+/// the headers found so far may not be the ones found next, e.g. at the
+/// start of a build or once a command wrote its outputs
+__C_DLL__ void cbuild_scanner_forget_resolutions(CBuildScanner* self);
+
+__C_DLL__ void cbuild_scanner_destroy(CBuildScanner* self);
+
+#endif // CBUILD_SCAN_PRIVATE_H
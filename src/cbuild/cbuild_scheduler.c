@@ -0,0 +1,612 @@
+#include "cbuild_scheduler_private.h"
+#include "cbuild_arena_private.h"
+#include "cbuild_private.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <defer.h>
+#include <fs.h>
+
+static CError internal_cbuild_scheduler_add_edge(CBuildScheduler* self,
+                                                 size_t           prerequisite,
+                                                 size_t           dependent);
+static CError internal_cbuild_scheduler_add_command(CBuildScheduler* self,
+                                                    CBuild*          cbuild,
+                                                    CArray* command_actions,
+                                                    size_t  command_index,
+                                                    size_t* out_action);
+static CError internal_cbuild_scheduler_add_source_commands(
+    CBuildScheduler* self, CBuild* cbuild, CArray* command_actions,
+    CTargetImpl* target, CStr const* source, size_t dependent);
+static uint64_t internal_cbuild_scheduler_target_hash(CTargetImpl* target);
+static size_t internal_cbuild_scheduler_pick(CBuildScheduler* self,
+                                             bool             has_own_dir);
+static void   internal_cbuild_scheduler_worker(void* data);
+static void   internal_cbuild_scheduler_work(CBuildScheduler* self,
+                                             bool             may_own_dir);
+static CError internal_cbuild_scheduler_exec(CBuildAction* action,
+                                             CBuildArena*  scratch);
+
+CError
+cbuild_scheduler_create(size_t jobs, CBuildScheduler* out_scheduler)
+{
+  assert(out_scheduler);
+
+  CError err = CERROR_none;
+
+  c_defer_init(6);
+
+  *out_scheduler      = (CBuildScheduler){0};
+  out_scheduler->jobs = jobs > 0 ? jobs : cbuild_thread_get_cpu_count();
+
+  c_array_error_t arr_err
+      = c_array_create(sizeof(CBuildAction), &out_scheduler->actions);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(arr_err.desc));
+
+  arr_err = c_array_create(sizeof(size_t), &out_scheduler->ready);
+  c_defer_check(arr_err.code == 0, c_array_destroy, &out_scheduler->actions,
+                err = CERROR_internal_error(arr_err.desc));
+
+  arr_err
+      = c_array_create(sizeof(CBuildTargetActions), &out_scheduler->targets);
+  c_defer_check(arr_err.code == 0, NULL, NULL,
+                (c_array_destroy(&out_scheduler->actions),
+                 c_array_destroy(&out_scheduler->ready),
+                 err = CERROR_internal_error(arr_err.desc)));
+
+  err = c_hash_index_create(0, &out_scheduler->target_index);
+  c_defer_check(err.code == 0, NULL, NULL,
+                (c_array_destroy(&out_scheduler->actions),
+                 c_array_destroy(&out_scheduler->ready),
+                 c_array_destroy(&out_scheduler->targets)));
+
+  c_defer_check(cbuild_mutex_create(&out_scheduler->lock), NULL, NULL,
+                (c_array_destroy(&out_scheduler->actions),
+                 c_array_destroy(&out_scheduler->ready),
+                 c_array_destroy(&out_scheduler->targets),
+                 c_hash_index_destroy(&out_scheduler->target_index),
+                 err = CERROR_internal_error("c: failed to create a mutex")));
+
+  c_defer_check(cbuild_cond_create(&out_scheduler->wakeup), NULL, NULL,
+                (c_array_destroy(&out_scheduler->actions),
+                 c_array_destroy(&out_scheduler->ready),
+                 c_array_destroy(&out_scheduler->targets),
+                 c_hash_index_destroy(&out_scheduler->target_index),
+                 cbuild_mutex_destroy(&out_scheduler->lock),
+                 err = CERROR_internal_error(
+                     "c: failed to create a condition variable")));
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_scheduler_add_project(CBuildScheduler* self,
+                             CBuild*          cbuild,
+                             bool             is_partial)
+{
+  assert(self);
+  assert(cbuild && cbuild->impl);
+
+  CError       err             = CERROR_none;
+  CArray       command_actions = {0}; // CArray< size_t >, SIZE_MAX until queued
+  size_t const targets_begin   = self->targets.len;
+
+  c_defer_init(4);
+
+  c_array_error_t arr_err = c_array_create(sizeof(size_t), &command_actions);
+  c_defer_err(arr_err.code == 0, c_array_destroy, &command_actions,
+              err = CERROR_internal_error(arr_err.desc));
+  for (size_t iii = 0; iii < cbuild->impl->commands.len; ++iii) {
+    arr_err = c_array_push(&command_actions, &(size_t){SIZE_MAX});
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+
+  // a partial build runs only the commands its targets read
+  for (size_t iii = 0; !is_partial && iii < cbuild->impl->commands.len;
+       ++iii) {
+    size_t action_index;
+    err = internal_cbuild_scheduler_add_command(self, cbuild, &command_actions,
+                                                iii, &action_index);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  // nodes
+  for (size_t iii = 0; iii < cbuild->impl->targets.len; ++iii) {
+    CTargetImpl* target = ((CTargetImpl**)cbuild->impl->targets.data)[iii];
+    if (!target->is_selected) { continue; }
+
+    CBuildTargetActions target_actions = {
+        .target     = target,
+        .precompile = SIZE_MAX,
+        .link       = SIZE_MAX,
+    };
+
+    if (target->precompiled_header.len > 0) {
+      CBuildAction action = {
+          .kind   = CBUILD_ACTION_KIND_precompile,
+          .cbuild = *cbuild,
+          .target = target,
+          .weight = 1,
+      };
+      arr_err = c_array_create(sizeof(size_t), &action.dependents);
+      c_defer_check(arr_err.code == 0, NULL, NULL,
+                    err = CERROR_internal_error(arr_err.desc));
+      arr_err = c_array_push(&self->actions, &action);
+      c_defer_check(arr_err.code == 0, c_array_destroy, &action.dependents,
+                    err = CERROR_internal_error(arr_err.desc));
+
+      target_actions.precompile = self->actions.len - 1;
+    }
+    target_actions.compile_begin = self->actions.len;
+
+    for (size_t jjj = 0; jjj <= target->units.len; ++jjj) {
+      bool is_link = jjj == target->units.len;
+      if (is_link && target->ttype == CTARGET_TYPE_object) { break; }
+
+      CBuildAction action = {
+          .kind       = is_link ? CBUILD_ACTION_KIND_link
+                                : CBUILD_ACTION_KIND_compile,
+          .cbuild     = *cbuild,
+          .target     = target,
+          .unit_index = jjj,
+          .weight     = 1,
+      };
+      // the compiler spreads a parallel lto link over every cpu
+      if (is_link && target->lto == CTARGET_LTO_parallel) {
+        action.weight = self->jobs;
+      }
+      arr_err = c_array_create(sizeof(size_t), &action.dependents);
+      c_defer_check(arr_err.code == 0, NULL, NULL,
+                    err = CERROR_internal_error(arr_err.desc));
+      arr_err = c_array_push(&self->actions, &action);
+      c_defer_check(arr_err.code == 0, c_array_destroy, &action.dependents,
+                    err = CERROR_internal_error(arr_err.desc));
+
+      if (is_link) { target_actions.link = self->actions.len - 1; }
+    }
+
+    target_actions.compile_end = target_actions.link != SIZE_MAX
+                                     ? target_actions.link
+                                     : self->actions.len;
+
+    arr_err = c_array_push(&self->targets, &target_actions);
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+    err = c_hash_index_insert(&self->target_index,
+                              internal_cbuild_scheduler_target_hash(target),
+                              self->targets.len - 1);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  // edges
+  for (size_t iii = targets_begin; iii < self->targets.len; ++iii) {
+    CBuildTargetActions* target_actions
+        = &((CBuildTargetActions*)self->targets.data)[iii];
+
+    // sources and headers are compiled after the commands writing them
+    CTargetImpl* target = target_actions->target;
+    if (target_actions->precompile != SIZE_MAX) {
+      err = internal_cbuild_scheduler_add_source_commands(
+          self, cbuild, &command_actions, target, &target->precompiled_header,
+          target_actions->precompile);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+    for (size_t jjj = target_actions->compile_begin;
+         jjj < target_actions->compile_end; ++jjj) {
+      size_t const unit_index
+          = ((CBuildAction*)self->actions.data)[jjj].unit_index;
+      err = internal_cbuild_scheduler_add_source_commands(
+          self, cbuild, &command_actions, target,
+          &((CStr*)target->units.data)[unit_index], jjj);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+
+    // the sources of a target are compiled after its precompiled header
+    if (target_actions->precompile != SIZE_MAX) {
+      for (size_t jjj = target_actions->compile_begin;
+           jjj < target_actions->compile_end; ++jjj) {
+        err = internal_cbuild_scheduler_add_edge(
+            self, target_actions->precompile, jjj);
+        c_defer_check(err.code == 0, NULL, NULL, NULL);
+      }
+    }
+
+    if (target_actions->link == SIZE_MAX) { continue; }
+
+    // a target is linked after its own objects
+    for (size_t jjj = target_actions->compile_begin;
+         jjj < target_actions->compile_end; ++jjj) {
+      err = internal_cbuild_scheduler_add_edge(self, jjj,
+                                               target_actions->link);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+
+    // and after the libraries and objects of its dependencies, in this
+    // project or in one added before, the ones not added are up to date
+    CArray* dependencies = &target_actions->target->dependencies;
+    for (size_t jjj = 0; jjj < dependencies->len; ++jjj) {
+      CTargetImpl*   dependency = ((CTargetImpl**)dependencies->data)[jjj];
+      uint64_t const hash = internal_cbuild_scheduler_target_hash(dependency);
+
+      size_t cursor = 0;
+      size_t kkk;
+      while (c_hash_index_next(&self->target_index, hash, &cursor, &kkk)) {
+        CBuildTargetActions* dependency_actions
+            = &((CBuildTargetActions*)self->targets.data)[kkk];
+        if (dependency_actions->target != dependency) { continue; }
+
+        if (dependency_actions->link != SIZE_MAX) {
+          err = internal_cbuild_scheduler_add_edge(
+              self, dependency_actions->link, target_actions->link);
+          c_defer_check(err.code == 0, NULL, NULL, NULL);
+        } else {
+          for (size_t lll = dependency_actions->compile_begin;
+               lll < dependency_actions->compile_end; ++lll) {
+            err = internal_cbuild_scheduler_add_edge(self, lll,
+                                                     target_actions->link);
+            c_defer_check(err.code == 0, NULL, NULL, NULL);
+          }
+        }
+      }
+    }
+  }
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+cbuild_scheduler_run(CBuildScheduler* self)
+{
+  assert(self);
+
+  if (self->actions.len == 0) { return CERROR_none; }
+
+  CError        err     = CERROR_none;
+  CBuildThread* workers = NULL;
+
+  c_defer_init(4);
+
+  for (size_t iii = 0; iii < self->actions.len; ++iii) {
+    if (((CBuildAction*)self->actions.data)[iii].pending == 0) {
+      c_array_error_t arr_err = c_array_push(&self->ready, &iii);
+      c_defer_check(arr_err.code == 0, NULL, NULL,
+                    err = CERROR_internal_error(arr_err.desc));
+    }
+  }
+
+  size_t workers_len
+      = self->jobs < self->actions.len ? self->jobs : self->actions.len;
+  workers = calloc(workers_len, sizeof(CBuildThread));
+  c_defer_err(workers, free, workers, err = CERROR_memory_allocation);
+
+  CBuildThreadStart start = {internal_cbuild_scheduler_worker, self};
+
+  size_t started = 0;
+  for (; started < workers_len; ++started) {
+    if (!cbuild_thread_create(&start, &workers[started])) { break; }
+  }
+  // the build still completes with fewer workers
+  // the calling thread keeps the directory of the process
+  if (started == 0) { internal_cbuild_scheduler_work(self, false); }
+
+  for (size_t iii = 0; iii < started; ++iii) {
+    cbuild_thread_join(workers[iii]);
+  }
+
+  err = self->err;
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+  c_defer_check(self->done == self->actions.len, NULL, NULL,
+                err = CERROR_internal_error("c: cyclic target dependencies"));
+
+  c_defer_deinit();
+
+  return err;
+}
+
+void
+cbuild_scheduler_destroy(CBuildScheduler* self)
+{
+  assert(self);
+
+  for (size_t iii = 0; iii < self->actions.len; ++iii) {
+    c_array_destroy(&((CBuildAction*)self->actions.data)[iii].dependents);
+  }
+  c_array_destroy(&self->actions);
+  c_array_destroy(&self->ready);
+  c_array_destroy(&self->targets);
+  c_hash_index_destroy(&self->target_index);
+  cbuild_cond_destroy(&self->wakeup);
+  cbuild_mutex_destroy(&self->lock);
+
+  *self = (CBuildScheduler){0};
+}
+
+// ------------------------------------------------------------------------//
+// ------------------------------ Internals -------------------------------//
+// ------------------------------------------------------------------------//
+
+CError
+internal_cbuild_scheduler_add_edge(CBuildScheduler* self,
+                                   size_t           prerequisite,
+                                   size_t           dependent)
+{
+  CBuildAction* actions = self->actions.data;
+
+  c_array_error_t arr_err
+      = c_array_push(&actions[prerequisite].dependents, &dependent);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+  actions[dependent].pending++;
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_scheduler_add_command(CBuildScheduler* self,
+                                      CBuild*          cbuild,
+                                      CArray*          command_actions,
+                                      size_t           command_index,
+                                      size_t*          out_action)
+{
+  size_t* queued = &((size_t*)command_actions->data)[command_index];
+  if (*queued != SIZE_MAX) {
+    *out_action = *queued;
+    return CERROR_none;
+  }
+
+  CBuildCommand const* commands = cbuild->impl->commands.data;
+  CBuildCommand const* command  = &commands[command_index];
+  CStr const*          output   = command->outputs.data;
+
+  // the configurations of a project declare the same commands, writing
+  // the same files
+  for (size_t iii = 0; iii < self->actions.len; ++iii) {
+    CBuildAction const* action = &((CBuildAction*)self->actions.data)[iii];
+    if (action->kind != CBUILD_ACTION_KIND_command
+        || strcmp(action->cbuild.impl->base_path.data,
+                  cbuild->impl->base_path.data)
+               != 0) {
+      continue;
+    }
+
+    CBuildCommand const* other = &((CBuildCommand*)action->cbuild.impl
+                                       ->commands.data)[action->command_index];
+    if (strcmp(((CStr*)other->outputs.data)->data, output->data) == 0) {
+      *queued = *out_action = iii;
+      return CERROR_none;
+    }
+  }
+
+  CBuildAction action = {
+      .kind          = CBUILD_ACTION_KIND_command,
+      .cbuild        = *cbuild,
+      .command_index = command_index,
+      .weight        = 1,
+  };
+  c_array_error_t arr_err = c_array_create(sizeof(size_t), &action.dependents);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+  arr_err = c_array_push(&self->actions, &action);
+  if (arr_err.code != 0) {
+    c_array_destroy(&action.dependents);
+    return CERROR_internal_error(arr_err.desc);
+  }
+
+  size_t const action_index = self->actions.len - 1;
+  *queued = *out_action = action_index;
+
+  // after the commands writing its inputs, a cycle never becomes ready
+  for (size_t iii = 0; iii < command->inputs.len; ++iii) {
+    CStr const* input = &((CStr*)command->inputs.data)[iii];
+
+    for (size_t jjj = 0; jjj < cbuild->impl->commands.len; ++jjj) {
+      CArray const* outputs    = &commands[jjj].outputs;
+      bool          is_written = false;
+      for (size_t kkk = 0; !is_written && kkk < outputs->len; ++kkk) {
+        is_written = strcmp(((CStr*)outputs->data)[kkk].data, input->data)
+                     == 0;
+      }
+      if (!is_written) { continue; }
+
+      size_t prerequisite;
+      CError err = internal_cbuild_scheduler_add_command(
+          self, cbuild, command_actions, jjj, &prerequisite);
+      if (err.code == 0) {
+        err = internal_cbuild_scheduler_add_edge(self, prerequisite,
+                                                 action_index);
+      }
+      if (err.code != 0) { return err; }
+    }
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cbuild_scheduler_add_source_commands(CBuildScheduler* self,
+                                              CBuild*          cbuild,
+                                              CArray*      command_actions,
+                                              CTargetImpl* target,
+                                              CStr const*  source,
+                                              size_t       dependent)
+{
+  if (cbuild->impl->commands.len == 0) { return CERROR_none; }
+
+  CArray commands; // CArray< size_t >
+  CError err
+      = cbuild_target_source_commands(cbuild, target, source, &commands);
+  if (err.code != 0) { return err; }
+
+  for (size_t iii = 0; iii < commands.len && err.code == 0; ++iii) {
+    size_t prerequisite;
+    err = internal_cbuild_scheduler_add_command(
+        self, cbuild, command_actions, ((size_t*)commands.data)[iii],
+        &prerequisite);
+    if (err.code == 0) {
+      err = internal_cbuild_scheduler_add_edge(self, prerequisite, dependent);
+    }
+  }
+  c_array_destroy(&commands);
+
+  return err;
+}
+
+uint64_t
+internal_cbuild_scheduler_target_hash(CTargetImpl* target)
+{
+  return c_hash128(&target, sizeof(target), 0).low;
+}
+
+size_t
+internal_cbuild_scheduler_pick(CBuildScheduler* self, bool has_own_dir)
+{
+  size_t const*       ready   = self->ready.data;
+  CBuildAction const* actions = self->actions.data;
+
+  // the latest ready action that fits, a heavy one runs alone at worst
+  for (size_t iii = self->ready.len; iii-- > 0;) {
+    CBuildAction const* action = &actions[ready[iii]];
+    if (self->running_weight != 0
+        && self->running_weight + action->weight > self->jobs) {
+      continue;
+    }
+    // the directory of the process moves only once nothing runs inside it
+    if (!has_own_dir && self->shared_running > 0
+        && self->shared_dir != action->cbuild.impl->base_path.data) {
+      continue;
+    }
+    return iii;
+  }
+
+  return SIZE_MAX;
+}
+
+void
+internal_cbuild_scheduler_worker(void* data)
+{
+  internal_cbuild_scheduler_work(data, true);
+}
+
+void
+internal_cbuild_scheduler_work(CBuildScheduler* self, bool may_own_dir)
+{
+  // reused by every action of the worker, reset after each one
+  CBuildArena scratch;
+  CError      scratch_err
+      = cbuild_arena_create(CBUILD_SCRATCH_BLOCK_SIZE, &scratch);
+
+  // projects of the same build run side by side where a thread can change
+  // its directory without moving the others
+  bool const  has_own_dir = may_own_dir && cbuild_thread_unshare_current_dir();
+  char const* own_dir     = NULL;
+
+  cbuild_mutex_lock(&self->lock);
+
+  if (scratch_err.code != 0) {
+    if (self->err.code == 0) { self->err = scratch_err; }
+    cbuild_cond_broadcast(&self->wakeup);
+    cbuild_mutex_unlock(&self->lock);
+    return;
+  }
+
+  for (;;) {
+    size_t ready_index = SIZE_MAX;
+    while (self->err.code == 0
+           && (ready_index = internal_cbuild_scheduler_pick(self, has_own_dir))
+                  == SIZE_MAX
+           && self->running > 0) {
+      cbuild_cond_wait(&self->wakeup, &self->lock);
+    }
+    // failed, finished or nothing left that could become ready
+    if (self->err.code != 0 || ready_index == SIZE_MAX) { break; }
+
+    size_t action_index = ((size_t*)self->ready.data)[ready_index];
+    c_array_remove(&self->ready, ready_index);
+
+    // `actions` is never resized while running
+    CBuildAction* action = &((CBuildAction*)self->actions.data)[action_index];
+    CStr const*   dir    = &action->cbuild.impl->base_path;
+
+    CError err = CERROR_none;
+    if (has_own_dir) {
+      if (own_dir != dir->data) {
+        c_fs_error_t fs_err = c_fs_dir_change_current(dir->data, dir->len);
+        if (fs_err.code != 0) { err = CERROR_internal_error(fs_err.desc); }
+        own_dir = err.code == 0 ? dir->data : NULL;
+      }
+    } else {
+      if (self->shared_dir != dir->data) {
+        c_fs_error_t fs_err = c_fs_dir_change_current(dir->data, dir->len);
+        if (fs_err.code != 0) { err = CERROR_internal_error(fs_err.desc); }
+        self->shared_dir = err.code == 0 ? dir->data : NULL;
+      }
+      self->shared_running++;
+    }
+
+    self->running++;
+    self->running_weight += action->weight;
+
+    if (err.code == 0) {
+      cbuild_mutex_unlock(&self->lock);
+      err = internal_cbuild_scheduler_exec(action, &scratch);
+      cbuild_arena_reset(&scratch);
+      cbuild_mutex_lock(&self->lock);
+    }
+
+    if (!has_own_dir) { self->shared_running--; }
+    self->running--;
+    self->running_weight -= action->weight;
+    self->done++;
+
+    if (err.code != 0) {
+      if (self->err.code == 0) { self->err = err; }
+    } else {
+      for (size_t iii = 0; iii < action->dependents.len; ++iii) {
+        size_t        dependent_index = ((size_t*)action->dependents.data)[iii];
+        CBuildAction* dependent
+            = &((CBuildAction*)self->actions.data)[dependent_index];
+        if (--dependent->pending == 0) {
+          c_array_error_t arr_err
+              = c_array_push(&self->ready, &dependent_index);
+          if (arr_err.code != 0 && self->err.code == 0) {
+            self->err = CERROR_internal_error(arr_err.desc);
+          }
+        }
+      }
+    }
+
+    cbuild_cond_broadcast(&self->wakeup);
+  }
+
+  cbuild_cond_broadcast(&self->wakeup);
+  cbuild_mutex_unlock(&self->lock);
+
+  cbuild_arena_destroy(&scratch);
+}
+
+CError
+internal_cbuild_scheduler_exec(CBuildAction* action, CBuildArena* scratch)
+{
+  switch (action->kind) {
+  case CBUILD_ACTION_KIND_precompile:
+    return cbuild_target_precompile_header(&action->cbuild, action->target,
+                                           scratch);
+  case CBUILD_ACTION_KIND_compile:
+    return cbuild_target_compile_source(&action->cbuild, action->target,
+                                        action->unit_index, scratch);
+  case CBUILD_ACTION_KIND_link:
+    return cbuild_target_link(&action->cbuild, action->target, scratch);
+  case CBUILD_ACTION_KIND_command:
+    return cbuild_command_run(&action->cbuild, action->command_index,
+                              scratch);
+  default:
+    return CERROR_invalid_target_type;
+  }
+}
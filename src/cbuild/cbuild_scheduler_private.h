@@ -0,0 +1,81 @@
+#ifndef CBUILD_SCHEDULER_PRIVATE_H
+#define CBUILD_SCHEDULER_PRIVATE_H
+
+#include "cbuild.h"
+#include "cbuild_thread_private.h"
+#include "cerror.h"
+
+#include <chash.h>
+
+#include <array.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum CBuildActionKind {
+  CBUILD_ACTION_KIND_precompile,
+  CBUILD_ACTION_KIND_compile,
+  CBUILD_ACTION_KIND_link,
+  CBUILD_ACTION_KIND_command,
+} CBuildActionKind;
+
+typedef struct CBuildAction {
+  CBuildActionKind kind;
+  CBuild           cbuild;
+  CTargetImpl*     target;        // NULL for a command
+  size_t           unit_index;    // compile only
+  size_t           command_index; // command only
+  size_t           weight;        // workers it keeps busy
+  size_t           pending;       // unfinished prerequisites
+  CArray           dependents;    // CArray< size_t >
+} CBuildAction;
+
+/// the actions of a target inside `CBuildScheduler::actions`
+typedef struct CBuildTargetActions {
+  CTargetImpl* target;
+  size_t       precompile; // SIZE_MAX without a precompiled header
+  size_t       compile_begin;
+  size_t       compile_end;
+  size_t       link; // SIZE_MAX if the target is not linked
+} CBuildTargetActions;
+
+/// runs the actions of one or more configured projects on a pool of
+/// workers, an action starts as soon as all of its prerequisites are done
+/// and enough of the `jobs` are free for its weight.
+/// actions run inside the directory of their project, a worker that can't
+/// have a current directory of its own shares the one of the process and
+/// only runs actions of the project it is in
+typedef struct CBuildScheduler {
+  CArray      actions;      // CArray< CBuildAction >
+  CArray      ready;        // CArray< size_t >, indices inside `actions`
+  CArray      targets;      // CArray< CBuildTargetActions >
+  CHashIndex  target_index; // hash(target) -> index inside `targets`
+  size_t      jobs;
+  size_t      running;
+  size_t      running_weight;
+  size_t      done;
+  char const* shared_dir;     // project the process is inside, NULL if none
+  size_t      shared_running; // actions running inside `shared_dir`
+  CError      err;
+  CBuildMutex lock;
+  CBuildCond  wakeup;
+} CBuildScheduler;
+
+/// `jobs` = 0 means one worker per cpu
+CError cbuild_scheduler_create(size_t jobs, CBuildScheduler* out_scheduler);
+
+/// queue the compile and link actions of the selected targets of `cbuild`
+/// (`CTargetImpl::is_selected`), after the ones of the targets they depend
+/// on, in this project or in the ones added before. the custom commands
+/// they read come first, configurations of the same project share them.
+/// `is_partial` runs only the commands read
+CError cbuild_scheduler_add_project(CBuildScheduler* self,
+                                    CBuild*          cbuild,
+                                    bool             is_partial);
+
+/// run all queued actions, the first failure stops starting new actions
+CError cbuild_scheduler_run(CBuildScheduler* self);
+
+void cbuild_scheduler_destroy(CBuildScheduler* self);
+
+#endif // CBUILD_SCHEDULER_PRIVATE_H
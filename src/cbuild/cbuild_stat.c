@@ -0,0 +1,431 @@
+#include "cbuild_stat_private.h"
+#include "cbuild_thread_private.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <defer.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/stat.h>
+#include <linux/version.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef __NR_statx
+#define CBUILD_STAT_HAS_STATX 1
+#endif
+
+// <linux/io_uring.h> knows IORING_OP_STATX since 5.6, the running kernel
+// is asked at runtime
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)                             \
+    && defined(__NR_io_uring_setup)
+#define CBUILD_STAT_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4996) // disable warning about unsafe functions
+#endif
+
+/// below that many paths the setup costs more than it saves
+#define CBUILD_STAT_SERIAL_MAX_LEN 256
+
+/// paths a worker claims at once
+#define CBUILD_STAT_CHUNK_LEN 64
+
+/// statx waits on the disk or the network far more than on the cpu
+#define CBUILD_STAT_THREADS_MAX_LEN 32
+
+/// requests in flight inside the ring
+#define CBUILD_STAT_RING_LEN 256
+
+typedef struct CBuildStatJob {
+  char const* const* paths;
+  size_t             paths_len;
+  CBuildFileState*   out_states;
+  size_t             next;
+  CBuildMutex        lock;
+} CBuildStatJob;
+
+static void   internal_cbuild_stat_serial(char const* const paths[],
+                                          size_t            paths_len,
+                                          CBuildFileState   out_states[]);
+static CError internal_cbuild_stat_threads(char const* const paths[],
+                                           size_t            paths_len,
+                                           CBuildFileState   out_states[]);
+static void   internal_cbuild_stat_worker(void* data);
+static void   internal_cbuild_statx(char const path[], CBuildFileState* out);
+#ifdef CBUILD_STAT_HAS_STATX
+static void internal_cbuild_stat_from_statx(struct statx const* buf,
+                                            CBuildFileState*    out_state);
+#endif
+#ifdef CBUILD_STAT_HAS_IO_URING
+static CError internal_cbuild_stat_io_uring(char const* const paths[],
+                                            size_t            paths_len,
+                                            CBuildFileState   out_states[]);
+#endif
+
+void
+cbuild_stat(char const path[], CBuildFileState* out_state)
+{
+  assert(path);
+  assert(out_state);
+
+  *out_state = (CBuildFileState){0};
+
+#ifdef _WIN32
+  struct _stat64 file_stat;
+  if (_stat64(path, &file_stat) != 0) { return; }
+
+  out_state->inode = 0;
+  out_state->mtime = (int64_t)file_stat.st_mtime * 1000000000LL;
+#else
+  struct stat file_stat;
+  if (stat(path, &file_stat) != 0) { return; }
+
+  out_state->inode = (uint64_t)file_stat.st_ino;
+#ifdef __APPLE__
+  out_state->mtime = (int64_t)file_stat.st_mtimespec.tv_sec * 1000000000LL
+                     + file_stat.st_mtimespec.tv_nsec;
+#else
+  out_state->mtime = (int64_t)file_stat.st_mtim.tv_sec * 1000000000LL
+                     + file_stat.st_mtim.tv_nsec;
+#endif
+#endif
+  out_state->size   = (uint64_t)file_stat.st_size;
+  out_state->exists = true;
+}
+
+CError
+cbuild_stat_many(char const* const paths[],
+                 size_t            paths_len,
+                 CBuildFileState   out_states[],
+                 CBuildStatImpl    impl)
+{
+  assert(paths || paths_len == 0);
+  assert(out_states || paths_len == 0);
+
+  switch (impl) {
+  case CBUILD_STAT_IMPL_auto:
+    if (paths_len <= CBUILD_STAT_SERIAL_MAX_LEN) {
+      internal_cbuild_stat_serial(paths, paths_len, out_states);
+      return CERROR_none;
+    }
+#ifdef CBUILD_STAT_HAS_IO_URING
+    // seccomp, io_uring_disabled or an old kernel
+    if (internal_cbuild_stat_io_uring(paths, paths_len, out_states).code
+        == 0) {
+      return CERROR_none;
+    }
+#endif
+    return internal_cbuild_stat_threads(paths, paths_len, out_states);
+  case CBUILD_STAT_IMPL_serial:
+    internal_cbuild_stat_serial(paths, paths_len, out_states);
+    return CERROR_none;
+  case CBUILD_STAT_IMPL_threads:
+    return internal_cbuild_stat_threads(paths, paths_len, out_states);
+  case CBUILD_STAT_IMPL_io_uring:
+#ifdef CBUILD_STAT_HAS_IO_URING
+    return internal_cbuild_stat_io_uring(paths, paths_len, out_states);
+#else
+    return CERROR_internal_error("c: io_uring is not available");
+#endif
+  default:
+    return CERROR_wrong_options;
+  }
+}
+
+// ------------------------------------------------------------------------//
+// ------------------------------ Internals -------------------------------//
+// ------------------------------------------------------------------------//
+
+void
+internal_cbuild_stat_serial(char const* const paths[],
+                            size_t            paths_len,
+                            CBuildFileState   out_states[])
+{
+  for (size_t iii = 0; iii < paths_len; ++iii) {
+    cbuild_stat(paths[iii], &out_states[iii]);
+  }
+}
+
+CError
+internal_cbuild_stat_threads(char const* const paths[],
+                             size_t            paths_len,
+                             CBuildFileState   out_states[])
+{
+  CError        err     = CERROR_none;
+  CBuildThread* workers = NULL;
+  CBuildStatJob job     = {
+          .paths      = paths,
+          .paths_len  = paths_len,
+          .out_states = out_states,
+  };
+
+  c_defer_init(4);
+
+  c_defer_check(cbuild_mutex_create(&job.lock), NULL, NULL,
+                err = CERROR_internal_error("c: failed to create a mutex"));
+
+  size_t workers_len = cbuild_thread_get_cpu_count() * 2;
+  if (workers_len > CBUILD_STAT_THREADS_MAX_LEN) {
+    workers_len = CBUILD_STAT_THREADS_MAX_LEN;
+  }
+  size_t const chunks_len
+      = (paths_len + CBUILD_STAT_CHUNK_LEN - 1) / CBUILD_STAT_CHUNK_LEN;
+  if (workers_len > chunks_len) { workers_len = chunks_len; }
+
+  workers = calloc(workers_len > 0 ? workers_len : 1, sizeof(CBuildThread));
+  c_defer_err(workers, free, workers,
+              (cbuild_mutex_destroy(&job.lock),
+               err = CERROR_memory_allocation));
+
+  CBuildThreadStart start = {internal_cbuild_stat_worker, &job};
+
+  size_t started = 0;
+  for (; started < workers_len; ++started) {
+    if (!cbuild_thread_create(&start, &workers[started])) { break; }
+  }
+  // whatever the workers did not take is done here
+  internal_cbuild_stat_worker(&job);
+
+  for (size_t iii = 0; iii < started; ++iii) {
+    cbuild_thread_join(workers[iii]);
+  }
+
+  cbuild_mutex_destroy(&job.lock);
+
+  c_defer_deinit();
+
+  return err;
+}
+
+void
+internal_cbuild_stat_worker(void* data)
+{
+  CBuildStatJob* job = data;
+
+  for (;;) {
+    cbuild_mutex_lock(&job->lock);
+    size_t const begin = job->next;
+    job->next += CBUILD_STAT_CHUNK_LEN;
+    cbuild_mutex_unlock(&job->lock);
+
+    if (begin >= job->paths_len) { break; }
+
+    size_t end = begin + CBUILD_STAT_CHUNK_LEN;
+    if (end > job->paths_len) { end = job->paths_len; }
+
+    for (size_t iii = begin; iii < end; ++iii) {
+      internal_cbuild_statx(job->paths[iii], &job->out_states[iii]);
+    }
+  }
+}
+
+void
+internal_cbuild_statx(char const path[], CBuildFileState* out_state)
+{
+#ifdef CBUILD_STAT_HAS_STATX
+  // only the fields the up-to-date checks need
+  struct statx buf;
+  if (syscall(__NR_statx, AT_FDCWD, path, 0,
+              STATX_INO | STATX_MTIME | STATX_SIZE, &buf)
+      == 0) {
+    internal_cbuild_stat_from_statx(&buf, out_state);
+    return;
+  }
+  if (errno != ENOSYS) {
+    *out_state = (CBuildFileState){0};
+    return;
+  }
+#endif
+  cbuild_stat(path, out_state);
+}
+
+#ifdef CBUILD_STAT_HAS_STATX
+void
+internal_cbuild_stat_from_statx(struct statx const* buf,
+                                CBuildFileState*    out_state)
+{
+  out_state->inode  = (uint64_t)buf->stx_ino;
+  out_state->mtime  = (int64_t)buf->stx_mtime.tv_sec * 1000000000LL
+                      + buf->stx_mtime.tv_nsec;
+  out_state->size   = (uint64_t)buf->stx_size;
+  out_state->exists = true;
+}
+#endif
+
+#ifdef CBUILD_STAT_HAS_IO_URING
+CError
+internal_cbuild_stat_io_uring(char const* const paths[],
+                              size_t            paths_len,
+                              CBuildFileState   out_states[])
+{
+  CError                 err      = CERROR_none;
+  struct io_uring_params params   = {0};
+  int                    ring_fd  = -1;
+  void*                  sq_ptr   = MAP_FAILED;
+  void*                  cq_ptr   = MAP_FAILED;
+  struct io_uring_sqe*   sqes     = MAP_FAILED;
+  size_t                 sq_size  = 0;
+  size_t                 cq_size  = 0;
+  struct statx*          bufs     = NULL; // one per slot
+  size_t*                slots    = NULL; // free slots
+  size_t*                owners   = NULL; // slot -> index inside `paths`
+  size_t                 next     = 0;    // first path not submitted
+  size_t                 done     = 0;    // paths completed
+
+  c_defer_init(8);
+
+  ring_fd = (int)syscall(__NR_io_uring_setup, CBUILD_STAT_RING_LEN, &params);
+  c_defer_check(ring_fd >= 0, NULL, NULL,
+                err = CERROR_internal_error("c: io_uring is not available"));
+
+  sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_size = params.cq_off.cqes
+            + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+  }
+
+  sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  cq_ptr = (params.features & IORING_FEAT_SINGLE_MMAP)
+               ? sq_ptr
+               : mmap(NULL, cq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+  sqes   = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                IORING_OFF_SQES);
+  c_defer_check(sq_ptr != MAP_FAILED && cq_ptr != MAP_FAILED
+                    && sqes != MAP_FAILED,
+                NULL, NULL,
+                err = CERROR_internal_error("c: failed to map io_uring"));
+
+  size_t const slots_len = params.sq_entries < params.cq_entries
+                               ? params.sq_entries
+                               : params.cq_entries;
+  bufs   = calloc(slots_len, sizeof(struct statx));
+  slots  = calloc(slots_len, sizeof(size_t));
+  owners = calloc(slots_len, sizeof(size_t));
+  c_defer_check(bufs && slots && owners, NULL, NULL,
+                err = CERROR_memory_allocation);
+  for (size_t iii = 0; iii < slots_len; ++iii) {
+    slots[iii] = iii;
+  }
+  size_t free_slots_len = slots_len;
+
+  char* const sq = sq_ptr;
+  char* const cq = cq_ptr;
+
+  unsigned* const sq_tail  = (unsigned*)(sq + params.sq_off.tail);
+  unsigned* const sq_mask  = (unsigned*)(sq + params.sq_off.ring_mask);
+  unsigned* const sq_array = (unsigned*)(sq + params.sq_off.array);
+  unsigned* const cq_head  = (unsigned*)(cq + params.cq_off.head);
+  unsigned* const cq_tail  = (unsigned*)(cq + params.cq_off.tail);
+  unsigned* const cq_mask  = (unsigned*)(cq + params.cq_off.ring_mask);
+
+  struct io_uring_cqe* const cqes
+      = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+  while (done < paths_len) {
+    // fill every free slot
+    unsigned tail      = *sq_tail;
+    unsigned submitted = 0;
+    while (next < paths_len && free_slots_len > 0) {
+      size_t const slot = slots[--free_slots_len];
+      owners[slot]      = next;
+
+      unsigned const       index = tail & *sq_mask;
+      struct io_uring_sqe* sqe   = &sqes[index];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode      = IORING_OP_STATX;
+      sqe->fd          = AT_FDCWD;
+      sqe->addr        = (uint64_t)(uintptr_t)paths[next];
+      sqe->len         = STATX_INO | STATX_MTIME | STATX_SIZE;
+      sqe->off         = (uint64_t)(uintptr_t)&bufs[slot];
+      sqe->statx_flags = 0;
+      sqe->user_data   = slot;
+      sq_array[index]  = index;
+
+      tail++;
+      submitted++;
+      next++;
+    }
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+    int const entered = (int)syscall(__NR_io_uring_enter, ring_fd, submitted,
+                                     1, IORING_ENTER_GETEVENTS, NULL, 0);
+    c_defer_check(entered >= 0 || errno == EINTR, NULL, NULL,
+                  err = CERROR_internal_error("c: io_uring_enter failed"));
+
+    // reap everything that completed
+    unsigned head = *cq_head;
+    while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe const* cqe  = &cqes[head & *cq_mask];
+      size_t const               slot = (size_t)cqe->user_data;
+      CBuildFileState* const     out  = &out_states[owners[slot]];
+
+      if (cqe->res == 0) {
+        internal_cbuild_stat_from_statx(&bufs[slot], out);
+      } else if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP) {
+        // the kernel has io_uring without IORING_OP_STATX
+        internal_cbuild_statx(paths[owners[slot]], out);
+      } else {
+        *out = (CBuildFileState){0};
+      }
+
+      slots[free_slots_len++] = slot;
+      done++;
+      head++;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+  }
+
+  c_defer_deinit();
+
+  // a failure can leave statx calls in flight, they write into `bufs`
+  // until they complete and closing the ring doesn't wait for them. the
+  // ring is drained first, `bufs` is leaked if it can't be
+  size_t in_flight = next - done;
+  while (in_flight > 0) {
+    int const entered = (int)syscall(__NR_io_uring_enter, ring_fd, 0, 1,
+                                     IORING_ENTER_GETEVENTS, NULL, 0);
+    if (entered < 0 && errno != EINTR) { break; }
+
+    unsigned* const cq_head = (unsigned*)((char*)cq_ptr + params.cq_off.head);
+    unsigned* const cq_tail = (unsigned*)((char*)cq_ptr + params.cq_off.tail);
+    unsigned        head    = *cq_head;
+    for (; head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE); ++head) {
+      in_flight--;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+  }
+
+  if (ring_fd >= 0) { close(ring_fd); }
+  if (sqes != MAP_FAILED) {
+    munmap(sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+  }
+  if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) { munmap(cq_ptr, cq_size); }
+  if (sq_ptr != MAP_FAILED) { munmap(sq_ptr, sq_size); }
+  free(owners);
+  free(slots);
+  if (in_flight == 0) { free(bufs); }
+
+  return err;
+}
+#endif
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
@@ -0,0 +1,40 @@
+#ifndef CBUILD_STAT_PRIVATE_H
+#define CBUILD_STAT_PRIVATE_H
+
+/// file state scanning, the up-to-date checks need the state of every
+/// input and output of a project before anything else
+
+#include "cbuild.h"
+#include "cerror.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct CBuildFileState {
+  uint64_t inode;
+  int64_t  mtime; // nanoseconds
+  uint64_t size;
+  bool     exists;
+} CBuildFileState;
+
+typedef enum CBuildStatImpl {
+  CBUILD_STAT_IMPL_auto,
+  CBUILD_STAT_IMPL_serial,   // one stat() after the other
+  CBUILD_STAT_IMPL_threads,  // statx() spread over a pool of threads
+  CBUILD_STAT_IMPL_io_uring, // batches of IORING_OP_STATX, linux >= 5.6
+} CBuildStatImpl;
+
+/// a missing file gives a zeroed state
+__C_DLL__ void cbuild_stat(char const path[], CBuildFileState* out_state);
+
+/// `out_states[i]` = state of `paths[i]`.
+/// `CBUILD_STAT_IMPL_auto` goes serial for small batches, then io_uring,
+/// then threads, whichever is available first. an explicitly requested
+/// implementation that is not available fails
+__C_DLL__ CError cbuild_stat_many(char const* const paths[],
+                                  size_t            paths_len,
+                                  CBuildFileState   out_states[],
+                                  CBuildStatImpl    impl);
+
+#endif // CBUILD_STAT_PRIVATE_H
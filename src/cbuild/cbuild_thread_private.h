@@ -0,0 +1,184 @@
+#ifndef CBUILD_THREAD_PRIVATE_H
+#define CBUILD_THREAD_PRIVATE_H
+
+/// minimal threading layer for the build scheduler, C99 has no threads
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/sched.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION   CBuildMutex;
+typedef CONDITION_VARIABLE CBuildCond;
+typedef HANDLE             CBuildThread;
+#else
+typedef pthread_mutex_t CBuildMutex;
+typedef pthread_cond_t  CBuildCond;
+typedef pthread_t       CBuildThread;
+#endif
+
+typedef void (*CBuildThreadFn)(void* data);
+
+typedef struct CBuildThreadStart {
+  CBuildThreadFn fn;
+  void*          data;
+} CBuildThreadStart;
+
+static inline bool
+cbuild_mutex_create(CBuildMutex* mutex)
+{
+#ifdef _WIN32
+  InitializeCriticalSection(mutex);
+  return true;
+#else
+  return pthread_mutex_init(mutex, NULL) == 0;
+#endif
+}
+
+static inline void
+cbuild_mutex_lock(CBuildMutex* mutex)
+{
+#ifdef _WIN32
+  EnterCriticalSection(mutex);
+#else
+  pthread_mutex_lock(mutex);
+#endif
+}
+
+static inline void
+cbuild_mutex_unlock(CBuildMutex* mutex)
+{
+#ifdef _WIN32
+  LeaveCriticalSection(mutex);
+#else
+  pthread_mutex_unlock(mutex);
+#endif
+}
+
+static inline void
+cbuild_mutex_destroy(CBuildMutex* mutex)
+{
+#ifdef _WIN32
+  DeleteCriticalSection(mutex);
+#else
+  pthread_mutex_destroy(mutex);
+#endif
+}
+
+static inline bool
+cbuild_cond_create(CBuildCond* cond)
+{
+#ifdef _WIN32
+  InitializeConditionVariable(cond);
+  return true;
+#else
+  return pthread_cond_init(cond, NULL) == 0;
+#endif
+}
+
+static inline void
+cbuild_cond_wait(CBuildCond* cond, CBuildMutex* mutex)
+{
+#ifdef _WIN32
+  SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+  pthread_cond_wait(cond, mutex);
+#endif
+}
+
+static inline void
+cbuild_cond_broadcast(CBuildCond* cond)
+{
+#ifdef _WIN32
+  WakeAllConditionVariable(cond);
+#else
+  pthread_cond_broadcast(cond);
+#endif
+}
+
+static inline void
+cbuild_cond_destroy(CBuildCond* cond)
+{
+#ifdef _WIN32
+  (void)cond;
+#else
+  pthread_cond_destroy(cond);
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+cbuild_thread_entry(LPVOID start)
+{
+  ((CBuildThreadStart*)start)->fn(((CBuildThreadStart*)start)->data);
+  return 0;
+}
+#else
+static inline void*
+cbuild_thread_entry(void* start)
+{
+  ((CBuildThreadStart*)start)->fn(((CBuildThreadStart*)start)->data);
+  return NULL;
+}
+#endif
+
+/// `start` must outlive the thread
+static inline bool
+cbuild_thread_create(CBuildThreadStart* start, CBuildThread* out_thread)
+{
+#ifdef _WIN32
+  *out_thread = CreateThread(NULL, 0, cbuild_thread_entry, start, 0, NULL);
+  return *out_thread != NULL;
+#else
+  return pthread_create(out_thread, NULL, cbuild_thread_entry, start) == 0;
+#endif
+}
+
+static inline void
+cbuild_thread_join(CBuildThread thread)
+{
+#ifdef _WIN32
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  pthread_join(thread, NULL);
+#endif
+}
+
+/// give the calling thread a current directory of its own, false where
+/// the threads of a process can only share one
+static inline bool
+cbuild_thread_unshare_current_dir(void)
+{
+#if defined(__linux__) && defined(__NR_unshare)
+  return syscall(__NR_unshare, CLONE_FS) == 0;
+#else
+  return false;
+#endif
+}
+
+static inline size_t
+cbuild_thread_get_cpu_count(void)
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (size_t)count : 1;
+#endif
+}
+
+#endif // CBUILD_THREAD_PRIVATE_H
@@ -0,0 +1,358 @@
+#include "cbuild_toc_private.h"
+#include "helpers.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <defer.h>
+
+#ifdef __linux__
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// the mapped library, every read is bounds checked against it
+typedef struct CBuildTocImage {
+  unsigned char const* data;
+  size_t               size;
+  bool                 is_64;
+} CBuildTocImage;
+
+/// what the table of contents needs of a section header, either class
+typedef struct CBuildTocSection {
+  uint32_t type;
+  uint32_t link;
+  uint64_t offset;
+  uint64_t size;
+  uint64_t entsize;
+} CBuildTocSection;
+
+typedef struct CBuildTocSymbol {
+  char const*   name;
+  unsigned char kind; // STT_*
+  unsigned char bind; // STB_*
+  uint64_t      size;
+} CBuildTocSymbol;
+
+static CError      internal_cbuild_toc_parse(CBuildTocImage const* image,
+                                             CStr*                 out_toc);
+static bool        internal_cbuild_toc_get_section(CBuildTocImage const* image,
+                                                   size_t                index,
+                                                   CBuildTocSection* out);
+static char const* internal_cbuild_toc_get_string(CBuildTocImage const* image,
+                                                  size_t   strtab_index,
+                                                  uint64_t offset);
+static int         internal_cbuild_toc_symbol_compare(void const* lhs,
+                                                      void const* rhs);
+#endif
+
+CError
+cbuild_toc_read(char const path[], size_t path_len, CStr* out_toc)
+{
+  assert(path && path_len > 0);
+  assert(out_toc);
+
+  if (path[path_len] != '\0') { return CERROR_invalid_string; }
+
+  c_str_error_t str_err = c_str_create_empty(256, out_toc);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+#ifdef __linux__
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) { return CERROR_none; }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+      || (size_t)file_stat.st_size < sizeof(Elf32_Ehdr)) {
+    close(fd);
+    return CERROR_none;
+  }
+
+  // only the headers and the dynamic sections are ever paged in
+  CBuildTocImage image = {.size = (size_t)file_stat.st_size};
+  void* data = mmap(NULL, image.size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) { return CERROR_none; }
+  image.data = data;
+
+  uint16_t const probe       = 1;
+  unsigned char  host_endian = *(unsigned char const*)&probe == 1
+                                   ? ELFDATA2LSB
+                                   : ELFDATA2MSB;
+
+  CError err = CERROR_none;
+  if (memcmp(image.data, ELFMAG, SELFMAG) == 0
+      && image.data[EI_DATA] == host_endian
+      && (image.data[EI_CLASS] == ELFCLASS32
+          || (image.data[EI_CLASS] == ELFCLASS64
+              && image.size >= sizeof(Elf64_Ehdr)))) {
+    image.is_64 = image.data[EI_CLASS] == ELFCLASS64;
+    err         = internal_cbuild_toc_parse(&image, out_toc);
+  }
+
+  munmap(data, image.size);
+
+  return err;
+#else
+  // the caller falls back to the whole library
+  return CERROR_none;
+#endif
+}
+
+#ifdef __linux__
+CError
+internal_cbuild_toc_parse(CBuildTocImage const* image, CStr* out_toc)
+{
+  CError           err         = CERROR_none;
+  CBuildTocSymbol* symbols     = NULL;
+  size_t           symbols_len = 0;
+
+  uint64_t section_headers_len = 0;
+  if (image->is_64) {
+    Elf64_Ehdr header;
+    memcpy(&header, image->data, sizeof(header));
+    section_headers_len = header.e_shnum;
+  } else {
+    Elf32_Ehdr header;
+    memcpy(&header, image->data, sizeof(header));
+    section_headers_len = header.e_shnum;
+  }
+
+  // .dynsym is what the dynamic linker resolves against, .dynamic names
+  // the library
+  CBuildTocSection dynsym        = {0};
+  CBuildTocSection dynamic       = {0};
+  size_t           dynsym_index  = 0;
+  size_t           dynamic_index = 0;
+  for (size_t iii = 0; iii < section_headers_len; ++iii) {
+    CBuildTocSection section;
+    if (!internal_cbuild_toc_get_section(image, iii, &section)) {
+      return CERROR_none;
+    }
+    if (section.type == SHT_DYNSYM) {
+      dynsym       = section;
+      dynsym_index = iii;
+    } else if (section.type == SHT_DYNAMIC) {
+      dynamic       = section;
+      dynamic_index = iii;
+    }
+  }
+  size_t const sym_entry_size
+      = image->is_64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+  if (dynsym_index == 0 || dynsym.entsize < sym_entry_size) {
+    return CERROR_none;
+  }
+
+  c_defer_init(2);
+
+  c_str_error_t str_err = C_STR_ERROR_none;
+
+  // soname <name>
+  size_t const dyn_entry_size
+      = image->is_64 ? sizeof(Elf64_Dyn) : sizeof(Elf32_Dyn);
+  uint64_t const dynamic_end = dynamic.offset + dynamic.size;
+  for (uint64_t offset = dynamic.offset;
+       dynamic_index != 0 && offset + dyn_entry_size <= dynamic_end;
+       offset += dyn_entry_size) {
+    int64_t  tag;
+    uint64_t value;
+    if (image->is_64) {
+      Elf64_Dyn entry;
+      memcpy(&entry, &image->data[offset], sizeof(entry));
+      tag   = entry.d_tag;
+      value = entry.d_un.d_val;
+    } else {
+      Elf32_Dyn entry;
+      memcpy(&entry, &image->data[offset], sizeof(entry));
+      tag   = entry.d_tag;
+      value = entry.d_un.d_val;
+    }
+    if (tag == DT_NULL) { break; }
+    if (tag != DT_SONAME) { continue; }
+
+    char const* soname
+        = internal_cbuild_toc_get_string(image, dynamic.link, value);
+    if (soname) {
+      str_err = c_str_format(out_toc, out_toc->len, C_STR_INV("soname %s\n"),
+                             soname);
+      c_defer_check(str_err.code == 0, NULL, NULL,
+                    err = CERROR_internal_error(str_err.desc));
+    }
+  }
+
+  // the first symbol is always the undefined one, an empty section has no
+  // symbols at all and nothing to allocate
+  size_t const dynsym_len = dynsym.size / dynsym.entsize;
+  if (dynsym_len > 0) { symbols = calloc(dynsym_len, sizeof(CBuildTocSymbol)); }
+  c_defer_err(symbols || dynsym_len == 0, free, symbols,
+              err = CERROR_memory_allocation);
+
+  for (size_t iii = 1; iii < dynsym_len; ++iii) {
+    uint64_t const offset = dynsym.offset + iii * dynsym.entsize;
+
+    CBuildTocSymbol symbol = {0};
+    uint64_t        name   = 0;
+    uint16_t        index  = SHN_UNDEF;
+    if (image->is_64) {
+      Elf64_Sym entry;
+      memcpy(&entry, &image->data[offset], sizeof(entry));
+      name        = entry.st_name;
+      index       = entry.st_shndx;
+      symbol.kind = ELF64_ST_TYPE(entry.st_info);
+      symbol.bind = ELF64_ST_BIND(entry.st_info);
+      symbol.size = entry.st_size;
+    } else {
+      Elf32_Sym entry;
+      memcpy(&entry, &image->data[offset], sizeof(entry));
+      name        = entry.st_name;
+      index       = entry.st_shndx;
+      symbol.kind = ELF32_ST_TYPE(entry.st_info);
+      symbol.bind = ELF32_ST_BIND(entry.st_info);
+      symbol.size = entry.st_size;
+    }
+
+    // what the library needs from others is not part of its interface
+    if (index == SHN_UNDEF || symbol.bind == STB_LOCAL) { continue; }
+
+    symbol.name = internal_cbuild_toc_get_string(image, dynsym.link, name);
+    if (symbol.name) { symbols[symbols_len++] = symbol; }
+  }
+
+  if (symbols_len > 1) {
+    qsort(symbols, symbols_len, sizeof(CBuildTocSymbol),
+          internal_cbuild_toc_symbol_compare);
+  }
+
+  // <name> <f|o|t|i|x><g|w> [<size>]
+  // a function may grow freely, a variable that grows breaks the copy
+  // relocations of the executables
+  for (size_t iii = 0; iii < symbols_len && str_err.code == 0; ++iii) {
+    CBuildTocSymbol const* symbol = &symbols[iii];
+
+    char kind = 'x';
+    switch (symbol->kind) {
+    case STT_FUNC:
+      kind = 'f';
+      break;
+    case STT_OBJECT:
+      kind = 'o';
+      break;
+    case STT_TLS:
+      kind = 't';
+      break;
+    case STT_GNU_IFUNC:
+      kind = 'i';
+      break;
+    default:
+      break;
+    }
+
+    if (kind == 'o' || kind == 't') {
+      str_err = c_str_format(out_toc, out_toc->len,
+                             C_STR_INV("%s %c%c %llu\n"), symbol->name, kind,
+                             symbol->bind == STB_WEAK ? 'w' : 'g',
+                             (unsigned long long)symbol->size);
+    } else {
+      str_err = c_str_format(out_toc, out_toc->len, C_STR_INV("%s %c%c\n"),
+                             symbol->name, kind,
+                             symbol->bind == STB_WEAK ? 'w' : 'g');
+    }
+  }
+  c_defer_check(str_err.code == 0, NULL, NULL,
+                err = CERROR_internal_error(str_err.desc));
+
+  c_defer_deinit();
+
+  return err;
+}
+
+bool
+internal_cbuild_toc_get_section(CBuildTocImage const* image,
+                                size_t                index,
+                                CBuildTocSection*     out)
+{
+  uint64_t section_headers;
+  uint64_t section_header_size;
+  if (image->is_64) {
+    Elf64_Ehdr header;
+    memcpy(&header, image->data, sizeof(header));
+    section_headers     = header.e_shoff;
+    section_header_size = header.e_shentsize;
+  } else {
+    Elf32_Ehdr header;
+    memcpy(&header, image->data, sizeof(header));
+    section_headers     = header.e_shoff;
+    section_header_size = header.e_shentsize;
+  }
+
+  uint64_t const offset = section_headers + index * section_header_size;
+  if (image->is_64) {
+    Elf64_Shdr section;
+    if (section_header_size < sizeof(section)
+        || offset + sizeof(section) > image->size) {
+      return false;
+    }
+    memcpy(&section, &image->data[offset], sizeof(section));
+    *out = (CBuildTocSection){section.sh_type, section.sh_link,
+                              section.sh_offset, section.sh_size,
+                              section.sh_entsize};
+  } else {
+    Elf32_Shdr section;
+    if (section_header_size < sizeof(section)
+        || offset + sizeof(section) > image->size) {
+      return false;
+    }
+    memcpy(&section, &image->data[offset], sizeof(section));
+    *out = (CBuildTocSection){section.sh_type, section.sh_link,
+                              section.sh_offset, section.sh_size,
+                              section.sh_entsize};
+  }
+
+  // .bss like sections take no room inside the file
+  return out->type == SHT_NOBITS
+         || (out->offset <= image->size
+             && out->size <= image->size - out->offset);
+}
+
+char const*
+internal_cbuild_toc_get_string(CBuildTocImage const* image,
+                               size_t                strtab_index,
+                               uint64_t              offset)
+{
+  CBuildTocSection strtab;
+  if (!internal_cbuild_toc_get_section(image, strtab_index, &strtab)
+      || strtab.type != SHT_STRTAB || offset >= strtab.size) {
+    return NULL;
+  }
+
+  char const* string = (char const*)&image->data[strtab.offset + offset];
+
+  return memchr(string, '\0', strtab.size - offset) ? string : NULL;
+}
+
+int
+internal_cbuild_toc_symbol_compare(void const* lhs, void const* rhs)
+{
+  CBuildTocSymbol const* lhs_symbol = lhs;
+  CBuildTocSymbol const* rhs_symbol = rhs;
+
+  int const order = strcmp(lhs_symbol->name, rhs_symbol->name);
+  if (order != 0) { return order; }
+
+  // versioned symbols share their names
+  if (lhs_symbol->kind != rhs_symbol->kind) {
+    return (int)lhs_symbol->kind - (int)rhs_symbol->kind;
+  }
+  if (lhs_symbol->bind != rhs_symbol->bind) {
+    return (int)lhs_symbol->bind - (int)rhs_symbol->bind;
+  }
+
+  return (lhs_symbol->size > rhs_symbol->size)
+         - (lhs_symbol->size < rhs_symbol->size);
+}
+#endif
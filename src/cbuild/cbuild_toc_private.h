@@ -0,0 +1,23 @@
+#ifndef CBUILD_TOC_PRIVATE_H
+#define CBUILD_TOC_PRIVATE_H
+
+/// table of contents of a shared library, what the targets linking it
+/// depend on. a library that changed without changing it doesn't get them
+/// linked again
+
+#include "cbuild.h"
+#include "cerror.h"
+
+#include <str.h>
+
+#include <stddef.h>
+
+/// `out_toc` = soname and sorted exported dynamic symbols of the elf
+/// shared library `path`, one per line with their kind and the size of the
+/// data ones. it stays empty when `path` is not an elf file of this host,
+/// the whole library is the interface then
+__C_DLL__ CError cbuild_toc_read(char const path[],
+                                 size_t     path_len,
+                                 CStr*      out_toc);
+
+#endif // CBUILD_TOC_PRIVATE_H
@@ -10,6 +10,16 @@ typedef struct CBuilder {
     char const* release_with_minimum_size;
     char const* compile;
     char const* include_path;
+    char const* depfile;
+    char const* precompile_header;
+    char const* force_include;
+    char const* lto_full;
+    char const* lto_parallel;
+    char const* pgo_generate;    // + <profile path>, empty if not supported
+    char const* pgo_use;         // + <profile path>
+    char const* pgo_prefix_path; // + <config tree>, empty if not needed
+    char const* split_dwarf;     // empty if not supported
+    char const* compress_debug;  // empty if not supported
   } cflags;
 
   struct {
@@ -20,25 +30,41 @@ typedef struct CBuilder {
     char const* release_with_minimum_size;
     char const* library_path;
     char const* library;
+    char const* lto_full;
+    char const* lto_parallel;
+    char const* lto_cache_dir; // empty if not supported
+    char const* pgo_generate;
+    char const* use_linker; // + <linker name>, empty if not supported
+    char const* gdb_index;  // not understood by ld.bfd
+    char const* compress_debug;
   } lflags;
 
   struct {
     char const* output;
     char const* shared_library;
     char const* static_library;
+    char const* static_library_thin;   // empty if not supported
+    char const* static_library_delete; // empty if not supported
   } flags;
 
   struct {
     char const* exe;
     char const* object;
+    char const* depfile;
     char const* lib_shared;
     char const* lib_static;
+    char const* precompiled_header; // empty if not supported
+    char const* profile_raw;        // what an instrumented run writes
+    char const* profile;            // what the merger writes
+    char const* split_dwarf;        // next to every object
   } extension;
 
   char const* compiler;
   char const* linker;
   char const* archiver_shared;
   char const* archiver_static;
+  char const* archiver_static_lto; // keeps the symbols of lto objects
+  char const* profile_merger;      // empty if runs merge on their own
 } CBuilder;
 
 enum CBuilderType {
@@ -53,48 +79,107 @@ static CBuilder builders[] = {
       .linker = "gcc",
       .archiver_shared = "gcc",
       .archiver_static = "ar",
+      .archiver_static_lto = "gcc-ar",
+      .profile_merger = "",
       .cflags = { "",
                   "-g",
                   "-O3 -DNDEBUG",
                   "-O2 -g -DNDEBUG",
                   "-Os -DNDEBUG",
                   "-c",
-                  "-I" },
-      .lflags = { "", "", "", "", "", "-L", "-l", },
-      .flags = { "-o", "-shared", "rcs" },
-      .extension = { "", ".o", ".so", ".a" }
+                  "-I",
+                  "-MMD",
+                  "-xc-header",
+                  "-include",
+                  "-flto",
+                  "-flto",
+                  "-fprofile-generate=",
+                  "-fprofile-use=",
+                  "-fprofile-prefix-path=",
+                  "-gsplit-dwarf",
+                  "-gz" },
+      .lflags = { "", "", "", "", "", "-L", "-l",
+                  "-flto -flto-partition=one",
+                  "-flto=auto",
+                  "",
+                  "-fprofile-generate",
+                  "-fuse-ld=",
+                  "-Wl,--gdb-index",
+                  "-gz" },
+      .flags = { "-o", "-shared", "rcs", "--thin", "d" },
+      .extension = { "", ".o", ".d", ".so", ".a", ".gch", ".gcda", "",
+                     ".dwo" }
   },
   [CBUILDER_TYPE_clang] = {
       .compiler = "clang",
       .linker = "clang",
       .archiver_shared = "clang",
       .archiver_static = "llvm-ar",
+      .archiver_static_lto = "llvm-ar",
+      .profile_merger = "llvm-profdata",
       .cflags = { "",
                   "-g",
                   "-O3 -DNDEBUG",
                   "-O2 -g -DNDEBUG",
                   "-Os -DNDEBUG",
                   "-c",
-                  "-I" },
-      .lflags = { "", "", "", "", "", "-L", "-l", },
-      .flags = { "-o", "-shared", "rcs" },
-      .extension = { "", ".o", ".so", ".a" }
+                  "-I",
+                  "-MMD",
+                  "-xc-header",
+                  "-include",
+                  "-flto=full",
+                  "-flto=thin",
+                  "-fprofile-instr-generate=",
+                  "-fprofile-instr-use=",
+                  "",
+                  "-gsplit-dwarf",
+                  "-gz" },
+      .lflags = { "", "", "", "", "", "-L", "-l",
+                  "-flto=full",
+                  "-flto=thin",
+                  "-Wl,--thinlto-cache-dir=",
+                  "-fprofile-instr-generate",
+                  "-fuse-ld=",
+                  "-Wl,--gdb-index",
+                  "-gz" },
+      .flags = { "-o", "-shared", "rcs", "--thin", "d" },
+      .extension = { "", ".o", ".d", ".so", ".a", ".pch", ".profraw",
+                     ".profdata", ".dwo" }
   },
   [CBUILDER_TYPE_msvc] = {
       .compiler = "cl.exe",
       .linker = "link.exe",
       .archiver_shared = "link.exe",
       .archiver_static = "lib.exe",
+      .archiver_static_lto = "lib.exe",
+      .profile_merger = "",
       .cflags = { "",
                   "/Zi /utf-8",
                   "/O2 /DNDEBUG",
                   "/O2 /Zi /DNDEBUG",
                   "/Os /DNDEBUG",
                   "/c",
-                  "/I" },
-      .lflags = { "", "/PDB", "", "", "", "/LIBPATH:", "", },
-      .flags = { "/out:", "/DLL /DEBUG", "" },
-      .extension = { ".exe", ".obj", ".dll", ".lib" }
+                  "/I",
+                  "",
+                  "",
+                  "/FI",
+                  "/GL",
+                  "/GL",
+                  "",
+                  "",
+                  "",
+                  "",
+                  "" },
+      .lflags = { "", "/PDB", "", "", "", "/LIBPATH:", "",
+                  "/LTCG",
+                  "/LTCG",
+                  "",
+                  "",
+                  "",
+                  "",
+                  "" },
+      .flags = { "/out:", "/DLL /DEBUG", "", "", "" },
+      .extension = { ".exe", ".obj", "", ".dll", ".lib", "", "", "", "" }
   },
 };
 
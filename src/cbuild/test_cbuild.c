@@ -1,11 +1,86 @@
 #include <cbuild.h>
+#include <cbuild_arena_private.h>
+#include <cbuild_db_private.h>
+#include <cbuild_glob_private.h>
+#include <cbuild_paths_private.h>
 #include <cbuild_private.h>
+#include <cbuild_scan_private.h>
+#include <cbuild_stat_private.h>
+#include <cbuild_toc_private.h>
 #include <helpers.h>
 
 #include <utest.h>
 
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#define mkdir(path, mode) _mkdir(path)
+#define getcwd            _getcwd
+#define chdir             _chdir
+#define TEST_TEMP_DIR     "test_cbuild.XXXXXX"
+#else
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define TEST_TEMP_DIR "/tmp/test_cbuild.XXXXXX"
+#endif
+
+#ifdef __linux__
+#include <elf.h>
+#endif
+
+static void
+write_file(char const path[], char const content[])
+{
+  FILE* file = fopen(path, "w");
+  if (file) {
+    fputs(content, file);
+    fclose(file);
+  }
+}
+
+/// the whole file, empty if it is missing
+static void
+read_file(char const path[], char content[], size_t content_capacity)
+{
+  size_t len  = 0;
+  FILE*  file = fopen(path, "r");
+  if (file) {
+    len = fread(content, 1, content_capacity - 1, file);
+    fclose(file);
+  }
+  content[len] = '\0';
+}
+
+/// `root` = a new empty directory, `root` holds `TEST_TEMP_DIR`
+static bool
+temp_dir_create(char root[])
+{
+  strcpy(root, TEST_TEMP_DIR);
+#ifdef _WIN32
+  return _mktemp_s(root, strlen(root) + 1) == 0 && mkdir(root, 0755) == 0;
+#else
+  return mkdtemp(root) != NULL;
+#endif
+}
+
+static int
+temp_dir_destroy(char const root[])
+{
+  char cmd[128];
+#ifdef _WIN32
+  snprintf(cmd, sizeof(cmd), "rmdir /s /q %s", root);
+#else
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+#endif
+  return system(cmd);
+}
 
 UTEST_F_SETUP(CBuild)
 {
@@ -19,6 +94,119 @@ UTEST_F_TEARDOWN(CBuild)
   cbuild_destroy(utest_fixture);
 }
 
+/// a project inside its own temporary directory, for what has to write
+/// files. the test runs inside it, build paths are relative
+struct CBuildProject {
+  char   root[sizeof(TEST_TEMP_DIR)];
+  char   cur_dir[1024];
+  CBuild cbuild;
+};
+
+UTEST_F_SETUP(CBuildProject)
+{
+  ASSERT_TRUE(getcwd(utest_fixture->cur_dir, sizeof(utest_fixture->cur_dir)));
+  ASSERT_TRUE(temp_dir_create(utest_fixture->root));
+  ASSERT_EQ(chdir(utest_fixture->root), 0);
+
+  CError err = cbuild_create(CBUILD_TYPE_debug, C_STR(utest_fixture->root),
+                             &utest_fixture->cbuild);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+}
+
+UTEST_F_TEARDOWN(CBuildProject)
+{
+  cbuild_destroy(&utest_fixture->cbuild);
+  ASSERT_EQ(chdir(utest_fixture->cur_dir), 0);
+  ASSERT_EQ(temp_dir_destroy(utest_fixture->root), 0);
+}
+
+/// a temporary working directory, for the tests writing files without a
+/// project. relative paths stay inside it
+struct CBuildTempDir {
+  char root[sizeof(TEST_TEMP_DIR)];
+  char cur_dir[1024];
+};
+
+UTEST_F_SETUP(CBuildTempDir)
+{
+  ASSERT_TRUE(getcwd(utest_fixture->cur_dir, sizeof(utest_fixture->cur_dir)));
+  ASSERT_TRUE(temp_dir_create(utest_fixture->root));
+  ASSERT_EQ(chdir(utest_fixture->root), 0);
+}
+
+UTEST_F_TEARDOWN(CBuildTempDir)
+{
+  ASSERT_EQ(chdir(utest_fixture->cur_dir), 0);
+  ASSERT_EQ(temp_dir_destroy(utest_fixture->root), 0);
+}
+
+/// `<root>/<name>` = `content`
+static void
+project_write(struct CBuildProject const* project,
+              char const                  name[],
+              char const                  content[])
+{
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/%s", project->root, name);
+  write_file(path, content);
+}
+
+/// whether an argument of `args` (CArray< char const* >) starts with
+/// `prefix`
+static bool
+has_arg(CArray const* args, char const prefix[])
+{
+  for (size_t iii = 0; iii < args->len; ++iii) {
+    char const* arg = ((char const**)args->data)[iii];
+    if (strncmp(arg, prefix, strlen(prefix)) == 0) { return true; }
+  }
+  return false;
+}
+
+#ifndef _WIN32
+/// lines of `path`, 0 if it is missing
+static size_t
+count_lines(char const path[])
+{
+  char content[1024];
+  read_file(path, content, sizeof(content));
+
+  size_t lines_len = 0;
+  for (char const* end = strchr(content, '\n'); end;
+       end             = strchr(end + 1, '\n')) {
+    lines_len++;
+  }
+  return lines_len;
+}
+
+/// run `fn`, the commands it prints are written into `log` instead
+static CError
+run_logged(CError (*fn)(CBuild*),
+           CBuild* cbuild,
+           char    log[],
+           size_t  log_capacity)
+{
+  fflush(stdout);
+  int const saved = dup(STDOUT_FILENO);
+  FILE*     file  = fopen("build.log", "w");
+  if (saved < 0 || !file) {
+    if (file) { fclose(file); }
+    return CERROR_internal_error("test: can't redirect the output");
+  }
+  dup2(fileno(file), STDOUT_FILENO);
+
+  CError err = fn(cbuild);
+
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  fclose(file);
+
+  read_file("build.log", log, log_capacity);
+  return err;
+}
+#endif
+
 UTEST_F(CBuild, general)
 {
   CTarget target;
@@ -51,3 +239,1460 @@ UTEST_F(CBuild, general)
   err = cbuild_build(utest_fixture);
   ASSERT_EQ_MSG(err.code, 0, err.desc);
 }
+
+#ifndef _WIN32
+/// the executable `t` of `main.c` and `a.c`
+static CError
+declare_exe(CBuild* cbuild, CTarget* out_target)
+{
+  CError err = cbuild_exe_create(cbuild, C_STR("t"), C_STR("."), out_target);
+  if (err.code == 0) {
+    err = cbuild_target_add_source(cbuild, out_target, C_STR("main.c"));
+  }
+  if (err.code == 0) {
+    err = cbuild_target_add_source(cbuild, out_target, C_STR("a.c"));
+  }
+  return err;
+}
+
+UTEST_F(CBuildProject, up_to_date_build)
+{
+  project_write(utest_fixture, "a.c", "int a(void) { return 0; }\n");
+  project_write(utest_fixture, "main.c",
+                "int a(void);\nint main(void) { return a(); }\n");
+
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget target;
+  CError  err = declare_exe(cbuild, &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  char log[8192];
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // a successful build records the stamp of the project
+  CBuildDb*       db    = cbuild->impl->db;
+  CBuildDbRecord* stamp = cbuild_db_find(db, CBUILD_DB_KIND_stamp,
+                                         C_STR2(cbuild->impl->base_path.data));
+  ASSERT_TRUE(stamp);
+  CHash128 const built = stamp->hash;
+  CHash128       state;
+  err = cbuild_get_stamp(cbuild, &state);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // the same stamp skips the project before its targets are prepared
+  target.impl->compile_args.len = 0;
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_FALSE(strstr(log, "command:"));
+  ASSERT_EQ(target.impl->compile_args.len, 0u);
+
+  // one source invalidates it, that source alone is compiled again
+  project_write(utest_fixture, "a.c", "int a(void) { return 10; }\n");
+  CHash128 changed;
+  err = cbuild_get_stamp(cbuild, &changed);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_FALSE(c_hash128_equal(state, changed));
+
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/a.c\n"));
+  ASSERT_FALSE(strstr(log, "/main.c\n"));
+  stamp = cbuild_db_find(db, CBUILD_DB_KIND_stamp,
+                         C_STR2(cbuild->impl->base_path.data));
+  ASSERT_TRUE(stamp);
+  ASSERT_FALSE(c_hash128_equal(stamp->hash, built));
+}
+
+/// build `t` as a `btype` project of `root` loading and saving its
+/// database like a configured one, in `.c_build/<config>/c_build.db`
+static CError
+build_config(char const root[], CBuildType btype, char log[], size_t log_cap)
+{
+  char db_path[256];
+  snprintf(db_path, sizeof(db_path), "%s/%s/%s/c_build.db", root,
+           cbuild_get_builder_dir_name(), cbuild_type_get_name(btype));
+
+  CBuild  cbuild;
+  CTarget target;
+  CError  err = cbuild_create(btype, C_STR2(root), &cbuild);
+  if (err.code != 0) { return err; }
+  err = cbuild_db_load(cbuild.impl->db, C_STR2(db_path));
+  if (err.code == 0) { err = declare_exe(&cbuild, &target); }
+  if (err.code == 0) { err = run_logged(cbuild_build, &cbuild, log, log_cap); }
+  cbuild_destroy(&cbuild);
+  return err;
+}
+
+UTEST_F(CBuildProject, switch_configs)
+{
+  project_write(utest_fixture, "a.c", "int a(void) { return 0; }\n");
+  project_write(utest_fixture, "main.c",
+                "int a(void);\nint main(void) { return a(); }\n");
+
+  // every type builds into its own tree
+  char              log[8192];
+  CBuildType const  btypes[] = {CBUILD_TYPE_debug, CBUILD_TYPE_release};
+  char const* const trees[]  = {".c_build/debug/t", ".c_build/release/t",
+                                ".c_build/debug/c_build.db",
+                                ".c_build/release/c_build.db"};
+  for (size_t iii = 0; iii < 2; ++iii) {
+    CError err = build_config(utest_fixture->root, btypes[iii], log,
+                              sizeof(log));
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+    ASSERT_TRUE(strstr(log, "/main.c\n"));
+  }
+  for (size_t iii = 0; iii < sizeof(trees) / sizeof(*trees); ++iii) {
+    struct stat info;
+    ASSERT_EQ(stat(trees[iii], &info), 0);
+  }
+
+  // switching back finds the database and the objects of the other type
+  // as they were
+  for (size_t iii = 0; iii < 2; ++iii) {
+    CError err = build_config(utest_fixture->root, btypes[iii], log,
+                              sizeof(log));
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+    ASSERT_FALSE(strstr(log, "command:"));
+  }
+
+  // a change is built by the type asked only
+  project_write(utest_fixture, "a.c", "int a(void) { return 10; }\n");
+  CError err = build_config(utest_fixture->root, CBUILD_TYPE_release, log,
+                            sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/a.c\n"));
+  ASSERT_FALSE(strstr(log, "/main.c\n"));
+  err = build_config(utest_fixture->root, CBUILD_TYPE_debug, log,
+                     sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/a.c\n"));
+  ASSERT_FALSE(strstr(log, "/main.c\n"));
+}
+#endif
+
+#ifndef _WIN32
+static CError
+build_only_t(CBuild* cbuild)
+{
+  char const* const names[] = {"t"};
+  return cbuild_build_targets(cbuild, names, 1);
+}
+
+UTEST_F(CBuildProject, build_closure)
+{
+  project_write(utest_fixture, "a.c", "int a(void) { return 0; }\n");
+  project_write(utest_fixture, "main.c",
+                "int a(void);\nint main(void) { return a(); }\n");
+  project_write(utest_fixture, "u.c", "int main(void) { return 0; }\n");
+
+  // t needs the archive a, u is unrelated
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget lib;
+  CTarget exe;
+  CTarget other;
+  CError  err = cbuild_static_lib_create(cbuild, C_STR("a"), C_STR("."), &lib);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &lib, C_STR("a.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_exe_create(cbuild, C_STR("t"), C_STR("."), &exe);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &exe, C_STR("main.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_depends_on(cbuild, &exe, &lib, CTARGET_PROPERTY_library);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_exe_create(cbuild, C_STR("u"), C_STR("."), &other);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &other, C_STR("u.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  char log[8192];
+  err = run_logged(build_only_t, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/a.c\n"));
+  ASSERT_TRUE(strstr(log, "/main.c\n"));
+  ASSERT_FALSE(strstr(log, "/u.c\n"));
+  ASSERT_TRUE(lib.impl->is_selected && exe.impl->is_selected);
+  ASSERT_FALSE(other.impl->is_selected);
+
+  // a partial build records no stamp, the full one builds what is left
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/u.c\n"));
+  ASSERT_FALSE(strstr(log, "/main.c\n"));
+}
+
+UTEST_F(CBuildProject, cross_project_build)
+{
+  char sub_path[sizeof(utest_fixture->root) + 4];
+  snprintf(sub_path, sizeof(sub_path), "%s/sub", utest_fixture->root);
+  ASSERT_EQ(mkdir(sub_path, 0755), 0);
+  project_write(utest_fixture, "sub/a.c", "int a(void) { return 0; }\n");
+  project_write(utest_fixture, "main.c",
+                "int a(void);\nint main(void) { return a(); }\n");
+  project_write(utest_fixture, "u.c", "int main(void) { return 0; }\n");
+
+  // the archive a of the project inside sub, t of this project links it,
+  // u doesn't need it
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CBuild  sub;
+  CError  err = cbuild_create(CBUILD_TYPE_debug, C_STR(sub_path), &sub);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  c_array_error_t arr_err
+      = c_array_push(&cbuild->impl->other_projects, &sub.impl);
+  ASSERT_EQ_MSG(arr_err.code, 0, arr_err.desc);
+
+  CTarget lib;
+  CTarget exe;
+  CTarget other;
+  // declared the way configuring sub does, from inside it
+  ASSERT_EQ(chdir(sub_path), 0);
+  err = cbuild_static_lib_create(&sub, C_STR("a"), C_STR("."), &lib);
+  ASSERT_EQ(chdir(utest_fixture->root), 0);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(&sub, &lib, C_STR("a.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_exe_create(cbuild, C_STR("t"), C_STR("."), &exe);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &exe, C_STR("main.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_depends_on(cbuild, &exe, &lib, CTARGET_PROPERTY_library);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_exe_create(cbuild, C_STR("u"), C_STR("."), &other);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &other, C_STR("u.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // one graph, the archive is written before t is linked. every action
+  // runs inside its own project, the objects land in their build paths
+  char log[8192];
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  char const* archive = strstr(log, "liba.a");
+  char const* link    = strstr(log, "c_out/debug/t/t ");
+  ASSERT_TRUE(archive && link && archive < link);
+  ASSERT_TRUE(strstr(log, "/sub/a.c\n"));
+  ASSERT_TRUE(strstr(log, "/u.c\n"));
+
+  char path[sizeof(utest_fixture->root) + 64];
+  snprintf(path, sizeof(path), "%s/.c_build/debug/a", sub_path);
+  ASSERT_EQ(access(path, F_OK), 0);
+  snprintf(path, sizeof(path), "%s/.c_build/debug/a", utest_fixture->root);
+  ASSERT_NE(access(path, F_OK), 0);
+
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(strlen(log), 0u);
+
+  // a change inside sub relinks t, an up to date project still reaches
+  // the one depending on it
+  project_write(utest_fixture, "sub/a.c", "int a(void) { return 1; }\n");
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/sub/a.c\n"));
+  ASSERT_TRUE(strstr(log, "c_out/debug/t/t "));
+  ASSERT_FALSE(strstr(log, "/u.c\n"));
+  ASSERT_FALSE(strstr(log, "/main.c\n"));
+}
+#endif
+
+UTEST_F(CBuild, precompiled_header)
+{
+  CTarget target;
+  CError  err
+      = cbuild_exe_create(utest_fixture, C_STR("t"), C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  err = cbuild_target_set_precompiled_header(utest_fixture, &target,
+                                             C_STR("no/such/header.h"));
+  ASSERT_EQ(err.code, CERROR_no_such_source.code);
+  ASSERT_EQ(target.impl->precompiled_header.len, 0u);
+}
+
+#ifndef _WIN32
+UTEST_F(CBuildProject, precompiled_header_build)
+{
+  // nothing includes the header, the compile is told to
+  project_write(utest_fixture, "common.h", "#define VALUE 0\n");
+  project_write(utest_fixture, "main.c", "int main(void) { return VALUE; }\n");
+
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget target;
+  CError  err = cbuild_exe_create(cbuild, C_STR("t"), C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &target, C_STR("main.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_set_precompiled_header(cbuild, &target,
+                                             C_STR("common.h"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  char log[8192];
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "-xc-header"));
+  ASSERT_TRUE(strstr(log, "-include "));
+
+  // the header is not precompiled again for a change of a source
+  project_write(utest_fixture, "main.c",
+                "int main(void) { return VALUE + 0; }\n");
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "main.c"));
+  ASSERT_FALSE(strstr(log, "-xc-header"));
+}
+#endif
+
+UTEST_F(CBuild, lto)
+{
+  CTarget target;
+  CError  err = cbuild_static_lib_create(utest_fixture, C_STR("t"),
+                                        C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(target.impl->lto, CTARGET_LTO_none);
+
+  err = cbuild_target_set_lto(utest_fixture, &target, CTARGET_LTO_parallel);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(target.impl->lto, CTARGET_LTO_parallel);
+
+  err = cbuild_target_set_lto(utest_fixture, &target, (CTargetLto)42);
+  ASSERT_EQ(err.code, CERROR_wrong_options.code);
+  ASSERT_EQ(target.impl->lto, CTARGET_LTO_parallel);
+}
+
+#ifndef _WIN32
+UTEST_F(CBuildProject, lto_build)
+{
+  project_write(utest_fixture, "a.c", "int a(void) { return 0; }\n");
+  project_write(utest_fixture, "main.c",
+                "int a(void);\nint main(void) { return a(); }\n");
+
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget exe;
+  CTarget archive;
+  CError  err = cbuild_exe_create(cbuild, C_STR("t"), C_STR("."), &exe);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_static_lib_create(cbuild, C_STR("l"), C_STR("."), &archive);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &exe, C_STR("a.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &exe, C_STR("main.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &archive, C_STR("a.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_set_lto(cbuild, &exe, CTARGET_LTO_parallel);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_set_lto(cbuild, &archive, CTARGET_LTO_full);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // the compiles and the link optimize, an archive keeps the symbols of
+  // its lto objects
+  err = cbuild_target_prepare(cbuild, exe.impl);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(has_arg(&exe.impl->compile_args, "-flto"));
+  ASSERT_TRUE(has_arg(&exe.impl->link_args, "-flto"));
+  err = cbuild_target_prepare(cbuild, archive.impl);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(has_arg(&archive.impl->compile_args, "-flto"));
+  ASSERT_STREQ(((char const**)archive.impl->link_args.data)[0],
+               cbuild->impl->cmds.static_lib_creator_lto.data);
+
+  char log[8192];
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // the link optimizes again, the unchanged object is not compiled again.
+  // a compile ends with its source
+  project_write(utest_fixture, "main.c",
+                "int a(void);\nint main(void) { return a() + 0; }\n");
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/main.c\n"));
+  ASSERT_FALSE(strstr(log, "/a.c\n"));
+  ASSERT_TRUE(strstr(log, "/c_out/debug/t/t "));
+}
+#endif
+
+UTEST_F(CBuild, thin_archive)
+{
+  CTarget target;
+  CError  err = cbuild_static_lib_create(utest_fixture, C_STR("t"),
+                                        C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_set_thin_archive(utest_fixture, &target, true);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(target.impl->is_thin_archive);
+
+  // only archives have members
+  CTarget exe;
+  err = cbuild_exe_create(utest_fixture, C_STR("e"), C_STR("."), &exe);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_set_thin_archive(utest_fixture, &exe, true);
+  ASSERT_EQ(err.code, CERROR_invalid_target_type.code);
+}
+
+#ifndef _WIN32
+UTEST_F(CBuildProject, archive_build)
+{
+  project_write(utest_fixture, "a.c", "int a(void) { return 1; }\n");
+  project_write(utest_fixture, "b.c", "int b(void) { return 1; }\n");
+
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget target;
+  CError  err
+      = cbuild_static_lib_create(cbuild, C_STR("l"), C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &target, C_STR("a.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &target, C_STR("b.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  err = cbuild_target_set_thin_archive(cbuild, &target, true);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_prepare(cbuild, target.impl);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(has_arg(&target.impl->link_args, "--thin"));
+
+  err = cbuild_target_set_thin_archive(cbuild, &target, false);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_prepare(cbuild, target.impl);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_FALSE(has_arg(&target.impl->link_args, "--thin"));
+
+  char log[8192];
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  char* archive = strstr(log, "command: ar ");
+  ASSERT_TRUE(archive);
+  ASSERT_TRUE(strstr(archive, "/b.c."));
+
+  // only the member that changed is written again
+  project_write(utest_fixture, "a.c", "int a(void) { return 10; }\n");
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  archive = strstr(log, "command: ar rcs ");
+  ASSERT_TRUE(archive);
+  archive[strcspn(archive, "\n")] = '\0';
+  ASSERT_TRUE(strstr(archive, "/a.c."));
+  ASSERT_FALSE(strstr(archive, "/b.c."));
+}
+
+UTEST_F(CBuildProject, archive_long_paths)
+{
+  // the manifest lines of the members run over 512 bytes
+  char name[241];
+  memset(name, 'n', sizeof(name) - 1);
+  name[sizeof(name) - 1] = '\0';
+  char source[sizeof(name) + 2];
+  snprintf(source, sizeof(source), "%s.c", name);
+  project_write(utest_fixture, "a.c", "int a(void) { return 1; }\n");
+  project_write(utest_fixture, source, "int b(void) { return 1; }\n");
+
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget target;
+  CError  err
+      = cbuild_static_lib_create(cbuild, C_STR2(name), C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &target, C_STR("a.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &target, C_STR2(source));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  char log[8192];
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  project_write(utest_fixture, "a.c", "int a(void) { return 10; }\n");
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  char* archive = strstr(log, "command: ar rcs ");
+  ASSERT_TRUE(archive);
+  archive[strcspn(archive, "\n")] = '\0';
+  ASSERT_TRUE(strstr(archive, "/a.c."));
+  ASSERT_FALSE(strstr(archive, source));
+}
+#endif
+
+UTEST_F(CBuild, object_dependency)
+{
+  CTarget objects;
+  CError  err = cbuild_object_create(utest_fixture, C_STR("o"), C_STR("."),
+                                    &objects);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  CTarget target;
+  err = cbuild_exe_create(utest_fixture, C_STR("t"), C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // the objects are linked once built, nothing is compiled again
+  err = cbuild_target_depends_on(utest_fixture, &target, &objects,
+                                 CTARGET_PROPERTY_objects);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(target.impl->sources.len, 0u);
+  ASSERT_EQ(target.impl->dependencies.len, 1u);
+  ASSERT_TRUE(((CTargetImpl**)target.impl->dependencies.data)[0]
+              == objects.impl);
+}
+
+#ifndef _WIN32
+UTEST_F(CBuildProject, object_dependency_build)
+{
+  project_write(utest_fixture, "o.c", "int o(void) { return 3; }\n");
+  project_write(utest_fixture, "main.c",
+                "int o(void);\nint main(void) { return o(); }\n");
+
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget objects;
+  CTarget exe;
+  CError  err = cbuild_object_create(cbuild, C_STR("o"), C_STR("."), &objects);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &objects, C_STR("o.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_exe_create(cbuild, C_STR("t"), C_STR("."), &exe);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &exe, C_STR("main.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_depends_on(cbuild, &exe, &objects,
+                                 CTARGET_PROPERTY_objects);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // the object of `o` is linked into `t` without being compiled for it
+  char log[8192];
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  char* link = strstr(log, "/c_out/debug/t/t ");
+  ASSERT_TRUE(link);
+  link[strcspn(link, "\n")] = '\0';
+  ASSERT_TRUE(strstr(link, "/o/o.c."));
+  ASSERT_TRUE(strstr(link, "/t/main.c."));
+  ASSERT_FALSE(strstr(log, "/t/o.c."));
+
+  char cmd[sizeof(utest_fixture->root) + 32];
+  snprintf(cmd, sizeof(cmd), "%s/c_out/debug/t/t", utest_fixture->root);
+  int const status = system(cmd);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(WEXITSTATUS(status), 3);
+
+  // an edit of the objects links again, `main.c` stays as it is
+  project_write(utest_fixture, "o.c", "int o(void) { return 4; }\n");
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/o.c\n"));
+  ASSERT_FALSE(strstr(log, "/main.c\n"));
+  ASSERT_TRUE(strstr(log, "/c_out/debug/t/t "));
+  ASSERT_EQ(WEXITSTATUS(system(cmd)), 4);
+}
+#endif
+
+UTEST_F(CBuild, share_objects)
+{
+  CTarget shared;
+  CError  err = cbuild_shared_lib_create(utest_fixture, C_STR("s"),
+                                        C_STR("."), &shared);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  CTarget archive;
+  err = cbuild_static_lib_create(utest_fixture, C_STR("a"), C_STR("."),
+                                 &archive);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  err = cbuild_target_share_objects(utest_fixture, &archive, &shared);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(archive.impl->objects_of == shared.impl);
+  ASSERT_TRUE(shared.impl->is_pic);
+
+  // executables are not built with pic
+  CTarget exe;
+  err = cbuild_exe_create(utest_fixture, C_STR("e"), C_STR("."), &exe);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_share_objects(utest_fixture, &exe, &shared);
+  ASSERT_EQ(err.code, CERROR_invalid_target_type.code);
+  ASSERT_TRUE(exe.impl->objects_of == NULL);
+}
+
+UTEST_F(CBuild, pgo)
+{
+  CError err = cbuild_set_pgo(utest_fixture, CBUILD_PGO_generate);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_STREQ(utest_fixture->impl->config.data, "debug_pgo_generate");
+
+  err = cbuild_set_pgo(utest_fixture, CBUILD_PGO_none);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_STREQ(utest_fixture->impl->config.data, "debug");
+
+  // trainings run executables
+  CTarget target;
+  err = cbuild_static_lib_create(utest_fixture, C_STR("t"), C_STR("."),
+                                 &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_pgo_training(utest_fixture, &target, C_STR("1"));
+  ASSERT_EQ(err.code, CERROR_invalid_target_type.code);
+  ASSERT_EQ(target.impl->pgo_trainings.len, 0u);
+}
+
+#ifndef _WIN32
+/// `t` logs each of its runs into `runs.log`, and is trained once
+static CError
+declare_trained_exe(CBuild* cbuild, CTarget* out_target)
+{
+  CError err = cbuild_exe_create(cbuild, C_STR("t"), C_STR("."), out_target);
+  if (err.code != 0) { return err; }
+  err = cbuild_target_add_source(cbuild, out_target, C_STR("main.c"));
+  if (err.code != 0) { return err; }
+
+  return cbuild_target_add_pgo_training(cbuild, out_target, C_STR("train"));
+}
+
+UTEST_F(CBuildProject, pgo_build)
+{
+  project_write(utest_fixture, "main.c",
+                "#include <stdio.h>\n"
+                "int main(void) {\n"
+                "  FILE* file = fopen(\"runs.log\", \"a\");\n"
+                "  if (file) { fputs(\"run\\n\", file); fclose(file); }\n"
+                "  return 0;\n"
+                "}\n");
+
+  // the stage names the build paths, it is chosen first
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CError  err    = cbuild_set_pgo(cbuild, CBUILD_PGO_generate);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  CTarget target;
+  err = declare_trained_exe(cbuild, &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // instrumented compiles, and the profiling runtime for the link
+  err = cbuild_target_prepare(cbuild, target.impl);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  // gcc, clang
+  CArray const* compile_args = &target.impl->compile_args;
+  ASSERT_TRUE(has_arg(compile_args, "-fprofile-generate=")
+              || has_arg(compile_args, "-fprofile-instr-generate="));
+  ASSERT_TRUE(has_arg(&target.impl->link_args, "-fprofile"));
+
+  err = cbuild_build(cbuild);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_pgo_train(cbuild);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(count_lines("runs.log"), 1u);
+
+  // the binaries and the trainings are the same, the profile is kept
+  err = cbuild_pgo_train(cbuild);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(count_lines("runs.log"), 1u);
+
+  // the use stage reads the profile
+  CBuild use;
+  err = cbuild_create(CBUILD_TYPE_debug, C_STR(utest_fixture->root), &use);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_set_pgo(&use, CBUILD_PGO_use);
+  if (err.code == 0) { err = declare_trained_exe(&use, &target); }
+  if (err.code == 0) { err = cbuild_target_prepare(&use, target.impl); }
+  bool const is_used
+      = err.code == 0
+        && (has_arg(&target.impl->compile_args, "-fprofile-use=")
+            || has_arg(&target.impl->compile_args, "-fprofile-instr-use="));
+  cbuild_destroy(&use);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(is_used);
+}
+#endif
+
+UTEST_F(CBuild, linker)
+{
+  CBuildLinker linker;
+  CError       err = cbuild_linker_from_name(C_STR("lld"), &linker);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(linker, CBUILD_LINKER_lld);
+
+  err = cbuild_linker_from_name(C_STR("ld"), &linker);
+  ASSERT_EQ(err.code, CERROR_wrong_options.code);
+
+  // auto always settles on an installed linker
+  err = cbuild_set_linker(utest_fixture, CBUILD_LINKER_auto);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_NE(utest_fixture->impl->linker, CBUILD_LINKER_auto);
+
+#ifndef _WIN32
+  // the answer is kept per compiler and PATH, without a PATH the compiler
+  // itself is not found
+  char path[4096];
+  snprintf(path, sizeof(path), "%s", getenv("PATH"));
+  ASSERT_EQ(setenv("PATH", "", 1), 0);
+  err = cbuild_set_linker(utest_fixture, CBUILD_LINKER_auto);
+  setenv("PATH", path, 1);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(utest_fixture->impl->linker, CBUILD_LINKER_default);
+#endif
+
+  err = cbuild_set_linker(utest_fixture, (CBuildLinker)42);
+  ASSERT_EQ(err.code, CERROR_wrong_options.code);
+}
+
+#ifndef _WIN32
+UTEST_F(CBuildProject, linker_build)
+{
+  project_write(utest_fixture, "main.c", "int main(void) { return 0; }\n");
+
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget target;
+  CError  err = cbuild_exe_create(cbuild, C_STR("t"), C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &target, C_STR("main.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // only the link is told, the compiler picks the default one on its own
+  err = cbuild_set_linker(cbuild, CBUILD_LINKER_gold);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_prepare(cbuild, target.impl);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(has_arg(&target.impl->link_args, "-fuse-ld=gold"));
+  ASSERT_FALSE(has_arg(&target.impl->compile_args, "-fuse-ld="));
+
+  err = cbuild_set_linker(cbuild, CBUILD_LINKER_default);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_prepare(cbuild, target.impl);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_FALSE(has_arg(&target.impl->link_args, "-fuse-ld="));
+
+  char log[8192];
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // another linker links again without compiling, if one is installed
+  err = cbuild_set_linker(cbuild, CBUILD_LINKER_auto);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  if (cbuild->impl->linker == CBUILD_LINKER_default) { return; }
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "-fuse-ld="));
+  ASSERT_FALSE(strstr(log, "/main.c\n"));
+}
+#endif
+
+UTEST_F(CBuild, debug_info)
+{
+  unsigned const debug_info
+      = CBUILD_DEBUG_INFO_split | CBUILD_DEBUG_INFO_compressed;
+  CError err = cbuild_set_debug_info(utest_fixture, debug_info);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(utest_fixture->impl->debug_info, debug_info);
+
+  err = cbuild_set_debug_info(utest_fixture, 1u << 7);
+  ASSERT_EQ(err.code, CERROR_wrong_options.code);
+  ASSERT_EQ(utest_fixture->impl->debug_info, debug_info);
+}
+
+#ifndef _WIN32
+UTEST_F(CBuildProject, debug_info_build)
+{
+  project_write(utest_fixture, "main.c", "int main(void) { return 0; }\n");
+
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget target;
+  CError  err = cbuild_exe_create(cbuild, C_STR("t"), C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &target, C_STR("main.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  err = cbuild_set_debug_info(cbuild, CBUILD_DEBUG_INFO_split);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_prepare(cbuild, target.impl);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(has_arg(&target.impl->compile_args, "-gsplit-dwarf"));
+
+  char log[8192];
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // the same setting again changes nothing, another one compiles again
+  err = cbuild_set_debug_info(cbuild, CBUILD_DEBUG_INFO_split);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_FALSE(strstr(log, "command:"));
+
+  err = cbuild_set_debug_info(cbuild, 0);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/main.c\n"));
+  ASSERT_FALSE(strstr(log, "-gsplit-dwarf"));
+
+  // a build without debug info has nothing to split
+  CBuild release;
+  err = cbuild_create(CBUILD_TYPE_release, C_STR(utest_fixture->root),
+                      &release);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_set_debug_info(&release, CBUILD_DEBUG_INFO_split);
+  if (err.code == 0) {
+    err = cbuild_exe_create(&release, C_STR("t"), C_STR("."), &target);
+  }
+  if (err.code == 0) { err = cbuild_target_prepare(&release, target.impl); }
+  bool const is_split
+      = has_arg(&target.impl->compile_args, "-gsplit-dwarf");
+  cbuild_destroy(&release);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_FALSE(is_split);
+}
+#endif
+
+UTEST_F(CBuild, unity)
+{
+  CTarget target;
+  CError  err
+      = cbuild_exe_create(utest_fixture, C_STR("t"), C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  err = cbuild_target_set_unity(utest_fixture, &target, 4);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(target.impl->is_unity_set);
+  ASSERT_EQ(target.impl->unity_batches, 4u);
+
+  err = cbuild_target_exclude_from_unity(utest_fixture, &target,
+                                         C_STR("no/such/source.c"));
+  ASSERT_EQ(err.code, CERROR_no_such_source.code);
+  ASSERT_EQ(target.impl->unity_excluded.len, 0u);
+}
+
+/// `<build path of target>/unity_<batch>.c`, empty if it is not written
+static void
+read_unity_batch(CTarget const* target,
+                 size_t         batch,
+                 char           content[],
+                 size_t         content_capacity)
+{
+  char path[512];
+  snprintf(path, sizeof(path), "%s/unity_%zu.c", target->impl->build_path.data,
+           batch);
+  read_file(path, content, content_capacity);
+}
+
+UTEST_F(CBuildProject, share_objects)
+{
+  char const* const names[] = {"a.c", "b.c", "c.c"};
+  for (size_t iii = 0; iii < sizeof(names) / sizeof(*names); ++iii) {
+    char content[64];
+    snprintf(content, sizeof(content), "int %c(void) { return 0; }\n",
+             names[iii][0]);
+    project_write(utest_fixture, names[iii], content);
+  }
+
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget archive;
+  CTarget shared;
+  CError  err = cbuild_static_lib_create(cbuild, C_STR("a"), C_STR("."),
+                                        &archive);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_shared_lib_create(cbuild, C_STR("s"), C_STR("."), &shared);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // both list the common sources, like a library built both ways
+  for (size_t iii = 0; iii < 2; ++iii) {
+    err = cbuild_target_add_source(cbuild, &archive, C_STR2(names[iii]));
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+  }
+  for (size_t iii = 0; iii < 3; ++iii) {
+    err = cbuild_target_add_source(cbuild, &shared, C_STR2(names[iii]));
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+  }
+  err = cbuild_target_share_objects(cbuild, &shared, &archive);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_exclude_from_sharing(cbuild, &archive, C_STR("b.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // its own source and the one left out, each compiled once
+  err = cbuild_target_prepare(cbuild, shared.impl);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(shared.impl->units.len, 2u);
+  ASSERT_TRUE(strstr(((CStr*)shared.impl->units.data)[0].data, "c.c"));
+  ASSERT_TRUE(strstr(((CStr*)shared.impl->units.data)[1].data, "b.c"));
+
+  // a symbol defined twice fails the link
+  err = cbuild_build(cbuild);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+}
+
+UTEST_F(CBuildProject, unity_batches)
+{
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget target;
+  CError  err = cbuild_exe_create(cbuild, C_STR("t"), C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_set_unity(cbuild, &target, 8);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  char const* const names[] = {"s0.c", "s1.c", "s2.c", "s3.c", "s4.c",
+                               "s5.c", "s6.c", "own.c"};
+  size_t const names_len = sizeof(names) / sizeof(*names);
+  for (size_t iii = 0; iii < names_len; ++iii) {
+    project_write(utest_fixture, names[iii], "");
+    // `s6.c` is added later
+    if (strcmp(names[iii], "s6.c") == 0) { continue; }
+    err = cbuild_target_add_source(cbuild, &target, names[iii],
+                                   strlen(names[iii]));
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+  }
+  err = cbuild_target_exclude_from_unity(cbuild, &target, C_STR("own.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  err = cbuild_target_prepare(cbuild, target.impl);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // more batches than sources, some are left empty and not written.
+  // the excluded source is its own unit, the others are included once by
+  // the batch written for them
+  char   batches[8][1024];
+  size_t units_len = 0;
+  bool   is_own    = false;
+  for (size_t iii = 0; iii < target.impl->units.len; ++iii) {
+    CStr const* unit = &((CStr*)target.impl->units.data)[iii];
+    is_own           = is_own || strstr(unit->data, "own.c");
+    units_len += strstr(unit->data, "unity_") != NULL;
+  }
+  ASSERT_TRUE(is_own);
+  ASSERT_EQ(target.impl->units.len, units_len + 1);
+
+  size_t includes_len = 0;
+  for (size_t iii = 0; iii < 8; ++iii) {
+    read_unity_batch(&target, iii, batches[iii], sizeof(batches[iii]));
+    for (char const* line = strstr(batches[iii], "#include \"");
+         line; line = strstr(line + 1, "#include \"")) {
+      includes_len++;
+    }
+  }
+  ASSERT_EQ(includes_len, 6u);
+  for (size_t iii = 0; iii < names_len; ++iii) {
+    char include[256];
+    snprintf(include, sizeof(include), "%s/%s\"\n", utest_fixture->root,
+             names[iii]);
+    size_t found = 0;
+    for (size_t jjj = 0; jjj < 8; ++jjj) {
+      found += strstr(batches[jjj], include) != NULL;
+    }
+    bool const is_batched = strcmp(names[iii], "s6.c") != 0
+                            && strcmp(names[iii], "own.c") != 0;
+    ASSERT_EQ(found, is_batched ? 1u : 0u);
+  }
+
+  // one more source changes only the batch it falls into
+  err = cbuild_target_add_source(cbuild, &target, C_STR("s6.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_prepare(cbuild, target.impl);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  size_t changed_len = 0;
+  for (size_t iii = 0; iii < 8; ++iii) {
+    char batch[1024];
+    read_unity_batch(&target, iii, batch, sizeof(batch));
+    changed_len += strcmp(batch, batches[iii]) != 0;
+  }
+  ASSERT_EQ(changed_len, 1u);
+}
+
+UTEST_F(CBuild, custom_command)
+{
+  CTarget target;
+  CError  err
+      = cbuild_exe_create(utest_fixture, C_STR("t"), C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // an output is a source before it exists
+  char const* const argv[]    = {"./gen.sh"};
+  char const* const outputs[] = {"gen/no_such_table.c"};
+  err = cbuild_custom_command(utest_fixture, argv, 1, NULL, 0, outputs, 1);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(utest_fixture->impl->commands.len, 1u);
+
+  err = cbuild_target_add_source(utest_fixture, &target,
+                                 C_STR("gen/no_such_table.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(utest_fixture, &target,
+                                 C_STR("gen/no_such_source.c"));
+  ASSERT_EQ(err.code, CERROR_no_such_source.code);
+  ASSERT_EQ(target.impl->sources.len, 1u);
+}
+
+#ifndef _WIN32
+/// `t` includes `gen/value.h`, generated from `value.txt` by a command
+/// logging each of its runs into `runs.log`
+static CError
+declare_generated_header(CBuild* cbuild, CTarget* out_target)
+{
+  char const* const argv[] = {
+      "sh", "-c",
+      "echo run >> runs.log && mkdir -p gen"
+      " && echo \"#define VALUE $(cat value.txt)\" > gen/value.h"};
+  char const* const inputs[]  = {"value.txt"};
+  char const* const outputs[] = {"gen/value.h"};
+
+  CError err = cbuild_custom_command(cbuild, argv, 3, inputs, 1, outputs, 1);
+  if (err.code != 0) { return err; }
+
+  err = cbuild_exe_create(cbuild, C_STR("t"), C_STR("."), out_target);
+  if (err.code != 0) { return err; }
+
+  return cbuild_target_add_source(cbuild, out_target, C_STR("main.c"));
+}
+
+UTEST_F(CBuildProject, custom_command_skip)
+{
+  project_write(utest_fixture, "value.txt", "1\n");
+  project_write(utest_fixture, "main.c",
+                "#include \"gen/value.h\"\n"
+                "int main(void) { return VALUE - 1; }\n");
+
+  CTarget target;
+  CError  err = declare_generated_header(&utest_fixture->cbuild, &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // the header is written before the compile including it
+  err = cbuild_build(&utest_fixture->cbuild);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(count_lines("runs.log"), 1u);
+
+  // a compile runs again, the command does not, its input is unchanged
+  project_write(utest_fixture, "main.c",
+                "#include \"gen/value.h\"\n"
+                "int main(void) { return VALUE - 1 + 0; }\n");
+  err = cbuild_build(&utest_fixture->cbuild);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(count_lines("runs.log"), 1u);
+
+  project_write(utest_fixture, "value.txt", "10\n");
+  err = cbuild_build(&utest_fixture->cbuild);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(count_lines("runs.log"), 2u);
+}
+
+UTEST_F(CBuildProject, custom_command_configurations)
+{
+  project_write(utest_fixture, "value.txt", "1\n");
+  project_write(utest_fixture, "main.c",
+                "#include \"gen/value.h\"\n"
+                "int main(void) { return VALUE - 1; }\n");
+
+  CBuild cbuilds[2] = {utest_fixture->cbuild};
+  CError err = cbuild_create(CBUILD_TYPE_release, C_STR(utest_fixture->root),
+                             &cbuilds[1]);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // every configuration declares the same command, it writes the same
+  // files for all of them
+  CTarget targets[2];
+  for (size_t iii = 0; iii < 2 && err.code == 0; ++iii) {
+    err = declare_generated_header(&cbuilds[iii], &targets[iii]);
+  }
+  if (err.code == 0) { err = cbuild_build_many(cbuilds, 2, NULL, 0, 2); }
+  cbuild_destroy(&cbuilds[1]);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(count_lines("runs.log"), 1u);
+}
+#endif
+
+UTEST_F(CBuild, flags)
+{
+  CTarget target;
+  CError  err
+      = cbuild_exe_create(utest_fixture, C_STR("t"), C_STR("."), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  size_t const len = target.impl->cflags.len;
+
+  // split once, when added
+  err = cbuild_target_add_compile_flag(utest_fixture, &target,
+                                       C_STR(" -Wall  -Wextra "));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(target.impl->cflags.len, len + 2);
+
+  // a path with spaces stays a single argument
+  err = cbuild_target_add_include_path_flag(utest_fixture, &target,
+                                            C_STR("dir with spaces"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(target.impl->cflags.len, len + 3);
+
+  char const** cflags = (char const**)target.impl->cflags.data;
+  ASSERT_STREQ(cflags[len], "-Wall");
+  ASSERT_STREQ(cflags[len + 1], "-Wextra");
+  ASSERT_TRUE(strstr(cflags[len + 2], "dir with spaces"));
+
+  // interned, the same flag is stored once
+  err = cbuild_target_add_compile_flag(utest_fixture, &target, C_STR("-Wall"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  cflags = (char const**)target.impl->cflags.data;
+  ASSERT_TRUE(cflags[len + 3] == cflags[len]);
+}
+
+UTEST_F(CBuild, target_lookup)
+{
+  CTarget targets[3];
+  CError  err = CERROR_none;
+  for (size_t iii = 0; iii < 3; ++iii) {
+    char const name[] = {(char)('a' + iii), '\0'};
+    err = cbuild_exe_create(utest_fixture, name, 1, C_STR("."), &targets[iii]);
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+  }
+
+  // the last target takes the place of a destroyed one, the index follows
+  cbuild_target_destroy(utest_fixture, &targets[1]);
+  ASSERT_EQ(utest_fixture->impl->targets.len, 2u);
+  ASSERT_TRUE(((CTargetImpl**)utest_fixture->impl->targets.data)[1]
+              == targets[2].impl);
+  CTarget target;
+  err = cbuild_target_get(utest_fixture, C_STR("c"), &target);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(target.impl == targets[2].impl);
+  err = cbuild_target_get(utest_fixture, C_STR("b"), &target);
+  ASSERT_EQ(err.code, CERROR_no_such_target.code);
+
+  char const* const names[] = {"c", "b", "a"};
+  CTarget           found[3];
+  err = cbuild_targets_get(utest_fixture, names, 3, found);
+  ASSERT_EQ(err.code, CERROR_no_such_target.code);
+  ASSERT_TRUE(found[0].impl == targets[2].impl);
+  ASSERT_FALSE(found[1].impl);
+  ASSERT_TRUE(found[2].impl == targets[0].impl);
+}
+
+UTEST(cbuild_arena, alloc)
+{
+  CBuildArena arena;
+  CError      err = cbuild_arena_create(64, &arena);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  char*     byte = cbuild_arena_alloc(&arena, 1, 1);
+  uint64_t* word = cbuild_arena_alloc(&arena, sizeof(uint64_t), 8);
+  ASSERT_TRUE(byte && word);
+  ASSERT_EQ((uintptr_t)word % 8, 0u);
+  ASSERT_EQ(arena.blocks.len, 1u);
+
+  // bigger than a block, it gets its own
+  ASSERT_TRUE(cbuild_arena_alloc(&arena, 100, 1));
+  ASSERT_TRUE(cbuild_arena_alloc(&arena, 60, 1));
+  ASSERT_EQ(arena.blocks.len, 3u);
+
+  // only the first block is kept, the next allocation reuses it
+  cbuild_arena_reset(&arena);
+  ASSERT_EQ(arena.blocks.len, 1u);
+  ASSERT_EQ(arena.bytes, 64u);
+  ASSERT_TRUE(cbuild_arena_alloc(&arena, 1, 1) == byte);
+
+  cbuild_arena_destroy(&arena);
+}
+
+UTEST(cbuild_paths, intern)
+{
+  CBuildPaths paths;
+  CError      err = cbuild_paths_create(&paths);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // a path longer than a block gets its own
+  static char long_path[100 * 1024];
+  memset(long_path, 'a', sizeof(long_path) - 1);
+
+  CStr first;
+  CStr second;
+  CStr other;
+  CStr longest;
+  ASSERT_EQ(cbuild_paths_intern(&paths, C_STR("/src/a.c"), &first).code, 0);
+  ASSERT_EQ(cbuild_paths_intern(&paths, C_STR("/src/b.c"), &other).code, 0);
+  ASSERT_EQ(cbuild_paths_intern(&paths, C_STR(long_path), &longest).code, 0);
+  ASSERT_EQ(cbuild_paths_intern(&paths, C_STR("/src/a.c"), &second).code, 0);
+
+  ASSERT_TRUE(first.data == second.data);
+  ASSERT_STREQ(first.data, "/src/a.c");
+  ASSERT_STREQ(other.data, "/src/b.c");
+  ASSERT_EQ(longest.len, sizeof(long_path) - 1);
+  ASSERT_EQ(paths.paths.len, 3u);
+
+  cbuild_paths_destroy(&paths);
+}
+
+UTEST_F(CBuildTempDir, db_escaped_keys)
+{
+  // the separators of the lines inside a path and a listing
+  char const      key[]   = "dir\twith\nbreaks\\";
+  CBuildDbRecord  record  = {.size = 7};
+  CBuildDbRecord* found   = NULL;
+  CBuildDb        db;
+  CError          err     = cbuild_db_create(&db);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_db_load(&db, C_STR("db"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(c_str_create(C_STR("a.c\tsub/\t"), &record.value).code, 0);
+  err = cbuild_db_put(&db, CBUILD_DB_KIND_dir, C_STR(key), &record);
+  c_str_destroy(&record.value);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_db_save(&db);
+  cbuild_db_destroy(&db);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  err = cbuild_db_create(&db);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_db_load(&db, C_STR("db"));
+  if (err.code == 0) {
+    found = cbuild_db_find(&db, CBUILD_DB_KIND_dir, C_STR(key));
+  }
+  bool const is_same = found && found->size == 7 && found->value.data
+                       && strcmp(found->value.data, "a.c\tsub/\t") == 0;
+  size_t const records_len = db.records.len;
+  cbuild_db_destroy(&db);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(is_same);
+  ASSERT_EQ(records_len, 1u);
+}
+
+UTEST(cbuild_stat, impls_agree)
+{
+  // enough paths to leave the serial path of `CBUILD_STAT_IMPL_auto`
+  char const* const samples[] = {".", "..", "/", "no/such/file"};
+  char const*       paths[1024];
+  for (size_t iii = 0; iii < sizeof(paths) / sizeof(*paths); ++iii) {
+    paths[iii] = samples[iii % (sizeof(samples) / sizeof(*samples))];
+  }
+  size_t const paths_len = sizeof(paths) / sizeof(*paths);
+
+  static CBuildFileState expected[1024];
+  static CBuildFileState states[1024];
+
+  CError err = cbuild_stat_many(paths, paths_len, expected,
+                                CBUILD_STAT_IMPL_serial);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(expected[0].exists);
+  ASSERT_FALSE(expected[3].exists);
+
+  CBuildStatImpl const impls[] = {CBUILD_STAT_IMPL_threads,
+                                  CBUILD_STAT_IMPL_io_uring,
+                                  CBUILD_STAT_IMPL_auto};
+  for (size_t iii = 0; iii < sizeof(impls) / sizeof(*impls); ++iii) {
+    memset(states, 0xff, sizeof(states));
+    err = cbuild_stat_many(paths, paths_len, states, impls[iii]);
+    // io_uring may be missing or disabled
+    if (err.code != 0 && impls[iii] == CBUILD_STAT_IMPL_io_uring) { continue; }
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+    for (size_t jjj = 0; jjj < paths_len; ++jjj) {
+      ASSERT_EQ(states[jjj].exists, expected[jjj].exists);
+      ASSERT_EQ(states[jjj].inode, expected[jjj].inode);
+      ASSERT_EQ(states[jjj].mtime, expected[jjj].mtime);
+      ASSERT_EQ(states[jjj].size, expected[jjj].size);
+    }
+  }
+}
+
+UTEST(cbuild_toc, not_a_library)
+{
+  // the caller tracks the whole file then
+  CStr   toc;
+  CError err = cbuild_toc_read(C_STR("no/such/library.so"), &toc);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(toc.len, 0u);
+  c_str_destroy(&toc);
+
+  err = cbuild_toc_read(C_STR("."), &toc);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(toc.len, 0u);
+  c_str_destroy(&toc);
+}
+
+#ifdef __linux__
+UTEST_F(CBuildTempDir, toc_empty_dynsym)
+{
+  // a header, the null section and a .dynsym without any entry
+  struct toc_image {
+    Elf64_Ehdr header;
+    Elf64_Shdr sections[2];
+  } image = {
+      .header   = {.e_ident     = {ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3,
+                                   ELFCLASS64},
+                   .e_shoff     = offsetof(struct toc_image, sections),
+                   .e_shentsize = sizeof(Elf64_Shdr),
+                   .e_shnum     = 2},
+      .sections = {[1] = {.sh_type    = SHT_DYNSYM,
+                          .sh_offset  = sizeof(Elf64_Ehdr),
+                          .sh_entsize = sizeof(Elf64_Sym)}},
+  };
+  uint16_t const probe          = 1;
+  image.header.e_ident[EI_DATA] = *(unsigned char const*)&probe == 1
+                                      ? ELFDATA2LSB
+                                      : ELFDATA2MSB;
+
+  FILE* file = fopen("empty.so", "wb");
+  ASSERT_TRUE(file);
+  ASSERT_EQ(fwrite(&image, sizeof(image), 1, file), 1u);
+  fclose(file);
+
+  CStr   toc;
+  CError err = cbuild_toc_read(C_STR("empty.so"), &toc);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(toc.len, 0u);
+  c_str_destroy(&toc);
+}
+#endif
+
+#ifdef __linux__
+UTEST_F(CBuildProject, shared_relink)
+{
+  project_write(utest_fixture, "s.c", "int f(void) { return 1; }\n");
+  project_write(utest_fixture, "main.c",
+                "int f(void);\nint main(void) { return f(); }\n");
+
+  CBuild* cbuild = &utest_fixture->cbuild;
+  CTarget lib;
+  CTarget exe;
+  CError  err
+      = cbuild_shared_lib_create(cbuild, C_STR("s"), C_STR("."), &lib);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &lib, C_STR("s.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_exe_create(cbuild, C_STR("e"), C_STR("."), &exe);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_add_source(cbuild, &exe, C_STR("main.c"));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  err = cbuild_target_depends_on(cbuild, &exe, &lib,
+                                 CTARGET_PROPERTY_library_with_rpath);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  char log[8192];
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/c_out/debug/e/e "));
+
+  // a body changes, the exports of the library stay the same
+  project_write(utest_fixture, "s.c", "int f(void) { return 10; }\n");
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/s.c\n"));
+  ASSERT_FALSE(strstr(log, "/c_out/debug/e/e "));
+
+  project_write(utest_fixture, "s.c", "int f(void) { return 10; }\n"
+                                      "int g(void) { return 2; }\n");
+  err = run_logged(cbuild_build, cbuild, log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(strstr(log, "/c_out/debug/e/e "));
+  ASSERT_FALSE(strstr(log, "/main.c\n"));
+}
+#endif
+
+UTEST_F(CBuildTempDir, scan_headers)
+{
+  mkdir("scan_tree", 0755);
+  mkdir("scan_tree/include", 0755);
+  write_file("scan_tree/main.c", "#include \"local.h\"\n"
+                                 "  #  include <lib.h>\n"
+                                 "#include <stdio.h>\n"
+                                 "int x = 1; // # include \"none.h\"\n");
+  write_file("scan_tree/local.h", "#include <lib.h>\n");
+  write_file("scan_tree/include/lib.h", "#include \"detail.h\"\n");
+  write_file("scan_tree/include/detail.h", "");
+
+  CBuildScanner scanner;
+  CError        err = cbuild_scanner_create(&scanner);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  CArray      include_dirs;
+  char const* include_dir = "scan_tree/include";
+  ASSERT_EQ(c_array_create(sizeof(char const*), &include_dirs).code, 0);
+  ASSERT_EQ(c_array_push(&include_dirs, &include_dir).code, 0);
+
+  // system headers are left out, every other one is listed once
+  char const* const expected[] = {"scan_tree/local.h",
+                                  "scan_tree/include/lib.h",
+                                  "scan_tree/include/detail.h"};
+  for (size_t iii = 0; iii < 2; ++iii) {
+    CArray headers;
+    CArray missing;
+    err = cbuild_scanner_headers(&scanner, C_STR("scan_tree/main.c"),
+                                 &include_dirs, &headers, &missing);
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+    ASSERT_EQ(missing.len, 1u);
+    ASSERT_STREQ(((CStr*)missing.data)[0].data, "stdio.h");
+    c_str_destroy(&((CStr*)missing.data)[0]);
+    c_array_destroy(&missing);
+
+    ASSERT_EQ(headers.len, sizeof(expected) / sizeof(*expected));
+    for (size_t jjj = 0; jjj < headers.len; ++jjj) {
+      ASSERT_STREQ(((CStr*)headers.data)[jjj].data, expected[jjj]);
+      c_str_destroy(&((CStr*)headers.data)[jjj]);
+    }
+    c_array_destroy(&headers);
+  }
+
+  // a header written later is found once the resolutions are forgotten
+  write_file("scan_tree/include/stdio.h", "");
+  for (size_t iii = 0; iii < 2; ++iii) {
+    if (iii == 1) { cbuild_scanner_forget_resolutions(&scanner); }
+
+    CArray headers;
+    err = cbuild_scanner_headers(&scanner, C_STR("scan_tree/main.c"),
+                                 &include_dirs, &headers, NULL);
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+    ASSERT_EQ(headers.len, sizeof(expected) / sizeof(*expected) + iii);
+    for (size_t jjj = 0; jjj < headers.len; ++jjj) {
+      c_str_destroy(&((CStr*)headers.data)[jjj]);
+    }
+    c_array_destroy(&headers);
+  }
+
+  c_array_destroy(&include_dirs);
+  cbuild_scanner_destroy(&scanner);
+}
+
+UTEST(cbuild_glob, match)
+{
+  ASSERT_TRUE(cbuild_glob_match("*.c", "main.c"));
+  ASSERT_TRUE(cbuild_glob_match("m?in.*", "main.c"));
+  ASSERT_TRUE(cbuild_glob_match("*a*n*.c", "main.c"));
+  ASSERT_FALSE(cbuild_glob_match("*.c", "main.h"));
+  ASSERT_FALSE(cbuild_glob_match("*.c", "main.cc"));
+  ASSERT_FALSE(cbuild_glob_match("*", ".hidden"));
+  ASSERT_TRUE(cbuild_glob_match(".*", ".hidden"));
+}
+
+UTEST_F(CBuildTempDir, glob_walk)
+{
+  mkdir("glob_tree", 0755);
+  mkdir("glob_tree/sub", 0755);
+  mkdir("glob_tree/sub/deep", 0755);
+  mkdir("glob_tree/.hidden", 0755);
+  mkdir("glob_tree/c_out", 0755);
+  write_file("glob_tree/a.c", "");
+  write_file("glob_tree/a.h", "");
+  write_file("glob_tree/sub/b.c", "");
+  write_file("glob_tree/sub/deep/c.c", "");
+  write_file("glob_tree/.hidden/d.c", "");
+  write_file("glob_tree/c_out/e.c", "");
+
+  CBuildDb db;
+  CError   err = cbuild_db_create(&db);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // the second walk lists the directories from the database, it goes
+  // through them twice and keeps every match once
+  char const* const patterns[] = {"glob_tree/**/*.c", "glob_tree/**/**/*.c"};
+  char const* const expected[] = {"./glob_tree/a.c", "./glob_tree/sub/b.c",
+                                  "./glob_tree/sub/deep/c.c"};
+  for (size_t iii = 0; iii < 2; ++iii) {
+    CArray paths;
+    err = cbuild_glob(&db, C_STR("."), C_STR2(patterns[iii]), &paths);
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+    ASSERT_TRUE(cbuild_db_find(&db, CBUILD_DB_KIND_dir,
+                               C_STR("./glob_tree/sub")));
+
+    ASSERT_EQ(paths.len, sizeof(expected) / sizeof(*expected));
+    for (size_t jjj = 0; jjj < paths.len; ++jjj) {
+      ASSERT_STREQ(((CStr*)paths.data)[jjj].data, expected[jjj]);
+      c_str_destroy(&((CStr*)paths.data)[jjj]);
+    }
+    c_array_destroy(&paths);
+  }
+
+  // a new file changes the directory, it is listed again
+  write_file("glob_tree/sub/f.c", "");
+  CArray paths;
+  err = cbuild_glob(&db, C_STR("."), C_STR("glob_tree/sub/*.c"), &paths);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(paths.len, 2u);
+  for (size_t iii = 0; iii < paths.len; ++iii) {
+    c_str_destroy(&((CStr*)paths.data)[iii]);
+  }
+  c_array_destroy(&paths);
+
+  cbuild_db_destroy(&db);
+}
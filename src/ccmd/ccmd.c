@@ -1,6 +1,7 @@
 #include "ccmd.h"
 #include "cbuild.h"
 #include "cbuild_private.h"
+#include "cdaemon.h"
 #include "helpers.h"
 
 #include <assert.h>
@@ -26,7 +27,46 @@ static char const* subcmd_helps[] = {
     "  directory.\n\n"
     "Options:\n"
     "-h, --help             Print this help and exit\n",
-  [CSUB_CMD_build] = "",
+  [CSUB_CMD_build] = "Usage: c build [options] [<target>...]\n\n"
+    "  Builds the project in the current working directory, or\n"
+    "  only the given targets and what they depend on.\n\n"
+    "Options:\n"
+    "--config <type>[,...]  Build type(s): none, debug, release,\n"
+    "                       relwithdebinfo or minsizerel\n"
+    "                       (default: debug), every type has its\n"
+    "                       own output tree and all of them share\n"
+    "                       one pool of jobs\n"
+    "-j, --jobs <n>         Number of parallel jobs\n"
+    "                       (default: one per cpu)\n"
+    "--linker <name>        Linker of executables and shared\n"
+    "                       libraries: default, mold, lld, gold\n"
+    "                       or auto, the fastest one installed\n"
+    "                       (default: default)\n"
+    "--pgo                  Profile guided build: build\n"
+    "                       instrumented, run the trainings of\n"
+    "                       build.c, then build again with the\n"
+    "                       profile (default config: release),\n"
+    "                       never served by `c daemon`\n"
+    "--split-dwarf          Keep the debug info of debug and\n"
+    "                       relwithdebinfo builds in .dwo files\n"
+    "                       next to the objects, out of the links\n"
+    "--compress-debug       Compress the debug info of debug and\n"
+    "                       relwithdebinfo builds (-gz)\n"
+    "--unity[=<n>]          Compile the sources of every target\n"
+    "                       through <n> generated files that\n"
+    "                       include several of them each\n"
+    "                       (default: one per cpu)\n"
+    "-w, --watch            Build again whenever a file of the\n"
+    "                       project changes, until Ctrl-C\n"
+    "--no-daemon            Build here even if `c daemon` is\n"
+    "                       running for the project\n"
+    "-h, --help             Print this help and exit\n",
+  [CSUB_CMD_daemon] = "Usage: c daemon\n\n"
+    "  Keeps the project in the current working directory\n"
+    "  configured and serves `c build` from memory, file\n"
+    "  changes are followed with inotify. Stops on Ctrl-C.\n\n"
+    "Options:\n"
+    "-h, --help             Print this help and exit\n",
   [CSUB_CMD_run] = "",
   [CSUB_CMD_test] = "",
   [CSUB_CMD_doc] = "",
@@ -38,6 +78,7 @@ static char const* subcmd_helps[] = {
 
 static int internal_ccmd_on_init(CCmd* self);
 static int internal_ccmd_on_build(CCmd* self);
+static int internal_ccmd_on_daemon(CCmd* self);
 static int internal_ccmd_on_run(CCmd* self);
 static int internal_ccmd_on_test(CCmd* self);
 static int internal_ccmd_on_doc(CCmd* self);
@@ -45,6 +86,13 @@ static int internal_ccmd_on_fmt(CCmd* self);
 static int internal_ccmd_on_help(CCmd* self);
 static int internal_ccmd_on_version(CCmd* self);
 
+static char const* internal_ccmd_get_option_value(CCmd*      self,
+                                                  size_t*    arg_index,
+                                                  char const name[]);
+static CError      internal_ccmd_build_configs(char const project_path[],
+                                               CDaemonRequest const* request,
+                                               CBuildPgo             pgo);
+
 CError
 ccmd_create(int argc, char* argv[], CCmd* out_ccmd)
 {
@@ -62,10 +110,15 @@ ccmd_create(int argc, char* argv[], CCmd* out_ccmd)
     char const* const subcmd;
     int (*handler)(CCmd* self);
   } const subcmds[] = {
-      {"init", internal_ccmd_on_init}, {"build", internal_ccmd_on_build},
-      {"run", internal_ccmd_on_run},   {"test", internal_ccmd_on_test},
-      {"doc", internal_ccmd_on_doc},   {"fmt", internal_ccmd_on_fmt},
-      {"help", internal_ccmd_on_help}, {"version", internal_ccmd_on_version},
+      {"init", internal_ccmd_on_init},
+      {"build", internal_ccmd_on_build},
+      {"daemon", internal_ccmd_on_daemon},
+      {"run", internal_ccmd_on_run},
+      {"test", internal_ccmd_on_test},
+      {"doc", internal_ccmd_on_doc},
+      {"fmt", internal_ccmd_on_fmt},
+      {"help", internal_ccmd_on_help},
+      {"version", internal_ccmd_on_version},
   };
   size_t const subcmds_len = sizeof(subcmds) / sizeof(subcmds[0]);
 
@@ -211,19 +264,216 @@ internal_ccmd_on_build(CCmd* self)
 
   CError err = CERROR_none;
 
+  CDaemonRequest request           = {0};
+  bool           is_daemon_allowed = true;
+  bool           is_watching       = false;
+  bool           is_pgo            = false;
+
   c_defer_init(10);
 
   /// FIXME: "." should be taken as a parameter
   char project_path[] = ".";
 
-  CBuild cbuild = {0};
+  // c build [options] [<target>...]
+  char const** target_names = calloc(self->argc + 1, sizeof(char const*));
+  c_defer_err(target_names, free, target_names,
+              ON_ERR(CERROR_memory_allocation));
+  request.target_names = target_names;
+
+  for (size_t iii = 0; iii < self->argc; ++iii) {
+    char const* arg = self->argv[iii];
+    char const* value;
+
+    if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+      puts(subcmd_helps[self->subcmd]);
+      c_defer_check(false, NULL, NULL, exit_status = EXIT_SUCCESS);
+    } else if (strcmp(arg, "--watch") == 0 || strcmp(arg, "-w") == 0) {
+      is_watching = true;
+    } else if (strcmp(arg, "--no-daemon") == 0) {
+      is_daemon_allowed = false;
+    } else if (strcmp(arg, "--pgo") == 0) {
+      is_pgo = true;
+    } else if (strcmp(arg, "--split-dwarf") == 0) {
+      request.debug_info |= CBUILD_DEBUG_INFO_split;
+    } else if (strcmp(arg, "--compress-debug") == 0) {
+      request.debug_info |= CBUILD_DEBUG_INFO_compressed;
+    } else if (strcmp(arg, "--unity") == 0) {
+      // the value is optional, a following argument is a target
+      request.unity_batches = CBUILD_UNITY_BATCHES_auto;
+    } else if (strncmp(arg, "--unity=", sizeof("--unity=") - 1) == 0) {
+      char* value_end       = NULL;
+      value                 = &arg[sizeof("--unity=") - 1];
+      request.unity_batches = strtoul(value, &value_end, 10);
+      c_defer_check(*value != '\0' && *value_end == '\0'
+                        && request.unity_batches > 0,
+                    NULL, NULL, ON_ERR(CERROR_wrong_options));
+    } else if ((value = internal_ccmd_get_option_value(self, &iii, "--config"))
+               != NULL) {
+      // --config <type>[,<type>...]
+      while (*value != '\0') {
+        size_t     value_len = strcspn(value, ",");
+        CBuildType btype;
+        err = cbuild_type_from_name(value, value_len, &btype);
+        c_defer_check(err.code == 0, NULL, NULL,
+                      (fprintf(stderr, "error: unknown config: %.*s\n",
+                               (int)value_len, value),
+                       ON_ERR(err)));
+
+        bool is_duplicate = false;
+        for (size_t jjj = 0; jjj < request.btypes_len; ++jjj) {
+          is_duplicate = is_duplicate || request.btypes[jjj] == btype;
+        }
+        if (!is_duplicate) { request.btypes[request.btypes_len++] = btype; }
+
+        value += value_len;
+        if (*value == ',') { value++; }
+      }
+    } else if ((value = internal_ccmd_get_option_value(self, &iii, "--linker"))
+               != NULL) {
+      err = cbuild_linker_from_name(value, strlen(value), &request.linker);
+      c_defer_check(err.code == 0, NULL, NULL,
+                    (fprintf(stderr, "error: unknown linker: %s\n", value),
+                     ON_ERR(err)));
+    } else if ((value = internal_ccmd_get_option_value(self, &iii, "--jobs"))
+                   != NULL
+               || (value = internal_ccmd_get_option_value(self, &iii, "-j"))
+                      != NULL) {
+      char* value_end = NULL;
+      request.jobs    = strtoul(value, &value_end, 10);
+      c_defer_check(*value_end == '\0' && request.jobs > 0, NULL, NULL,
+                    ON_ERR(CERROR_wrong_options));
+    } else if (arg[0] != '-') {
+      target_names[request.target_names_len++] = arg;
+    } else {
+      fprintf(stderr, "%s: %s\n", ON_EXTRA_PARAM_ERR, arg);
+      c_defer_check(false, NULL, NULL, exit_status = EXIT_FAILURE);
+    }
+  }
+
   /// FIXME: this should not be debug
-  err = cbuild_create(CBUILD_TYPE_debug, C_STR(project_path), &cbuild);
-  c_defer_err(err.code == 0, cbuild_destroy, &cbuild, ON_ERR(err));
+  if (request.btypes_len == 0) {
+    request.btypes[request.btypes_len++]
+        = is_pgo ? CBUILD_TYPE_release : CBUILD_TYPE_debug;
+  }
 
-  err = cbuild_configure(&cbuild);
+  // the stages run one after the other, each in its own output roots
+  if (is_pgo) {
+    c_defer_check(!is_watching, NULL, NULL,
+                  (fprintf(stderr, "error: --pgo can't --watch\n"),
+                   ON_ERR(CERROR_wrong_options)));
+
+    err = internal_ccmd_build_configs(project_path, &request,
+                                      CBUILD_PGO_generate);
+    c_defer_check(err.code == 0, NULL, NULL, ON_ERR(err));
+    err = internal_ccmd_build_configs(project_path, &request, CBUILD_PGO_use);
+    c_defer_check(err.code == 0, NULL, NULL, ON_ERR(err));
+    c_defer_check(false, NULL, NULL, NULL);
+  }
+
+  // the watcher keeps its own configured projects, like the daemon
+  if (is_watching) {
+    err = cdaemon_watch(C_STR(project_path), &request);
+    c_defer_check(err.code == 0, NULL, NULL, ON_ERR(err));
+    c_defer_check(false, NULL, NULL, NULL);
+  }
+
+  // a running daemon has everything configured already
+  if (is_daemon_allowed) {
+    bool is_served  = false;
+    bool is_success = false;
+    err = cdaemon_request(C_STR(project_path), &request, &is_served,
+                          &is_success);
+    c_defer_check(err.code == 0, NULL, NULL, ON_ERR(err));
+    if (is_served) {
+      c_defer_check(false, NULL, NULL,
+                    exit_status = is_success ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+  }
+
+  err = internal_ccmd_build_configs(project_path, &request, CBUILD_PGO_none);
   c_defer_check(err.code == 0, NULL, NULL, ON_ERR(err));
-  err = cbuild_build(&cbuild);
+
+  c_defer_deinit();
+
+  return exit_status;
+}
+
+CError
+internal_ccmd_build_configs(char const            project_path[],
+                            CDaemonRequest const* request,
+                            CBuildPgo             pgo)
+{
+  CError err = CERROR_none;
+
+  // one build per configuration, the same type is never built twice
+  CBuild cbuilds[CDAEMON_BUILD_TYPES_LEN] = {0};
+
+  c_defer_init(2);
+
+  for (size_t iii = 0; iii < request->btypes_len; ++iii) {
+    err = cbuild_create(request->btypes[iii], C_STR2(project_path),
+                        &cbuilds[iii]);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    err = cbuild_set_pgo(&cbuilds[iii], pgo);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    err = cbuild_configure(&cbuilds[iii]);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    cbuild_set_unity_batches(&cbuilds[iii], request->unity_batches);
+
+    err = cbuild_set_linker(&cbuilds[iii], request->linker);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    err = cbuild_set_debug_info(&cbuilds[iii], request->debug_info);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  err = cbuild_build_many(cbuilds, request->btypes_len, request->target_names,
+                          request->target_names_len, request->jobs);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // the instrumented binaries write the profiles the use stage reads
+  if (pgo == CBUILD_PGO_generate) {
+    for (size_t iii = 0; iii < request->btypes_len; ++iii) {
+      err = cbuild_pgo_train(&cbuilds[iii]);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+  }
+
+  c_defer_deinit();
+
+  for (size_t iii = 0; iii < request->btypes_len; ++iii) {
+    if (cbuilds[iii].impl) { cbuild_destroy(&cbuilds[iii]); }
+  }
+
+  return err;
+}
+
+int
+internal_ccmd_on_daemon(CCmd* self)
+{
+  int    exit_status = EXIT_SUCCESS;
+  CError err         = CERROR_none;
+
+  c_defer_init(2);
+
+  /// FIXME: "." should be taken as a parameter
+  char project_path[] = ".";
+
+  if (self->argc >= 1) {
+    if (strcmp(self->argv[0], "--help") == 0
+        || strcmp(self->argv[0], "-h") == 0) {
+      puts(subcmd_helps[self->subcmd]);
+      c_defer_check(false, NULL, NULL, exit_status = EXIT_SUCCESS);
+    } else {
+      fprintf(stderr, "%s: %s\n", ON_EXTRA_PARAM_ERR, self->argv[0]);
+      c_defer_check(false, NULL, NULL, exit_status = EXIT_FAILURE);
+    }
+  }
+
+  err = cdaemon_run(C_STR(project_path));
   c_defer_check(err.code == 0, NULL, NULL, ON_ERR(err));
 
   c_defer_deinit();
@@ -231,6 +481,32 @@ internal_ccmd_on_build(CCmd* self)
   return exit_status;
 }
 
+char const*
+internal_ccmd_get_option_value(CCmd*      self,
+                               size_t*    arg_index,
+                               char const name[])
+{
+  char const* arg      = self->argv[*arg_index];
+  size_t      name_len = strlen(name);
+
+  if (strncmp(arg, name, name_len) != 0) { return NULL; }
+
+  // <name>=<value>
+  if (arg[name_len] == '=') { return &arg[name_len + 1]; }
+
+  // <short name><value>, e.g. `-j8`
+  bool const is_short = name_len == 2 && name[0] == '-' && name[1] != '-';
+  if (is_short && arg[name_len] != '\0') { return &arg[name_len]; }
+
+  // <name> <value>
+  if (arg[name_len] == '\0' && *arg_index + 1 < self->argc) {
+    *arg_index += 1;
+    return self->argv[*arg_index];
+  }
+
+  return NULL;
+}
+
 int
 internal_ccmd_on_run(CCmd* self)
 {
@@ -264,6 +540,7 @@ internal_ccmd_on_help(CCmd* self)
          "Commands:\n\n"
          "  init\t\tInitialize project in the current directory\n"
          "  build\t\tBuild project from build.c\n"
+         "  daemon\tServe builds of the project from memory\n"
          "  run\t\tBuild and Run\n"
          "  test\t\tPerform unit testing\n"
          "  doc\t\tGenerate doc and open it in browser\n"
@@ -8,6 +8,7 @@
 typedef enum CSubCmd {
   CSUB_CMD_init,
   CSUB_CMD_build,
+  CSUB_CMD_daemon,
   CSUB_CMD_run,
   CSUB_CMD_test,
   CSUB_CMD_doc,
@@ -0,0 +1,732 @@
+#include "cdaemon.h"
+#include "cbuild_private.h"
+#include "cwatch.h"
+#include "helpers.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <defer.h>
+#include <str.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+static char const default_socket_name[] = "c.sock";
+static char const default_build_file[]  = "build.c";
+
+/// the longest request line accepted
+#define CDAEMON_REQUEST_MAX_LEN 4096
+
+/// editors write a file in several steps, a build starts once nothing
+/// changed for that long
+#define CDAEMON_DEBOUNCE_MS 50
+
+/// configured projects kept alive between builds
+typedef struct CDaemonSession {
+  CStr   project_path;
+  CBuild cbuilds[CDAEMON_BUILD_TYPES_LEN]; // configured on first use
+  bool     is_clean[CDAEMON_BUILD_TYPES_LEN];
+  CStr     clean_targets[CDAEMON_BUILD_TYPES_LEN]; // empty when all are built
+  CHash128 clean_stamps[CDAEMON_BUILD_TYPES_LEN];  // outputs are not watched
+  CWatch   watch;
+} CDaemonSession;
+
+#ifdef __linux__
+static volatile sig_atomic_t cdaemon_is_stopping = 0;
+
+static CError internal_cdaemon_session_create(char const      project_path[],
+                                              size_t          project_path_len,
+                                              CDaemonSession* out_session);
+static CError internal_cdaemon_session_build(CDaemonSession*       self,
+                                             CDaemonRequest const* request);
+static CError internal_cdaemon_session_watch(CDaemonSession* self,
+                                             CBuildImpl*     cbuild);
+static void   internal_cdaemon_session_on_change(char const path[],
+                                                 size_t     path_len,
+                                                 void*      extra_data);
+static void   internal_cdaemon_session_destroy(CDaemonSession* self);
+static CError internal_cdaemon_get_address(char const          project_path[],
+                                           size_t              project_path_len,
+                                           struct sockaddr_un* out_address);
+static CError internal_cdaemon_serve(CDaemonSession* session, int client);
+static CError internal_cdaemon_request_to_line(CDaemonRequest const* request,
+                                               CStr* out_line);
+static CError internal_cdaemon_request_from_line(char             line[],
+                                                 CDaemonRequest*  out_request,
+                                                 char const**     target_names);
+static CError internal_cdaemon_request_key(CDaemonRequest const* request,
+                                           CStr*                 out_key);
+static void   internal_cdaemon_handle_signals(void);
+static void   internal_cdaemon_on_signal(int signal_number);
+#endif
+
+CError
+cdaemon_run(char const project_path[], size_t project_path_len)
+{
+  assert(project_path && project_path_len > 0);
+
+#ifdef __linux__
+  CError             err     = CERROR_none;
+  CDaemonSession     session = {0};
+  struct sockaddr_un address = {0};
+  int                server  = -1;
+
+  c_defer_init(8);
+
+  err = internal_cdaemon_get_address(project_path, project_path_len,
+                                     &address);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  err = internal_cdaemon_session_create(project_path, project_path_len,
+                                        &session);
+  c_defer_err(err.code == 0, internal_cdaemon_session_destroy, &session,
+              NULL);
+
+  server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  c_defer_check(server >= 0, NULL, NULL,
+                err = CERROR_internal_error("c: failed to create a socket"));
+
+  // a socket nobody answers on is left over from a crashed daemon
+  if (connect(server, (struct sockaddr*)&address, sizeof(address)) == 0) {
+    close(server);
+    c_defer_check(false, NULL, NULL,
+                  err = CERROR_internal_error(
+                      "c: a daemon is already running for this project"));
+  }
+  unlink(address.sun_path);
+
+  // <project>/<build path> may not exist before the first build
+  char* socket_name = strrchr(address.sun_path, '/');
+  *socket_name      = '\0';
+  mkdir(address.sun_path, 0755);
+  *socket_name = '/';
+
+  c_defer_check(bind(server, (struct sockaddr*)&address, sizeof(address))
+                        == 0
+                    && listen(server, 16) == 0,
+                NULL, NULL,
+                (close(server),
+                 err = CERROR_internal_error("c: failed to listen on the "
+                                             "daemon socket")));
+
+  internal_cdaemon_handle_signals();
+
+  printf("c: serving builds on %s\n", address.sun_path);
+  fflush(stdout);
+
+  while (!cdaemon_is_stopping) {
+    struct pollfd pfds[] = {
+        {.fd = server, .events = POLLIN},
+        {.fd = cwatch_get_fd(&session.watch), .events = POLLIN},
+    };
+    if (poll(pfds, sizeof(pfds) / sizeof(*pfds), -1) < 0) {
+      if (errno == EINTR) { continue; }
+      err = CERROR_internal_error("c: failed to wait for requests");
+      break;
+    }
+
+    if (pfds[1].revents & POLLIN) {
+      err = cwatch_poll(&session.watch, 0, internal_cdaemon_session_on_change,
+                        &session, NULL);
+      if (err.code != 0) { break; }
+    }
+
+    if (pfds[0].revents & POLLIN) {
+      int client = accept(server, NULL, NULL);
+      if (client < 0) { continue; }
+
+      // a failed request is reported to its client, the daemon keeps going
+      CError serve_err = internal_cdaemon_serve(&session, client);
+      if (serve_err.code != 0) {
+        fprintf(stderr, "Error: %d\n---\n%s\n", serve_err.code,
+                serve_err.desc);
+      }
+      close(client);
+    }
+  }
+
+  unlink(address.sun_path);
+  close(server);
+
+  c_defer_deinit();
+
+  return err;
+#else
+  (void)project_path_len;
+  return CERROR_internal_error(
+      "c: the daemon is not supported on this platform");
+#endif
+}
+
+CError
+cdaemon_request(char const            project_path[],
+                size_t                project_path_len,
+                CDaemonRequest const* request,
+                bool*                 out_is_served,
+                bool*                 out_is_success)
+{
+  assert(project_path && project_path_len > 0);
+  assert(request);
+  assert(out_is_served);
+  assert(out_is_success);
+
+  *out_is_served  = false;
+  *out_is_success = false;
+
+#ifdef __linux__
+  CError             err     = CERROR_none;
+  CStr               line    = {0};
+  struct sockaddr_un address = {0};
+  int                client  = -1;
+
+  c_defer_init(6);
+
+  // no socket, no daemon
+  err = internal_cdaemon_get_address(project_path, project_path_len,
+                                     &address);
+  c_defer_check(err.code == 0, NULL, NULL, err = CERROR_none);
+
+  client = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  c_defer_check(client >= 0, NULL, NULL, NULL);
+  c_defer_check(
+      connect(client, (struct sockaddr*)&address, sizeof(address)) == 0,
+      NULL, NULL, close(client));
+
+  err = internal_cdaemon_request_to_line(request, &line);
+  c_defer_err(err.code == 0, c_str_destroy, &line, close(client));
+
+  signal(SIGPIPE, SIG_IGN);
+  c_defer_check(write(client, line.data, line.len) == (ssize_t)line.len, NULL,
+                NULL,
+                (close(client), err = CERROR_internal_error(
+                                    "c: failed to send the build request")));
+
+  // <output>... '\0' <'0' | '1'>
+  bool    is_output_done = false;
+  char    buf[4096];
+  ssize_t buf_len;
+  while ((buf_len = read(client, buf, sizeof(buf))) > 0) {
+    for (ssize_t iii = 0; iii < buf_len; ++iii) {
+      if (is_output_done) {
+        *out_is_served  = true;
+        *out_is_success = buf[iii] == '0';
+        break;
+      }
+      if (buf[iii] == '\0') {
+        fwrite(buf, 1, (size_t)iii, stdout);
+        is_output_done = true;
+      }
+    }
+    if (!is_output_done) { fwrite(buf, 1, (size_t)buf_len, stdout); }
+    if (*out_is_served) { break; }
+  }
+  fflush(stdout);
+  close(client);
+
+  c_defer_check(*out_is_served, NULL, NULL,
+                err = CERROR_internal_error(
+                    "c: the daemon hung up in the middle of a build"));
+
+  c_defer_deinit();
+
+  return err;
+#else
+  (void)project_path_len;
+  return CERROR_none;
+#endif
+}
+
+CError
+cdaemon_watch(char const            project_path[],
+              size_t                project_path_len,
+              CDaemonRequest const* request)
+{
+  assert(project_path && project_path_len > 0);
+  assert(request);
+
+#ifdef __linux__
+  CError         err         = CERROR_none;
+  CDaemonSession session     = {0};
+  size_t         changes_len = 0;
+
+  c_defer_init(4);
+
+  err = internal_cdaemon_session_create(project_path, project_path_len,
+                                        &session);
+  c_defer_err(err.code == 0, internal_cdaemon_session_destroy, &session,
+              NULL);
+
+  internal_cdaemon_handle_signals();
+
+  while (!cdaemon_is_stopping) {
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    CError build_err = internal_cdaemon_session_build(&session, request);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double const elapsed_ms = (double)(end.tv_sec - begin.tv_sec) * 1e3
+                              + (double)(end.tv_nsec - begin.tv_nsec) / 1e6;
+
+    if (build_err.code != 0) {
+      fprintf(stderr, "Error: %d\n---\n%s\n", build_err.code,
+              build_err.desc);
+    }
+    printf("c: %zu change(s), build %s in %.1f ms, watching...\n",
+           changes_len, build_err.code == 0 ? "succeeded" : "failed",
+           elapsed_ms);
+    fflush(stdout);
+
+    // wait for the first change, then until the writes settle
+    changes_len = 0;
+    for (size_t new_changes_len = 0;
+         !cdaemon_is_stopping && (changes_len == 0 || new_changes_len > 0);
+         changes_len += new_changes_len) {
+      err = cwatch_poll(&session.watch,
+                        changes_len == 0 ? -1 : CDAEMON_DEBOUNCE_MS,
+                        internal_cdaemon_session_on_change, &session,
+                        &new_changes_len);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+  }
+
+  c_defer_deinit();
+
+  return err;
+#else
+  (void)project_path_len;
+  return CERROR_internal_error(
+      "c: watching is not supported on this platform");
+#endif
+}
+
+// ------------------------------------------------------------------------//
+// ------------------------------ Internals -------------------------------//
+// ------------------------------------------------------------------------//
+
+#ifdef __linux__
+CError
+internal_cdaemon_session_create(char const      project_path[],
+                                size_t          project_path_len,
+                                CDaemonSession* out_session)
+{
+  *out_session = (CDaemonSession){.watch = {.fd = -1}};
+
+  c_str_error_t str_err = c_str_create(project_path, project_path_len,
+                                       &out_session->project_path);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  CError err = cwatch_create(cbuild_is_output_dir, &out_session->watch);
+  if (err.code != 0) {
+    c_str_destroy(&out_session->project_path);
+    return err;
+  }
+
+  // a project that fails to configure is watched as well, its fix is
+  // awaited
+  err = cwatch_add_dir(&out_session->watch, project_path, project_path_len);
+  if (err.code != 0) { internal_cdaemon_session_destroy(out_session); }
+
+  return err;
+}
+
+CError
+internal_cdaemon_session_build(CDaemonSession*       self,
+                               CDaemonRequest const* request)
+{
+  CError   err     = CERROR_none;
+  CStr     key     = {0};
+  CBuild   cbuilds[CDAEMON_BUILD_TYPES_LEN];
+  CTarget* targets = NULL;
+
+  c_defer_init(5);
+
+  err = internal_cdaemon_request_key(request, &key);
+  c_defer_err(err.code == 0, c_str_destroy, &key, NULL);
+
+  targets = calloc(request->target_names_len + 1, sizeof(CTarget));
+  c_defer_err(targets, free, targets, err = CERROR_memory_allocation);
+
+  bool is_up_to_date = true;
+  for (size_t iii = 0; iii < request->btypes_len; ++iii) {
+    CBuildType btype  = request->btypes[iii];
+    CBuild*    cbuild = &self->cbuilds[btype];
+
+    if (!cbuild->impl) {
+      err = cbuild_create(btype, self->project_path.data,
+                          self->project_path.len, cbuild);
+      c_defer_check(err.code == 0, NULL, NULL, *cbuild = (CBuild){0});
+
+      err = cbuild_configure(cbuild);
+      c_defer_check(err.code == 0, cbuild_destroy, cbuild, NULL);
+
+      // every project of every configuration lives in the same folders
+      err = internal_cdaemon_session_watch(self, cbuild->impl);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+    }
+
+    cbuilds[iii] = *cbuild;
+
+    // other unity batches compile other files
+    if (cbuild->impl->unity_batches != request->unity_batches) {
+      cbuild_set_unity_batches(cbuild, request->unity_batches);
+      self->is_clean[btype] = false;
+    }
+
+    // another linker links everything again
+    CBuildLinker const linker = cbuild->impl->linker;
+    err = cbuild_set_linker(cbuild, request->linker);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+    if (cbuild->impl->linker != linker) { self->is_clean[btype] = false; }
+
+    if (cbuild->impl->debug_info != request->debug_info) {
+      err = cbuild_set_debug_info(cbuild, request->debug_info);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+      self->is_clean[btype] = false;
+    }
+
+    // unknown targets fail even when there is nothing to build
+    err = cbuild_targets_get(cbuild, request->target_names,
+                             request->target_names_len, targets);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    // the last build covered everything, or exactly the same targets
+    is_up_to_date
+        = is_up_to_date && self->is_clean[btype]
+          && (self->clean_targets[btype].len == 0
+              || strcmp(self->clean_targets[btype].data, key.data) == 0);
+
+    // nothing watched changed, an output may have been deleted all the same
+    if (is_up_to_date) {
+      CHash128 stamp;
+      err = cbuild_get_outputs_stamp(cbuild, &stamp);
+      c_defer_check(err.code == 0, NULL, NULL, NULL);
+      is_up_to_date = c_hash128_equal(stamp, self->clean_stamps[btype]);
+    }
+  }
+
+  if (is_up_to_date) { c_defer_check(false, NULL, NULL, NULL); }
+
+  for (size_t iii = 0; iii < request->btypes_len; ++iii) {
+    self->is_clean[request->btypes[iii]] = false;
+  }
+
+  err = cbuild_build_many(cbuilds, request->btypes_len, request->target_names,
+                          request->target_names_len, request->jobs);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  for (size_t iii = 0; iii < request->btypes_len; ++iii) {
+    CBuildType btype = request->btypes[iii];
+
+    c_str_destroy(&self->clean_targets[btype]);
+    c_str_error_t str_err = c_str_clone(&key, &self->clean_targets[btype]);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+
+    err = cbuild_get_outputs_stamp(&self->cbuilds[btype],
+                                   &self->clean_stamps[btype]);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+    self->is_clean[btype] = true;
+  }
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+internal_cdaemon_session_watch(CDaemonSession* self, CBuildImpl* cbuild)
+{
+  CError err
+      = cwatch_add_dir(&self->watch, C_STR2(cbuild->base_path.data));
+  if (err.code != 0) { return err; }
+
+  // a request that changed nothing never stats a source, the headers out
+  // of the project have to be watched as well
+  CArray include_dirs; // CArray< CStr >
+  err = cbuild_get_external_include_dirs(&(CBuild){cbuild}, &include_dirs);
+  if (err.code != 0) { return err; }
+  for (size_t iii = 0; iii < include_dirs.len; ++iii) {
+    CStr* include_dir = &((CStr*)include_dirs.data)[iii];
+    // a missing directory is a failing compile, not a daemon failure
+    (void)cwatch_add_dir(&self->watch, include_dir->data, include_dir->len);
+    c_str_destroy(include_dir);
+  }
+  c_array_destroy(&include_dirs);
+
+  for (size_t iii = 0; iii < cbuild->other_projects.len; ++iii) {
+    err = internal_cdaemon_session_watch(
+        self, ((CBuildImpl**)cbuild->other_projects.data)[iii]);
+    if (err.code != 0) { return err; }
+  }
+
+  return CERROR_none;
+}
+
+void
+internal_cdaemon_session_on_change(char const path[],
+                                   size_t     path_len,
+                                   void*      extra_data)
+{
+  CDaemonSession* self = extra_data;
+
+  for (size_t iii = 0; iii < CDAEMON_BUILD_TYPES_LEN; ++iii) {
+    self->is_clean[iii] = false;
+  }
+
+  // lost events could have hidden a build.c change as well
+  size_t const name_len = sizeof(default_build_file) - 1;
+  bool const   is_build_file
+      = path_len == 0
+        || (path_len > name_len && path[path_len - name_len - 1] == '/'
+            && strncmp(&path[path_len - name_len], default_build_file,
+                       name_len)
+                   == 0);
+  if (!is_build_file) { return; }
+
+  // configured again on the next request
+  for (size_t iii = 0; iii < CDAEMON_BUILD_TYPES_LEN; ++iii) {
+    if (self->cbuilds[iii].impl) { cbuild_destroy(&self->cbuilds[iii]); }
+  }
+}
+
+void
+internal_cdaemon_session_destroy(CDaemonSession* self)
+{
+  for (size_t iii = 0; iii < CDAEMON_BUILD_TYPES_LEN; ++iii) {
+    if (self->cbuilds[iii].impl) { cbuild_destroy(&self->cbuilds[iii]); }
+    c_str_destroy(&self->clean_targets[iii]);
+  }
+  cwatch_destroy(&self->watch);
+  c_str_destroy(&self->project_path);
+
+  *self = (CDaemonSession){0};
+}
+
+CError
+internal_cdaemon_get_address(char const          project_path[],
+                             size_t              project_path_len,
+                             struct sockaddr_un* out_address)
+{
+  // <project>/<build path>/<socket name>
+  *out_address            = (struct sockaddr_un){0};
+  out_address->sun_family = AF_UNIX;
+
+  int len = snprintf(out_address->sun_path, sizeof(out_address->sun_path),
+                     "%.*s/%s", (int)project_path_len, project_path,
+                     cbuild_get_builder_dir_name());
+  if (len < 0 || (size_t)len >= sizeof(out_address->sun_path)) {
+    return CERROR_str_exccedded_len;
+  }
+
+  len = snprintf(&out_address->sun_path[len],
+                 sizeof(out_address->sun_path) - (size_t)len, "/%s",
+                 default_socket_name);
+  if (len < 0 || (size_t)len >= sizeof(out_address->sun_path)) {
+    return CERROR_str_exccedded_len;
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cdaemon_serve(CDaemonSession* session, int client)
+{
+  CError         err             = CERROR_none;
+  CDaemonRequest request         = {0};
+  char const**   target_names    = NULL;
+  int            saved_fds[2]    = {-1, -1};
+  char           line[CDAEMON_REQUEST_MAX_LEN + 1];
+  size_t         line_len        = 0;
+
+  c_defer_init(4);
+
+  // <jobs> <unity batches> <linker> <debug info> <btype>[,<btype>...]
+  // [<target>...] '\n'
+  while (line_len < CDAEMON_REQUEST_MAX_LEN
+         && (line_len == 0 || line[line_len - 1] != '\n')) {
+    ssize_t read_len
+        = read(client, &line[line_len], CDAEMON_REQUEST_MAX_LEN - line_len);
+    if (read_len <= 0) { break; }
+    line_len += (size_t)read_len;
+  }
+  line[line_len] = '\0';
+  c_defer_check(line_len > 0 && line[line_len - 1] == '\n', NULL, NULL,
+                err = CERROR_wrong_options);
+
+  target_names = calloc(line_len, sizeof(char const*));
+  c_defer_err(target_names, free, target_names,
+              err = CERROR_memory_allocation);
+
+  err = internal_cdaemon_request_from_line(line, &request, target_names);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // whatever changed right before the request belongs to it
+  err = cwatch_poll(&session->watch, 0, internal_cdaemon_session_on_change,
+                    session, NULL);
+  c_defer_check(err.code == 0, NULL, NULL, NULL);
+
+  // the build, the compilers it runs included, writes to the client
+  fflush(stdout);
+  fflush(stderr);
+  saved_fds[0] = dup(STDOUT_FILENO);
+  saved_fds[1] = dup(STDERR_FILENO);
+  dup2(client, STDOUT_FILENO);
+  dup2(client, STDERR_FILENO);
+
+  CError build_err = internal_cdaemon_session_build(session, &request);
+  if (build_err.code != 0) {
+    fprintf(stderr, "Error: %d\n---\n%s\n", build_err.code, build_err.desc);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  dup2(saved_fds[0], STDOUT_FILENO);
+  dup2(saved_fds[1], STDERR_FILENO);
+  close(saved_fds[0]);
+  close(saved_fds[1]);
+
+  char const status[] = {'\0', build_err.code == 0 ? '0' : '1'};
+  c_defer_check(write(client, status, sizeof(status)) == sizeof(status),
+                NULL, NULL,
+                err = CERROR_internal_error("c: the client hung up"));
+
+  c_defer_deinit();
+
+  return err;
+}
+
+CError
+internal_cdaemon_request_to_line(CDaemonRequest const* request, CStr* out_line)
+{
+  c_str_error_t str_err = c_str_create_empty(256, out_line);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  str_err = c_str_format(out_line, 0, C_STR_INV("%zu %zu %d %u "),
+                         request->jobs, request->unity_batches,
+                         (int)request->linker, request->debug_info);
+  for (size_t iii = 0; iii < request->btypes_len && str_err.code == 0; ++iii) {
+    str_err = c_str_format(out_line, out_line->len, C_STR_INV("%s%d"),
+                           iii > 0 ? "," : "", (int)request->btypes[iii]);
+  }
+  for (size_t iii = 0; iii < request->target_names_len && str_err.code == 0;
+       ++iii) {
+    str_err = c_str_format(out_line, out_line->len, C_STR_INV(" %s"),
+                           request->target_names[iii]);
+  }
+  if (str_err.code == 0) {
+    str_err = c_str_format(out_line, out_line->len, C_STR_INV("\n"));
+  }
+
+  if (str_err.code != 0) {
+    c_str_destroy(out_line);
+    return CERROR_internal_error(str_err.desc);
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cdaemon_request_from_line(char            line[],
+                                   CDaemonRequest* out_request,
+                                   char const**    target_names)
+{
+  char* save  = NULL;
+  char* token = strtok_r(line, " \n", &save);
+  if (!token) { return CERROR_wrong_options; }
+
+  *out_request = (CDaemonRequest){.target_names = target_names};
+
+  out_request->jobs = strtoul(token, NULL, 10);
+
+  token = strtok_r(NULL, " \n", &save);
+  if (!token) { return CERROR_wrong_options; }
+
+  out_request->unity_batches = strtoull(token, NULL, 10);
+
+  token = strtok_r(NULL, " \n", &save);
+  if (!token) { return CERROR_wrong_options; }
+
+  unsigned long const linker = strtoul(token, NULL, 10);
+  if (linker > CBUILD_LINKER_auto) { return CERROR_wrong_options; }
+  out_request->linker = (CBuildLinker)linker;
+
+  token = strtok_r(NULL, " \n", &save);
+  if (!token) { return CERROR_wrong_options; }
+
+  out_request->debug_info = (unsigned)strtoul(token, NULL, 10);
+
+  token = strtok_r(NULL, " \n", &save);
+  if (!token) { return CERROR_wrong_options; }
+
+  for (char* btype = token; *btype != '\0';) {
+    char*         btype_end = NULL;
+    unsigned long value     = strtoul(btype, &btype_end, 10);
+    if (btype_end == btype || value >= CDAEMON_BUILD_TYPES_LEN
+        || out_request->btypes_len >= CDAEMON_BUILD_TYPES_LEN) {
+      return CERROR_wrong_options;
+    }
+    out_request->btypes[out_request->btypes_len++] = (CBuildType)value;
+
+    btype = *btype_end == ',' ? btype_end + 1 : btype_end;
+  }
+
+  while ((token = strtok_r(NULL, " \n", &save)) != NULL) {
+    target_names[out_request->target_names_len++] = token;
+  }
+
+  return CERROR_none;
+}
+
+CError
+internal_cdaemon_request_key(CDaemonRequest const* request, CStr* out_key)
+{
+  c_str_error_t str_err = c_str_create_empty(64, out_key);
+  if (str_err.code != 0) { return CERROR_internal_error(str_err.desc); }
+
+  for (size_t iii = 0; iii < request->target_names_len && str_err.code == 0;
+       ++iii) {
+    str_err = c_str_format(out_key, out_key->len, C_STR_INV("%s "),
+                           request->target_names[iii]);
+  }
+
+  if (str_err.code != 0) {
+    c_str_destroy(out_key);
+    return CERROR_internal_error(str_err.desc);
+  }
+
+  return CERROR_none;
+}
+
+void
+internal_cdaemon_handle_signals(void)
+{
+  // no SA_RESTART, a blocked poll() returns to see the stop request
+  struct sigaction action = {.sa_handler = internal_cdaemon_on_signal};
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  // a client that hangs up must not take the daemon down with it
+  signal(SIGPIPE, SIG_IGN);
+}
+
+void
+internal_cdaemon_on_signal(int signal_number)
+{
+  (void)signal_number;
+
+  cdaemon_is_stopping = 1;
+}
+#endif
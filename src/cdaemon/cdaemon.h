@@ -0,0 +1,48 @@
+#ifndef CDAEMON_H
+#define CDAEMON_H
+
+#include "cbuild.h"
+#include "cbuild_private.h"
+#include "cerror.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CDAEMON_BUILD_TYPES_LEN (CBUILD_TYPE_release_with_minimum_size + 1)
+
+/// what `c build` asks for
+typedef struct CDaemonRequest {
+  CBuildType         btypes[CDAEMON_BUILD_TYPES_LEN];
+  size_t             btypes_len;
+  char const* const* target_names;
+  size_t             target_names_len;
+  size_t             jobs;
+  size_t             unity_batches; // see `cbuild_set_unity_batches`
+  CBuildLinker       linker;        // see `cbuild_set_linker`
+  unsigned           debug_info;    // see `cbuild_set_debug_info`
+} CDaemonRequest;
+
+/// serve build requests for the project at `project_path` on
+/// `<project>/.c_build/c.sock` until SIGINT/SIGTERM.
+/// the configured projects stay in memory between requests and inotify
+/// tells which of them went stale, a request nothing changed for since the
+/// last successful one is answered by asking the state of the outputs only.
+/// a changed `build.c` gets everything configured again
+CError cdaemon_run(char const project_path[], size_t project_path_len);
+
+/// build `request`, then build it again every time a file of the project
+/// changes until SIGINT/SIGTERM. a burst of writes makes one build, a
+/// changed `build.c` gets the project configured again
+CError cdaemon_watch(char const            project_path[],
+                     size_t                project_path_len,
+                     CDaemonRequest const* request);
+
+/// hand `request` to the daemon serving `project_path`, its output is
+/// forwarded to stdout. `out_is_served` is false when no daemon is running
+CError cdaemon_request(char const            project_path[],
+                       size_t                project_path_len,
+                       CDaemonRequest const* request,
+                       bool*                 out_is_served,
+                       bool*                 out_is_success);
+
+#endif // CDAEMON_H
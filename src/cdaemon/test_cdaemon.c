@@ -0,0 +1,307 @@
+#include <cdaemon.h>
+#include <helpers.h>
+
+#include <utest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/// the build file of the project, `%s` is an include directory outside of
+/// it. it declares what it calls itself, the headers of cbuild are not
+/// installed while testing
+static char const build_file[]
+    = "#include <stddef.h>\n"
+      "#include <string.h>\n"
+      "typedef struct CError { int code; char const* desc; } CError;\n"
+      "typedef struct CBuild { void* impl; } CBuild;\n"
+      "typedef struct CTarget { void* impl; } CTarget;\n"
+      "CError cbuild_exe_create(CBuild*, char const*, size_t, char const*,\n"
+      "                         size_t, CTarget*);\n"
+      "CError cbuild_target_add_source(CBuild*, CTarget*, char const*,\n"
+      "                                size_t);\n"
+      "CError cbuild_target_add_include_path_flag(CBuild*, CTarget*,\n"
+      "                                           char const*, size_t);\n"
+      "CError project(CBuild* cbuild)\n"
+      "{\n"
+      "  CTarget target;\n"
+      "  CError err = cbuild_exe_create(cbuild, \"t\", 1, \".\", 1, &target);\n"
+      "  if (err.code != 0) { return err; }\n"
+      "  err = cbuild_target_add_include_path_flag(cbuild, &target, \"%s\",\n"
+      "                                            strlen(\"%s\"));\n"
+      "  if (err.code != 0) { return err; }\n"
+      "  return cbuild_target_add_source(cbuild, &target, \"main.c\", 6);\n"
+      "}\n";
+
+static void
+write_file(char const path[], char const content[])
+{
+  FILE* file = fopen(path, "w");
+  if (file) {
+    fputs(content, file);
+    fclose(file);
+  }
+}
+
+/// the whole file, empty if it is missing
+static void
+read_file(char const path[], char content[], size_t content_capacity)
+{
+  size_t len  = 0;
+  FILE*  file = fopen(path, "r");
+  if (file) {
+    len = fread(content, 1, content_capacity - 1, file);
+    fclose(file);
+  }
+  content[len] = '\0';
+}
+
+struct cdaemon {
+  char  root[64];
+  char  include_dir[72]; // <root>_include
+  char  path[128];
+  pid_t daemon;
+};
+
+/// serve the project of `self` from a child process, or watch it for
+/// `watch_request` if not NULL, its output goes to `<root>.watch.log`
+/// where the watch doesn't see it
+static pid_t
+daemon_start(struct cdaemon const* self, CDaemonRequest const* watch_request)
+{
+  fflush(stdout);
+  pid_t const daemon = fork();
+  if (daemon != 0) { return daemon; }
+
+  CError err = CERROR_none;
+  if (watch_request) {
+    char log_path[128];
+    snprintf(log_path, sizeof(log_path), "%s.watch.log", self->root);
+    FILE* file = fopen(log_path, "w");
+    if (!file) { _exit(1); }
+    dup2(fileno(file), STDOUT_FILENO);
+
+    err = cdaemon_watch(C_STR2(self->root), watch_request);
+  } else {
+    err = cdaemon_run(C_STR2(self->root));
+  }
+  _exit(err.code == 0 ? 0 : 1);
+}
+
+/// wait until the watch of `self` finished `builds_len` builds, `log` gets
+/// what the last one printed
+static bool
+watch_wait(struct cdaemon const* self,
+           size_t                builds_len,
+           char                  log[],
+           size_t                log_capacity)
+{
+  char log_path[128];
+  snprintf(log_path, sizeof(log_path), "%s.watch.log", self->root);
+
+  for (size_t iii = 0; iii < 1000; ++iii) {
+    read_file(log_path, log, log_capacity);
+
+    // every build ends with `watching...`
+    char const* last  = log;
+    size_t      found = 0;
+    for (char const* end = strstr(log, "watching..."); end;
+         end             = strstr(end + 1, "watching...")) {
+      if (++found == builds_len) {
+        memmove(log, last, (size_t)(end - last));
+        log[end - last] = '\0';
+        return true;
+      }
+      last = end;
+    }
+
+    nanosleep(&(struct timespec){.tv_nsec = 10 * 1000 * 1000}, NULL);
+  }
+
+  return false;
+}
+
+/// send `request` to the daemon of `root`, what it prints is written into
+/// `log` instead of stdout
+static CError
+request_logged(char const            root[],
+               CDaemonRequest const* request,
+               bool*                 out_is_served,
+               bool*                 out_is_success,
+               char                  log[],
+               size_t                log_capacity)
+{
+  char log_path[128];
+  snprintf(log_path, sizeof(log_path), "%s.log", root);
+
+  fflush(stdout);
+  int const saved = dup(STDOUT_FILENO);
+  FILE*     file  = fopen(log_path, "w");
+  if (saved < 0 || !file) {
+    if (file) { fclose(file); }
+    return CERROR_internal_error("test: can't redirect the output");
+  }
+  dup2(fileno(file), STDOUT_FILENO);
+
+  CError err = cdaemon_request(C_STR2(root), request, out_is_served,
+                               out_is_success);
+
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  fclose(file);
+
+  read_file(log_path, log, log_capacity);
+  remove(log_path);
+  return err;
+}
+
+UTEST_F_SETUP(cdaemon)
+{
+  strcpy(utest_fixture->root, "/tmp/test_cdaemon.XXXXXX");
+  ASSERT_TRUE(mkdtemp(utest_fixture->root));
+
+  snprintf(utest_fixture->include_dir, sizeof(utest_fixture->include_dir),
+           "%s_include", utest_fixture->root);
+  ASSERT_EQ(mkdir(utest_fixture->include_dir, 0755), 0);
+  snprintf(utest_fixture->path, sizeof(utest_fixture->path), "%s/value.h",
+           utest_fixture->include_dir);
+  write_file(utest_fixture->path, "#define VALUE 0\n");
+
+  char content[sizeof(build_file) + 2 * sizeof(utest_fixture->include_dir)];
+  snprintf(content, sizeof(content), build_file, utest_fixture->include_dir,
+           utest_fixture->include_dir);
+  snprintf(utest_fixture->path, sizeof(utest_fixture->path), "%s/build.c",
+           utest_fixture->root);
+  write_file(utest_fixture->path, content);
+  snprintf(utest_fixture->path, sizeof(utest_fixture->path), "%s/main.c",
+           utest_fixture->root);
+  write_file(utest_fixture->path, "#include \"value.h\"\n"
+                                  "int main(void) { return VALUE; }\n");
+
+  utest_fixture->daemon = -1;
+}
+
+UTEST_F_TEARDOWN(cdaemon)
+{
+  if (utest_fixture->daemon > 0) {
+    kill(utest_fixture->daemon, SIGTERM);
+    int status = 0;
+    ASSERT_EQ(waitpid(utest_fixture->daemon, &status, 0),
+              utest_fixture->daemon);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  char cmd[256];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s %s %s.watch.log", utest_fixture->root,
+           utest_fixture->include_dir, utest_fixture->root);
+  ASSERT_EQ(system(cmd), 0);
+}
+
+UTEST_F(cdaemon, requests)
+{
+  CDaemonRequest request = {
+      .btypes     = {CBUILD_TYPE_debug},
+      .btypes_len = 1,
+      .jobs       = 1,
+      .linker     = CBUILD_LINKER_default,
+  };
+
+  utest_fixture->daemon = daemon_start(utest_fixture, NULL);
+  ASSERT_GT(utest_fixture->daemon, 0);
+
+  // the daemon listens once its socket exists
+  char   log[8192];
+  bool   is_served  = false;
+  bool   is_success = false;
+  CError err        = CERROR_none;
+  for (size_t iii = 0; iii < 500 && !is_served; ++iii) {
+    nanosleep(&(struct timespec){.tv_nsec = 10 * 1000 * 1000}, NULL);
+    err = request_logged(utest_fixture->root, &request, &is_served,
+                         &is_success, log, sizeof(log));
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+  }
+  ASSERT_TRUE(is_served);
+  ASSERT_TRUE(is_success);
+  ASSERT_TRUE(strstr(log, "/main.c\n"));
+
+  // nothing changed, nothing runs
+  err = request_logged(utest_fixture->root, &request, &is_served, &is_success,
+                       log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(is_served && is_success);
+  ASSERT_FALSE(strstr(log, "command:"));
+
+  // an edit is seen by the watch
+  write_file(utest_fixture->path, "#include \"value.h\"\n"
+                                  "int main(void) { return !VALUE; }\n");
+  err = request_logged(utest_fixture->root, &request, &is_served, &is_success,
+                       log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(is_served && is_success);
+  ASSERT_TRUE(strstr(log, "/main.c\n"));
+  ASSERT_TRUE(strstr(log, "c_out/debug/t/t "));
+
+  // so is one of a header outside of the project
+  char header[128];
+  snprintf(header, sizeof(header), "%s/value.h", utest_fixture->include_dir);
+  write_file(header, "#define VALUE 1\n");
+  err = request_logged(utest_fixture->root, &request, &is_served, &is_success,
+                       log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(is_served && is_success);
+  ASSERT_TRUE(strstr(log, "/main.c\n"));
+
+  // a deleted output is not watched, its state is asked on every request
+  char output[128];
+  snprintf(output, sizeof(output), "%s/c_out/debug/t/t", utest_fixture->root);
+  ASSERT_EQ(remove(output), 0);
+  err = request_logged(utest_fixture->root, &request, &is_served, &is_success,
+                       log, sizeof(log));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(is_served && is_success);
+  ASSERT_TRUE(strstr(log, "c_out/debug/t/t "));
+  ASSERT_FALSE(strstr(log, "/main.c\n"));
+}
+
+UTEST_F(cdaemon, watch)
+{
+  CDaemonRequest request = {
+      .btypes     = {CBUILD_TYPE_debug},
+      .btypes_len = 1,
+      .jobs       = 1,
+      .linker     = CBUILD_LINKER_default,
+  };
+
+  utest_fixture->daemon = daemon_start(utest_fixture, &request);
+  ASSERT_GT(utest_fixture->daemon, 0);
+
+  // the first build runs right away
+  char log[8192];
+  ASSERT_TRUE(watch_wait(utest_fixture, 1, log, sizeof(log)));
+  ASSERT_TRUE(strstr(log, "/main.c\n"));
+  ASSERT_TRUE(strstr(log, "build succeeded"));
+
+  // an edit builds again
+  write_file(utest_fixture->path, "#include \"value.h\"\n"
+                                  "int main(void) { return !VALUE; }\n");
+  ASSERT_TRUE(watch_wait(utest_fixture, 2, log, sizeof(log)));
+  ASSERT_TRUE(strstr(log, "/main.c\n"));
+  ASSERT_TRUE(strstr(log, "build succeeded"));
+
+  // so does one of a header outside of the project
+  char header[128];
+  snprintf(header, sizeof(header), "%s/value.h", utest_fixture->include_dir);
+  write_file(header, "#define VALUE 1\n");
+  ASSERT_TRUE(watch_wait(utest_fixture, 3, log, sizeof(log)));
+  ASSERT_TRUE(strstr(log, "/main.c\n"));
+  ASSERT_TRUE(strstr(log, "build succeeded"));
+}
+#endif
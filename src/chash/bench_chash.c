@@ -0,0 +1,50 @@
+#include <chash.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_TOTAL_BYTES (1ULL << 30)
+
+static double
+bench_now(void)
+{
+  return (double)clock() / CLOCKS_PER_SEC;
+}
+
+int
+main(void)
+{
+  size_t const sizes[] = {16, 128, 1024, 64 * 1024, 16 * 1024 * 1024};
+  CHashImpl const impls[] = {CHASH_IMPL_scalar, CHASH_IMPL_sse2,
+                             CHASH_IMPL_avx2};
+
+  unsigned char* buf = malloc(sizes[sizeof(sizes) / sizeof(*sizes) - 1]);
+  if (!buf) { return EXIT_FAILURE; }
+  memset(buf, 0x5a, sizes[sizeof(sizes) / sizeof(*sizes) - 1]);
+
+  printf("%-8s %12s %10s\n", "impl", "bytes", "GB/s");
+  for (size_t iii = 0; iii < sizeof(impls) / sizeof(*impls); ++iii) {
+    if (!c_hash_set_impl(impls[iii])) { continue; }
+
+    for (size_t jjj = 0; jjj < sizeof(sizes) / sizeof(*sizes); ++jjj) {
+      size_t const rounds   = BENCH_TOTAL_BYTES / sizes[jjj];
+      uint64_t     checksum = 0;
+
+      double const start = bench_now();
+      for (size_t rrr = 0; rrr < rounds; ++rrr) {
+        checksum ^= c_hash128(buf, sizes[jjj], rrr).low;
+      }
+      double const elapsed = bench_now() - start;
+
+      printf("%-8s %12zu %10.2f (%016llx)\n", c_hash_impl_get_name(impls[iii]),
+             sizes[jjj], (double)BENCH_TOTAL_BYTES / elapsed / 1e9,
+             (unsigned long long)checksum);
+    }
+  }
+
+  free(buf);
+
+  return EXIT_SUCCESS;
+}
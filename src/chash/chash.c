@@ -0,0 +1,819 @@
+#include "chash.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHASH_HAS_X86_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define CHASH_HAS_X86_SIMD 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CHASH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CHASH_TARGET_AVX2
+#endif
+
+#define CHASH_STRIPE_LEN 64
+#define CHASH_SECRET_LEN 192
+#define CHASH_SECRET_CONSUME_RATE 8
+#define CHASH_ACC_NB 8
+#define CHASH_STRIPES_PER_BLOCK                                                \
+  ((CHASH_SECRET_LEN - CHASH_STRIPE_LEN) / CHASH_SECRET_CONSUME_RATE)
+#define CHASH_BLOCK_LEN (CHASH_STRIPE_LEN * CHASH_STRIPES_PER_BLOCK)
+#define CHASH_MIDSIZE_MAX 128
+
+static uint32_t const CHASH_PRIME32_1 = 0x9E3779B1U;
+static uint32_t const CHASH_PRIME32_2 = 0x85EBCA77U;
+static uint32_t const CHASH_PRIME32_3 = 0xC2B2AE3DU;
+static uint64_t const CHASH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static uint64_t const CHASH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static uint64_t const CHASH_PRIME64_3 = 0x165667B19E3779F9ULL;
+static uint64_t const CHASH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static uint64_t const CHASH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+/// splitmix64 sequence seeded with CHASH_PRIME64_1
+static uint64_t const internal_secret[CHASH_SECRET_LEN / sizeof(uint64_t)] = {
+    0x8c9ff21eb4943e94ULL, 0x529bcfd80991254cULL, 0x12b8eb6d931b5e6eULL,
+    0xcec50c5d0c1fcc21ULL, 0x31f5796e26ef1ca1ULL, 0x6fad0e5ad91dff82ULL,
+    0x061c22c6f5405433ULL, 0xacebed3be37886a1ULL, 0x0d81e8485a2713a6ULL,
+    0xa3e600f8f1fd238cULL, 0xef1382c779e55f8eULL, 0xfe2c41ff60885d40ULL,
+    0x94cbb826dac34bb2ULL, 0xb502428724a731f6ULL, 0xd0bec29520b72715ULL,
+    0x81335f7cacfebd80ULL, 0xe34be0aababd1d08ULL, 0x25c86b4d7ef8431aULL,
+    0x889c2b2a461ffb7eULL, 0x6a810fe6190b977eULL, 0xa24c7ba4f2058340ULL,
+    0xba5c108702350f86ULL, 0x73b2efd68e1c6856ULL, 0xc539d9c263ee450aULL,
+};
+
+typedef void (*internal_accumulate_fn)(uint64_t       acc[CHASH_ACC_NB],
+                                       uint8_t const* data,
+                                       uint8_t const* secret,
+                                       size_t         stripes);
+typedef void (*internal_scramble_fn)(uint64_t       acc[CHASH_ACC_NB],
+                                     uint8_t const* secret);
+
+static void internal_accumulate_scalar(uint64_t       acc[CHASH_ACC_NB],
+                                       uint8_t const* data,
+                                       uint8_t const* secret,
+                                       size_t         stripes);
+static void internal_scramble_scalar(uint64_t       acc[CHASH_ACC_NB],
+                                     uint8_t const* secret);
+#if CHASH_HAS_X86_SIMD
+static void internal_accumulate_sse2(uint64_t       acc[CHASH_ACC_NB],
+                                     uint8_t const* data,
+                                     uint8_t const* secret,
+                                     size_t         stripes);
+static void internal_scramble_sse2(uint64_t       acc[CHASH_ACC_NB],
+                                   uint8_t const* secret);
+static void internal_accumulate_avx2(uint64_t       acc[CHASH_ACC_NB],
+                                     uint8_t const* data,
+                                     uint8_t const* secret,
+                                     size_t         stripes);
+static void internal_scramble_avx2(uint64_t       acc[CHASH_ACC_NB],
+                                   uint8_t const* secret);
+#endif
+static bool internal_cpu_supports(CHashImpl impl);
+static void internal_dispatch_set(CHashImpl impl);
+
+static struct {
+  CHashImpl              impl;
+  internal_accumulate_fn accumulate;
+  internal_scramble_fn   scramble;
+} internal_dispatch;
+
+// the implementation is resolved once, concurrent hashes of the build
+// workers would race on `internal_dispatch` otherwise
+#ifdef _WIN32
+static INIT_ONCE internal_dispatch_once = INIT_ONCE_STATIC_INIT;
+#else
+static pthread_once_t internal_dispatch_once = PTHREAD_ONCE_INIT;
+#endif
+
+static inline uint64_t
+internal_read64(void const* ptr)
+{
+  uint64_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+static inline uint64_t
+internal_avalanche(uint64_t hash)
+{
+  hash ^= hash >> 37;
+  hash *= 0x165667919E3779F9ULL;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+static inline uint64_t
+internal_mul128_fold64(uint64_t lhs, uint64_t rhs)
+{
+#if defined(__SIZEOF_INT128__)
+  __uint128_t const product = (__uint128_t)lhs * rhs;
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  uint64_t high;
+  uint64_t low = _umul128(lhs, rhs, &high);
+  return low ^ high;
+#else
+  uint64_t const lo_lo = (lhs & 0xFFFFFFFFULL) * (rhs & 0xFFFFFFFFULL);
+  uint64_t const hi_lo = (lhs >> 32) * (rhs & 0xFFFFFFFFULL);
+  uint64_t const lo_hi = (lhs & 0xFFFFFFFFULL) * (rhs >> 32);
+  uint64_t const hi_hi = (lhs >> 32) * (rhs >> 32);
+  uint64_t const cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFULL) + lo_hi;
+  uint64_t const upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+  uint64_t const lower = (cross << 32) | (lo_lo & 0xFFFFFFFFULL);
+  return lower ^ upper;
+#endif
+}
+
+static inline uint64_t
+internal_mix16(uint8_t const* data, uint8_t const* secret, uint64_t seed)
+{
+  return internal_mul128_fold64(
+      internal_read64(data) ^ (internal_read64(secret) + seed),
+      internal_read64(data + 8) ^ (internal_read64(secret + 8) - seed));
+}
+
+static inline uint64_t
+internal_merge_accs(uint64_t const acc[CHASH_ACC_NB],
+                    uint8_t const* secret,
+                    uint64_t       start)
+{
+  uint64_t result = start;
+  for (size_t iii = 0; iii < CHASH_ACC_NB / 2; ++iii) {
+    result += internal_mul128_fold64(
+        acc[2 * iii] ^ internal_read64(secret + 16 * iii),
+        acc[2 * iii + 1] ^ internal_read64(secret + 16 * iii + 8));
+  }
+  return internal_avalanche(result);
+}
+
+static void
+internal_dispatch_resolve(void)
+{
+  CHashImpl impl = CHASH_IMPL_scalar;
+#if CHASH_HAS_X86_SIMD
+  impl = internal_cpu_supports(CHASH_IMPL_avx2) ? CHASH_IMPL_avx2
+                                                : CHASH_IMPL_sse2;
+#endif
+  internal_dispatch_set(impl);
+}
+
+#ifdef _WIN32
+static BOOL CALLBACK
+internal_dispatch_resolve_once(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+  (void)once;
+  (void)param;
+  (void)context;
+  internal_dispatch_resolve();
+  return TRUE;
+}
+#endif
+
+static void
+internal_dispatch_init(void)
+{
+#ifdef _WIN32
+  InitOnceExecuteOnce(&internal_dispatch_once, internal_dispatch_resolve_once,
+                      NULL, NULL);
+#else
+  pthread_once(&internal_dispatch_once, internal_dispatch_resolve);
+#endif
+}
+
+static CHash128
+internal_hash128_short(uint8_t const* data,
+                       size_t         data_len,
+                       uint8_t const* secret,
+                       uint64_t       seed)
+{
+  if (data_len == 0) {
+    return (CHash128){
+        .low  = internal_avalanche(seed ^ internal_read64(secret + 64)
+                                   ^ internal_read64(secret + 72)),
+        .high = internal_avalanche(seed ^ internal_read64(secret + 80)
+                                   ^ internal_read64(secret + 88)),
+    };
+  }
+
+  // first and last (up to) 8 bytes, they overlap for short inputs
+  uint64_t     first     = 0;
+  uint64_t     last      = 0;
+  size_t const chunk_len = data_len < 8 ? data_len : 8;
+  memcpy(&first, data, chunk_len);
+  memcpy(&last, data + data_len - chunk_len, chunk_len);
+
+  uint64_t const low
+      = internal_mul128_fold64(first ^ (internal_read64(secret) + seed),
+                               last ^ (internal_read64(secret + 8) - seed))
+        ^ data_len;
+  uint64_t const high
+      = internal_mul128_fold64(last ^ (internal_read64(secret + 16) - seed),
+                               first ^ (internal_read64(secret + 24) + seed))
+        + data_len * CHASH_PRIME64_1;
+
+  return (CHash128){.low = internal_avalanche(low),
+                    .high = internal_avalanche(high)};
+}
+
+static CHash128
+internal_hash128_midsize(uint8_t const* data,
+                         size_t         data_len,
+                         uint8_t const* secret,
+                         uint64_t       seed)
+{
+  uint64_t     acc_low  = data_len * CHASH_PRIME64_1;
+  uint64_t     acc_high = 0;
+  size_t const rounds   = (data_len + 31) / 32;
+
+  // pair chunks from the front and the back of the input
+  for (size_t iii = 0; iii < rounds; ++iii) {
+    uint8_t const* front = data + 16 * iii;
+    uint8_t const* back  = data + data_len - 16 * (iii + 1);
+
+    acc_low += internal_mix16(front, secret + 32 * iii, seed);
+    acc_low ^= internal_read64(back) + internal_read64(back + 8);
+    acc_high += internal_mix16(back, secret + 32 * iii + 16, seed);
+    acc_high ^= internal_read64(front) + internal_read64(front + 8);
+  }
+
+  return (CHash128){
+      .low  = internal_avalanche(acc_low + acc_high),
+      .high = internal_avalanche(acc_low * CHASH_PRIME64_1
+                                 + acc_high * CHASH_PRIME64_4
+                                 + (data_len - seed) * CHASH_PRIME64_2),
+  };
+}
+
+static CHash128
+internal_hash128_long(uint8_t const* data,
+                      size_t         data_len,
+                      uint8_t const* secret)
+{
+  uint64_t acc[CHASH_ACC_NB] = {
+      CHASH_PRIME32_3, CHASH_PRIME64_1, CHASH_PRIME64_2, CHASH_PRIME64_3,
+      CHASH_PRIME64_4, CHASH_PRIME32_2, CHASH_PRIME64_5, CHASH_PRIME32_1,
+  };
+
+  size_t const blocks = (data_len - 1) / CHASH_BLOCK_LEN;
+  for (size_t iii = 0; iii < blocks; ++iii) {
+    internal_dispatch.accumulate(acc, data + iii * CHASH_BLOCK_LEN, secret,
+                                 CHASH_STRIPES_PER_BLOCK);
+    internal_dispatch.scramble(acc,
+                               secret + CHASH_SECRET_LEN - CHASH_STRIPE_LEN);
+  }
+
+  // last partial block
+  size_t const stripes
+      = ((data_len - 1) - CHASH_BLOCK_LEN * blocks) / CHASH_STRIPE_LEN;
+  internal_dispatch.accumulate(acc, data + blocks * CHASH_BLOCK_LEN, secret,
+                               stripes);
+
+  // last stripe, it overlaps with the previous one
+  internal_dispatch.accumulate(acc, data + data_len - CHASH_STRIPE_LEN,
+                               secret + CHASH_SECRET_LEN - CHASH_STRIPE_LEN - 7,
+                               1);
+
+  return (CHash128){
+      .low  = internal_merge_accs(acc, secret + 11, data_len * CHASH_PRIME64_1),
+      .high = internal_merge_accs(
+          acc, secret + CHASH_SECRET_LEN - CHASH_STRIPE_LEN - 11,
+          ~(data_len * CHASH_PRIME64_2)),
+  };
+}
+
+CHash128
+c_hash128(void const* data, size_t data_len, uint64_t seed)
+{
+  assert(data || data_len == 0);
+
+  internal_dispatch_init();
+
+  uint8_t const* secret = (uint8_t const*)internal_secret;
+
+  if (data_len <= 16) {
+    return internal_hash128_short(data, data_len, secret, seed);
+  } else if (data_len <= CHASH_MIDSIZE_MAX) {
+    return internal_hash128_midsize(data, data_len, secret, seed);
+  }
+
+  if (seed == 0) { return internal_hash128_long(data, data_len, secret); }
+
+  // derive a custom secret from the seed
+  uint64_t custom_secret[CHASH_SECRET_LEN / sizeof(uint64_t)];
+  for (size_t iii = 0; iii < CHASH_SECRET_LEN / sizeof(uint64_t); iii += 2) {
+    custom_secret[iii]     = internal_secret[iii] + seed;
+    custom_secret[iii + 1] = internal_secret[iii + 1] - seed;
+  }
+
+  return internal_hash128_long(data, data_len, (uint8_t const*)custom_secret);
+}
+
+CHash128
+c_hash128_combine(CHash128 hash, CHash128 other)
+{
+  uint64_t const parts[4] = {hash.low, hash.high, other.low, other.high};
+  return c_hash128(parts, sizeof(parts), 0);
+}
+
+bool
+c_hash128_equal(CHash128 hash, CHash128 other)
+{
+  return hash.low == other.low && hash.high == other.high;
+}
+
+CError
+c_hash128_file(char const path[], size_t path_len, CHash128* out_hash)
+{
+  assert(path && path_len > 0);
+  assert(out_hash);
+
+  if (path[path_len] != '\0') { return CERROR_invalid_string; }
+
+#ifdef _WIN32
+  HANDLE file
+      = CreateFileA(path, GENERIC_READ,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                    NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE) { return CERROR_no_such_source; }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    return CERROR_internal_error("c: failed to get the file size");
+  }
+
+  if (file_size.QuadPart == 0) {
+    CloseHandle(file);
+    *out_hash = c_hash128(NULL, 0, 0);
+    return CERROR_none;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping) {
+    CloseHandle(file);
+    return CERROR_internal_error("c: failed to map the file");
+  }
+
+  void const* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view) { *out_hash = c_hash128(view, (size_t)file_size.QuadPart, 0); }
+
+  if (view) { UnmapViewOfFile(view); }
+  CloseHandle(mapping);
+  CloseHandle(file);
+
+  return view ? CERROR_none
+              : CERROR_internal_error("c: failed to map the file");
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) { return CERROR_no_such_source; }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return CERROR_internal_error("c: failed to get the file size");
+  }
+
+  if (file_stat.st_size == 0) {
+    close(fd);
+    *out_hash = c_hash128(NULL, 0, 0);
+    return CERROR_none;
+  }
+
+  size_t const file_size = (size_t)file_stat.st_size;
+  void* view = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (view == MAP_FAILED) {
+    return CERROR_internal_error("c: failed to map the file");
+  }
+
+#ifdef POSIX_MADV_SEQUENTIAL
+  posix_madvise(view, file_size, POSIX_MADV_SEQUENTIAL);
+#endif
+  *out_hash = c_hash128(view, file_size, 0);
+  munmap(view, file_size);
+
+  return CERROR_none;
+#endif
+}
+
+CHashImpl
+c_hash_get_impl(void)
+{
+  internal_dispatch_init();
+
+  return internal_dispatch.impl;
+}
+
+bool
+c_hash_set_impl(CHashImpl impl)
+{
+  if (!internal_cpu_supports(impl)) { return false; }
+
+  // the default is resolved first so that it never overrides `impl` later
+  internal_dispatch_init();
+  internal_dispatch_set(impl);
+
+  return true;
+}
+
+void
+internal_dispatch_set(CHashImpl impl)
+{
+  switch (impl) {
+#if CHASH_HAS_X86_SIMD
+  case CHASH_IMPL_avx2:
+    internal_dispatch.accumulate = internal_accumulate_avx2;
+    internal_dispatch.scramble   = internal_scramble_avx2;
+    break;
+
+  case CHASH_IMPL_sse2:
+    internal_dispatch.accumulate = internal_accumulate_sse2;
+    internal_dispatch.scramble   = internal_scramble_sse2;
+    break;
+#endif
+
+  default:
+    internal_dispatch.accumulate = internal_accumulate_scalar;
+    internal_dispatch.scramble   = internal_scramble_scalar;
+  }
+
+  internal_dispatch.impl = impl;
+}
+
+char const*
+c_hash_impl_get_name(CHashImpl impl)
+{
+  switch (impl) {
+  case CHASH_IMPL_sse2:
+    return "sse2";
+  case CHASH_IMPL_avx2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+CError
+c_hash_index_create(size_t capacity, CHashIndex* out_index)
+{
+  assert(out_index);
+
+  // keep the load factor under 0.5
+  size_t real_capacity = 16;
+  while (real_capacity < capacity * 2) {
+    real_capacity <<= 1;
+  }
+
+  *out_index = (CHashIndex){0};
+
+  out_index->keys   = calloc(real_capacity, sizeof(uint64_t));
+  out_index->values = calloc(real_capacity, sizeof(size_t));
+  if (!out_index->keys || !out_index->values) {
+    c_hash_index_destroy(out_index);
+    return CERROR_memory_allocation;
+  }
+  out_index->capacity = real_capacity;
+
+  return CERROR_none;
+}
+
+CError
+c_hash_index_insert(CHashIndex* self, uint64_t key, size_t value)
+{
+  assert(self && self->capacity > 0);
+
+  if ((self->len + 1) * 2 > self->capacity) {
+    CHashIndex bigger;
+    CError     err = c_hash_index_create(self->capacity, &bigger);
+    if (err.code != 0) { return err; }
+
+    for (size_t iii = 0; iii < self->capacity; ++iii) {
+      if (self->values[iii] != 0) {
+        c_hash_index_insert(&bigger, self->keys[iii], self->values[iii] - 1);
+      }
+    }
+
+    c_hash_index_destroy(self);
+    *self = bigger;
+  }
+
+  size_t const mask = self->capacity - 1;
+  size_t       slot = (size_t)key & mask;
+  while (self->values[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+
+  self->keys[slot]   = key;
+  self->values[slot] = value + 1;
+  self->len++;
+
+  return CERROR_none;
+}
+
+bool
+c_hash_index_next(CHashIndex const* self,
+                  uint64_t          key,
+                  size_t*           cursor,
+                  size_t*           out_value)
+{
+  assert(self && cursor && out_value);
+
+  if (self->capacity == 0) { return false; }
+
+  size_t const mask = self->capacity - 1;
+  for (; *cursor < self->capacity; ++(*cursor)) {
+    size_t const slot = ((size_t)key + *cursor) & mask;
+    if (self->values[slot] == 0) { return false; }
+    if (self->keys[slot] == key) {
+      *out_value = self->values[slot] - 1;
+      ++(*cursor);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool
+c_hash_index_remove(CHashIndex* self, uint64_t key, size_t value)
+{
+  assert(self);
+
+  if (self->capacity == 0) { return false; }
+
+  size_t const mask = self->capacity - 1;
+  size_t       slot = (size_t)key & mask;
+  while (self->values[slot] != 0
+         && (self->keys[slot] != key || self->values[slot] != value + 1)) {
+    slot = (slot + 1) & mask;
+  }
+  if (self->values[slot] == 0) { return false; }
+
+  // backward shift, the following entries of the run must stay reachable
+  // from their home slot, there are no tombstones
+  size_t hole = slot;
+  for (size_t next = (hole + 1) & mask; self->values[next] != 0;
+       next      = (next + 1) & mask) {
+    size_t const home = (size_t)self->keys[next] & mask;
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      self->keys[hole]   = self->keys[next];
+      self->values[hole] = self->values[next];
+      hole               = next;
+    }
+  }
+  self->values[hole] = 0;
+  self->len--;
+
+  return true;
+}
+
+bool
+c_hash_index_move(CHashIndex* self,
+                  uint64_t    key,
+                  size_t      value,
+                  size_t      new_value)
+{
+  assert(self);
+
+  if (self->capacity == 0) { return false; }
+
+  size_t const mask = self->capacity - 1;
+  size_t       slot = (size_t)key & mask;
+  while (self->values[slot] != 0
+         && (self->keys[slot] != key || self->values[slot] != value + 1)) {
+    slot = (slot + 1) & mask;
+  }
+  if (self->values[slot] == 0) { return false; }
+
+  self->values[slot] = new_value + 1;
+
+  return true;
+}
+
+void
+c_hash_index_destroy(CHashIndex* self)
+{
+  assert(self);
+
+  free(self->keys);
+  free(self->values);
+
+  *self = (CHashIndex){0};
+}
+
+// ------------------------------------------------------------------------//
+// ------------------------------ Internals -------------------------------//
+// ------------------------------------------------------------------------//
+
+void
+internal_accumulate_scalar(uint64_t       acc[CHASH_ACC_NB],
+                           uint8_t const* data,
+                           uint8_t const* secret,
+                           size_t         stripes)
+{
+  for (size_t nnn = 0; nnn < stripes; ++nnn) {
+    uint8_t const* input = data + nnn * CHASH_STRIPE_LEN;
+    uint8_t const* key   = secret + nnn * CHASH_SECRET_CONSUME_RATE;
+
+    for (size_t iii = 0; iii < CHASH_ACC_NB; ++iii) {
+      uint64_t const data_val = internal_read64(input + 8 * iii);
+      uint64_t const data_key = data_val ^ internal_read64(key + 8 * iii);
+      acc[iii ^ 1] += data_val;
+      acc[iii] += (data_key & 0xFFFFFFFFULL) * (data_key >> 32);
+    }
+  }
+}
+
+void
+internal_scramble_scalar(uint64_t acc[CHASH_ACC_NB], uint8_t const* secret)
+{
+  for (size_t iii = 0; iii < CHASH_ACC_NB; ++iii) {
+    uint64_t value = acc[iii];
+    value ^= value >> 47;
+    value ^= internal_read64(secret + 8 * iii);
+    value *= CHASH_PRIME32_1;
+    acc[iii] = value;
+  }
+}
+
+#if CHASH_HAS_X86_SIMD
+void
+internal_accumulate_sse2(uint64_t       acc[CHASH_ACC_NB],
+                         uint8_t const* data,
+                         uint8_t const* secret,
+                         size_t         stripes)
+{
+  __m128i xacc[CHASH_ACC_NB / 2];
+  for (size_t iii = 0; iii < CHASH_ACC_NB / 2; ++iii) {
+    xacc[iii] = _mm_loadu_si128((__m128i const*)(void const*)(acc + 2 * iii));
+  }
+
+  for (size_t nnn = 0; nnn < stripes; ++nnn) {
+    uint8_t const* input = data + nnn * CHASH_STRIPE_LEN;
+    uint8_t const* key   = secret + nnn * CHASH_SECRET_CONSUME_RATE;
+
+    for (size_t iii = 0; iii < CHASH_ACC_NB / 2; ++iii) {
+      __m128i const data_vec
+          = _mm_loadu_si128((__m128i const*)(void const*)(input + 16 * iii));
+      __m128i const key_vec
+          = _mm_loadu_si128((__m128i const*)(void const*)(key + 16 * iii));
+      __m128i const data_key = _mm_xor_si128(data_vec, key_vec);
+      // low 32 bits * high 32 bits of every 64 bits lane
+      __m128i const data_key_high
+          = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+      __m128i const product = _mm_mul_epu32(data_key, data_key_high);
+      // acc[i ^ 1] += data[i]
+      __m128i const data_swap
+          = _mm_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+      xacc[iii] = _mm_add_epi64(xacc[iii], _mm_add_epi64(product, data_swap));
+    }
+  }
+
+  for (size_t iii = 0; iii < CHASH_ACC_NB / 2; ++iii) {
+    _mm_storeu_si128((__m128i*)(void*)(acc + 2 * iii), xacc[iii]);
+  }
+}
+
+void
+internal_scramble_sse2(uint64_t acc[CHASH_ACC_NB], uint8_t const* secret)
+{
+  __m128i const prime32 = _mm_set1_epi32((int)CHASH_PRIME32_1);
+
+  for (size_t iii = 0; iii < CHASH_ACC_NB / 2; ++iii) {
+    __m128i value
+        = _mm_loadu_si128((__m128i const*)(void const*)(acc + 2 * iii));
+    value = _mm_xor_si128(value, _mm_srli_epi64(value, 47));
+    value = _mm_xor_si128(
+        value,
+        _mm_loadu_si128((__m128i const*)(void const*)(secret + 16 * iii)));
+
+    // 64 bits * 32 bits multiplication out of two 32 * 32 ones
+    __m128i const value_high
+        = _mm_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1));
+    __m128i const product_low  = _mm_mul_epu32(value, prime32);
+    __m128i const product_high = _mm_mul_epu32(value_high, prime32);
+    value = _mm_add_epi64(product_low, _mm_slli_epi64(product_high, 32));
+
+    _mm_storeu_si128((__m128i*)(void*)(acc + 2 * iii), value);
+  }
+}
+
+CHASH_TARGET_AVX2 void
+internal_accumulate_avx2(uint64_t       acc[CHASH_ACC_NB],
+                         uint8_t const* data,
+                         uint8_t const* secret,
+                         size_t         stripes)
+{
+  __m256i xacc[CHASH_ACC_NB / 4];
+  for (size_t iii = 0; iii < CHASH_ACC_NB / 4; ++iii) {
+    xacc[iii]
+        = _mm256_loadu_si256((__m256i const*)(void const*)(acc + 4 * iii));
+  }
+
+  for (size_t nnn = 0; nnn < stripes; ++nnn) {
+    uint8_t const* input = data + nnn * CHASH_STRIPE_LEN;
+    uint8_t const* key   = secret + nnn * CHASH_SECRET_CONSUME_RATE;
+
+    for (size_t iii = 0; iii < CHASH_ACC_NB / 4; ++iii) {
+      __m256i const data_vec = _mm256_loadu_si256(
+          (__m256i const*)(void const*)(input + 32 * iii));
+      __m256i const key_vec
+          = _mm256_loadu_si256((__m256i const*)(void const*)(key + 32 * iii));
+      __m256i const data_key = _mm256_xor_si256(data_vec, key_vec);
+      __m256i const data_key_high
+          = _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+      __m256i const product = _mm256_mul_epu32(data_key, data_key_high);
+      __m256i const data_swap
+          = _mm256_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+      xacc[iii]
+          = _mm256_add_epi64(xacc[iii], _mm256_add_epi64(product, data_swap));
+    }
+  }
+
+  for (size_t iii = 0; iii < CHASH_ACC_NB / 4; ++iii) {
+    _mm256_storeu_si256((__m256i*)(void*)(acc + 4 * iii), xacc[iii]);
+  }
+}
+
+CHASH_TARGET_AVX2 void
+internal_scramble_avx2(uint64_t acc[CHASH_ACC_NB], uint8_t const* secret)
+{
+  __m256i const prime32 = _mm256_set1_epi32((int)CHASH_PRIME32_1);
+
+  for (size_t iii = 0; iii < CHASH_ACC_NB / 4; ++iii) {
+    __m256i value
+        = _mm256_loadu_si256((__m256i const*)(void const*)(acc + 4 * iii));
+    value = _mm256_xor_si256(value, _mm256_srli_epi64(value, 47));
+    value = _mm256_xor_si256(
+        value,
+        _mm256_loadu_si256((__m256i const*)(void const*)(secret + 32 * iii)));
+
+    __m256i const value_high
+        = _mm256_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1));
+    __m256i const product_low  = _mm256_mul_epu32(value, prime32);
+    __m256i const product_high = _mm256_mul_epu32(value_high, prime32);
+    value = _mm256_add_epi64(product_low, _mm256_slli_epi64(product_high, 32));
+
+    _mm256_storeu_si256((__m256i*)(void*)(acc + 4 * iii), value);
+  }
+}
+#endif
+
+bool
+internal_cpu_supports(CHashImpl impl)
+{
+  switch (impl) {
+  case CHASH_IMPL_scalar:
+    return true;
+
+#if CHASH_HAS_X86_SIMD
+  case CHASH_IMPL_sse2:
+    // part of the x86_64 baseline
+    return true;
+
+  case CHASH_IMPL_avx2: {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) { return false; }
+
+    // the os must save the ymm registers
+    __cpuid(info, 1);
+    bool const has_osxsave = (info[2] & (1 << 27)) != 0;
+    bool const has_avx     = (info[2] & (1 << 28)) != 0;
+    if (!has_osxsave || !has_avx || (_xgetbv(0) & 6) != 6) { return false; }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+  }
+#endif
+
+  default:
+    return false;
+  }
+}
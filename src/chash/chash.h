@@ -0,0 +1,73 @@
+#ifndef CHASH_H
+#define CHASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cerror.h"
+
+typedef struct CHash128 {
+  uint64_t low;
+  uint64_t high;
+} CHash128;
+
+typedef enum CHashImpl {
+  CHASH_IMPL_scalar,
+  CHASH_IMPL_sse2,
+  CHASH_IMPL_avx2,
+} CHashImpl;
+
+/// hash index: maps 64 bits hashes to positions inside a side array,
+/// the owner of that array is responsible for resolving collisions
+typedef struct CHashIndex {
+  uint64_t* keys;
+  size_t*   values; // value + 1, 0 marks an empty slot
+  size_t    capacity;
+  size_t    len;
+} CHashIndex;
+
+/// XXH3 style 128 bits non cryptographic hash, it uses the fastest
+/// implementation supported by the current cpu (see `c_hash_set_impl`)
+CHash128 c_hash128(void const* data, size_t data_len, uint64_t seed);
+
+CHash128 c_hash128_combine(CHash128 hash, CHash128 other);
+
+bool c_hash128_equal(CHash128 hash, CHash128 other);
+
+/// hash the content of a file, the file is memory mapped instead of read
+CError c_hash128_file(char const path[], size_t path_len, CHash128* out_hash);
+
+CHashImpl c_hash_get_impl(void);
+
+/// force a specific implementation, returns false if the cpu does not
+/// support it. not thread safe, it is meant to be called before hashing
+bool c_hash_set_impl(CHashImpl impl);
+
+char const* c_hash_impl_get_name(CHashImpl impl);
+
+CError c_hash_index_create(size_t capacity, CHashIndex* out_index);
+
+CError c_hash_index_insert(CHashIndex* self, uint64_t key, size_t value);
+
+/// iterate over all values inserted with `key`, `cursor` must be
+/// zero initialized before the first call
+bool c_hash_index_next(CHashIndex const* self,
+                       uint64_t          key,
+                       size_t*           cursor,
+                       size_t*           out_value);
+
+/// remove `value` inserted with `key`, the other values are left as they
+/// are. a side array removes an element by moving its last one into the
+/// hole, `c_hash_index_move` follows it
+bool c_hash_index_remove(CHashIndex* self, uint64_t key, size_t value);
+
+/// `value` inserted with `key` becomes `new_value`
+bool c_hash_index_move(CHashIndex* self,
+                       uint64_t    key,
+                       size_t      value,
+                       size_t      new_value);
+
+void c_hash_index_destroy(CHashIndex* self);
+
+#endif // CHASH_H
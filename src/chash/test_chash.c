@@ -0,0 +1,149 @@
+#include <chash.h>
+#include <helpers.h>
+
+#include <utest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_BUF_LEN 4096
+
+static void
+fill_buf(unsigned char buf[], size_t buf_len)
+{
+  uint32_t state = 0x12345678U;
+  for (size_t iii = 0; iii < buf_len; ++iii) {
+    state    = state * 1664525U + 1013904223U;
+    buf[iii] = (unsigned char)(state >> 24);
+  }
+}
+
+UTEST(chash, impls_agree)
+{
+  static unsigned char buf[TEST_BUF_LEN];
+  fill_buf(buf, sizeof(buf));
+
+  CHashImpl const impls[] = {CHASH_IMPL_sse2, CHASH_IMPL_avx2};
+
+  for (size_t iii = 0; iii < sizeof(impls) / sizeof(*impls); ++iii) {
+    if (!c_hash_set_impl(impls[iii])) { continue; }
+
+    for (size_t len = 0; len <= TEST_BUF_LEN; len += (len < 300 ? 1 : 97)) {
+      for (uint64_t seed = 0; seed < 2; ++seed) {
+        CHash128 const simd = c_hash128(buf, len, seed);
+        ASSERT_TRUE(c_hash_set_impl(CHASH_IMPL_scalar));
+        CHash128 const scalar = c_hash128(buf, len, seed);
+        ASSERT_TRUE(c_hash_set_impl(impls[iii]));
+
+        ASSERT_TRUE(c_hash128_equal(simd, scalar));
+      }
+    }
+  }
+}
+
+UTEST(chash, sensitivity)
+{
+  static unsigned char buf[TEST_BUF_LEN];
+  fill_buf(buf, sizeof(buf));
+
+  size_t const lens[] = {1, 7, 16, 17, 128, 129, 1024, 1025, TEST_BUF_LEN};
+  for (size_t iii = 0; iii < sizeof(lens) / sizeof(*lens); ++iii) {
+    CHash128 const orig = c_hash128(buf, lens[iii], 0);
+    ASSERT_TRUE(c_hash128_equal(orig, c_hash128(buf, lens[iii], 0)));
+    ASSERT_FALSE(c_hash128_equal(orig, c_hash128(buf, lens[iii], 1)));
+
+    // flip the first and the last bit
+    buf[0] ^= 1;
+    ASSERT_FALSE(c_hash128_equal(orig, c_hash128(buf, lens[iii], 0)));
+    buf[0] ^= 1;
+    buf[lens[iii] - 1] ^= 0x80;
+    ASSERT_FALSE(c_hash128_equal(orig, c_hash128(buf, lens[iii], 0)));
+    buf[lens[iii] - 1] ^= 0x80;
+  }
+}
+
+UTEST(chash, file)
+{
+  static unsigned char buf[TEST_BUF_LEN];
+  fill_buf(buf, sizeof(buf));
+
+  char const path[] = "test_chash_file.bin";
+  FILE*      file   = fopen(path, "wb");
+  ASSERT_TRUE(file);
+  ASSERT_EQ(fwrite(buf, 1, sizeof(buf), file), sizeof(buf));
+  fclose(file);
+
+  CHash128 hash;
+  CError   err = c_hash128_file(C_STR(path), &hash);
+  remove(path);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_TRUE(c_hash128_equal(hash, c_hash128(buf, sizeof(buf), 0)));
+
+  err = c_hash128_file(C_STR(path), &hash);
+  ASSERT_EQ(err.code, CERROR_no_such_source.code);
+}
+
+UTEST(chash, index)
+{
+  CHashIndex index;
+  CError     err = c_hash_index_create(0, &index);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  for (size_t iii = 0; iii < 1000; ++iii) {
+    err = c_hash_index_insert(&index, iii % 500, iii);
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+  }
+
+  for (uint64_t key = 0; key < 500; ++key) {
+    size_t cursor = 0;
+    size_t value;
+    size_t found = 0;
+    while (c_hash_index_next(&index, key, &cursor, &value)) {
+      ASSERT_EQ(value % 500, key);
+      found++;
+    }
+    ASSERT_EQ(found, 2U);
+  }
+
+  size_t cursor = 0;
+  size_t value;
+  ASSERT_FALSE(c_hash_index_next(&index, 501, &cursor, &value));
+
+  c_hash_index_destroy(&index);
+}
+
+UTEST(chash, index_remove)
+{
+  CHashIndex index;
+  CError     err = c_hash_index_create(0, &index);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // colliding keys, the runs cross each other
+  for (size_t iii = 0; iii < 100; ++iii) {
+    err = c_hash_index_insert(&index, iii % 7, iii);
+    ASSERT_EQ_MSG(err.code, 0, err.desc);
+  }
+
+  // the last one, then one in the middle, the last one moves into its
+  // place like it does inside the side array
+  ASSERT_TRUE(c_hash_index_remove(&index, 99 % 7, 99));
+  ASSERT_TRUE(c_hash_index_remove(&index, 42 % 7, 42));
+  ASSERT_FALSE(c_hash_index_remove(&index, 42 % 7, 42));
+  ASSERT_TRUE(c_hash_index_move(&index, 98 % 7, 98, 42));
+  ASSERT_FALSE(c_hash_index_move(&index, 98 % 7, 98, 42));
+  ASSERT_EQ(index.len, 98U);
+
+  for (size_t iii = 0; iii < 98; ++iii) {
+    size_t const position = iii == 42 ? 98 : iii;
+    size_t       cursor   = 0;
+    size_t       value;
+    size_t       found = 0;
+    while (c_hash_index_next(&index, position % 7, &cursor, &value)) {
+      found += value == iii;
+    }
+    ASSERT_EQ(found, 1U);
+  }
+
+  c_hash_index_destroy(&index);
+}
@@ -46,6 +46,7 @@ cprocess_exec(char const* const command_line[],
 
   int join_status = subprocess_join(&out_process, &status);
   c_defer_check(join_status == 0, NULL, NULL, NULL);
+  if (out_status) { *out_status = status; }
 
   if (verbose) { printf("Status: %d\n", status); }
 
@@ -74,9 +75,9 @@ cprocess_exec(char const* const command_line[],
       }
     }
 
-    // c_defer_check (false, NULL, NULL, err = CERROR_failed_command);
-    err = CERROR_failed_command;
 #endif
+
+    err = CERROR_failed_command;
   }
 
   if (out_stdout_stderr) {
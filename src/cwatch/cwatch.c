@@ -0,0 +1,288 @@
+#include "cwatch.h"
+#include "helpers.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <defer.h>
+#include <str.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+// attribute changes (touch) leave the content alone, they are not reported.
+// a file written without being closed, by an mmap or a writer that keeps
+// it open, only shows up as modified
+#define CWATCH_EVENTS                                                          \
+  (IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM         \
+   | IN_MOVED_TO | IN_DELETE_SELF)
+#endif
+
+#define CWATCH_NOT_SUPPORTED                                                   \
+  CERROR_internal_error("c: directory watching is not supported on this "      \
+                        "platform")
+
+static CStr* internal_cwatch_find(CWatch* self, int wd);
+static void  internal_cwatch_remove(CWatch* self, int wd);
+static bool  internal_cwatch_is_skipped(CWatch*    self,
+                                        char const name[],
+                                        bool       is_dir);
+
+CError
+cwatch_create(CWatchFilter filter, CWatch* out_watch)
+{
+  assert(out_watch);
+
+#ifdef __linux__
+  *out_watch = (CWatch){.fd = -1, .filter = filter};
+
+  c_array_error_t arr_err = c_array_create(sizeof(CStr), &out_watch->dirs);
+  if (arr_err.code != 0) { return CERROR_internal_error(arr_err.desc); }
+
+  out_watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (out_watch->fd < 0) {
+    c_array_destroy(&out_watch->dirs);
+    return CERROR_internal_error("c: failed to create an inotify instance");
+  }
+
+  return CERROR_none;
+#else
+  (void)filter;
+  *out_watch = (CWatch){.fd = -1};
+  return CWATCH_NOT_SUPPORTED;
+#endif
+}
+
+CError
+cwatch_add_dir(CWatch* self, char const dir_path[], size_t dir_path_len)
+{
+  assert(self);
+  assert(dir_path && dir_path_len > 0);
+
+#ifdef __linux__
+  CError err        = CERROR_none;
+  CStr   path       = {0};
+  CStr   child_path = {0};
+  DIR*   dir        = NULL;
+
+  c_defer_init(6);
+
+  c_str_error_t str_err = c_str_create(dir_path, dir_path_len, &path);
+  c_defer_err(str_err.code == 0, c_str_destroy, &path,
+              err = CERROR_internal_error(str_err.desc));
+
+  int wd = inotify_add_watch(self->fd, path.data, CWATCH_EVENTS | IN_ONLYDIR);
+  c_defer_check(wd >= 0, NULL, NULL,
+                err = CERROR_internal_error("c: failed to watch a directory"));
+
+  // descriptors are small and handed out in order, the table grows up to
+  // the newest one
+  while (self->dirs.len <= (size_t)wd) {
+    c_array_error_t arr_err = c_array_push(&self->dirs, &(CStr){0});
+    c_defer_check(arr_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(arr_err.desc));
+  }
+
+  // inotify hands back the same descriptor for an already watched directory
+  if (!internal_cwatch_find(self, wd)) {
+    str_err = c_str_clone(&path, &((CStr*)self->dirs.data)[wd]);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  (((CStr*)self->dirs.data)[wd] = (CStr){0},
+                   err = CERROR_internal_error(str_err.desc)));
+  }
+
+  str_err = c_str_create_empty(path.len + 64, &child_path);
+  c_defer_err(str_err.code == 0, c_str_destroy, &child_path,
+              err = CERROR_internal_error(str_err.desc));
+
+  dir = opendir(path.data);
+  c_defer_err(dir, closedir, dir,
+              err = CERROR_internal_error("c: failed to open a directory"));
+
+  for (struct dirent* entry = readdir(dir); entry; entry = readdir(dir)) {
+    if (internal_cwatch_is_skipped(self, entry->d_name, false)) { continue; }
+
+    str_err = c_str_format(&child_path, 0, C_STR_INV("%s/%s"), path.data,
+                           entry->d_name);
+    c_defer_check(str_err.code == 0, NULL, NULL,
+                  err = CERROR_internal_error(str_err.desc));
+
+    // symbolic links are not followed, they could loop
+    bool        is_dir = entry->d_type == DT_DIR;
+    struct stat info;
+    if (entry->d_type == DT_UNKNOWN && lstat(child_path.data, &info) == 0) {
+      is_dir = S_ISDIR(info.st_mode);
+    }
+    if (!is_dir || internal_cwatch_is_skipped(self, entry->d_name, true)) {
+      continue;
+    }
+
+    err = cwatch_add_dir(self, child_path.data, child_path.len);
+    c_defer_check(err.code == 0, NULL, NULL, NULL);
+  }
+
+  c_defer_deinit();
+
+  return err;
+#else
+  (void)dir_path_len;
+  return CWATCH_NOT_SUPPORTED;
+#endif
+}
+
+CError
+cwatch_poll(CWatch*       self,
+            int           timeout_ms,
+            CWatchHandler handler,
+            void*         extra_data,
+            size_t*       out_changes_len)
+{
+  assert(self);
+  assert(handler);
+
+#ifdef __linux__
+  CError err         = CERROR_none;
+  CStr   path        = {0};
+  size_t changes_len = 0;
+
+  c_defer_init(4);
+
+  c_str_error_t str_err = c_str_create_empty(256, &path);
+  c_defer_err(str_err.code == 0, c_str_destroy, &path,
+              err = CERROR_internal_error(str_err.desc));
+
+  struct pollfd pfd   = {.fd = self->fd, .events = POLLIN};
+  int           ready = poll(&pfd, 1, timeout_ms);
+  c_defer_check(ready >= 0 || errno == EINTR, NULL, NULL,
+                err = CERROR_internal_error("c: failed to wait for changes"));
+
+  // drain everything queued so far, the descriptor is non blocking
+  while (ready > 0) {
+    union {
+      struct inotify_event event;
+      char                 bytes[4096];
+    } buf;
+
+    ssize_t buf_len = read(self->fd, buf.bytes, sizeof(buf.bytes));
+    if (buf_len <= 0) { break; }
+
+    for (char const* ptr = buf.bytes; ptr < buf.bytes + buf_len;) {
+      struct inotify_event const* event = (struct inotify_event const*)ptr;
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        handler("", 0, extra_data);
+        changes_len++;
+        continue;
+      }
+      if (event->mask & IN_IGNORED) {
+        internal_cwatch_remove(self, event->wd);
+        continue;
+      }
+
+      CStr const* dir = internal_cwatch_find(self, event->wd);
+      if (!dir) { continue; }
+
+      if (event->len > 0) {
+        if (internal_cwatch_is_skipped(self, event->name,
+                                       event->mask & IN_ISDIR)) {
+          continue;
+        }
+        str_err = c_str_format(&path, 0, C_STR_INV("%s/%s"), dir->data,
+                               event->name);
+      } else {
+        str_err = c_str_format(&path, 0, C_STR_INV("%s"), dir->data);
+      }
+      c_defer_check(str_err.code == 0, NULL, NULL,
+                    err = CERROR_internal_error(str_err.desc));
+
+      if ((event->mask & IN_ISDIR)
+          && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+        // it may be gone already, the change is reported either way. `dir`
+        // is not valid past this point
+        (void)cwatch_add_dir(self, path.data, path.len);
+      }
+
+      handler(path.data, path.len, extra_data);
+      changes_len++;
+    }
+  }
+
+  if (out_changes_len) { *out_changes_len = changes_len; }
+
+  c_defer_deinit();
+
+  return err;
+#else
+  (void)timeout_ms;
+  (void)extra_data;
+  (void)out_changes_len;
+  return CWATCH_NOT_SUPPORTED;
+#endif
+}
+
+int
+cwatch_get_fd(CWatch const* self)
+{
+  assert(self);
+
+  return self->fd;
+}
+
+void
+cwatch_destroy(CWatch* self)
+{
+  assert(self);
+
+  for (size_t iii = 0; iii < self->dirs.len; ++iii) {
+    internal_cwatch_remove(self, (int)iii);
+  }
+  c_array_destroy(&self->dirs);
+
+#ifdef __linux__
+  if (self->fd >= 0) { close(self->fd); }
+#endif
+
+  *self = (CWatch){.fd = -1};
+}
+
+// ------------------------------------------------------------------------//
+// ------------------------------ Internals -------------------------------//
+// ------------------------------------------------------------------------//
+
+CStr*
+internal_cwatch_find(CWatch* self, int wd)
+{
+  if (wd < 0 || (size_t)wd >= self->dirs.len) { return NULL; }
+
+  CStr* dir = &((CStr*)self->dirs.data)[wd];
+  return dir->data ? dir : NULL;
+}
+
+void
+internal_cwatch_remove(CWatch* self, int wd)
+{
+  CStr* dir = internal_cwatch_find(self, wd);
+  if (dir) {
+    c_str_destroy(dir);
+    *dir = (CStr){0};
+  }
+}
+
+bool
+internal_cwatch_is_skipped(CWatch* self, char const name[], bool is_dir)
+{
+  // hidden entries, `.` and `..` included, editors keep their swap files
+  // there too
+  if (name[0] == '.') { return true; }
+
+  return is_dir && self->filter && self->filter(name, strlen(name));
+}
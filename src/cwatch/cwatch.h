@@ -0,0 +1,49 @@
+#ifndef CWATCH_H
+#define CWATCH_H
+
+#include "cerror.h"
+
+#include <array.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// whether a directory named `dir_name` is left out of the watch
+typedef bool (*CWatchFilter)(char const dir_name[], size_t dir_name_len);
+
+/// called once per changed path, an empty path means that events were lost
+/// and anything could have changed
+typedef void (*CWatchHandler)(char const path[],
+                              size_t     path_len,
+                              void*      extra_data);
+
+/// recursive directory watcher, linux only (inotify) for now
+typedef struct CWatch {
+  int          fd;
+  CArray       dirs; // CArray< CStr >, indexed by watch descriptor, a
+                     // directory no longer watched has no data
+  CWatchFilter filter;
+} CWatch;
+
+/// hidden directories are never watched, `filter` may be NULL
+CError cwatch_create(CWatchFilter filter, CWatch* out_watch);
+
+/// watch `dir_path` and all of its sub directories, new sub directories
+/// are picked up as they are created
+CError cwatch_add_dir(CWatch* self, char const dir_path[], size_t dir_path_len);
+
+/// wait up to `timeout_ms` milliseconds (-1 waits forever) for changes and
+/// report every one of them to `handler`, `out_changes_len` may be NULL
+CError cwatch_poll(CWatch*       self,
+                   int           timeout_ms,
+                   CWatchHandler handler,
+                   void*         extra_data,
+                   size_t*       out_changes_len);
+
+/// a descriptor that becomes readable when there are changes, to be used
+/// with poll()/select() next to other descriptors
+int cwatch_get_fd(CWatch const* self);
+
+void cwatch_destroy(CWatch* self);
+
+#endif // CWATCH_H
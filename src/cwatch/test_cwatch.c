@@ -0,0 +1,161 @@
+#include <cwatch.h>
+#include <helpers.h>
+
+#include <utest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct TestChanges {
+  size_t len;
+  char   last[256];
+} TestChanges;
+
+static void
+on_change(char const path[], size_t path_len, void* extra_data)
+{
+  TestChanges* changes = extra_data;
+  snprintf(changes->last, sizeof(changes->last), "%.*s", (int)path_len, path);
+  changes->len++;
+}
+
+static bool
+skip_out_dir(char const dir_name[], size_t dir_name_len)
+{
+  return dir_name_len == 3 && strncmp(dir_name, "out", 3) == 0;
+}
+
+static void
+write_file(char const path[])
+{
+  FILE* file = fopen(path, "w");
+  if (file) {
+    fputs("int x;\n", file);
+    fclose(file);
+  }
+}
+
+struct cwatch {
+  char   root[64];
+  char   path[128];
+  CWatch watch;
+};
+
+UTEST_F_SETUP(cwatch)
+{
+  strcpy(utest_fixture->root, "/tmp/test_cwatch.XXXXXX");
+  ASSERT_TRUE(mkdtemp(utest_fixture->root));
+
+  snprintf(utest_fixture->path, sizeof(utest_fixture->path), "%s/src",
+           utest_fixture->root);
+  ASSERT_EQ(mkdir(utest_fixture->path, 0755), 0);
+
+  CError err = cwatch_create(skip_out_dir, &utest_fixture->watch);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  err = cwatch_add_dir(&utest_fixture->watch, C_STR2(utest_fixture->root));
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+}
+
+UTEST_F_TEARDOWN(cwatch)
+{
+  cwatch_destroy(&utest_fixture->watch);
+
+  char cmd[128];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", utest_fixture->root);
+  ASSERT_EQ(system(cmd), 0);
+}
+
+UTEST_F(cwatch, sub_dir_file)
+{
+  char file_path[192];
+  snprintf(file_path, sizeof(file_path), "%s/main.c", utest_fixture->path);
+  write_file(file_path);
+
+  TestChanges changes = {0};
+  CError      err     = cwatch_poll(&utest_fixture->watch, 1000, on_change,
+                                    &changes, NULL);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_GE(changes.len, 1u);
+  ASSERT_STREQ(changes.last, file_path);
+}
+
+UTEST_F(cwatch, open_file)
+{
+  char file_path[192];
+  snprintf(file_path, sizeof(file_path), "%s/main.c", utest_fixture->path);
+  write_file(file_path);
+
+  TestChanges changes = {0};
+  CError      err     = cwatch_poll(&utest_fixture->watch, 1000, on_change,
+                                    &changes, NULL);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+
+  // a writer that keeps the file open is seen before it closes it
+  FILE* file = fopen(file_path, "a");
+  ASSERT_TRUE(file);
+  fputs("int y;\n", file);
+  fflush(file);
+
+  changes = (TestChanges){0};
+  err = cwatch_poll(&utest_fixture->watch, 1000, on_change, &changes, NULL);
+  fclose(file);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_GE(changes.len, 1u);
+  ASSERT_STREQ(changes.last, file_path);
+}
+
+UTEST_F(cwatch, new_dir)
+{
+  char dir_path[192];
+  snprintf(dir_path, sizeof(dir_path), "%s/new", utest_fixture->path);
+  ASSERT_EQ(mkdir(dir_path, 0755), 0);
+
+  TestChanges changes = {0};
+  CError      err     = cwatch_poll(&utest_fixture->watch, 1000, on_change,
+                                    &changes, NULL);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_STREQ(changes.last, dir_path);
+
+  // the new directory is watched as well
+  char file_path[256];
+  snprintf(file_path, sizeof(file_path), "%s/a.h", dir_path);
+  write_file(file_path);
+
+  changes = (TestChanges){0};
+  err = cwatch_poll(&utest_fixture->watch, 1000, on_change, &changes, NULL);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_STREQ(changes.last, file_path);
+}
+
+UTEST_F(cwatch, skipped)
+{
+  char path[192];
+  snprintf(path, sizeof(path), "%s/.hidden", utest_fixture->root);
+  ASSERT_EQ(mkdir(path, 0755), 0);
+  snprintf(path, sizeof(path), "%s/out", utest_fixture->root);
+  ASSERT_EQ(mkdir(path, 0755), 0);
+
+  size_t      changes_len = 0;
+  TestChanges changes     = {0};
+  CError      err = cwatch_poll(&utest_fixture->watch, 100, on_change,
+                                &changes, &changes_len);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(changes_len, 0u);
+
+  snprintf(path, sizeof(path), "%s/out/a.o", utest_fixture->root);
+  write_file(path);
+  snprintf(path, sizeof(path), "%s/.main.c.swp", utest_fixture->path);
+  write_file(path);
+
+  err = cwatch_poll(&utest_fixture->watch, 100, on_change, &changes,
+                    &changes_len);
+  ASSERT_EQ_MSG(err.code, 0, err.desc);
+  ASSERT_EQ(changes_len, 0u);
+}
+#endif